@@ -0,0 +1,15 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+// Control math of the driverless vehicles on plain data: no UObjects, no engine, only Core.
+// It's shared by the game module and by the standalone DriverlessCoreBench program.
+public class DriverlessCore : ModuleRules
+{
+	public DriverlessCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
@@ -0,0 +1,369 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ConeDelaunay.h"
+
+namespace
+{
+	// twice the signed area of ABC, positive when counter-clockwise
+	double Orient(const FVector2D& A, const FVector2D& B, const FVector2D& C)
+	{
+		return (B.X - A.X) * (C.Y - A.Y) - (B.Y - A.Y) * (C.X - A.X);
+	}
+}
+
+FConeDelaunay::FConeDelaunay(const FVector2D& Center, double Extent)
+{
+	Reset(Center, Extent);
+}
+
+void FConeDelaunay::Reset(const FVector2D& Center, double Extent)
+{
+	Vertices.Reset();
+	Sides.Reset();
+	Triangles.Reset();
+	AliveTriangles.Reset();
+	FreeTriangles.Reset();
+
+	// a triangle far outside the expected cones encloses all of them, its corners are never part of the centerline
+	const double Size = FMath::Max(Extent, 1.0) * 4.0;
+	Vertices.Add(FVector(Center.X - Size, Center.Y - Size, 0.0));
+	Vertices.Add(FVector(Center.X + 2.0 * Size, Center.Y - Size, 0.0));
+	Vertices.Add(FVector(Center.X - Size, Center.Y + 2.0 * Size, 0.0));
+	Sides.Init(EConeSide::Unknown, NumSuperVertices);
+
+	Triangles.Add({ { 0, 1, 2 }, { INDEX_NONE, INDEX_NONE, INDEX_NONE } });
+	AliveTriangles.Add(true);
+	LastTriangle = 0;
+}
+
+bool FConeDelaunay::TouchesSuperTriangle(const FTriangle& Triangle) const
+{
+	return IsSuperVertex(Triangle.V[0]) || IsSuperVertex(Triangle.V[1]) || IsSuperVertex(Triangle.V[2]);
+}
+
+bool FConeDelaunay::InCircumcircle(const FTriangle& Triangle, const FVector2D& Point) const
+{
+	const FVector2D A = GetPoint(Triangle.V[0]) - Point;
+	const FVector2D B = GetPoint(Triangle.V[1]) - Point;
+	const FVector2D C = GetPoint(Triangle.V[2]) - Point;
+
+	// positive for a point inside the circumcircle of a counter-clockwise triangle
+	const double Det =
+		A.SizeSquared() * (B.X * C.Y - C.X * B.Y) -
+		B.SizeSquared() * (A.X * C.Y - C.X * A.Y) +
+		C.SizeSquared() * (A.X * B.Y - B.X * A.Y);
+	return Det > 0.0;
+}
+
+bool FConeDelaunay::IsLeftRightEdge(const FTriangle& Triangle, int32 Edge) const
+{
+	const EConeSide Start = Sides[Triangle.V[(Edge + 1) % 3]];
+	const EConeSide End = Sides[Triangle.V[(Edge + 2) % 3]];
+	return (int32)Start * (int32)End < 0;
+}
+
+FVector FConeDelaunay::GetEdgeMidpoint(const FTriangle& Triangle, int32 Edge) const
+{
+	return 0.5 * (Vertices[Triangle.V[(Edge + 1) % 3]] + Vertices[Triangle.V[(Edge + 2) % 3]]);
+}
+
+int32 FConeDelaunay::LocateTriangle(const FVector2D& Point) const
+{
+	int32 Current = AliveTriangles.IsValidIndex(LastTriangle) && AliveTriangles[LastTriangle] ? LastTriangle : AliveTriangles.Find(true);
+
+	// walk towards the point, crossing whichever edge it's behind of. A Delaunay triangulation can't make the walk cycle,
+	// the step cap only guards against rounding on nearly degenerate triangles
+	for (int32 Step = 0; Current != INDEX_NONE && Step < Triangles.Num(); Step++)
+	{
+		const FTriangle& Triangle = Triangles[Current];
+		int32 Next = Current;
+		for (int32 Edge = 0; Edge < 3; Edge++)
+		{
+			if (Orient(GetPoint(Triangle.V[(Edge + 1) % 3]), GetPoint(Triangle.V[(Edge + 2) % 3]), Point) < 0.0)
+			{
+				Next = Triangle.N[Edge];
+				break;
+			}
+		}
+
+		if (Next == Current)
+		{
+			LastTriangle = Current;
+			return Current;
+		}
+		Current = Next;
+	}
+
+	if (Current == INDEX_NONE)
+		return INDEX_NONE; // outside the bounding triangle
+
+	for (TConstSetBitIterator<> It(AliveTriangles); It; ++It)
+	{
+		const FTriangle& Triangle = Triangles[It.GetIndex()];
+		if (Orient(GetPoint(Triangle.V[0]), GetPoint(Triangle.V[1]), Point) >= 0.0 &&
+			Orient(GetPoint(Triangle.V[1]), GetPoint(Triangle.V[2]), Point) >= 0.0 &&
+			Orient(GetPoint(Triangle.V[2]), GetPoint(Triangle.V[0]), Point) >= 0.0)
+		{
+			LastTriangle = It.GetIndex();
+			return LastTriangle;
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 FConeDelaunay::AllocateTriangle()
+{
+	if (FreeTriangles.Num() > 0)
+	{
+		const int32 Index = FreeTriangles.Pop(EAllowShrinking::No);
+		AliveTriangles[Index] = true;
+		return Index;
+	}
+
+	AliveTriangles.Add(true);
+	return Triangles.AddUninitialized();
+}
+
+void FConeDelaunay::ReplaceNeighbor(int32 Triangle, int32 EdgeStart, int32 EdgeEnd, int32 NewNeighbor)
+{
+	FTriangle& Outer = Triangles[Triangle];
+	for (int32 Edge = 0; Edge < 3; Edge++)
+	{
+		if (Outer.V[(Edge + 1) % 3] == EdgeStart && Outer.V[(Edge + 2) % 3] == EdgeEnd)
+		{
+			Outer.N[Edge] = NewNeighbor;
+			return;
+		}
+	}
+	checkNoEntry();
+}
+
+int32 FConeDelaunay::AddCone(const FVector& Location, EConeSide Side, double MergeDistance)
+{
+	const FVector2D Point(Location.X, Location.Y);
+	const int32 Containing = LocateTriangle(Point);
+	if (Containing == INDEX_NONE)
+		return INDEX_NONE;
+
+	// the cavity: triangles whose circumcircle holds the cone. It's connected, so it grows from the one the cone is in
+	CavityStamps.SetNumZeroed(Triangles.Num(), EAllowShrinking::No);
+	CavityStamp++;
+
+	Cavity.Reset();
+	CavityStack.Reset();
+	CavityStack.Push(Containing);
+	CavityStamps[Containing] = CavityStamp;
+	while (CavityStack.Num() > 0)
+	{
+		const int32 Current = CavityStack.Pop(EAllowShrinking::No);
+		Cavity.Add(Current);
+
+		for (const int32 Neighbor : Triangles[Current].N)
+		{
+			if (Neighbor != INDEX_NONE && CavityStamps[Neighbor] != CavityStamp && InCircumcircle(Triangles[Neighbor], Point))
+			{
+				CavityStamps[Neighbor] = CavityStamp;
+				CavityStack.Push(Neighbor);
+			}
+		}
+	}
+
+	// the same cone seen again, or close enough to be the same one. The cone closest to the new one is always a corner of the
+	// cavity (it would be joined to the new cone), while the triangle it falls in may well not touch it
+	int32 ClosestVertex = INDEX_NONE;
+	double ClosestDistanceSquared = FMath::Square(MergeDistance);
+	for (const int32 Current : Cavity)
+	{
+		for (const int32 Vertex : Triangles[Current].V)
+		{
+			const double DistanceSquared = FVector2D::DistSquared(GetPoint(Vertex), Point);
+			if (!IsSuperVertex(Vertex) && DistanceSquared <= ClosestDistanceSquared)
+			{
+				ClosestVertex = Vertex;
+				ClosestDistanceSquared = DistanceSquared;
+			}
+		}
+	}
+	if (ClosestVertex != INDEX_NONE)
+		return ClosestVertex - NumSuperVertices;
+
+	const int32 NewVertex = Vertices.Add(Location);
+	Sides.Add(Side);
+
+	// its outline, counter-clockwise as seen from inside
+	Boundary.Reset();
+	for (const int32 Current : Cavity)
+	{
+		const FTriangle& Triangle = Triangles[Current];
+		for (int32 Edge = 0; Edge < 3; Edge++)
+		{
+			const int32 Neighbor = Triangle.N[Edge];
+			if (Neighbor == INDEX_NONE || CavityStamps[Neighbor] != CavityStamp)
+				Boundary.Add({ Triangle.V[(Edge + 1) % 3], Triangle.V[(Edge + 2) % 3], Neighbor, INDEX_NONE });
+		}
+	}
+
+	for (const int32 Current : Cavity)
+	{
+		AliveTriangles[Current] = false;
+		FreeTriangles.Push(Current);
+	}
+
+	// fan the outline around the cone
+	for (FBoundaryEdge& Edge : Boundary)
+	{
+		Edge.NewTriangle = AllocateTriangle();
+		Triangles[Edge.NewTriangle] = { { Edge.Start, Edge.End, NewVertex }, { INDEX_NONE, INDEX_NONE, Edge.Outer } };
+		if (Edge.Outer != INDEX_NONE)
+			ReplaceNeighbor(Edge.Outer, Edge.End, Edge.Start, Edge.NewTriangle);
+	}
+
+	// and stitch the fan: across (End, cone) is the fan triangle starting at End, across (cone, Start) the one ending at Start
+	for (const FBoundaryEdge& Edge : Boundary)
+	{
+		FTriangle& Triangle = Triangles[Edge.NewTriangle];
+		for (const FBoundaryEdge& Other : Boundary)
+		{
+			if (Other.Start == Edge.End)
+				Triangle.N[0] = Other.NewTriangle;
+			if (Other.End == Edge.Start)
+				Triangle.N[1] = Other.NewTriangle;
+		}
+	}
+
+	LastTriangle = Boundary.Last().NewTriangle;
+	return NewVertex - NumSuperVertices;
+}
+
+void FConeDelaunay::TraceCenterline(const FVector& Location, const FVector& Direction, double MaxLength, TArray<FVector>& OutPoints) const
+{
+	OutPoints.Reset();
+
+	const FVector2D Point(Location.X, Location.Y);
+	const FVector2D Forward = FVector2D(Direction.X, Direction.Y).GetSafeNormal();
+	const int32 Containing = LocateTriangle(Point);
+	if (Containing == INDEX_NONE)
+		return;
+
+	// the strip may not cover the vehicle (off track, or past the last cone pair seen): look for it in the triangles around
+	int32 Current = INDEX_NONE;
+	int32 Exit = INDEX_NONE;
+	double BestAlignment = 0.0;
+
+	TArray<int32, TInlineAllocator<64>> Visited;
+	Visited.Add(Containing);
+	for (int32 i = 0; i < Visited.Num() && i < 64; i++)
+	{
+		const FTriangle& Triangle = Triangles[Visited[i]];
+		if (!TouchesSuperTriangle(Triangle))
+		{
+			for (int32 Edge = 0; Edge < 3; Edge++)
+			{
+				if (!IsLeftRightEdge(Triangle, Edge)) continue;
+
+				const FVector2D ToMidpoint = FVector2D(GetEdgeMidpoint(Triangle, Edge)) - Point;
+				const double Alignment = FVector2D::DotProduct(ToMidpoint.GetSafeNormal(), Forward);
+				if (Alignment > BestAlignment)
+				{
+					BestAlignment = Alignment;
+					Current = Visited[i];
+					Exit = Edge;
+				}
+			}
+		}
+
+		// the first ring holding the strip wins
+		if (Current != INDEX_NONE)
+			break;
+
+		for (const int32 Neighbor : Triangle.N)
+		{
+			if (Neighbor != INDEX_NONE)
+				Visited.AddUnique(Neighbor);
+		}
+	}
+
+	if (Current == INDEX_NONE)
+		return;
+
+	// every triangle of the strip has one left and one right cone plus a third, so exactly two left-right edges:
+	// it's entered through one and left through the other
+	double Length = 0.0;
+	FVector Previous = Location;
+	for (int32 Step = 0; Step < Triangles.Num(); Step++)
+	{
+		const FTriangle& Triangle = Triangles[Current];
+		const FVector Midpoint = GetEdgeMidpoint(Triangle, Exit);
+		Length += FVector::Dist2D(Previous, Midpoint);
+		OutPoints.Add(Midpoint);
+		Previous = Midpoint;
+
+		const int32 Next = Triangle.N[Exit];
+		if (Length >= MaxLength || Next == INDEX_NONE || TouchesSuperTriangle(Triangles[Next]))
+			break;
+
+		const FTriangle& NextTriangle = Triangles[Next];
+		int32 NextExit = INDEX_NONE;
+		for (int32 Edge = 0; Edge < 3; Edge++)
+		{
+			if (NextTriangle.N[Edge] != Current && IsLeftRightEdge(NextTriangle, Edge))
+				NextExit = Edge;
+		}
+
+		if (NextExit == INDEX_NONE)
+			break;
+
+		Current = Next;
+		Exit = NextExit;
+	}
+}
+
+int32 FConeDelaunay::NumTriangles() const
+{
+	int32 Count = 0;
+	for (TConstSetBitIterator<> It(AliveTriangles); It; ++It)
+		Count += TouchesSuperTriangle(Triangles[It.GetIndex()]) ? 0 : 1;
+	return Count;
+}
+
+bool FConeDelaunay::Validate() const
+{
+	for (TConstSetBitIterator<> It(AliveTriangles); It; ++It)
+	{
+		const FTriangle& Triangle = Triangles[It.GetIndex()];
+		if (Orient(GetPoint(Triangle.V[0]), GetPoint(Triangle.V[1]), GetPoint(Triangle.V[2])) <= 0.0)
+			return false;
+
+		for (int32 Edge = 0; Edge < 3; Edge++)
+		{
+			const int32 Neighbor = Triangle.N[Edge];
+			if (Neighbor == INDEX_NONE) continue;
+			if (!AliveTriangles[Neighbor])
+				return false;
+
+			const FTriangle& Other = Triangles[Neighbor];
+			const int32 Start = Triangle.V[(Edge + 1) % 3];
+			const int32 End = Triangle.V[(Edge + 2) % 3];
+			bool bLinked = false;
+			for (int32 OtherEdge = 0; OtherEdge < 3; OtherEdge++)
+				bLinked |= Other.N[OtherEdge] == It.GetIndex() && Other.V[(OtherEdge + 1) % 3] == End && Other.V[(OtherEdge + 2) % 3] == Start;
+			if (!bLinked)
+				return false;
+		}
+
+		for (int32 Vertex = NumSuperVertices; Vertex < Vertices.Num(); Vertex++)
+		{
+			if (Vertex != Triangle.V[0] && Vertex != Triangle.V[1] && Vertex != Triangle.V[2] && InCircumcircle(Triangle, GetPoint(Vertex)))
+				return false;
+		}
+	}
+	return true;
+}
+
+SIZE_T FConeDelaunay::GetAllocatedSize() const
+{
+	return Vertices.GetAllocatedSize() + Sides.GetAllocatedSize() + Triangles.GetAllocatedSize() + AliveTriangles.GetAllocatedSize()
+		+ FreeTriangles.GetAllocatedSize() + Cavity.GetAllocatedSize() + CavityStack.GetAllocatedSize() + CavityStamps.GetAllocatedSize()
+		+ Boundary.GetAllocatedSize();
+}
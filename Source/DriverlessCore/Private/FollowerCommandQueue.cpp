@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FollowerCommandQueue.h"
+
+FFollowerCommandQueue::FFollowerCommandQueue(uint32 Capacity)
+	: Queue(FMath::Max(Capacity, 2u))
+{
+}
+
+FFollowerCommandDrain FFollowerCommandQueue::Drain(double Now, double MaxAge)
+{
+	FFollowerCommandDrain Result;
+
+	// only the latest due command matters, the ones before it are superseded
+	while (const FFollowerTimedCommand* Next = Queue.Peek())
+	{
+		if (Next->Timestamp > Now)
+			break;
+
+		FFollowerTimedCommand Command;
+		Queue.Dequeue(Command);
+		Result.NumConsumed++;
+
+		if (Now - Command.Timestamp > MaxAge)
+			Result.NumStale++;
+		else
+			Result.Command = Command;
+	}
+
+	return Result;
+}
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FollowerCommandRecording.h"
+#include "HAL/FileManager.h"
+#include "Serialization/Archive.h"
+
+namespace FollowerCommandRecording
+{
+	static constexpr uint32 FileMagic = 0x43455244; // "DREC"
+	static constexpr int32 FileVersion = 1;
+}
+
+bool FFollowerCommandRecording::SaveToFile(const FString& FileName) const
+{
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FileName));
+	if (!Writer)
+		return false;
+
+	uint32 Magic = FollowerCommandRecording::FileMagic;
+	int32 Version = FollowerCommandRecording::FileVersion;
+	*Writer << Magic << Version;
+	int32 NumFrames = Frames.Num();
+	*Writer << NumFrames;
+	for (FFollowerCommandFrame Frame : Frames)
+		*Writer << Frame;
+
+	return Writer->Close();
+}
+
+bool FFollowerCommandRecording::LoadFromFile(const FString& FileName)
+{
+	Frames.Reset();
+
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FileName));
+	if (!Reader)
+		return false;
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	*Reader << Magic << Version;
+	if (Magic != FollowerCommandRecording::FileMagic || Version != FollowerCommandRecording::FileVersion)
+		return false;
+
+	int32 NumFrames = 0;
+	*Reader << NumFrames;
+	if (NumFrames < 0 || (int64)NumFrames * (int64)sizeof(FFollowerCommandFrame) > Reader->TotalSize() * 4)
+		return false;
+
+	Frames.SetNum(NumFrames);
+	for (FFollowerCommandFrame& Frame : Frames)
+		*Reader << Frame;
+
+	return !Reader->IsError();
+}
+
+const FFollowerCommandFrame* FFollowerCommandRecording::FindFrame(int32 PhysicsFrame, int32& InOutCursor) const
+{
+	if (Frames.Num() == 0 || PhysicsFrame < Frames[0].PhysicsFrame)
+		return nullptr;
+
+	InOutCursor = FMath::Clamp(InOutCursor, 0, Frames.Num() - 1);
+
+	// a rewind (e.g. a restored snapshot) searches from the start again
+	if (Frames[InOutCursor].PhysicsFrame > PhysicsFrame)
+		InOutCursor = 0;
+
+	while (InOutCursor + 1 < Frames.Num() && Frames[InOutCursor + 1].PhysicsFrame <= PhysicsFrame)
+		InOutCursor++;
+
+	return &Frames[InOutCursor];
+}
+
+void FFollowerReplayDivergence::AddPose(const FFollowerCommandFrame& Recorded, const FVector& Location, const FQuat& Rotation)
+{
+	const float PositionError = FVector::Dist(Recorded.Location, Location);
+	const float HeadingError = FMath::RadiansToDegrees(Recorded.Rotation.AngularDistance(Rotation));
+
+	NumFrames++;
+	SumPositionError += PositionError;
+	MaxPositionError = FMath::Max(MaxPositionError, PositionError);
+	FinalPositionError = PositionError;
+	MaxHeadingError = FMath::Max(MaxHeadingError, HeadingError);
+}
+
+void FFollowerReplayDivergence::AddCommands(const FFollowerCommandFrame& Recorded, float Steering, float Throttle, float Brake, float Tolerance)
+{
+	const float SteeringError = FMath::Abs(Recorded.Steering - Steering);
+	const float ThrottleError = FMath::Abs(Recorded.Throttle - Throttle);
+	const float BrakeError = FMath::Abs(Recorded.Brake - Brake);
+
+	NumCommandFrames++;
+	MaxSteeringError = FMath::Max(MaxSteeringError, SteeringError);
+	MaxThrottleError = FMath::Max(MaxThrottleError, ThrottleError);
+	MaxBrakeError = FMath::Max(MaxBrakeError, BrakeError);
+
+	if (SteeringError > Tolerance || ThrottleError > Tolerance || BrakeError > Tolerance)
+		NumCommandMismatches++;
+}
+
+FString FFollowerReplayDivergence::ToString() const
+{
+	FString Result = FString::Printf(TEXT("%d frames, position error mean %.1f cm / max %.1f cm / final %.1f cm, max heading error %.2f deg"),
+		NumFrames, GetMeanPositionError(), MaxPositionError, FinalPositionError, MaxHeadingError);
+
+	if (NumCommandFrames > 0)
+	{
+		Result += FString::Printf(TEXT("; controller vs recording: %d/%d frames differ, max error steering %.4f, throttle %.4f, brake %.4f"),
+			NumCommandMismatches, NumCommandFrames, MaxSteeringError, MaxThrottleError, MaxBrakeError);
+	}
+	return Result;
+}
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FollowerControlLaw.h"
+#include "Math/VectorRegister.h"
+
+FFollowerSpeedPlan FollowerControl::PlanSpeed(const FFollowerControlParams& Params, const FVector& CurrentTangent, const FVector& FutureTangent)
+{
+	FFollowerSpeedPlan Plan;
+
+	// dot product of the two directions, it indicates how sharp the curve is between current and future point
+	// 1.0 = Perfectly , 0.0 = 90 turn , 1.0 = A 180 U-turn
+	const float Curvature = FVector::DotProduct(CurrentTangent, FutureTangent);
+
+	/* DYNAMIC LOOK-AHEAD & THROTTLE / BRAKE */
+
+	// map the curvature (1.0 to -1.0) to a "sharpness" factor (0.0 to 1.0)
+	// BrakingSharpness indicates the sharpness that triggers full braking eg. the default is 0.8 = gentle
+	Plan.TurnSharpness = FMath::Clamp(1.0f - (Curvature / Params.BrakingSharpness), 0.0f, 1.0f);
+
+	// as the turn gets sharper, reduce look-ahead distance, to prevent cutting corners, and lower throttle + apply brakes
+	// A linear interpolation is applied to smooth the transitions
+	Plan.PredictiveThrottle = FMath::Lerp(1.0f, 0.0f, Plan.TurnSharpness * 1.2f); // reduce throttle
+	Plan.CurvatureBrake = FMath::Lerp(0.0f, 1.0f, Plan.TurnSharpness * 1.5f); // apply brakes if the turn is sharp enough
+
+	Plan.SteeringLookAhead = FMath::Lerp(Params.MaxLookAheadDistance, Params.MinLookAheadDistance, Plan.TurnSharpness);
+
+	return Plan;
+}
+
+FFollowerControlOutput FollowerControl::ComputeCommands(const FFollowerControlParams& Params, const FFollowerSpeedPlan& Plan, const FFollowerControlInput& Input)
+{
+	FFollowerControlOutput Output;
+
+	const FVector& VehicleForward = Input.VehicleForward;
+
+	// Calculate steering input
+	FVector DirectionToTarget = (Input.TargetLocation - Input.VehicleLocation).GetSafeNormal();
+
+	// proportionally blend steering and braking based on distance to obstacle, if any
+	float AvoidanceFactor = 0.0f;
+	if (Input.bAvoiding) {
+
+		AvoidanceFactor = FMath::Clamp(1.0f - (Input.ObstacleHitDistance / Params.ObstacleTraceDistance), 0.0f, 1.0f);
+		DirectionToTarget = BlendAvoidanceDirection(Params, VehicleForward, Input.SafeDirection);
+	}
+
+	const FVector CrossProduct = FVector::CrossProduct(VehicleForward, DirectionToTarget);
+	float SteeringInput = FMath::Clamp(CrossProduct.Z, -1.0f, 1.0f);
+
+	// 180 stall correction
+	if (FMath::IsNearlyZero(SteeringInput, 0.01f))
+	{
+		if (FVector::DotProduct(VehicleForward, DirectionToTarget) < 0.0f) // if facing backwards
+		{
+			// determine which direction to turn
+			float RightDot = FVector::DotProduct(Input.VehicleRight, DirectionToTarget);
+			SteeringInput = (RightDot >= 0.0f) ? 1.0f : -1.0f; // turn right or left
+		}
+	}
+
+	// Combine path following and obstacle avoidance
+	float AvoidanceBrake = FMath::Lerp(0.0f, 0.8f, FMath::Clamp((AvoidanceFactor - 0.6f) * 2.5f, 0.0f, 1.0f));
+
+	/* FINAL THROTTLE AND BRAKE */
+
+	// reduce throttle based on final steering input
+	float ReactiveThrottle = 1.0f - (FMath::Abs(SteeringInput) * 0.8f);
+	// combine throttle factors (steering and predictive braking)
+	// minimum throttle reduced based on avoidance factor
+	Output.Throttle = FMath::Min(Plan.PredictiveThrottle, ReactiveThrottle) * FMath::Lerp(1.0f, 0.2f, AvoidanceFactor) * Input.TrafficThrottleScale;
+	Output.Brake = FMath::Max3(Plan.CurvatureBrake, AvoidanceBrake, Input.TrafficBrake);
+	Output.Steering = SteeringInput;
+
+	return Output;
+}
+
+FVector FollowerControl::BlendAvoidanceDirection(const FFollowerControlParams& Params, const FVector& VehicleForward, const FVector& SafeDirection)
+{
+	return FMath::Lerp(VehicleForward, SafeDirection, Params.AvoidanceStrength).GetSafeNormal();
+}
+
+int32 FollowerControl::ScoreProbeFan(const FFollowerControlParams& Params, const FFollowerProbeWeights& Weights,
+	TConstArrayView<FVector> Directions, TConstArrayView<float> Distances,
+	const FVector& VehicleForward, const FVector& TrackDirection, float CurrentSteering, FFollowerProbeScores& Scratch)
+{
+	const int32 NumProbes = Directions.Num();
+	check(Distances.Num() == NumProbes && NumProbes > 0);
+
+	const int32 NumPadded = Align(NumProbes, 4);
+	const FVector TrackForward = TrackDirection.GetSafeNormal();
+
+	Scratch.DirectionX.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.DirectionY.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.DirectionZ.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.Clearance.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.Alignment.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.Steering.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+	Scratch.Scores.SetNumUninitialized(NumPadded, EAllowShrinking::No);
+
+	// the probes transposed to structure of arrays. Padding lanes are zero directions and distances: no clearance, no
+	// alignment and, blending the forward direction with itself, no steering
+	for (int32 i = 0; i < NumPadded; i++)
+	{
+		const bool bProbe = i < NumProbes;
+		Scratch.DirectionX[i] = bProbe ? Directions[i].X : 0.0f;
+		Scratch.DirectionY[i] = bProbe ? Directions[i].Y : 0.0f;
+		Scratch.DirectionZ[i] = bProbe ? Directions[i].Z : 0.0f;
+		Scratch.Clearance[i] = bProbe ? Distances[i] : 0.0f;
+	}
+
+	const VectorRegister4Float InvTraceDistance = VectorSetFloat1(1.0f / Params.ObstacleTraceDistance);
+	const VectorRegister4Float TrackX = VectorSetFloat1(TrackForward.X);
+	const VectorRegister4Float TrackY = VectorSetFloat1(TrackForward.Y);
+	const VectorRegister4Float TrackZ = VectorSetFloat1(TrackForward.Z);
+	const VectorRegister4Float ForwardX = VectorSetFloat1(VehicleForward.X);
+	const VectorRegister4Float ForwardY = VectorSetFloat1(VehicleForward.Y);
+	const VectorRegister4Float ForwardZ = VectorSetFloat1(VehicleForward.Z);
+	const VectorRegister4Float Strength = VectorSetFloat1(Params.AvoidanceStrength);
+	const VectorRegister4Float MinSizeSquared = VectorSetFloat1(SMALL_NUMBER); // as GetSafeNormal
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float MinusOne = VectorSetFloat1(-1.0f);
+
+	// Clearance = Distance / TraceDistance, Alignment = Direction . Track, and the steering the controller would output
+	// when avoiding towards the probe: Blended = normalize(lerp(Forward, Direction, Strength)), Steering = (Forward x Blended).Z
+	for (int32 i = 0; i < NumPadded; i += 4)
+	{
+		const VectorRegister4Float DirX = VectorLoad(&Scratch.DirectionX[i]);
+		const VectorRegister4Float DirY = VectorLoad(&Scratch.DirectionY[i]);
+		const VectorRegister4Float DirZ = VectorLoad(&Scratch.DirectionZ[i]);
+
+		VectorStore(VectorMultiply(VectorLoad(&Scratch.Clearance[i]), InvTraceDistance), &Scratch.Clearance[i]);
+
+		VectorRegister4Float Alignment = VectorMultiply(DirX, TrackX);
+		Alignment = VectorMultiplyAdd(DirY, TrackY, Alignment);
+		Alignment = VectorMultiplyAdd(DirZ, TrackZ, Alignment);
+		VectorStore(Alignment, &Scratch.Alignment[i]);
+
+		const VectorRegister4Float BlendX = VectorMultiplyAdd(Strength, VectorSubtract(DirX, ForwardX), ForwardX);
+		const VectorRegister4Float BlendY = VectorMultiplyAdd(Strength, VectorSubtract(DirY, ForwardY), ForwardY);
+		const VectorRegister4Float BlendZ = VectorMultiplyAdd(Strength, VectorSubtract(DirZ, ForwardZ), ForwardZ);
+
+		VectorRegister4Float SizeSquared = VectorMultiply(BlendX, BlendX);
+		SizeSquared = VectorMultiplyAdd(BlendY, BlendY, SizeSquared);
+		SizeSquared = VectorMultiplyAdd(BlendZ, BlendZ, SizeSquared);
+
+		// a blend too short to normalize steers nowhere
+		const VectorRegister4Float CrossZ = VectorSubtract(VectorMultiply(ForwardX, BlendY), VectorMultiply(ForwardY, BlendX));
+		const VectorRegister4Float Normalized = VectorMultiply(CrossZ, VectorReciprocalSqrt(VectorMax(SizeSquared, MinSizeSquared)));
+		const VectorRegister4Float Steering = VectorSelect(VectorCompareGE(SizeSquared, MinSizeSquared), Normalized, VectorZeroFloat());
+		VectorStore(VectorMin(VectorMax(Steering, MinusOne), One), &Scratch.Steering[i]);
+	}
+
+	// Score = Wc * Clearance + Wa * Alignment - Ws * |Steering - CurrentSteering|
+	const VectorRegister4Float WClear = VectorSetFloat1(Weights.Clearance);
+	const VectorRegister4Float WAlign = VectorSetFloat1(Weights.TrackAlignment);
+	const VectorRegister4Float WSteer = VectorSetFloat1(-Weights.SteeringChange);
+	const VectorRegister4Float CurrentSteer = VectorSetFloat1(CurrentSteering);
+
+	for (int32 i = 0; i < NumPadded; i += 4)
+	{
+		const VectorRegister4Float SteerChange = VectorAbs(VectorSubtract(VectorLoad(&Scratch.Steering[i]), CurrentSteer));
+		VectorRegister4Float Score = VectorMultiply(WSteer, SteerChange);
+		Score = VectorMultiplyAdd(WAlign, VectorLoad(&Scratch.Alignment[i]), Score);
+		Score = VectorMultiplyAdd(WClear, VectorLoad(&Scratch.Clearance[i]), Score);
+		VectorStore(Score, &Scratch.Scores[i]);
+	}
+
+	int32 BestProbe = 0;
+	for (int32 i = 1; i < NumProbes; i++)
+	{
+		if (Scratch.Scores[i] > Scratch.Scores[BestProbe] + KINDA_SMALL_NUMBER)
+			BestProbe = i;
+	}
+
+	return BestProbe;
+}
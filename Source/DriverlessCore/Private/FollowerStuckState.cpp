@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FollowerStuckState.h"
+
+FFollowerStuckOutput FFollowerStuckState::Update(const FFollowerStuckParams& Params, float DeltaTime, float ForwardSpeed)
+{
+	FFollowerStuckOutput Output;
+
+	if (StuckTime < 0.0f) // reversing
+	{
+		Output.bOverride = true;
+		Output.TargetGear = -1; // reverse
+		Output.Throttle = 1.0f;
+		Output.Steering = RecoverySteer;
+		Output.Brake = 0.0f;
+
+		StuckTime += DeltaTime;
+
+		if (StuckTime >= 0.0f) {
+			StuckTime = Params.MaxStuckTime / 2;
+			bPostRecovery = true;
+			Output.TargetGear = 1; // forward
+		}
+
+		return Output;
+	}
+
+	if (StuckTime > 0.0f && bPostRecovery) {
+		// after recovery, drive forward for a short while
+		Output.bOverride = true;
+		StuckTime -= DeltaTime;
+
+		if (StuckTime <= 0.0f) {
+			StuckTime = 0.0f;
+			bPostRecovery = false;
+			Output.Throttle = 0.0f;
+		}
+		return Output;
+	}
+
+	// if we're practically still, update the stuck timer. Otherwise, reset it
+	if (FMath::Abs(ForwardSpeed) < Params.StuckSpeedThreshold)
+		StuckTime += DeltaTime;
+	else
+		StuckTime = 0.0f;
+
+	// if we're stuck for too long, the caller initiates reversing
+	if (StuckTime > Params.MaxStuckTime)
+	{
+		Output.bStartRecovery = true;
+		Output.bOverride = true;
+	}
+
+	return Output;
+}
+
+void FFollowerStuckState::StartRecovery(const FFollowerStuckParams& Params, bool bRecoverRight)
+{
+	StuckTime = -Params.UnstuckTime;
+	RecoverySteer = bRecoverRight ? 1.0f : -1.0f;
+	bPostRecovery = false;
+}
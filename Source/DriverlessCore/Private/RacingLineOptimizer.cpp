@@ -0,0 +1,451 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RacingLineOptimizer.h"
+#include "TrackTable.h"
+
+namespace
+{
+	// keeps the Hessian definite on straights, where shifting the whole line sideways costs no curvature.
+	// Bends of the line longer than this (cm) cost less than the offsets they take
+	constexpr double RegularizationWavelength = 20000.0;
+	// a held offset is released when its gradient points inside the bounds by more than this
+	constexpr double GradientTolerance = 1e-7;
+
+	// level unit vector to the right of a direction
+	FVector2D GetRight(const FVector2D& Direction)
+	{
+		return FVector2D(-Direction.Y, Direction.X);
+	}
+}
+
+bool FRacingLineOptimizer::Solve(const FTrackTable& Track, const FRacingLineParams& Params, TArray<float>& OutOffsets)
+{
+	NumIterations = 0;
+	bConverged = true;
+
+	Num = Track.Num();
+	bLoop = Track.bClosedLoop;
+	if (Num < 5 || !Track.HasBoundaries())
+		return false;
+
+	// the offsets move the line along the centerline's normals, the curvature is measured along the line's own
+	TArray<FVector2D> Centers, Rights, Line, Normals;
+	TArray<double> Weights;
+	Centers.SetNumUninitialized(Num);
+	Rights.SetNumUninitialized(Num);
+	Line.SetNumUninitialized(Num);
+	Normals.SetNumUninitialized(Num);
+	Weights.SetNumUninitialized(Num);
+
+	Offsets.SetNumUninitialized(Num);
+	Lower.SetNumUninitialized(Num);
+	Upper.SetNumUninitialized(Num);
+	Bounds.SetNumUninitialized(Num);
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		Centers[i] = FVector2D(Track.Locations[i]);
+		Rights[i] = GetRight(FVector2D(Track.Directions[i]).GetSafeNormal());
+
+		// a stretch narrower than the margins is held in its middle
+		Lower[i] = Track.LeftBoundary[i] + Params.Margin;
+		Upper[i] = Track.RightBoundary[i] - Params.Margin;
+		if (Lower[i] > Upper[i])
+			Lower[i] = Upper[i] = 0.5 * (Track.LeftBoundary[i] + Track.RightBoundary[i]);
+
+		Offsets[i] = FMath::Clamp(0.0, Lower[i], Upper[i]);
+	}
+
+	for (int32 Linearization = 0; Linearization < FMath::Max(Params.NumLinearizations, 1); Linearization++)
+	{
+		// normals of the line so far, and the weight of its curvature. The curvature is the second difference over the
+		// length h between samples squared, so its square integrated over h is the squared second difference / h^3:
+		// the weight of a squared residual is (centerline spacing / h)^3, its square root scales the residual
+		for (int32 i = 0; i < Num; i++)
+			Line[i] = Centers[i] + Rights[i] * Offsets[i];
+
+		for (int32 i = 0; i < Num; i++)
+		{
+			const int32 Prev = bLoop ? (i - 1 + Num) % Num : FMath::Max(i - 1, 0);
+			const int32 Next = bLoop ? (i + 1) % Num : FMath::Min(i + 1, Num - 1);
+			Normals[i] = GetRight((Line[Next] - Line[Prev]).GetSafeNormal());
+
+			// two steps apart, but one at the ends of an open track (and Next - Prev is negative across the seam of a loop)
+			const double Spacing = FVector2D::Distance(Line[Next], Line[Prev]) / (bLoop ? 2 : FMath::Max(Next - Prev, 1));
+			Weights[i] = FMath::Pow(Track.SampleSpacing / FMath::Max(Spacing, 1.0), 3.0);
+		}
+
+		BuildProblem(Centers, Rights, Normals, Weights, Track.SampleSpacing);
+
+		// the bounds the last line reached are held to start with
+		for (int32 i = 0; i < Num; i++)
+			Bounds[i] = (Offsets[i] <= Lower[i]) ? -1 : (Offsets[i] >= Upper[i] ? 1 : 0);
+
+		bConverged &= SolveBounded(Params.MaxIterations);
+	}
+
+	OutOffsets.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+		OutOffsets[i] = (float)Offsets[i];
+
+	return true;
+}
+
+void FRacingLineOptimizer::BuildProblem(TConstArrayView<FVector2D> Centers, TConstArrayView<FVector2D> Rights,
+	TConstArrayView<FVector2D> Normals, TConstArrayView<double> Weights, float Spacing)
+{
+	// second differences shrink a bend of wavelength L by (2 pi Spacing / L)^2, the regularization matches them at L
+	Diag.Init(FMath::Square(FMath::Square(UE_TWO_PI * Spacing / RegularizationWavelength)), Num);
+	Band1.Init(0.0, Num);
+	Band2.Init(0.0, Num);
+	Linear.Init(0.0, Num);
+
+	// curvature at i ~ N(i) . (P(i - 1) - 2 P(i) + P(i + 1)), with P(j) = Center(j) + Right(j) * Offset(j).
+	// Open tracks have no curvature at their ends
+	const int32 First = bLoop ? 0 : 1;
+	const int32 Last = bLoop ? Num - 1 : Num - 2;
+	for (int32 i = First; i <= Last; i++)
+	{
+		const int32 Indices[3] = { (i - 1 + Num) % Num, i, (i + 1) % Num };
+		const double RowWeights[3] = { 1.0, -2.0, 1.0 };
+		const double Scale = FMath::Sqrt(Weights[i]);
+
+		const FVector2D SecondDifference = Centers[Indices[0]] - 2.0 * Centers[i] + Centers[Indices[2]];
+		const double Residual = Scale * FVector2D::DotProduct(Normals[i], SecondDifference);
+
+		double Coefficients[3];
+		for (int32 p = 0; p < 3; p++)
+			Coefficients[p] = Scale * RowWeights[p] * FVector2D::DotProduct(Normals[i], Rights[Indices[p]]);
+
+		// the row's outer product lands on three diagonals, stored from its lower index
+		for (int32 p = 0; p < 3; p++)
+		{
+			Linear[Indices[p]] += Coefficients[p] * Residual;
+			Diag[Indices[p]] += Coefficients[p] * Coefficients[p];
+		}
+		Band1[Indices[0]] += Coefficients[0] * Coefficients[1];
+		Band1[Indices[1]] += Coefficients[1] * Coefficients[2];
+		Band2[Indices[0]] += Coefficients[0] * Coefficients[2];
+	}
+}
+
+double FRacingLineOptimizer::GetHessianEntry(int32 J, int32 K) const
+{
+	if (J > K)
+		Swap(J, K);
+
+	const int32 Delta = K - J;
+	if (Delta == 0)
+		return Diag[J];
+	if (Delta <= 2)
+		return (Delta == 1) ? Band1[J] : Band2[J];
+
+	// on loops the last samples are next to the first ones
+	if (bLoop && Num - Delta <= 2)
+		return (Num - Delta == 1) ? Band1[K] : Band2[K];
+
+	return 0.0;
+}
+
+void FRacingLineOptimizer::MultiplyHessian(TConstArrayView<double> X, TArray<double>& OutResult) const
+{
+	OutResult.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+		OutResult[i] = Diag[i] * X[i];
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		const int32 Next = i + 1;
+		const int32 After = i + 2;
+		if (bLoop || Next < Num)
+		{
+			const int32 j = Next % Num;
+			OutResult[i] += Band1[i] * X[j];
+			OutResult[j] += Band1[i] * X[i];
+		}
+		if (bLoop || After < Num)
+		{
+			const int32 j = After % Num;
+			OutResult[i] += Band2[i] * X[j];
+			OutResult[j] += Band2[i] * X[i];
+		}
+	}
+}
+
+bool FRacingLineOptimizer::SolveBounded(int32 MaxIterations)
+{
+	for (int32 Iteration = 0; Iteration < MaxIterations; Iteration++, NumIterations++)
+	{
+		if (!SolveFree())
+			return false;
+
+		// step towards the minimum of the free offsets, as far as the bounds let it
+		double Step = 1.0;
+		for (const int32 i : Free)
+		{
+			const double Delta = Target[i] - Offsets[i];
+			if (Offsets[i] + Delta < Lower[i])
+				Step = FMath::Min(Step, (Lower[i] - Offsets[i]) / Delta);
+			else if (Offsets[i] + Delta > Upper[i])
+				Step = FMath::Min(Step, (Upper[i] - Offsets[i]) / Delta);
+		}
+
+		if (Step < 1.0)
+		{
+			// the offsets reaching a bound on the way are held there from now on
+			Step = FMath::Max(Step, 0.0);
+			for (const int32 i : Free)
+			{
+				Offsets[i] += Step * (Target[i] - Offsets[i]);
+				if (Offsets[i] <= Lower[i] + UE_DOUBLE_KINDA_SMALL_NUMBER)
+				{
+					Offsets[i] = Lower[i];
+					Bounds[i] = -1;
+				}
+				else if (Offsets[i] >= Upper[i] - UE_DOUBLE_KINDA_SMALL_NUMBER)
+				{
+					Offsets[i] = Upper[i];
+					Bounds[i] = 1;
+				}
+			}
+			continue;
+		}
+
+		for (const int32 i : Free)
+			Offsets[i] = Target[i];
+
+		// the held offset whose gradient pulls it back inside the most is released, none means the minimum is reached.
+		// Releasing them all at once can cycle, they push each other back out. An offset with no room between its bounds
+		// (a stretch narrower than the margins) would only be held again by a zero step, it stays where it is
+		MultiplyHessian(Offsets, Gradient);
+		int32 Released = INDEX_NONE;
+		double MaxPull = GradientTolerance;
+		for (int32 i = 0; i < Num; i++)
+		{
+			if (Lower[i] == Upper[i])
+				continue;
+
+			const double Pull = Bounds[i] * (Gradient[i] + Linear[i]);
+			if (Pull > MaxPull)
+			{
+				Released = i;
+				MaxPull = Pull;
+			}
+		}
+
+		if (Released == INDEX_NONE)
+			return true;
+		Bounds[Released] = 0;
+	}
+
+	return false;
+}
+
+bool FRacingLineOptimizer::SolveFree()
+{
+	Free.Reset();
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (Bounds[i] == 0)
+			Free.Add(i);
+	}
+
+	// the held offsets move to the right hand side: H(F, F) x(F) = -(Linear + H(F, Held) x(Held))
+	Target.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+		Target[i] = (Bounds[i] == 0) ? 0.0 : Offsets[i];
+
+	MultiplyHessian(Target, Gradient);
+
+	const int32 NumFree = Free.Num();
+	if (NumFree == 0)
+		return true;
+
+	// on loops the first and last free offsets are coupled across the start, the last two are solved apart
+	const int32 NumBorder = (bLoop && NumFree > 4) ? 2 : 0;
+	const int32 NumInner = NumFree - NumBorder;
+
+	if (!FactorInner(NumInner))
+		return false;
+
+	Rhs.SetNumUninitialized(NumInner);
+	for (int32 i = 0; i < NumInner; i++)
+		Rhs[i] = -(Linear[Free[i]] + Gradient[Free[i]]);
+	SolveInner(Rhs, NumInner);
+
+	if (NumBorder == 0)
+	{
+		for (int32 i = 0; i < NumInner; i++)
+			Target[Free[i]] = Rhs[i];
+		return true;
+	}
+
+	// coupling of the inner offsets with the two border ones, only the ones within two samples of them can be non zero
+	auto IsNearBorder = [NumInner](int32 i) { return i < 4 || i >= NumInner - 4; };
+	const int32 Border[2] = { Free[NumInner], Free[NumInner + 1] };
+
+	Border0.Init(0.0, NumInner);
+	Border1.Init(0.0, NumInner);
+	for (int32 i = 0; i < NumInner; i++)
+	{
+		if (!IsNearBorder(i)) continue;
+		Border0[i] = GetHessianEntry(Free[i], Border[0]);
+		Border1[i] = GetHessianEntry(Free[i], Border[1]);
+	}
+	SolveInner(Border0, NumInner);
+	SolveInner(Border1, NumInner);
+
+	// Schur complement of the inner block, S = H(Border) - E^T H(Inner)^-1 E, and its right hand side
+	double S00 = GetHessianEntry(Border[0], Border[0]);
+	double S01 = GetHessianEntry(Border[0], Border[1]);
+	double S11 = GetHessianEntry(Border[1], Border[1]);
+	double R0 = -(Linear[Border[0]] + Gradient[Border[0]]);
+	double R1 = -(Linear[Border[1]] + Gradient[Border[1]]);
+	for (int32 i = 0; i < NumInner; i++)
+	{
+		if (!IsNearBorder(i)) continue;
+		const double E0 = GetHessianEntry(Free[i], Border[0]);
+		const double E1 = GetHessianEntry(Free[i], Border[1]);
+		S00 -= E0 * Border0[i];
+		S01 -= E0 * Border1[i];
+		S11 -= E1 * Border1[i];
+		R0 -= E0 * Rhs[i];
+		R1 -= E1 * Rhs[i];
+	}
+
+	const double Determinant = S00 * S11 - S01 * S01;
+	if (Determinant <= 0.0)
+		return false;
+
+	const double X0 = (S11 * R0 - S01 * R1) / Determinant;
+	const double X1 = (S00 * R1 - S01 * R0) / Determinant;
+
+	for (int32 i = 0; i < NumInner; i++)
+		Target[Free[i]] = Rhs[i] - Border0[i] * X0 - Border1[i] * X1;
+	Target[Border[0]] = X0;
+	Target[Border[1]] = X1;
+	return true;
+}
+
+bool FRacingLineOptimizer::FactorInner(int32 NumInner)
+{
+	FactorD.SetNumUninitialized(NumInner);
+	FactorL1.SetNumUninitialized(NumInner);
+	FactorL2.SetNumUninitialized(NumInner);
+
+	// entries between inner offsets never wrap: a wrapping pair always involves one of the two border offsets
+	auto GetInnerEntry = [this](int32 A, int32 B)
+	{
+		const int32 Delta = Free[B] - Free[A];
+		if (Delta == 1) return Band1[Free[A]];
+		if (Delta == 2) return Band2[Free[A]];
+		return 0.0;
+	};
+
+	for (int32 i = 0; i < NumInner; i++)
+	{
+		double D = Diag[Free[i]];
+		if (i >= 1) D -= FMath::Square(FactorL1[i - 1]) * FactorD[i - 1];
+		if (i >= 2) D -= FMath::Square(FactorL2[i - 2]) * FactorD[i - 2];
+		if (D <= 0.0)
+			return false;
+		FactorD[i] = D;
+
+		double L1 = (i + 1 < NumInner) ? GetInnerEntry(i, i + 1) : 0.0;
+		if (i >= 1) L1 -= FactorL1[i - 1] * FactorL2[i - 1] * FactorD[i - 1];
+		FactorL1[i] = L1 / D;
+
+		FactorL2[i] = (i + 2 < NumInner) ? GetInnerEntry(i, i + 2) / D : 0.0;
+	}
+
+	return true;
+}
+
+void FRacingLineOptimizer::SolveInner(TArray<double>& InOutVector, int32 NumInner) const
+{
+	for (int32 i = 1; i < NumInner; i++)
+	{
+		InOutVector[i] -= FactorL1[i - 1] * InOutVector[i - 1];
+		if (i >= 2) InOutVector[i] -= FactorL2[i - 2] * InOutVector[i - 2];
+	}
+
+	for (int32 i = 0; i < NumInner; i++)
+		InOutVector[i] /= FactorD[i];
+
+	for (int32 i = NumInner - 2; i >= 0; i--)
+	{
+		InOutVector[i] -= FactorL1[i] * InOutVector[i + 1];
+		if (i + 2 < NumInner) InOutVector[i] -= FactorL2[i] * InOutVector[i + 2];
+	}
+}
+
+TSharedRef<FTrackTable> FRacingLineOptimizer::BuildLineTable(const FTrackTable& Track, TConstArrayView<float> Offsets, float SampleSpacing)
+{
+	check(Offsets.Num() == Track.Num());
+
+	// the line through the offsets, closed back onto its start on loops, and the centerline distance of each point
+	TArray<FVector> Points;
+	TArray<float> Stations;
+	for (int32 i = 0; i < Track.Num(); i++)
+	{
+		const FVector Right = FVector::CrossProduct(FVector::UpVector, Track.Directions[i]).GetSafeNormal();
+		Points.Add(Track.Locations[i] + Right * Offsets[i]);
+		Stations.Add(i * Track.SampleSpacing);
+	}
+	if (Track.bClosedLoop)
+	{
+		Points.Add(Points[0]);
+		Stations.Add(Track.Length);
+	}
+
+	TArray<float> Distances;
+	Distances.SetNumUninitialized(Points.Num());
+	Distances[0] = 0.0f;
+	for (int32 i = 1; i < Points.Num(); i++)
+		Distances[i] = Distances[i - 1] + FVector::Dist(Points[i - 1], Points[i]);
+
+	const float LineLength = Distances.Last();
+	const int32 NumSamples = FMath::Max(2, FMath::CeilToInt32(LineLength / FMath::Max(SampleSpacing, 1.0f)) + 1);
+	const float Spacing = LineLength / (NumSamples - 1);
+
+	// evenly spaced along the line, as the table expects
+	TArray<FVector> Locations;
+	TArray<float> SampleStations;
+	Locations.SetNumUninitialized(NumSamples);
+	SampleStations.SetNumUninitialized(NumSamples);
+	int32 Segment = 0;
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		const float Distance = FMath::Min(i * Spacing, LineLength);
+		while (Segment < Points.Num() - 2 && Distances[Segment + 1] < Distance)
+			Segment++;
+
+		const float SegmentLength = Distances[Segment + 1] - Distances[Segment];
+		const float Alpha = (SegmentLength > UE_SMALL_NUMBER) ? (Distance - Distances[Segment]) / SegmentLength : 0.0f;
+		Locations[i] = FMath::Lerp(Points[Segment], Points[Segment + 1], Alpha);
+		SampleStations[i] = FMath::Lerp(Stations[Segment], Stations[Segment + 1], Alpha);
+	}
+
+	TArray<FVector> Directions, Tangents;
+	Directions.SetNumUninitialized(NumSamples);
+	Tangents.SetNumUninitialized(NumSamples);
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		// on loops the last sample is the first one again, its neighbours are across the start
+		int32 Prev = i - 1;
+		int32 Next = i + 1;
+		if (Track.bClosedLoop)
+		{
+			Prev = (i == 0) ? NumSamples - 2 : Prev;
+			Next = (i == NumSamples - 1) ? 1 : Next;
+		}
+		Prev = FMath::Max(Prev, 0);
+		Next = FMath::Min(Next, NumSamples - 1);
+
+		Directions[i] = (Locations[Next] - Locations[Prev]).GetSafeNormal();
+		Tangents[i] = Directions[i] * Track.GetTangentAtDistance(SampleStations[i]).Size();
+	}
+
+	return FTrackTable::BuildFromSamples(MoveTemp(Locations), MoveTemp(Directions), MoveTemp(Tangents), Spacing, Track.bClosedLoop);
+}
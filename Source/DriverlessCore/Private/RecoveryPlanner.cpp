@@ -0,0 +1,647 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RecoveryPlanner.h"
+
+namespace
+{
+	constexpr float HeadingStep = UE_TWO_PI / FRecoveryPlanner::NumHeadings;
+
+	// motions 0-2 forward, 3-5 reverse, each steering left, straight and right
+	int32 GetMotionDirection(int32 Motion) { return Motion < 3 ? 1 : -1; }
+	int32 GetMotionSteer(int32 Motion) { return Motion % 3 - 1; }
+
+	int32 WrapHeading(int32 Heading)
+	{
+		return (Heading % FRecoveryPlanner::NumHeadings + FRecoveryPlanner::NumHeadings) % FRecoveryPlanner::NumHeadings;
+	}
+}
+
+void FRecoveryPlanner::Init(const FRecoveryPlannerParams& InParams, const FVector2D& Center)
+{
+	Reset();
+
+	Params = InParams;
+	Params.CellSize = FMath::Max(Params.CellSize, 1.0f);
+	Params.MinTurnRadius = FMath::Max(Params.MinTurnRadius, Params.CellSize);
+	GridSize = FMath::Clamp(Params.GridSize, 8, 1024);
+	Origin = Center - FVector2D(0.5f * GridSize * Params.CellSize);
+
+	// the buffers of the previous incident are reused, they only grow with the grid
+	const int32 NumCells = GridSize * GridSize;
+	Occupied.Init(false, NumCells);
+	Collisions.SetNumUninitialized(NumCells, EAllowShrinking::No);
+	FMemory::Memzero(Collisions.GetData(), Collisions.NumBytes());
+	GoalHeadings.Init(INDEX_NONE, NumCells);
+
+	const int32 NumStates = NumCells * NumHeadings;
+	G.Init(Unreachable, NumStates);
+	Rhs.Init(Unreachable, NumStates);
+	HeapIndex.Init(INDEX_NONE, NumStates);
+	Stamps.SetNumUninitialized(NumStates, EAllowShrinking::No);
+	FMemory::Memzero(Stamps.GetData(), Stamps.NumBytes());
+	Stamp = 0;
+
+	BuildTables();
+}
+
+void FRecoveryPlanner::Reset()
+{
+	GridSize = 0;
+	Origin = FVector2D::ZeroVector;
+
+	// emptied but kept allocated for the next Init
+	Occupied.Reset();
+	Collisions.Reset();
+	GoalHeadings.Reset();
+	G.Reset();
+	Rhs.Reset();
+	HeapIndex.Reset();
+	Stamps.Reset();
+	Stamp = 0;
+	Heap.Reset();
+	HeapKeys.Reset();
+	ChangedStates.Reset();
+	RepairStates.Reset();
+
+	StartState = INDEX_NONE;
+	LastState = INDEX_NONE;
+	KeyModifier = 0.0f;
+	bSearched = false;
+	NumExpansions = 0;
+}
+
+bool FRecoveryPlanner::IsInFootprint(int32 OffsetX, int32 OffsetY, int32 Heading) const
+{
+	const FVector2D Offset(OffsetX * Params.CellSize, OffsetY * Params.CellSize);
+	const FVector2D Forward(FMath::Cos(Heading * HeadingStep), FMath::Sin(Heading * HeadingStep));
+	const float DiscOffset = FMath::Max(0.5f * (Params.VehicleLength - Params.VehicleWidth), 0.0f);
+	const float RadiusSquared = FMath::Square(0.5f * Params.VehicleWidth + Params.Margin);
+
+	return FVector2D::DistSquared(Offset, Forward * DiscOffset) <= RadiusSquared
+		|| FVector2D::DistSquared(Offset, -Forward * DiscOffset) <= RadiusSquared;
+}
+
+void FRecoveryPlanner::BuildTables()
+{
+	// cells under the vehicle at each heading
+	const int32 Reach = FMath::CeilToInt32((0.5f * FMath::Max(Params.VehicleLength, Params.VehicleWidth) + Params.Margin) / Params.CellSize);
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		Footprints[Heading].Reset();
+		for (int32 Y = -Reach; Y <= Reach; Y++)
+		{
+			for (int32 X = -Reach; X <= Reach; X++)
+			{
+				if (IsInFootprint(X, Y, Heading))
+					Footprints[Heading].Add({ (int16)X, (int16)Y, (int16)Heading });
+			}
+		}
+	}
+
+	// each arc turns by one heading step at full lock, straight ones are as long
+	const float Length = Params.MinTurnRadius * HeadingStep;
+	const int32 NumSamples = FMath::Max(2, FMath::CeilToInt32(Length / Params.CellSize));
+	const float SampleLength = Length / NumSamples;
+
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		Predecessors[Heading].Reset();
+		SampleSources[Heading].Reset();
+	}
+
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		for (int32 Motion = 0; Motion < NumMotions; Motion++)
+		{
+			const int32 Direction = GetMotionDirection(Motion);
+			const int32 Steer = GetMotionSteer(Motion);
+			const float Curvature = Steer / Params.MinTurnRadius;
+
+			FMotionTable& Table = Motions[Heading][Motion];
+			Table.Samples.Reset();
+
+			double X = 0.0, Y = 0.0, Yaw = Heading * HeadingStep;
+			for (int32 Sample = 0; Sample < NumSamples; Sample++)
+			{
+				if (Steer == 0)
+				{
+					X += Direction * FMath::Cos(Yaw) * SampleLength;
+					Y += Direction * FMath::Sin(Yaw) * SampleLength;
+				}
+				else
+				{
+					// exact arc: reversing with the same lock turns the other way
+					const double NextYaw = Yaw + Direction * Curvature * SampleLength;
+					X += (FMath::Sin(NextYaw) - FMath::Sin(Yaw)) / Curvature;
+					Y -= (FMath::Cos(NextYaw) - FMath::Cos(Yaw)) / Curvature;
+					Yaw = NextYaw;
+				}
+
+				const FPoseOffset Pose = { (int16)FMath::RoundToInt32(X / Params.CellSize), (int16)FMath::RoundToInt32(Y / Params.CellSize),
+					(int16)WrapHeading(FMath::RoundToInt32(Yaw / HeadingStep)) };
+				if (Table.Samples.Num() == 0 || !(Table.Samples.Last() == Pose))
+					Table.Samples.Add(Pose);
+			}
+
+			Table.End = Table.Samples.Last();
+
+			// never cheaper than the distance between the rounded ends, so the heuristic stays admissible
+			const float Chord = FMath::Sqrt((float)(FMath::Square(Table.End.X) + FMath::Square(Table.End.Y))) * Params.CellSize;
+			Table.Cost = FMath::Max(Length, Chord) * (Direction < 0 ? Params.ReverseCostScale : 1.0f) * (Steer != 0 ? Params.SteerCostScale : 1.0f);
+
+			Predecessors[Table.End.Heading].Add({ Table.End.X, Table.End.Y, (int8)Heading, (int8)Motion });
+			for (const FPoseOffset& Sample : Table.Samples)
+				SampleSources[Sample.Heading].AddUnique({ Sample.X, Sample.Y, (int16)Heading });
+		}
+	}
+
+	// poses straight ahead a goal has to be free over
+	const int32 NumClearance = FMath::Max(1, FMath::CeilToInt32(Params.GoalClearance / Params.CellSize));
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		ClearanceOffsets[Heading].Reset();
+		for (int32 Step = 1; Step <= NumClearance; Step++)
+		{
+			ClearanceOffsets[Heading].AddUnique({ (int16)FMath::RoundToInt32(FMath::Cos(Heading * HeadingStep) * Step),
+				(int16)FMath::RoundToInt32(FMath::Sin(Heading * HeadingStep) * Step), (int16)Heading });
+		}
+	}
+}
+
+FVector2D FRecoveryPlanner::GetCellCenter(int32 X, int32 Y) const
+{
+	return Origin + FVector2D((X + 0.5f) * Params.CellSize, (Y + 0.5f) * Params.CellSize);
+}
+
+bool FRecoveryPlanner::GetCell(const FVector2D& Location, int32& OutX, int32& OutY) const
+{
+	OutX = FMath::FloorToInt32((Location.X - Origin.X) / Params.CellSize);
+	OutY = FMath::FloorToInt32((Location.Y - Origin.Y) / Params.CellSize);
+	return IsInGrid(OutX, OutY);
+}
+
+bool FRecoveryPlanner::IsInside(const FVector2D& Location) const
+{
+	int32 X, Y;
+	return IsInitialized() && GetCell(Location, X, Y);
+}
+
+void FRecoveryPlanner::DecodeState(int32 State, int32& OutX, int32& OutY, int32& OutHeading) const
+{
+	OutHeading = State % NumHeadings;
+	const int32 Cell = State / NumHeadings;
+	OutX = Cell % GridSize;
+	OutY = Cell / GridSize;
+}
+
+void FRecoveryPlanner::SetGoalHeading(int32 X, int32 Y, float Heading)
+{
+	if (IsInGrid(X, Y))
+		GoalHeadings[GetCellIndex(X, Y)] = (int8)WrapHeading(FMath::RoundToInt32(Heading / HeadingStep));
+}
+
+bool FRecoveryPlanner::AddObstacle(const FVector2D& Location)
+{
+	int32 X, Y;
+	if (!IsInitialized() || !GetCell(Location, X, Y))
+		return false;
+
+	const int32 Cell = GetCellIndex(X, Y);
+	if (Occupied[Cell])
+		return false;
+	Occupied[Cell] = true;
+
+	// the vehicle collides wherever its footprint covers the cell
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		const uint16 Bit = 1 << Heading;
+		for (const FPoseOffset& Offset : Footprints[Heading])
+		{
+			const int32 PoseX = X - Offset.X;
+			const int32 PoseY = Y - Offset.Y;
+			if (!IsInGrid(PoseX, PoseY)) continue;
+
+			uint16& Collision = Collisions[GetCellIndex(PoseX, PoseY)];
+			if (Collision & Bit) continue;
+
+			Collision |= Bit;
+			if (bSearched)
+				ChangedStates.Add(GetState(PoseX, PoseY, Heading));
+		}
+	}
+	return true;
+}
+
+bool FRecoveryPlanner::Collides(int32 X, int32 Y, int32 Heading) const
+{
+	return !IsInGrid(X, Y) || (Collisions[GetCellIndex(X, Y)] & (1 << Heading)) != 0;
+}
+
+bool FRecoveryPlanner::IsGoal(int32 State) const
+{
+	int32 X, Y, Heading;
+	DecodeState(State, X, Y, Heading);
+
+	// aligned with the track within a step
+	const int32 GoalHeading = GoalHeadings[GetCellIndex(X, Y)];
+	if (GoalHeading == INDEX_NONE)
+		return false;
+
+	const int32 HeadingError = WrapHeading(Heading - GoalHeading);
+	if (HeadingError > 1 && HeadingError < NumHeadings - 1)
+		return false;
+
+	if (Collides(X, Y, Heading))
+		return false;
+
+	for (const FPoseOffset& Offset : ClearanceOffsets[Heading])
+	{
+		if (Collides(X + Offset.X, Y + Offset.Y, Heading))
+			return false;
+	}
+	return true;
+}
+
+float FRecoveryPlanner::GetEdgeCost(int32 State, int32 Motion, int32& OutSuccessor) const
+{
+	int32 X, Y, Heading;
+	DecodeState(State, X, Y, Heading);
+
+	const FMotionTable& Table = Motions[Heading][Motion];
+	if (!IsInGrid(X + Table.End.X, Y + Table.End.Y))
+		return Unreachable;
+
+	if (State == StartState)
+	{
+		// cell by cell, sparing the obstacles the vehicle stands on
+		for (const FPoseOffset& Sample : Table.Samples)
+		{
+			for (const FPoseOffset& Offset : Footprints[Sample.Heading])
+			{
+				const int32 CellX = X + Sample.X + Offset.X;
+				const int32 CellY = Y + Sample.Y + Offset.Y;
+				if (!IsInGrid(CellX, CellY))
+					return Unreachable;
+				if (Occupied[GetCellIndex(CellX, CellY)] && !IsInFootprint(CellX - X, CellY - Y, Heading))
+					return Unreachable;
+			}
+		}
+	}
+	else
+	{
+		for (const FPoseOffset& Sample : Table.Samples)
+		{
+			if (Collides(X + Sample.X, Y + Sample.Y, Sample.Heading))
+				return Unreachable;
+		}
+	}
+
+	OutSuccessor = GetState(X + Table.End.X, Y + Table.End.Y, Table.End.Heading);
+	return Table.Cost;
+}
+
+int32 FRecoveryPlanner::GetBestMotion(int32 State, int32& OutSuccessor, float& OutCost) const
+{
+	int32 BestMotion = INDEX_NONE;
+	OutCost = Unreachable;
+
+	for (int32 Motion = 0; Motion < NumMotions; Motion++)
+	{
+		int32 Successor;
+		const float Cost = GetEdgeCost(State, Motion, Successor);
+		if (Cost == Unreachable || G[Successor] == Unreachable)
+			continue;
+
+		if (Cost + G[Successor] < OutCost)
+		{
+			OutCost = Cost + G[Successor];
+			OutSuccessor = Successor;
+			BestMotion = Motion;
+		}
+	}
+	return BestMotion;
+}
+
+float FRecoveryPlanner::Heuristic(int32 From, int32 To) const
+{
+	int32 FromX, FromY, FromHeading, ToX, ToY, ToHeading;
+	DecodeState(From, FromX, FromY, FromHeading);
+	DecodeState(To, ToX, ToY, ToHeading);
+	return FMath::Sqrt((float)(FMath::Square(FromX - ToX) + FMath::Square(FromY - ToY))) * Params.CellSize;
+}
+
+FRecoveryPlanner::FKey FRecoveryPlanner::CalculateKey(int32 State) const
+{
+	const float Cost = FMath::Min(G[State], Rhs[State]);
+	if (Cost == Unreachable)
+		return { Unreachable, Unreachable };
+	return { Cost + Heuristic(StartState, State) + KeyModifier, Cost };
+}
+
+void FRecoveryPlanner::UpdateVertex(int32 State)
+{
+	if (IsGoal(State))
+	{
+		Rhs[State] = 0.0f;
+	}
+	else
+	{
+		int32 Successor;
+		GetBestMotion(State, Successor, Rhs[State]);
+	}
+
+	QueueRemove(State);
+	if (G[State] != Rhs[State])
+		QueuePush(State, CalculateKey(State));
+}
+
+void FRecoveryPlanner::UpdatePredecessors(int32 State)
+{
+	int32 X, Y, Heading;
+	DecodeState(State, X, Y, Heading);
+
+	for (const FPredecessor& Predecessor : Predecessors[Heading])
+	{
+		const int32 FromX = X - Predecessor.X;
+		const int32 FromY = Y - Predecessor.Y;
+		if (IsInGrid(FromX, FromY))
+			UpdateVertex(GetState(FromX, FromY, Predecessor.Heading));
+	}
+}
+
+void FRecoveryPlanner::ComputeShortestPath()
+{
+	NumExpansions = 0;
+	while (Heap.Num() > 0 && NumExpansions < Params.MaxExpansions)
+	{
+		const FKey TopKey = HeapKeys[0];
+		if (!(TopKey < CalculateKey(StartState)) && Rhs[StartState] == G[StartState])
+			break;
+
+		const int32 State = Heap[0];
+		NumExpansions++;
+
+		const FKey NewKey = CalculateKey(State);
+		if (TopKey < NewKey)
+		{
+			QueueRemove(State);
+			QueuePush(State, NewKey);
+		}
+		else if (G[State] > Rhs[State])
+		{
+			G[State] = Rhs[State];
+			QueueRemove(State);
+			UpdatePredecessors(State);
+		}
+		else
+		{
+			G[State] = Unreachable;
+			UpdatePredecessors(State);
+			UpdateVertex(State);
+		}
+	}
+}
+
+void FRecoveryPlanner::RepairChangedStates()
+{
+	if (++Stamp == 0)
+	{
+		FMemory::Memzero(Stamps.GetData(), Stamps.NumBytes());
+		Stamp = 1;
+	}
+
+	auto Mark = [this](int32 X, int32 Y, int32 Heading)
+	{
+		if (!IsInGrid(X, Y)) return;
+		const int32 State = GetState(X, Y, Heading);
+		if (Stamps[State] == Stamp) return;
+		Stamps[State] = Stamp;
+		RepairStates.Add(State);
+	};
+
+	// a pose now colliding blocks the motions sampling it, and the goals that needed it clear
+	RepairStates.Reset();
+	for (const int32 Changed : ChangedStates)
+	{
+		int32 X, Y, Heading;
+		DecodeState(Changed, X, Y, Heading);
+
+		Mark(X, Y, Heading);
+		for (const FPoseOffset& Source : SampleSources[Heading])
+			Mark(X - Source.X, Y - Source.Y, Source.Heading);
+		for (const FPoseOffset& Offset : ClearanceOffsets[Heading])
+			Mark(X - Offset.X, Y - Offset.Y, Heading);
+	}
+	ChangedStates.Reset();
+
+	for (const int32 State : RepairStates)
+	{
+		// costs only went up: a state that reached nothing still doesn't
+		if (G[State] == Unreachable && Rhs[State] == Unreachable && !IsGoal(State))
+			continue;
+		UpdateVertex(State);
+	}
+}
+
+bool FRecoveryPlanner::Plan(const FVector2D& Location, float Yaw)
+{
+	int32 X, Y;
+	if (!IsInitialized() || !GetCell(Location, X, Y))
+		return false;
+
+	const int32 State = GetState(X, Y, WrapHeading(FMath::RoundToInt32(Yaw / HeadingStep)));
+
+	if (!bSearched)
+	{
+		StartState = LastState = State;
+
+		// every goal pose is a source of the backward search
+		for (int32 Cell = 0; Cell < GridSize * GridSize; Cell++)
+		{
+			if (GoalHeadings[Cell] == INDEX_NONE) continue;
+
+			for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+			{
+				const int32 Goal = Cell * NumHeadings + Heading;
+				if (!IsGoal(Goal)) continue;
+
+				Rhs[Goal] = 0.0f;
+				QueuePush(Goal, CalculateKey(Goal));
+			}
+		}
+
+		ChangedStates.Reset();
+		bSearched = true;
+	}
+	else
+	{
+		if (State != StartState)
+		{
+			KeyModifier += Heuristic(LastState, State);
+			LastState = State;
+
+			// only the start is spared the obstacles under it, the edges out of the old and new one changed
+			const int32 PreviousStart = StartState;
+			StartState = State;
+			UpdateVertex(PreviousStart);
+			UpdateVertex(State);
+		}
+
+		RepairChangedStates();
+	}
+
+	ComputeShortestPath();
+	return IsAtGoal() || Rhs[StartState] != Unreachable;
+}
+
+bool FRecoveryPlanner::IsAtGoal() const
+{
+	return StartState != INDEX_NONE && IsGoal(StartState);
+}
+
+FRecoveryMotion FRecoveryPlanner::GetNextMotion() const
+{
+	FRecoveryMotion Next;
+	if (StartState == INDEX_NONE || IsAtGoal())
+		return Next;
+
+	int32 Successor;
+	float Cost;
+	const int32 Motion = GetBestMotion(StartState, Successor, Cost);
+	if (Motion != INDEX_NONE)
+	{
+		Next.Direction = (int8)GetMotionDirection(Motion);
+		Next.Steer = (int8)GetMotionSteer(Motion);
+	}
+	return Next;
+}
+
+bool FRecoveryPlanner::GetNextPose(FVector2D& OutLocation, float& OutYaw) const
+{
+	if (StartState == INDEX_NONE || IsAtGoal())
+		return false;
+
+	int32 Successor;
+	float Cost;
+	if (GetBestMotion(StartState, Successor, Cost) == INDEX_NONE)
+		return false;
+
+	int32 X, Y, Heading;
+	DecodeState(Successor, X, Y, Heading);
+	OutLocation = GetCellCenter(X, Y);
+	OutYaw = Heading * HeadingStep;
+	return true;
+}
+
+float FRecoveryPlanner::GetPlanCost() const
+{
+	if (StartState == INDEX_NONE)
+		return Unreachable;
+	return IsAtGoal() ? 0.0f : Rhs[StartState];
+}
+
+void FRecoveryPlanner::GetPath(TArray<FVector2D>& OutLocations, int32 MaxMotions) const
+{
+	OutLocations.Reset();
+	if (StartState == INDEX_NONE)
+		return;
+
+	int32 State = StartState;
+	for (int32 Step = 0; Step <= MaxMotions; Step++)
+	{
+		int32 X, Y, Heading;
+		DecodeState(State, X, Y, Heading);
+		OutLocations.Add(GetCellCenter(X, Y));
+
+		if (IsGoal(State))
+			break;
+
+		int32 Successor;
+		float Cost;
+		if (GetBestMotion(State, Successor, Cost) == INDEX_NONE)
+			break;
+		State = Successor;
+	}
+}
+
+void FRecoveryPlanner::QueueSwap(int32 A, int32 B)
+{
+	Swap(Heap[A], Heap[B]);
+	Swap(HeapKeys[A], HeapKeys[B]);
+	HeapIndex[Heap[A]] = A;
+	HeapIndex[Heap[B]] = B;
+}
+
+void FRecoveryPlanner::SiftUp(int32 Index)
+{
+	while (Index > 0)
+	{
+		const int32 Parent = (Index - 1) / 2;
+		if (!(HeapKeys[Index] < HeapKeys[Parent]))
+			break;
+		QueueSwap(Index, Parent);
+		Index = Parent;
+	}
+}
+
+void FRecoveryPlanner::SiftDown(int32 Index)
+{
+	for (;;)
+	{
+		const int32 Left = 2 * Index + 1;
+		const int32 Right = Left + 1;
+		int32 Smallest = Index;
+		if (Left < Heap.Num() && HeapKeys[Left] < HeapKeys[Smallest]) Smallest = Left;
+		if (Right < Heap.Num() && HeapKeys[Right] < HeapKeys[Smallest]) Smallest = Right;
+		if (Smallest == Index)
+			break;
+		QueueSwap(Index, Smallest);
+		Index = Smallest;
+	}
+}
+
+void FRecoveryPlanner::QueuePush(int32 State, const FKey& Key)
+{
+	const int32 Index = Heap.Add(State);
+	HeapKeys.Add(Key);
+	HeapIndex[State] = Index;
+	SiftUp(Index);
+}
+
+void FRecoveryPlanner::QueueRemove(int32 State)
+{
+	const int32 Index = HeapIndex[State];
+	if (Index == INDEX_NONE)
+		return;
+
+	const int32 Last = Heap.Num() - 1;
+	if (Index != Last)
+		QueueSwap(Index, Last);
+
+	Heap.Pop(EAllowShrinking::No);
+	HeapKeys.Pop(EAllowShrinking::No);
+	HeapIndex[State] = INDEX_NONE;
+
+	if (Index < Heap.Num())
+	{
+		SiftDown(Index);
+		SiftUp(Index);
+	}
+}
+
+SIZE_T FRecoveryPlanner::GetAllocatedSize() const
+{
+	SIZE_T Size = Occupied.GetAllocatedSize() + Collisions.GetAllocatedSize() + GoalHeadings.GetAllocatedSize();
+	Size += G.GetAllocatedSize() + Rhs.GetAllocatedSize() + HeapIndex.GetAllocatedSize() + Stamps.GetAllocatedSize();
+	Size += Heap.GetAllocatedSize() + HeapKeys.GetAllocatedSize() + ChangedStates.GetAllocatedSize() + RepairStates.GetAllocatedSize();
+
+	for (int32 Heading = 0; Heading < NumHeadings; Heading++)
+	{
+		Size += Footprints[Heading].GetAllocatedSize() + Predecessors[Heading].GetAllocatedSize();
+		Size += ClearanceOffsets[Heading].GetAllocatedSize() + SampleSources[Heading].GetAllocatedSize();
+		for (int32 Motion = 0; Motion < NumMotions; Motion++)
+			Size += Motions[Heading][Motion].Samples.GetAllocatedSize();
+	}
+	return Size;
+}
@@ -0,0 +1,358 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrackOccupancyGrid.h"
+
+namespace
+{
+	// bytes FirstRow..LastRow of a tile word
+	uint64 TileRowMask(int32 FirstRow, int32 LastRow)
+	{
+		return (~0ull >> (8 * (7 - LastRow))) & (~0ull << (8 * FirstRow));
+	}
+
+	// bits FirstCol..LastCol of every byte of a tile word
+	uint64 TileColMask(int32 FirstCol, int32 LastCol)
+	{
+		const uint64 Byte = (0xFFull >> (7 - LastCol)) & (0xFFull << FirstCol);
+		return Byte * 0x0101010101010101ull;
+	}
+}
+
+void FTrackOccupancyGrid::Init(float InLength, bool bInClosedLoop, float InHalfWidth, float InCellSize)
+{
+	Length = FMath::Max(InLength, 1.0f);
+	bClosedLoop = bInClosedLoop;
+	HalfWidth = FMath::Max(InHalfWidth, 1.0f);
+	CellSize = FMath::Max(InCellSize, 1.0f);
+
+	NumRows = FMath::Max(FMath::CeilToInt32(Length / CellSize), 1);
+	NumCols = FMath::Max(FMath::CeilToInt32(2.0f * HalfWidth / CellSize), 1);
+	NumTileRows = FMath::DivideAndRoundUp(NumRows, TileSize);
+	NumTileCols = FMath::DivideAndRoundUp(NumCols, TileSize);
+
+	WallTiles.SetNumZeroed(NumTileRows * NumTileCols);
+	ObstacleTiles.SetNumZeroed(NumTileRows * NumTileCols);
+
+	// the padding of the last tiles is outside the grid
+	for (int32 Row = 0; Row < NumTileRows * TileSize; Row++)
+	{
+		if (Row >= NumRows)
+			SetRowSpan(WallTiles, Row, 0, NumTileCols * TileSize - 1);
+		else if (NumCols < NumTileCols * TileSize)
+			SetRowSpan(WallTiles, Row, NumCols, NumTileCols * TileSize - 1);
+	}
+	Tiles = WallTiles;
+
+	Obstacles.Reset();
+	TileRowObstacles.Reset();
+	TileRowObstacles.SetNum(NumTileRows);
+}
+
+float FTrackOccupancyGrid::WrapS(float S) const
+{
+	S = FMath::Fmod(S, Length);
+	return (S < 0.0f) ? S + Length : S;
+}
+
+int32 FTrackOccupancyGrid::GetRow(float S) const
+{
+	if (bClosedLoop)
+		S = WrapS(S);
+	return FMath::Clamp(FMath::FloorToInt32(S / CellSize), 0, NumRows - 1);
+}
+
+int32 FTrackOccupancyGrid::GetCol(float D) const
+{
+	return FMath::Clamp(FMath::FloorToInt32((D + HalfWidth) / CellSize), 0, NumCols - 1);
+}
+
+bool FTrackOccupancyGrid::GetColSpan(float MinD, float MaxD, int32& OutFirst, int32& OutLast) const
+{
+	if (MinD > MaxD) Swap(MinD, MaxD);
+	if (MinD < -HalfWidth || MaxD > HalfWidth)
+		return false;
+
+	OutFirst = GetCol(MinD);
+	OutLast = GetCol(MaxD);
+	return true;
+}
+
+void FTrackOccupancyGrid::SetRowSpan(TArray<uint64>& Layer, int32 Row, int32 FirstCol, int32 LastCol)
+{
+	const int32 Shift = (Row % TileSize) * TileSize;
+	for (int32 TileCol = FirstCol / TileSize; TileCol <= LastCol / TileSize; TileCol++)
+	{
+		const int32 First = FMath::Max(FirstCol - TileCol * TileSize, 0);
+		const int32 Last = FMath::Min(LastCol - TileCol * TileSize, TileSize - 1);
+		const uint64 Byte = (0xFFull >> (7 - Last)) & (0xFFull << First);
+		Layer[(Row / TileSize) * NumTileCols + TileCol] |= Byte << Shift;
+	}
+}
+
+void FTrackOccupancyGrid::SetRowWalls(int32 Row, float LeftWall, float RightWall)
+{
+	if (Row < 0 || Row >= NumRows) return;
+
+	// the cell a wall stands in is occupied too
+	if (LeftWall > -HalfWidth)
+	{
+		SetRowSpan(WallTiles, Row, 0, GetCol(LeftWall));
+		SetRowSpan(Tiles, Row, 0, GetCol(LeftWall));
+	}
+	if (RightWall < HalfWidth)
+	{
+		SetRowSpan(WallTiles, Row, GetCol(RightWall), NumCols - 1);
+		SetRowSpan(Tiles, Row, GetCol(RightWall), NumCols - 1);
+	}
+}
+
+bool FTrackOccupancyGrid::IsCellOccupied(int32 Row, int32 Col) const
+{
+	if (Row < 0 || Row >= NumRows || Col < 0 || Col >= NumCols)
+		return true;
+	return (Tiles[GetTileIndex(Row, Col)] & GetCellBit(Row, Col)) != 0;
+}
+
+bool FTrackOccupancyGrid::IsOccupied(float S, float D) const
+{
+	if (D < -HalfWidth || D > HalfWidth || (!bClosedLoop && (S < 0.0f || S > Length)))
+		return true;
+	return IsCellOccupied(GetRow(S), GetCol(D));
+}
+
+bool FTrackOccupancyGrid::IsRectClear(int32 FirstRow, int32 LastRow, int32 FirstCol, int32 LastCol) const
+{
+	for (int32 TileRow = FirstRow / TileSize; TileRow <= LastRow / TileSize; TileRow++)
+	{
+		const uint64 RowMask = TileRowMask(FMath::Max(FirstRow - TileRow * TileSize, 0), FMath::Min(LastRow - TileRow * TileSize, TileSize - 1));
+		const uint64* TileRowWords = &Tiles[TileRow * NumTileCols];
+
+		for (int32 TileCol = FirstCol / TileSize; TileCol <= LastCol / TileSize; TileCol++)
+		{
+			const uint64 ColMask = TileColMask(FMath::Max(FirstCol - TileCol * TileSize, 0), FMath::Min(LastCol - TileCol * TileSize, TileSize - 1));
+			if (TileRowWords[TileCol] & RowMask & ColMask)
+				return false;
+		}
+	}
+	return true;
+}
+
+int32 FTrackOccupancyGrid::FindFirstOccupiedRow(int32 FirstRow, int32 LastRow, int32 FirstCol, int32 LastCol) const
+{
+	for (int32 TileRow = FirstRow / TileSize; TileRow <= LastRow / TileSize; TileRow++)
+	{
+		const uint64 RowMask = TileRowMask(FMath::Max(FirstRow - TileRow * TileSize, 0), FMath::Min(LastRow - TileRow * TileSize, TileSize - 1));
+		const uint64* TileRowWords = &Tiles[TileRow * NumTileCols];
+
+		// the occupied rows of the whole lane, folded in one word
+		uint64 Occupied = 0;
+		for (int32 TileCol = FirstCol / TileSize; TileCol <= LastCol / TileSize; TileCol++)
+			Occupied |= TileRowWords[TileCol] & TileColMask(FMath::Max(FirstCol - TileCol * TileSize, 0), FMath::Min(LastCol - TileCol * TileSize, TileSize - 1));
+		Occupied &= RowMask;
+
+		if (Occupied)
+			return TileRow * TileSize + (int32)FMath::CountTrailingZeros64(Occupied) / TileSize;
+	}
+	return INDEX_NONE;
+}
+
+bool FTrackOccupancyGrid::IsCorridorClear(float StartS, float EndS, float MinD, float MaxD) const
+{
+	if (StartS > EndS) Swap(StartS, EndS);
+
+	int32 FirstCol, LastCol;
+	if (!GetColSpan(MinD, MaxD, FirstCol, LastCol))
+		return false;
+
+	if (!bClosedLoop)
+	{
+		if (StartS < 0.0f || EndS > Length)
+			return false;
+		return IsRectClear(GetRow(StartS), GetRow(EndS), FirstCol, LastCol);
+	}
+
+	// a lap or close enough that both ends fall in the same row
+	if (EndS - StartS >= Length - CellSize)
+		return IsRectClear(0, NumRows - 1, FirstCol, LastCol);
+
+	// across the start line the corridor is two rectangles
+	const int32 FirstRow = GetRow(StartS);
+	const int32 LastRow = GetRow(EndS);
+	if (LastRow >= FirstRow)
+		return IsRectClear(FirstRow, LastRow, FirstCol, LastCol);
+	return IsRectClear(FirstRow, NumRows - 1, FirstCol, LastCol) && IsRectClear(0, LastRow, FirstCol, LastCol);
+}
+
+float FTrackOccupancyGrid::GetFreeDistance(float S, float MinD, float MaxD, float MaxDistance) const
+{
+	int32 FirstCol, LastCol;
+	if (!GetColSpan(MinD, MaxD, FirstCol, LastCol) || MaxDistance <= 0.0f)
+		return 0.0f;
+
+	const float StartS = bClosedLoop ? WrapS(S) : FMath::Clamp(S, 0.0f, Length);
+	const int32 FirstRow = GetRow(StartS);
+
+	int32 Occupied = INDEX_NONE;
+	float Offset = 0.0f;
+	if (!bClosedLoop || StartS + MaxDistance < Length)
+	{
+		Occupied = FindFirstOccupiedRow(FirstRow, GetRow(StartS + MaxDistance), FirstCol, LastCol);
+	}
+	else
+	{
+		// across the start line, the rows after it are one lap further
+		Occupied = FindFirstOccupiedRow(FirstRow, NumRows - 1, FirstCol, LastCol);
+		const int32 LastRow = (MaxDistance >= Length) ? FirstRow - 1 : FMath::Min(GetRow(StartS + MaxDistance - Length), FirstRow - 1);
+		if (Occupied == INDEX_NONE && LastRow >= 0)
+		{
+			Occupied = FindFirstOccupiedRow(0, LastRow, FirstCol, LastCol);
+			Offset = Length;
+		}
+	}
+
+	if (Occupied == INDEX_NONE)
+		return MaxDistance;
+
+	// up to the near edge of the first occupied row
+	return FMath::Clamp(Occupied * CellSize + Offset - StartS, 0.0f, MaxDistance);
+}
+
+void FTrackOccupancyGrid::GetObstacleTileRows(const FObstacle& Obstacle, TArray<int32, TInlineAllocator<4>>& OutTileRows) const
+{
+	OutTileRows.Reset();
+	if (Obstacle.Radius <= 0.0f) return;
+
+	const int32 First = FMath::FloorToInt32((Obstacle.S - Obstacle.Radius) / CellSize);
+	const int32 Last = FMath::FloorToInt32((Obstacle.S + Obstacle.Radius) / CellSize);
+	for (int32 Row = First; Row <= Last; Row++)
+	{
+		const int32 Wrapped = bClosedLoop ? (Row % NumRows + NumRows) % NumRows : Row;
+		if (Wrapped >= 0 && Wrapped < NumRows)
+			OutTileRows.AddUnique(Wrapped / TileSize);
+	}
+}
+
+void FTrackOccupancyGrid::StampObstacle(const FObstacle& Obstacle)
+{
+	if (Obstacle.Radius <= 0.0f) return;
+
+	const int32 First = FMath::FloorToInt32((Obstacle.S - Obstacle.Radius) / CellSize);
+	const int32 Last = FMath::FloorToInt32((Obstacle.S + Obstacle.Radius) / CellSize);
+	for (int32 Row = First; Row <= Last; Row++)
+	{
+		const int32 Wrapped = bClosedLoop ? (Row % NumRows + NumRows) % NumRows : Row;
+		if (Wrapped < 0 || Wrapped >= NumRows) continue;
+
+		// widest chord of the disc within the row
+		const float RowDistance = FMath::Max(FMath::Abs((Row + 0.5f) * CellSize - Obstacle.S) - 0.5f * CellSize, 0.0f);
+		if (RowDistance > Obstacle.Radius) continue;
+		const float HalfChord = FMath::Sqrt(FMath::Square(Obstacle.Radius) - FMath::Square(RowDistance));
+
+		if (Obstacle.D + HalfChord < -HalfWidth || Obstacle.D - HalfChord > HalfWidth) continue;
+		SetRowSpan(ObstacleTiles, Wrapped, GetCol(Obstacle.D - HalfChord), GetCol(Obstacle.D + HalfChord));
+	}
+}
+
+void FTrackOccupancyGrid::RebuildTileRows(const TArray<int32, TInlineAllocator<8>>& TileRows)
+{
+	for (const int32 TileRow : TileRows)
+		FMemory::Memzero(&ObstacleTiles[TileRow * NumTileCols], NumTileCols * sizeof(uint64));
+
+	// an obstacle may spill into rows that aren't rebuilt, its bits are already set there
+	for (const int32 TileRow : TileRows)
+	{
+		for (const int32 Index : TileRowObstacles[TileRow])
+			StampObstacle(Obstacles[Index]);
+	}
+
+	for (const int32 TileRow : TileRows)
+	{
+		for (int32 Tile = TileRow * NumTileCols; Tile < (TileRow + 1) * NumTileCols; Tile++)
+			Tiles[Tile] = WallTiles[Tile] | ObstacleTiles[Tile];
+	}
+}
+
+int32 FTrackOccupancyGrid::AddObstacle(float S, float D, float Radius)
+{
+	const int32 Index = Obstacles.Add({ bClosedLoop ? WrapS(S) : S, D, FMath::Max(Radius, 0.0f) });
+
+	TArray<int32, TInlineAllocator<4>> ObstacleRows;
+	GetObstacleTileRows(Obstacles[Index], ObstacleRows);
+
+	TArray<int32, TInlineAllocator<8>> TileRows;
+	for (const int32 TileRow : ObstacleRows)
+	{
+		TileRowObstacles[TileRow].Add(Index);
+		TileRows.Add(TileRow);
+	}
+	RebuildTileRows(TileRows);
+
+	return Index;
+}
+
+void FTrackOccupancyGrid::MoveObstacle(int32 Index, float S, float D)
+{
+	if (!Obstacles.IsValidIndex(Index)) return;
+	FObstacle& Obstacle = Obstacles[Index];
+
+	TArray<int32, TInlineAllocator<8>> TileRows;
+	TArray<int32, TInlineAllocator<4>> ObstacleRows;
+
+	GetObstacleTileRows(Obstacle, ObstacleRows);
+	for (const int32 TileRow : ObstacleRows)
+	{
+		TileRowObstacles[TileRow].RemoveSingleSwap(Index, EAllowShrinking::No);
+		TileRows.AddUnique(TileRow);
+	}
+
+	Obstacle.S = bClosedLoop ? WrapS(S) : S;
+	Obstacle.D = D;
+
+	GetObstacleTileRows(Obstacle, ObstacleRows);
+	for (const int32 TileRow : ObstacleRows)
+	{
+		TileRowObstacles[TileRow].Add(Index);
+		TileRows.AddUnique(TileRow);
+	}
+
+	RebuildTileRows(TileRows);
+}
+
+void FTrackOccupancyGrid::RemoveObstacle(int32 Index)
+{
+	if (!Obstacles.IsValidIndex(Index)) return;
+
+	TArray<int32, TInlineAllocator<4>> ObstacleRows;
+	GetObstacleTileRows(Obstacles[Index], ObstacleRows);
+
+	TArray<int32, TInlineAllocator<8>> TileRows;
+	for (const int32 TileRow : ObstacleRows)
+	{
+		TileRowObstacles[TileRow].RemoveSingleSwap(Index, EAllowShrinking::No);
+		TileRows.Add(TileRow);
+	}
+
+	// the index stays reserved, so the others keep theirs
+	Obstacles[Index].Radius = 0.0f;
+	RebuildTileRows(TileRows);
+}
+
+void FTrackOccupancyGrid::ClearObstacles()
+{
+	Obstacles.Reset();
+	for (TArray<int32>& Bucket : TileRowObstacles)
+		Bucket.Reset();
+
+	FMemory::Memzero(ObstacleTiles.GetData(), ObstacleTiles.NumBytes());
+	Tiles = WallTiles;
+}
+
+SIZE_T FTrackOccupancyGrid::GetAllocatedSize() const
+{
+	SIZE_T Size = WallTiles.GetAllocatedSize() + ObstacleTiles.GetAllocatedSize() + Tiles.GetAllocatedSize();
+	Size += Obstacles.GetAllocatedSize() + TileRowObstacles.GetAllocatedSize();
+	for (const TArray<int32>& Bucket : TileRowObstacles)
+		Size += Bucket.GetAllocatedSize();
+	return Size;
+}
@@ -0,0 +1,387 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrackTable.h"
+
+TSharedRef<FTrackTable> FTrackTable::BuildFromSamples(TArray<FVector> Locations, TArray<FVector> Directions, TArray<FVector> Tangents, float SampleSpacing, bool bClosedLoop)
+{
+	check(Locations.Num() >= 2 && Directions.Num() == Locations.Num() && Tangents.Num() == Locations.Num());
+
+	TSharedRef<FTrackTable> Table = MakeShared<FTrackTable>();
+
+	const int32 NumSamples = Locations.Num();
+	Table->SampleSpacing = SampleSpacing;
+	Table->Length = SampleSpacing * (NumSamples - 1);
+	Table->Locations = MoveTemp(Locations);
+	Table->Directions = MoveTemp(Directions);
+	Table->Tangents = MoveTemp(Tangents);
+
+	// landscape splines are often not flagged as loops even when their ends meet
+	Table->bClosedLoop = bClosedLoop || FVector::Dist(Table->Locations[0], Table->Locations.Last()) < 2.0f * Table->SampleSpacing;
+
+	// on a loop the last sample is the first one again, drop it so indices wrap cleanly
+	if (Table->bClosedLoop && NumSamples > 2)
+	{
+		Table->Locations.Pop();
+		Table->Directions.Pop();
+		Table->Tangents.Pop();
+	}
+
+	// signed curvature from the heading change between the neighbouring samples
+	const int32 Num = Table->Num();
+	Table->Curvature.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		const int32 Prev = Table->bClosedLoop ? (i - 1 + Num) % Num : FMath::Max(i - 1, 0);
+		const int32 Next = Table->bClosedLoop ? (i + 1) % Num : FMath::Min(i + 1, Num - 1);
+
+		const FVector PrevDir = Table->Directions[Prev].GetSafeNormal2D();
+		const FVector NextDir = Table->Directions[Next].GetSafeNormal2D();
+		const float HeadingChange = FMath::Atan2(FVector::CrossProduct(PrevDir, NextDir).Z, FVector::DotProduct(PrevDir, NextDir));
+
+		Table->Curvature[i] = HeadingChange / FMath::Max((Next - Prev + Num) % Num, 1) / Table->SampleSpacing;
+	}
+
+	// sensible defaults, a car setup can rebuild it with its own limits
+	Table->BuildSpeedProfile(3000.0f, 900.0f, 400.0f, 800.0f);
+
+	return Table;
+}
+
+void FTrackTable::BuildSpeedProfile(float MaxSpeed, float MaxLateralAccel, float MaxAccel, float MaxDecel)
+{
+	const int32 Num = this->Num();
+	SpeedProfile.SetNumUninitialized(Num);
+
+	// grip limit in each corner: v^2 * k <= a_lat
+	for (int32 i = 0; i < Num; i++)
+	{
+		const float AbsCurvature = FMath::Abs(Curvature[i]);
+		SpeedProfile[i] = (AbsCurvature > UE_SMALL_NUMBER) ? FMath::Min(MaxSpeed, FMath::Sqrt(MaxLateralAccel / AbsCurvature)) : MaxSpeed;
+	}
+
+	// brake early enough for the next corner (backward pass) and don't accelerate faster than the car can (forward pass).
+	// On a loop the passes run twice around so the limits propagate across the start line
+	const int32 NumSteps = bClosedLoop ? 2 * Num : Num;
+	for (int32 Step = 1; Step < NumSteps; Step++)
+	{
+		const int32 i = (Num - 1 - Step % Num + Num) % Num;
+		const int32 Next = (i + 1) % Num;
+		if (!bClosedLoop && Next == 0) continue;
+
+		SpeedProfile[i] = FMath::Min(SpeedProfile[i], FMath::Sqrt(FMath::Square(SpeedProfile[Next]) + 2.0f * MaxDecel * SampleSpacing));
+	}
+
+	for (int32 Step = 1; Step < NumSteps; Step++)
+	{
+		const int32 i = Step % Num;
+		const int32 Prev = (i - 1 + Num) % Num;
+		if (!bClosedLoop && i == 0) continue;
+
+		SpeedProfile[i] = FMath::Min(SpeedProfile[i], FMath::Sqrt(FMath::Square(SpeedProfile[Prev]) + 2.0f * MaxAccel * SampleSpacing));
+	}
+}
+
+void FTrackTable::InitBoundaries(float MaxOffset)
+{
+	BoundaryRange = MaxOffset;
+	LeftBoundary.Init(-MaxOffset, Num());
+	RightBoundary.Init(MaxOffset, Num());
+}
+
+void FTrackTable::SetBoundariesFromEdges(TConstArrayView<FVector> EdgePoints)
+{
+	if (!HasBoundaries())
+		return;
+
+	// track coordinates of the edge points, split by side
+	TArray<FVector2D> LeftPoints, RightPoints;
+	float Hint = -1.0f;
+	for (const FVector& Location : EdgePoints)
+	{
+		// edges come in runs of neighbouring points, the previous one is a good hint unless a new run starts elsewhere
+		FVector2D Point = GetTrackCoordinates(Location, Hint);
+		if (Hint >= 0.0f && FVector::DistSquared2D(Location, GetLocationAtDistance(Point.X) + GetRightAtDistance(Point.X) * Point.Y) > FMath::Square(SampleSpacing))
+			Point = GetTrackCoordinates(Location);
+		Hint = Point.X;
+
+		(Point.Y < 0.0f ? LeftPoints : RightPoints).Add(Point);
+	}
+
+	const int32 Num = this->Num();
+
+	auto NarrowBoundary = [&](TArray<FVector2D>& Points, TArray<float>& Boundary, bool bRight)
+	{
+		if (Points.Num() == 0)
+			return;
+
+		Points.Sort([](const FVector2D& A, const FVector2D& B) { return A.X < B.X; });
+
+		// each sample takes the edge interpolated between the points around it, wrapping around loops.
+		// Past the ends of an open track the edge is held
+		int32 Next = 0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			const float Distance = i * SampleSpacing;
+			while (Next < Points.Num() && Points[Next].X < Distance)
+				Next++;
+
+			const bool bHasPrev = Next > 0 || bClosedLoop;
+			const bool bHasNext = Next < Points.Num() || bClosedLoop;
+			const FVector2D Prev = (Next > 0) ? Points[Next - 1] : Points.Last() - FVector2D(Length, 0.0f);
+			const FVector2D After = (Next < Points.Num()) ? Points[Next] : Points[0] + FVector2D(Length, 0.0f);
+
+			float Offset;
+			if (bHasPrev && bHasNext)
+				Offset = FMath::Lerp(Prev.Y, After.Y, (After.X > Prev.X) ? (Distance - Prev.X) / (After.X - Prev.X) : 0.0f);
+			else
+				Offset = bHasPrev ? Prev.Y : After.Y;
+
+			// the edges only ever narrow the boundaries
+			Boundary[i] = bRight ? FMath::Min(Boundary[i], Offset) : FMath::Max(Boundary[i], Offset);
+		}
+	};
+
+	NarrowBoundary(LeftPoints, LeftBoundary, false);
+	NarrowBoundary(RightPoints, RightBoundary, true);
+}
+
+void FTrackTable::BuildSpatialIndex(float CellSize)
+{
+	IndexCellStarts.Reset();
+	IndexSegments.Reset();
+	IndexSizeX = IndexSizeY = 0;
+
+	const int32 Num = this->Num();
+	const int32 NumSegments = bClosedLoop ? Num : Num - 1;
+	if (NumSegments <= 0 || CellSize <= 0.0f)
+		return;
+
+	// the grid reaches CellSize past the track, so every segment's reach fits in it
+	FBox2D Bounds(ForceInit);
+	for (const FVector& Location : Locations)
+		Bounds += FVector2D(Location);
+
+	IndexCellSize = CellSize;
+	IndexOrigin = Bounds.Min - FVector2D(CellSize, CellSize);
+	IndexSizeX = FMath::FloorToInt32((Bounds.Max.X - IndexOrigin.X) / CellSize) + 2;
+	IndexSizeY = FMath::FloorToInt32((Bounds.Max.Y - IndexOrigin.Y) / CellSize) + 2;
+
+	// cells of the bounding box of a segment grown by CellSize: any location within CellSize of the segment is in one of them
+	auto GetCellRange = [this, CellSize](int32 Segment, FIntPoint& OutMin, FIntPoint& OutMax)
+	{
+		const FVector2D Start(Locations[Segment]);
+		const FVector2D End(Locations[(Segment + 1) % Locations.Num()]);
+		const FVector2D Min = FVector2D::Min(Start, End) - FVector2D(CellSize, CellSize) - IndexOrigin;
+		const FVector2D Max = FVector2D::Max(Start, End) + FVector2D(CellSize, CellSize) - IndexOrigin;
+
+		OutMin = FIntPoint(FMath::Clamp(FMath::FloorToInt32(Min.X / CellSize), 0, IndexSizeX - 1), FMath::Clamp(FMath::FloorToInt32(Min.Y / CellSize), 0, IndexSizeY - 1));
+		OutMax = FIntPoint(FMath::Clamp(FMath::FloorToInt32(Max.X / CellSize), 0, IndexSizeX - 1), FMath::Clamp(FMath::FloorToInt32(Max.Y / CellSize), 0, IndexSizeY - 1));
+	};
+
+	// counted first, then filled in segment order, so each cell's list is sorted
+	IndexCellStarts.Init(0, IndexSizeX * IndexSizeY + 1);
+	for (int32 Segment = 0; Segment < NumSegments; Segment++)
+	{
+		FIntPoint Min, Max;
+		GetCellRange(Segment, Min, Max);
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			for (int32 X = Min.X; X <= Max.X; X++)
+				IndexCellStarts[Y * IndexSizeX + X + 1]++;
+		}
+	}
+
+	for (int32 Cell = 1; Cell < IndexCellStarts.Num(); Cell++)
+		IndexCellStarts[Cell] += IndexCellStarts[Cell - 1];
+
+	TArray<int32> Cursors(IndexCellStarts.GetData(), IndexCellStarts.Num() - 1);
+	IndexSegments.SetNumUninitialized(IndexCellStarts.Last());
+	for (int32 Segment = 0; Segment < NumSegments; Segment++)
+	{
+		FIntPoint Min, Max;
+		GetCellRange(Segment, Min, Max);
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			for (int32 X = Min.X; X <= Max.X; X++)
+				IndexSegments[Cursors[Y * IndexSizeX + X]++] = Segment;
+		}
+	}
+}
+
+SIZE_T FTrackTable::GetAllocatedSize() const
+{
+	return Locations.GetAllocatedSize() + Directions.GetAllocatedSize() + Tangents.GetAllocatedSize()
+		+ Curvature.GetAllocatedSize() + SpeedProfile.GetAllocatedSize()
+		+ LeftBoundary.GetAllocatedSize() + RightBoundary.GetAllocatedSize()
+		+ IndexCellStarts.GetAllocatedSize() + IndexSegments.GetAllocatedSize();
+}
+
+float FTrackTable::WrapDistance(float Distance) const
+{
+	if (bClosedLoop)
+	{
+		Distance = FMath::Fmod(Distance, Length);
+		return (Distance < 0.0f) ? Distance + Length : Distance;
+	}
+
+	return FMath::Clamp(Distance, 0.0f, Length);
+}
+
+void FTrackTable::GetSegment(float Distance, int32& OutIndex, int32& OutNextIndex, float& OutAlpha) const
+{
+	const float Position = WrapDistance(Distance) / SampleSpacing;
+	const int32 Num = this->Num();
+
+	OutIndex = FMath::Clamp(FMath::FloorToInt32(Position), 0, Num - 1);
+	OutAlpha = Position - OutIndex;
+	OutNextIndex = bClosedLoop ? (OutIndex + 1) % Num : FMath::Min(OutIndex + 1, Num - 1);
+}
+
+FVector FTrackTable::GetLocationAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FMath::Lerp(Locations[Index], Locations[Next], Alpha);
+}
+
+FVector FTrackTable::GetDirectionAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FMath::Lerp(Directions[Index], Directions[Next], Alpha).GetSafeNormal();
+}
+
+FVector FTrackTable::GetTangentAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FMath::Lerp(Tangents[Index], Tangents[Next], Alpha);
+}
+
+float FTrackTable::GetCurvatureAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FMath::Lerp(Curvature[Index], Curvature[Next], Alpha);
+}
+
+float FTrackTable::GetSpeedAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FMath::Lerp(SpeedProfile[Index], SpeedProfile[Next], Alpha);
+}
+
+FVector FTrackTable::GetRightAtDistance(float Distance) const
+{
+	return FVector::CrossProduct(FVector::UpVector, GetDirectionAtDistance(Distance)).GetSafeNormal();
+}
+
+FVector2D FTrackTable::GetBoundariesAtDistance(float Distance) const
+{
+	int32 Index, Next;
+	float Alpha;
+	GetSegment(Distance, Index, Next, Alpha);
+	return FVector2D(FMath::Lerp(LeftBoundary[Index], LeftBoundary[Next], Alpha), FMath::Lerp(RightBoundary[Index], RightBoundary[Next], Alpha));
+}
+
+FVector FTrackTable::GetBoundaryLocation(float Distance, bool bRight) const
+{
+	const FVector2D Boundaries = GetBoundariesAtDistance(Distance);
+	return GetLocationAtDistance(Distance) + GetRightAtDistance(Distance) * (bRight ? Boundaries.Y : Boundaries.X);
+}
+
+FVector2D FTrackTable::GetWallClearance(float S, float D) const
+{
+	const FVector2D Boundaries = GetBoundariesAtDistance(S);
+	return FVector2D(D - Boundaries.X, Boundaries.Y - D);
+}
+
+FVector2D FTrackTable::GetTrackCoordinates(const FVector& Location, float HintDistance) const
+{
+	const float Distance = FindDistanceClosestToLocation(Location, HintDistance);
+	const float Offset = FVector::DotProduct(Location - GetLocationAtDistance(Distance), GetRightAtDistance(Distance));
+	return FVector2D(Distance, Offset);
+}
+
+float FTrackTable::ProjectOnSegment(int32 Index, const FVector& Location, float& OutDistSq) const
+{
+	const int32 Next = (Index + 1) % Num();
+	const FVector Segment = Locations[Next] - Locations[Index];
+	const float Alpha = FMath::Clamp(FVector::DotProduct(Location - Locations[Index], Segment) / FMath::Max(Segment.SizeSquared(), UE_SMALL_NUMBER), 0.0f, 1.0f);
+
+	OutDistSq = FVector::DistSquared(Location, Locations[Index] + Segment * Alpha);
+	return (Index + Alpha) * SampleSpacing;
+}
+
+float FTrackTable::FindDistanceClosestToLocation(const FVector& Location, float HintDistance, float SearchWindow) const
+{
+	const int32 Num = this->Num();
+	const int32 NumSegments = bClosedLoop ? Num : Num - 1;
+
+	// without a hint, the segments near the cell of Location. The closest of them is the closest of all when it's within
+	// a cell size, any closer segment would have been registered in the cell
+	if (HintDistance < 0.0f && HasSpatialIndex())
+	{
+		const int32 X = FMath::FloorToInt32((Location.X - IndexOrigin.X) / IndexCellSize);
+		const int32 Y = FMath::FloorToInt32((Location.Y - IndexOrigin.Y) / IndexCellSize);
+		if (X >= 0 && Y >= 0 && X < IndexSizeX && Y < IndexSizeY)
+		{
+			const int32 Cell = Y * IndexSizeX + X;
+
+			float BestDistance = 0.0f;
+			float BestDistSq = MAX_flt;
+			for (int32 Entry = IndexCellStarts[Cell]; Entry < IndexCellStarts[Cell + 1]; Entry++)
+			{
+				float DistSq;
+				const float Distance = ProjectOnSegment(IndexSegments[Entry], Location, DistSq);
+				if (DistSq < BestDistSq)
+				{
+					BestDistSq = DistSq;
+					BestDistance = Distance;
+				}
+			}
+
+			if (BestDistSq <= FMath::Square(IndexCellSize))
+				return WrapDistance(BestDistance);
+		}
+	}
+
+	// either a window of segments around the hint, or all of them
+	int32 First = 0;
+	int32 Count = NumSegments;
+	if (HintDistance >= 0.0f)
+	{
+		const int32 HalfWindow = FMath::CeilToInt32(SearchWindow / SampleSpacing);
+		First = FMath::FloorToInt32(WrapDistance(HintDistance) / SampleSpacing) - HalfWindow;
+		Count = FMath::Min(2 * HalfWindow + 1, NumSegments);
+
+		if (!bClosedLoop)
+		{
+			First = FMath::Clamp(First, 0, NumSegments - Count);
+		}
+	}
+
+	float BestDistance = 0.0f;
+	float BestDistSq = MAX_flt;
+	for (int32 Offset = 0; Offset < Count; Offset++)
+	{
+		const int32 Index = ((First + Offset) % NumSegments + NumSegments) % NumSegments;
+
+		float DistSq;
+		const float Distance = ProjectOnSegment(Index, Location, DistSq);
+		if (DistSq < BestDistSq)
+		{
+			BestDistSq = DistSq;
+			BestDistance = Distance;
+		}
+	}
+
+	return WrapDistance(BestDistance);
+}
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VehicleStateEstimator.h"
+
+FVehicleStateEstimator::FVehicleStateEstimator()
+	: State(FState::Zero())
+	, Covariance(FCovariance::Identity())
+{
+}
+
+void FVehicleStateEstimator::Reset(const FVehicleStateEstimatorParams& InParams, const FVector2D& Location, double InYaw, double InSpeed)
+{
+	Params = InParams;
+
+	State = FState::Zero();
+	State[X] = Location.X;
+	State[Y] = Location.Y;
+	State[Yaw] = FMath::UnwindRadians(InYaw);
+	State[Speed] = InSpeed;
+
+	Covariance = FCovariance::Zero();
+	Covariance(X, X) = Covariance(Y, Y) = FMath::Square(Params.PositionFixNoise);
+	Covariance(Yaw, Yaw) = FMath::Square(FMath::DegreesToRadians(5.0));
+	Covariance(Speed, Speed) = FMath::Square(Params.OdometryNoise);
+	Covariance(YawRate, YawRate) = FMath::Square(Params.GyroNoise);
+}
+
+void FVehicleStateEstimator::Predict(double DeltaTime, double LongitudinalAcceleration)
+{
+	if (DeltaTime <= 0.0) return;
+
+	const double Cos = FMath::Cos(State[Yaw]);
+	const double Sin = FMath::Sin(State[Yaw]);
+	const double V = State[Speed];
+
+	// Jacobian of the motion, at the state before it
+	FCovariance F = FCovariance::Identity();
+	F(X, Yaw) = -V * Sin * DeltaTime;
+	F(X, Speed) = Cos * DeltaTime;
+	F(Y, Yaw) = V * Cos * DeltaTime;
+	F(Y, Speed) = Sin * DeltaTime;
+	F(Yaw, YawRate) = DeltaTime;
+
+	State[X] += V * Cos * DeltaTime;
+	State[Y] += V * Sin * DeltaTime;
+	State[Yaw] = FMath::UnwindRadians(State[Yaw] + State[YawRate] * DeltaTime);
+	State[Speed] += LongitudinalAcceleration * DeltaTime;
+
+	// the unknown accelerations, held over the step, spread into the state through G
+	const double HalfDtSquared = 0.5 * DeltaTime * DeltaTime;
+	TFixedVector<NumStates> AccelGain = TFixedVector<NumStates>::Zero();
+	AccelGain[X] = HalfDtSquared * Cos;
+	AccelGain[Y] = HalfDtSquared * Sin;
+	AccelGain[Speed] = DeltaTime;
+
+	TFixedVector<NumStates> YawAccelGain = TFixedVector<NumStates>::Zero();
+	YawAccelGain[Yaw] = HalfDtSquared;
+	YawAccelGain[YawRate] = DeltaTime;
+
+	const FCovariance Q = AccelGain * AccelGain.Transposed() * FMath::Square(Params.AccelNoise)
+		+ YawAccelGain * YawAccelGain.Transposed() * FMath::Square(Params.YawAccelNoise);
+
+	Covariance = (F * Covariance * F.Transposed() + Q).Symmetrized();
+}
+
+template <int32 NumMeasurements>
+bool FVehicleStateEstimator::Update(const TFixedVector<NumMeasurements>& Innovation, const TFixedMatrix<NumMeasurements, NumStates>& H,
+	const TFixedMatrix<NumMeasurements, NumMeasurements>& R, double Gate)
+{
+	const TFixedMatrix<NumStates, NumMeasurements> PHt = Covariance * H.Transposed();
+	const TFixedMatrix<NumMeasurements, NumMeasurements> S = H * PHt + R;
+
+	TFixedMatrix<NumMeasurements, NumMeasurements> SInverse;
+	if (!InvertSymmetricPositiveDefinite(S, SInverse))
+		return false;
+
+	if (Gate > 0.0 && (Innovation.Transposed() * SInverse * Innovation)(0, 0) > Gate)
+		return false;
+
+	const TFixedMatrix<NumStates, NumMeasurements> K = PHt * SInverse;
+	State = State + K * Innovation;
+	State[Yaw] = FMath::UnwindRadians(State[Yaw]);
+
+	// Joseph form, it keeps the covariance positive definite through rounding
+	const FCovariance IKH = FCovariance::Identity() - K * H;
+	Covariance = (IKH * Covariance * IKH.Transposed() + K * R * K.Transposed()).Symmetrized();
+	return true;
+}
+
+bool FVehicleStateEstimator::FuseGyro(double MeasuredYawRate)
+{
+	TFixedMatrix<1, NumStates> H = TFixedMatrix<1, NumStates>::Zero();
+	H(0, YawRate) = 1.0;
+
+	TFixedVector<1> Innovation;
+	Innovation[0] = MeasuredYawRate - State[YawRate];
+
+	TFixedMatrix<1, 1> R;
+	R(0, 0) = FMath::Square(Params.GyroNoise);
+
+	return Update(Innovation, H, R, 0.0);
+}
+
+bool FVehicleStateEstimator::FuseOdometry(double MeasuredSpeed)
+{
+	TFixedMatrix<1, NumStates> H = TFixedMatrix<1, NumStates>::Zero();
+	H(0, Speed) = 1.0;
+
+	TFixedVector<1> Innovation;
+	Innovation[0] = MeasuredSpeed - State[Speed];
+
+	TFixedMatrix<1, 1> R;
+	R(0, 0) = FMath::Square(Params.OdometryNoise);
+
+	return Update(Innovation, H, R, 0.0);
+}
+
+bool FVehicleStateEstimator::FusePositionFix(const FVector2D& MeasuredLocation)
+{
+	TFixedMatrix<2, NumStates> H = TFixedMatrix<2, NumStates>::Zero();
+	H(0, X) = 1.0;
+	H(1, Y) = 1.0;
+
+	TFixedVector<2> Innovation;
+	Innovation[0] = MeasuredLocation.X - State[X];
+	Innovation[1] = MeasuredLocation.Y - State[Y];
+
+	TFixedMatrix<2, 2> R = TFixedMatrix<2, 2>::Identity() * FMath::Square(Params.PositionFixNoise);
+
+	return Update(Innovation, H, R, Params.PositionFixGate);
+}
+
+double FVehicleStateEstimator::GetPositionUncertainty() const
+{
+	// larger eigenvalue of the position block
+	const double A = Covariance(X, X);
+	const double B = Covariance(X, Y);
+	const double C = Covariance(Y, Y);
+	const double Largest = 0.5 * (A + C) + FMath::Sqrt(FMath::Square(0.5 * (A - C)) + B * B);
+	return FMath::Sqrt(FMath::Max(Largest, 0.0));
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// side of the track a cone bounds
+enum class EConeSide : int8
+{
+	Left = -1,
+	Unknown = 0,
+	Right = 1,
+};
+
+/**
+ * Delaunay triangulation of the cones seen so far, in the XY plane, grown one cone at a time (Bowyer-Watson):
+ * a new cone only retriangulates the triangles whose circumcircle contains it, found by walking from the
+ * triangle it falls in, so the cost of an insertion doesn't depend on how many cones are already in.
+ *
+ * The edges joining a left and a right cone cross the track, and the triangles holding them form a strip along it.
+ * The centerline is the chain of midpoints of those edges, read by walking the strip from the vehicle.
+ */
+class DRIVERLESSCORE_API FConeDelaunay
+{
+public:
+	// the cones are expected within Extent (cm) of Center
+	explicit FConeDelaunay(const FVector2D& Center = FVector2D::ZeroVector, double Extent = 1.0e7);
+
+	void Reset(const FVector2D& Center, double Extent);
+
+	// adds a cone and retriangulates around it. Returns its index, the index of the closest cone already within
+	// MergeDistance of it, or INDEX_NONE when it's outside the expected extent
+	int32 AddCone(const FVector& Location, EConeSide Side, double MergeDistance = 10.0);
+
+	// midpoints of the left-right edges met going forward from Location along Direction, up to MaxLength (cm)
+	void TraceCenterline(const FVector& Location, const FVector& Direction, double MaxLength, TArray<FVector>& OutPoints) const;
+
+	int32 NumCones() const { return Vertices.Num() - NumSuperVertices; }
+	const FVector& GetCone(int32 Index) const { return Vertices[Index + NumSuperVertices]; }
+	EConeSide GetConeSide(int32 Index) const { return Sides[Index + NumSuperVertices]; }
+
+	// triangles between cones, without the ones touching the bounding triangle
+	int32 NumTriangles() const;
+
+	// true if every triangle is counter-clockwise, its neighbors point back at it and no cone lies in its circumcircle. Slow, for tests
+	bool Validate() const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	static constexpr int32 NumSuperVertices = 3;
+
+	// vertices counter-clockwise. Neighbors[i] is across the edge opposite Vertices[i]
+	struct FTriangle
+	{
+		int32 V[3];
+		int32 N[3];
+	};
+
+	FVector2D GetPoint(int32 Vertex) const { return FVector2D(Vertices[Vertex].X, Vertices[Vertex].Y); }
+	bool IsSuperVertex(int32 Vertex) const { return Vertex < NumSuperVertices; }
+	bool TouchesSuperTriangle(const FTriangle& Triangle) const;
+	bool InCircumcircle(const FTriangle& Triangle, const FVector2D& Point) const;
+	bool IsLeftRightEdge(const FTriangle& Triangle, int32 Edge) const;
+	FVector GetEdgeMidpoint(const FTriangle& Triangle, int32 Edge) const;
+
+	int32 LocateTriangle(const FVector2D& Point) const;
+	int32 AllocateTriangle();
+	void ReplaceNeighbor(int32 Triangle, int32 EdgeStart, int32 EdgeEnd, int32 NewNeighbor);
+
+	TArray<FVector> Vertices;
+	TArray<EConeSide> Sides;
+
+	TArray<FTriangle> Triangles;
+	TBitArray<> AliveTriangles;
+	TArray<int32> FreeTriangles;
+
+	// where the last walk ended, the next one usually starts close to it
+	mutable int32 LastTriangle = 0;
+
+	// scratch of the insertions, kept to avoid allocating every time
+	struct FBoundaryEdge
+	{
+		int32 Start;
+		int32 End;
+		int32 Outer;
+		int32 NewTriangle;
+	};
+	TArray<int32> Cavity;
+	TArray<int32> CavityStack;
+	TArray<uint32> CavityStamps;
+	uint32 CavityStamp = 0;
+	TArray<FBoundaryEdge> Boundary;
+};
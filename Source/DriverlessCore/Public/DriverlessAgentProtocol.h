@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Layout of the shared memory region the followers are driven through by an external agent.
+ * Only fixed size, standard layout types, so the agent can map the same region from any language
+ * (the sizes are checked below). Locations are in cm, angles in degrees, speeds in cm/s.
+ *
+ *   [FDriverlessAgentHeader][FDriverlessAgentObservation x MaxVehicles][FDriverlessAgentAction x MaxVehicles]
+ *
+ * Both sides publish through a sequence lock. The engine sets ObservationSequence to 2 * Step - 1 (odd) before
+ * writing the observations of a step and to 2 * Step (even) once they are complete; the agent does the same
+ * with ActionSequence and the step its actions answer. A reader copies the data out between two reads of the
+ * sequence and retries when it was odd or changed. In lock-step mode the engine waits for the actions of a step
+ * before simulating the next one, in free-running mode it applies the latest complete actions it finds.
+ *
+ * Slots below NumVehicles are in use or free, a free slot's observation is zeroed until a vehicle takes it over.
+ */
+namespace DriverlessAgent
+{
+	static constexpr uint32 Magic = 0x47414C44; // "DLAG"
+	static constexpr uint32 Version = 2;
+	static constexpr int32 MaxProbes = 64;
+}
+
+enum class EDriverlessAgentMode : uint32
+{
+	// the engine waits for the agent's actions at every step
+	LockStep = 0,
+	// the engine never waits, actions are applied whenever they arrive
+	FreeRunning = 1,
+};
+
+struct FDriverlessAgentHeader
+{
+	uint32 Magic = DriverlessAgent::Magic;
+	uint32 Version = DriverlessAgent::Version;
+	uint32 MaxVehicles = 0;
+	uint32 MaxProbes = DriverlessAgent::MaxProbes;
+	uint32 ObservationOffset = 0;
+	uint32 ObservationStride = 0;
+	uint32 ActionOffset = 0;
+	uint32 ActionStride = 0;
+
+	std::atomic<uint32> NumVehicles { 0 };
+	std::atomic<uint32> Mode { (uint32)EDriverlessAgentMode::LockStep };
+
+	// sequence locks of the observations (engine) and of the actions (agent), odd while being written, 2 * Step once complete
+	std::atomic<uint64> ObservationSequence { 0 };
+	std::atomic<uint64> ActionSequence { 0 };
+
+	// simulation time of the observations, and the step that led to them (seconds)
+	double SimTime = 0.0;
+	float DeltaTime = 0.0f;
+	uint32 Padding = 0;
+};
+
+enum EDriverlessAgentFlags : uint32
+{
+	DriverlessAgentFlag_Stuck = 1 << 0,
+	DriverlessAgentFlag_Avoiding = 1 << 1,
+	DriverlessAgentFlag_Kinematic = 1 << 2,
+};
+
+struct FDriverlessAgentObservation
+{
+	float Location[3];
+	float Rotation[4]; // quaternion x, y, z, w
+	float Velocity[3];
+	float AngularVelocity[3];
+
+	// track relative: distance along the centerline, signed offset from it (right is positive) and heading error
+	float TrackDistance;
+	float LateralOffset;
+	float HeadingError;
+	float TrackLength;
+
+	float ForwardSpeed;
+	int32 Gear;
+	uint32 Flags; // EDriverlessAgentFlags
+	uint32 NumProbes;
+
+	// free distance in front of each probe of the avoidance fan, left to right
+	float ProbeDistances[DriverlessAgent::MaxProbes];
+};
+
+struct FDriverlessAgentAction
+{
+	float Steering; // -1..1
+	float Throttle; // 0..1
+	float Brake; // 0..1
+	int32 Gear; // 0 = leave the gearbox alone
+};
+
+static_assert(sizeof(FDriverlessAgentHeader) == 72, "The agent protocol layout changed, bump DriverlessAgent::Version");
+static_assert(sizeof(FDriverlessAgentObservation) == 84 + DriverlessAgent::MaxProbes * 4, "The agent protocol layout changed, bump DriverlessAgent::Version");
+static_assert(sizeof(FDriverlessAgentAction) == 16, "The agent protocol layout changed, bump DriverlessAgent::Version");
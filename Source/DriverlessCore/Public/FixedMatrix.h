@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Dense matrix of compile-time size, stored inline (row major) so it never touches the heap.
+ * Meant for the small filters of the vehicles, where every dimension is known up front and the loops unroll.
+ * Not initialized by default: start from Zero() or Identity().
+ */
+template <int32 NumRows, int32 NumCols>
+struct TFixedMatrix
+{
+	static_assert(NumRows > 0 && NumCols > 0, "TFixedMatrix needs at least one row and one column");
+
+	double M[NumRows][NumCols];
+
+	static TFixedMatrix Zero()
+	{
+		TFixedMatrix Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Row][Col] = 0.0;
+		return Result;
+	}
+
+	static TFixedMatrix Identity()
+	{
+		static_assert(NumRows == NumCols, "Identity needs a square matrix");
+		TFixedMatrix Result = Zero();
+		for (int32 i = 0; i < NumRows; i++)
+			Result.M[i][i] = 1.0;
+		return Result;
+	}
+
+	double& operator()(int32 Row, int32 Col) { return M[Row][Col]; }
+	double operator()(int32 Row, int32 Col) const { return M[Row][Col]; }
+
+	// vectors (one column) are indexed by row alone
+	double& operator[](int32 Row) { static_assert(NumCols == 1, "Single index on a matrix"); return M[Row][0]; }
+	double operator[](int32 Row) const { static_assert(NumCols == 1, "Single index on a matrix"); return M[Row][0]; }
+
+	TFixedMatrix operator+(const TFixedMatrix& Other) const
+	{
+		TFixedMatrix Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Row][Col] = M[Row][Col] + Other.M[Row][Col];
+		return Result;
+	}
+
+	TFixedMatrix operator-(const TFixedMatrix& Other) const
+	{
+		TFixedMatrix Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Row][Col] = M[Row][Col] - Other.M[Row][Col];
+		return Result;
+	}
+
+	TFixedMatrix operator*(double Scale) const
+	{
+		TFixedMatrix Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Row][Col] = M[Row][Col] * Scale;
+		return Result;
+	}
+
+	template <int32 OtherCols>
+	TFixedMatrix<NumRows, OtherCols> operator*(const TFixedMatrix<NumCols, OtherCols>& Other) const
+	{
+		TFixedMatrix<NumRows, OtherCols> Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+		{
+			for (int32 Col = 0; Col < OtherCols; Col++)
+			{
+				double Sum = 0.0;
+				for (int32 k = 0; k < NumCols; k++)
+					Sum += M[Row][k] * Other.M[k][Col];
+				Result.M[Row][Col] = Sum;
+			}
+		}
+		return Result;
+	}
+
+	TFixedMatrix<NumCols, NumRows> Transposed() const
+	{
+		TFixedMatrix<NumCols, NumRows> Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Col][Row] = M[Row][Col];
+		return Result;
+	}
+
+	// (A + A^T) / 2, to keep covariances symmetric against rounding
+	TFixedMatrix Symmetrized() const
+	{
+		static_assert(NumRows == NumCols, "Symmetrized needs a square matrix");
+		TFixedMatrix Result;
+		for (int32 Row = 0; Row < NumRows; Row++)
+			for (int32 Col = 0; Col < NumCols; Col++)
+				Result.M[Row][Col] = 0.5 * (M[Row][Col] + M[Col][Row]);
+		return Result;
+	}
+};
+
+template <int32 Size>
+using TFixedVector = TFixedMatrix<Size, 1>;
+
+/**
+ * Inverse of a symmetric positive definite matrix (a covariance), through its Cholesky factorization.
+ * Returns false, leaving OutInverse untouched, when the matrix isn't positive definite.
+ */
+template <int32 Size>
+bool InvertSymmetricPositiveDefinite(const TFixedMatrix<Size, Size>& Matrix, TFixedMatrix<Size, Size>& OutInverse)
+{
+	// Matrix = L L^T
+	TFixedMatrix<Size, Size> L = TFixedMatrix<Size, Size>::Zero();
+	for (int32 Row = 0; Row < Size; Row++)
+	{
+		for (int32 Col = 0; Col <= Row; Col++)
+		{
+			double Sum = Matrix.M[Row][Col];
+			for (int32 k = 0; k < Col; k++)
+				Sum -= L.M[Row][k] * L.M[Col][k];
+
+			if (Row == Col)
+			{
+				if (Sum <= 0.0)
+					return false;
+				L.M[Row][Row] = FMath::Sqrt(Sum);
+			}
+			else
+			{
+				L.M[Row][Col] = Sum / L.M[Col][Col];
+			}
+		}
+	}
+
+	// L^-1, lower triangular, by forward substitution
+	TFixedMatrix<Size, Size> LInverse = TFixedMatrix<Size, Size>::Zero();
+	for (int32 Col = 0; Col < Size; Col++)
+	{
+		LInverse.M[Col][Col] = 1.0 / L.M[Col][Col];
+		for (int32 Row = Col + 1; Row < Size; Row++)
+		{
+			double Sum = 0.0;
+			for (int32 k = Col; k < Row; k++)
+				Sum -= L.M[Row][k] * LInverse.M[k][Col];
+			LInverse.M[Row][Col] = Sum / L.M[Row][Row];
+		}
+	}
+
+	// Matrix^-1 = L^-T L^-1
+	OutInverse = LInverse.Transposed() * LInverse;
+	return true;
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/CircularQueue.h"
+
+// vehicle inputs sent by an external controller, stamped with FPlatformTime::Seconds() at the time they apply from
+struct FFollowerTimedCommand
+{
+	double Timestamp = 0.0;
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+	int32 Gear = 0; // 0 = leave the gearbox alone
+};
+
+// what a drain found in the queue
+struct FFollowerCommandDrain
+{
+	// latest command due and not stale, if any
+	TOptional<FFollowerTimedCommand> Command;
+	int32 NumConsumed = 0;
+	int32 NumStale = 0;
+};
+
+/**
+ * Single producer, single consumer queue of commands for one vehicle: any one thread pushes,
+ * the follower drains it when it actuates. Lock-free and allocation-free after construction.
+ * Commands are expected in timestamp order; the ones stamped in the future wait in the queue until they are due.
+ */
+class DRIVERLESSCORE_API FFollowerCommandQueue
+{
+public:
+	// Capacity is rounded up to a power of two, and one slot of it always stays empty: the default holds 63 commands
+	explicit FFollowerCommandQueue(uint32 Capacity = 64);
+
+	// producer side. False if the queue is full, the command is dropped
+	bool Push(const FFollowerTimedCommand& Command) { return Queue.Enqueue(Command); }
+
+	// consumer side. Consumes every command due at Now and returns the latest one younger than MaxAge (seconds)
+	FFollowerCommandDrain Drain(double Now, double MaxAge);
+
+	bool IsEmpty() const { return Queue.IsEmpty(); }
+
+private:
+	TCircularQueue<FFollowerTimedCommand> Queue;
+};
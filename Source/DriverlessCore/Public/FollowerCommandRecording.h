@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// commands a vehicle received at one physics step, and the pose it had when they were computed
+struct FFollowerCommandFrame
+{
+	// solver frame, relative to the first frame of the recording
+	int32 PhysicsFrame = 0;
+
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+	int32 Gear = 0;
+
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+	FVector Velocity = FVector::ZeroVector;
+
+	friend FArchive& operator<<(FArchive& Ar, FFollowerCommandFrame& Frame)
+	{
+		Ar << Frame.PhysicsFrame << Frame.Steering << Frame.Throttle << Frame.Brake << Frame.Gear;
+		Ar << Frame.Location << Frame.Rotation << Frame.Velocity;
+		return Ar;
+	}
+};
+
+/**
+ * Control commands of a vehicle over a drive, stamped with the physics steps they were applied at,
+ * so they can be fed back to the vehicle without running the controller.
+ */
+struct DRIVERLESSCORE_API FFollowerCommandRecording
+{
+	TArray<FFollowerCommandFrame> Frames;
+
+	bool SaveToFile(const FString& FileName) const;
+	bool LoadFromFile(const FString& FileName);
+
+	// last frame at or before PhysicsFrame. Replays move forward, so the search starts from InOutCursor
+	const FFollowerCommandFrame* FindFrame(int32 PhysicsFrame, int32& InOutCursor) const;
+
+	bool IsFinished(int32 PhysicsFrame) const { return Frames.Num() == 0 || PhysicsFrame > Frames.Last().PhysicsFrame; }
+};
+
+// how far a replay drifted from the recording it replays
+struct DRIVERLESSCORE_API FFollowerReplayDivergence
+{
+	// pose, compared at every replayed frame
+	int32 NumFrames = 0;
+	double SumPositionError = 0.0;
+	float MaxPositionError = 0.0f;
+	float FinalPositionError = 0.0f;
+	float MaxHeadingError = 0.0f; // degrees
+
+	// commands of a controller running in the shadow of the replay, against the recorded ones
+	int32 NumCommandFrames = 0;
+	int32 NumCommandMismatches = 0;
+	float MaxSteeringError = 0.0f;
+	float MaxThrottleError = 0.0f;
+	float MaxBrakeError = 0.0f;
+
+	void AddPose(const FFollowerCommandFrame& Recorded, const FVector& Location, const FQuat& Rotation);
+	void AddCommands(const FFollowerCommandFrame& Recorded, float Steering, float Throttle, float Brake, float Tolerance);
+
+	float GetMeanPositionError() const { return NumFrames > 0 ? (float)(SumPositionError / NumFrames) : 0.0f; }
+	FString ToString() const;
+};
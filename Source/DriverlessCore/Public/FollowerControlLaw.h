@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// tuning of the follower's control law, copied out of the component so the law can run on any thread
+struct FFollowerControlParams
+{
+	float BrakingLookAhead = 3000.0f;
+	float MinLookAheadDistance = 800.0f;
+	float MaxLookAheadDistance = 2000.0f;
+	float BrakingSharpness = 0.8f;
+	float ObstacleTraceDistance = 1000.0f;
+	float AvoidanceStrength = 3.0f;
+};
+
+// throttle, brake and look-ahead planned from the sharpness of the curve ahead
+struct FFollowerSpeedPlan
+{
+	float TurnSharpness = 0.0f;
+	float PredictiveThrottle = 1.0f;
+	float CurvatureBrake = 0.0f;
+	float SteeringLookAhead = 0.0f;
+};
+
+// what the controller knows about the vehicle and its surroundings at a given step
+struct FFollowerControlInput
+{
+	FVector VehicleLocation = FVector::ZeroVector;
+	FVector VehicleForward = FVector::ForwardVector;
+	FVector VehicleRight = FVector::RightVector;
+
+	// look-ahead point on the track, already shifted by the traffic response
+	FVector TargetLocation = FVector::ZeroVector;
+
+	// obstacle avoidance result
+	bool bAvoiding = false;
+	FVector SafeDirection = FVector::ForwardVector;
+	float ObstacleHitDistance = 0.0f;
+
+	// other vehicles
+	float TrafficThrottleScale = 1.0f;
+	float TrafficBrake = 0.0f;
+};
+
+struct FFollowerControlOutput
+{
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+};
+
+// weights of the probe fan score: Wc * Clearance + Wa * Alignment - Ws * |Steering - CurrentSteering|
+struct FFollowerProbeWeights
+{
+	float Clearance = 1.0f;
+	float TrackAlignment = 0.3f;
+	float SteeringChange = 0.2f;
+};
+
+// per-probe terms of the fan score, as structure of arrays padded to a multiple of 4 so they're scored 4 probes at a time.
+// Kept by the caller between calls so scoring doesn't allocate
+struct FFollowerProbeScores
+{
+	// probe directions, transposed
+	TArray<float> DirectionX;
+	TArray<float> DirectionY;
+	TArray<float> DirectionZ;
+
+	TArray<float> Clearance;
+	TArray<float> Alignment;
+	TArray<float> Steering;
+	TArray<float> Scores;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return DirectionX.GetAllocatedSize() + DirectionY.GetAllocatedSize() + DirectionZ.GetAllocatedSize()
+			+ Clearance.GetAllocatedSize() + Alignment.GetAllocatedSize() + Steering.GetAllocatedSize() + Scores.GetAllocatedSize();
+	}
+};
+
+/**
+ * The follower's control law, on plain data only.
+ * The caller does the track lookups in between: PlanSpeed tells how far ahead to look, the caller finds
+ * the target there, and ComputeCommands turns it into steering, throttle and brake.
+ */
+namespace FollowerControl
+{
+	// CurrentTangent is the track tangent right ahead of the vehicle, FutureTangent the one BrakingLookAhead further
+	DRIVERLESSCORE_API FFollowerSpeedPlan PlanSpeed(const FFollowerControlParams& Params, const FVector& CurrentTangent, const FVector& FutureTangent);
+
+	DRIVERLESSCORE_API FFollowerControlOutput ComputeCommands(const FFollowerControlParams& Params, const FFollowerSpeedPlan& Plan, const FFollowerControlInput& Input);
+
+	// direction the controller steers to when avoiding towards SafeDirection
+	DRIVERLESSCORE_API FVector BlendAvoidanceDirection(const FFollowerControlParams& Params, const FVector& VehicleForward, const FVector& SafeDirection);
+
+	// index of the probe with the best trade-off between free distance, track direction and steering effort.
+	// Directions and Distances hold one entry per probe, Distances being the free distance along each of them
+	DRIVERLESSCORE_API int32 ScoreProbeFan(const FFollowerControlParams& Params, const FFollowerProbeWeights& Weights,
+		TConstArrayView<FVector> Directions, TConstArrayView<float> Distances,
+		const FVector& VehicleForward, const FVector& TrackDirection, float CurrentSteering, FFollowerProbeScores& Scratch);
+}
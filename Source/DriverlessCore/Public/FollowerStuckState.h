@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FFollowerStuckParams
+{
+	// still time before the recovery kicks in (seconds)
+	float MaxStuckTime = 2.0f;
+	// reverse time of the recovery (seconds)
+	float UnstuckTime = 2.0f;
+	// below this forward speed the vehicle counts as still (cm/s)
+	float StuckSpeedThreshold = 0.5f;
+};
+
+// what the stuck state machine wants from the vehicle this step. Unset inputs keep their previous value
+struct FFollowerStuckOutput
+{
+	// the recovery owns the vehicle this step, the regular control law is skipped
+	bool bOverride = false;
+
+	// the vehicle has been still for too long, the caller starts the recovery (StartRecovery, or a maneuver of its own)
+	bool bStartRecovery = false;
+
+	// gear to engage, 0 = keep the current one
+	int32 TargetGear = 0;
+
+	TOptional<float> Throttle;
+	TOptional<float> Steering;
+	TOptional<float> Brake;
+};
+
+/**
+ * Detects a vehicle stuck in place and drives the recovery: reverse with full lock to a random side,
+ * then drive forward for a while before handing control back.
+ * StuckTime encodes the phase: > 0 still (or driving away after a recovery), < 0 reversing, 0 driving.
+ */
+struct DRIVERLESSCORE_API FFollowerStuckState
+{
+	float StuckTime = 0.0f;
+	float RecoverySteer = 0.0f;
+	bool bPostRecovery = false;
+
+	FFollowerStuckOutput Update(const FFollowerStuckParams& Params, float DeltaTime, float ForwardSpeed);
+
+	// starts reversing now, when Update asks for it or a planned recovery gave up. bRecoverRight picks the steering side
+	void StartRecovery(const FFollowerStuckParams& Params, bool bRecoverRight);
+
+	bool IsReversing() const { return StuckTime < 0.0f; }
+	bool IsRecovering() const { return StuckTime < 0.0f || bPostRecovery; }
+
+	void Reset() { *this = FFollowerStuckState(); }
+};
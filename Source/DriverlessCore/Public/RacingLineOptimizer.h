@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTrackTable;
+
+struct FRacingLineParams
+{
+	// distance kept from the boundaries (cm), about half the width of the car plus some room
+	float Margin = 150.0f;
+
+	// problems solved in a row, each one linearizing the curvature around the line of the previous one
+	int32 NumLinearizations = 3;
+
+	// active set changes allowed per problem. Past them the line found so far is kept, it's always within the boundaries
+	int32 MaxIterations = 20000;
+};
+
+/**
+ * Minimum curvature racing line of a track, as lateral offsets from its centerline within its boundaries.
+ * The curvature at each sample is linearized as the second difference of the line along the normal of the previous line,
+ * so the sum of its squares is a quadratic of the offsets whose Hessian is pentadiagonal (cyclic on loops).
+ *
+ * The box constrained problem is solved with a primal active set method: each step solves the free offsets with a
+ * banded LDL^T factorization, O(samples). On loops the last two free offsets are split off and solved through their
+ * 2x2 Schur complement, so the band stays intact.
+ */
+class DRIVERLESSCORE_API FRacingLineOptimizer
+{
+public:
+	// offsets (cm, positive right) of the racing line at every sample of Track, which needs boundaries.
+	// False when the track has no boundaries or too few samples
+	bool Solve(const FTrackTable& Track, const FRacingLineParams& Params, TArray<float>& OutOffsets);
+
+	// active set steps of the last Solve, over all its linearizations, and whether each of them converged
+	int32 GetNumIterations() const { return NumIterations; }
+	bool HasConverged() const { return bConverged; }
+
+	// the line through the offsets as a table of its own, resampled every SampleSpacing along its length.
+	// Its tangents keep the length of the centerline's, the control law's curve measure depends on it
+	static TSharedRef<FTrackTable> BuildLineTable(const FTrackTable& Track, TConstArrayView<float> Offsets, float SampleSpacing);
+
+private:
+	// Hessian and linear term of the weighted sum of squared curvatures along Normals, for offsets along Rights from Centers
+	void BuildProblem(TConstArrayView<FVector2D> Centers, TConstArrayView<FVector2D> Rights,
+		TConstArrayView<FVector2D> Normals, TConstArrayView<double> Weights, float Spacing);
+	double GetHessianEntry(int32 J, int32 K) const;
+	void MultiplyHessian(TConstArrayView<double> X, TArray<double>& OutResult) const;
+
+	// one box constrained problem, from Offsets (within the bounds) to its minimum. False if it ran out of iterations
+	bool SolveBounded(int32 MaxIterations);
+	// minimum over the free offsets with the others held at their bound, into Target. False if the system is singular
+	bool SolveFree();
+	// banded LDL^T of the inner free offsets, then the solves of a right hand side in place
+	bool FactorInner(int32 NumInner);
+	void SolveInner(TArray<double>& InOutVector, int32 NumInner) const;
+
+	int32 Num = 0;
+	bool bLoop = false;
+
+	// Hessian bands: H(i, i), H(i, i + 1) and H(i, i + 2), indices wrapped on loops
+	TArray<double> Diag;
+	TArray<double> Band1;
+	TArray<double> Band2;
+	TArray<double> Linear;
+
+	TArray<double> Offsets;
+	TArray<double> Lower;
+	TArray<double> Upper;
+	TArray<int8> Bounds; // -1 held at Lower, 1 held at Upper, 0 free
+	TArray<double> Target;
+	TArray<double> Gradient;
+
+	// free offsets, their factorization and solves
+	TArray<int32> Free;
+	TArray<double> FactorD;
+	TArray<double> FactorL1;
+	TArray<double> FactorL2;
+	TArray<double> Rhs;
+	TArray<double> Border0;
+	TArray<double> Border1;
+
+	int32 NumIterations = 0;
+	bool bConverged = false;
+};
@@ -0,0 +1,196 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FRecoveryPlannerParams
+{
+	// local grid: size of a cell (cm) and cells per side, centered on the vehicle when the recovery starts
+	float CellSize = 50.0f;
+	int32 GridSize = 48;
+
+	// the vehicle, covered by two discs along its length, and the clearance kept around it (cm)
+	float VehicleLength = 450.0f;
+	float VehicleWidth = 200.0f;
+	float Margin = 25.0f;
+
+	// radius of the full lock arcs a maneuver is made of (cm)
+	float MinTurnRadius = 600.0f;
+
+	// cost of reversing and of steering, relative to driving straight forward
+	float ReverseCostScale = 1.5f;
+	float SteerCostScale = 1.1f;
+
+	// free distance straight ahead of a realigned pose (cm)
+	float GoalClearance = 300.0f;
+
+	// a search gives up after this many expansions
+	int32 MaxExpansions = 200000;
+};
+
+// one arc of a maneuver
+struct FRecoveryMotion
+{
+	int8 Direction = 0; // 1 forward, -1 reverse, 0 none
+	int8 Steer = 0; // -1 full lock left, 1 full lock right
+
+	bool IsValid() const { return Direction != 0; }
+};
+
+/**
+ * Plans the way out for a stuck vehicle: a few full lock or straight arcs, forward and in reverse, on a lattice of
+ * the cells of a local grid x 16 headings, ending aligned with the track with room ahead.
+ * The search is D* Lite: it runs backwards from the goal poses, so when the vehicle moves or new obstacles are seen
+ * the plan is repaired from what changed instead of searched from scratch.
+ *
+ * Collisions are checked in configuration space: each cell keeps a bit per heading, set when the vehicle would collide there.
+ * The obstacles the vehicle already overlaps don't block its first motion, so it can back out of them.
+ */
+class DRIVERLESSCORE_API FRecoveryPlanner
+{
+public:
+	static constexpr int32 NumHeadings = 16;
+	static constexpr int32 NumMotions = 6;
+
+	// empty grid centered on Center. The search is allocated by the first Init, Reset keeps it for the next one
+	void Init(const FRecoveryPlannerParams& InParams, const FVector2D& Center);
+	void Reset();
+	bool IsInitialized() const { return GridSize > 0; }
+
+	int32 GetGridSize() const { return GridSize; }
+	float GetCellSize() const { return Params.CellSize; }
+	FVector2D GetCellCenter(int32 X, int32 Y) const;
+	bool IsInside(const FVector2D& Location) const;
+
+	// heading (rad) of the track over a cell, the poses aligned with it are the goals. Set before the first plan
+	void SetGoalHeading(int32 X, int32 Y, float Heading);
+
+	// marks the cell of Location occupied. False if it already was, or it's outside the grid
+	bool AddObstacle(const FVector2D& Location);
+
+	// searches (first call) or repairs (next calls) the plan from the vehicle pose. False when no maneuver reaches a goal
+	bool Plan(const FVector2D& Location, float Yaw);
+
+	// the pose of the last plan is a goal, the maneuver is over
+	bool IsAtGoal() const;
+
+	// first motion of the plan, invalid without one, and the pose it ends at
+	FRecoveryMotion GetNextMotion() const;
+	bool GetNextPose(FVector2D& OutLocation, float& OutYaw) const;
+
+	// cost left to a goal (weighted cm), MAX_flt without a plan
+	float GetPlanCost() const;
+
+	// cell centers the plan goes through, for debug drawing
+	void GetPath(TArray<FVector2D>& OutLocations, int32 MaxMotions = 32) const;
+
+	// expansions of the last search or repair
+	int32 GetNumExpansions() const { return NumExpansions; }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	static constexpr float Unreachable = MAX_flt;
+
+	struct FKey
+	{
+		float Primary = 0.0f;
+		float Secondary = 0.0f;
+
+		bool operator<(const FKey& Other) const { return Primary < Other.Primary || (Primary == Other.Primary && Secondary < Other.Secondary); }
+	};
+
+	// cell offset and heading of a pose, relative to another
+	struct FPoseOffset
+	{
+		int16 X = 0;
+		int16 Y = 0;
+		int16 Heading = 0;
+
+		bool operator==(const FPoseOffset& Other) const { return X == Other.X && Y == Other.Y && Heading == Other.Heading; }
+	};
+
+	struct FMotionTable
+	{
+		FPoseOffset End;
+		float Cost = 0.0f;
+		// poses along the motion after its start, the end included
+		TArray<FPoseOffset> Samples;
+	};
+
+	// a motion reaching a pose of some heading: its start heading, and the cell offset from start to end
+	struct FPredecessor
+	{
+		int16 X = 0;
+		int16 Y = 0;
+		int8 Heading = 0;
+		int8 Motion = 0;
+	};
+
+	void BuildTables();
+	bool IsInFootprint(int32 OffsetX, int32 OffsetY, int32 Heading) const;
+
+	bool IsInGrid(int32 X, int32 Y) const { return X >= 0 && Y >= 0 && X < GridSize && Y < GridSize; }
+	int32 GetCellIndex(int32 X, int32 Y) const { return Y * GridSize + X; }
+	int32 GetState(int32 X, int32 Y, int32 Heading) const { return GetCellIndex(X, Y) * NumHeadings + Heading; }
+	void DecodeState(int32 State, int32& OutX, int32& OutY, int32& OutHeading) const;
+	bool GetCell(const FVector2D& Location, int32& OutX, int32& OutY) const;
+
+	bool Collides(int32 X, int32 Y, int32 Heading) const;
+	bool IsGoal(int32 State) const;
+	// cost of a motion from State, Unreachable when it's blocked
+	float GetEdgeCost(int32 State, int32 Motion, int32& OutSuccessor) const;
+	int32 GetBestMotion(int32 State, int32& OutSuccessor, float& OutCost) const;
+	float Heuristic(int32 From, int32 To) const;
+
+	FKey CalculateKey(int32 State) const;
+	void UpdateVertex(int32 State);
+	void UpdatePredecessors(int32 State);
+	void RepairChangedStates();
+	void ComputeShortestPath();
+
+	// priority queue of the search, a binary heap that knows where each state is
+	void QueuePush(int32 State, const FKey& Key);
+	void QueueRemove(int32 State);
+	void QueueSwap(int32 A, int32 B);
+	void SiftUp(int32 Index);
+	void SiftDown(int32 Index);
+
+	FRecoveryPlannerParams Params;
+	int32 GridSize = 0;
+	FVector2D Origin = FVector2D::ZeroVector; // corner of the grid
+
+	// per cell
+	TBitArray<> Occupied;
+	TArray<uint16> Collisions; // bit per heading
+	TArray<int8> GoalHeadings; // INDEX_NONE off the track
+
+	// per state
+	TArray<float> G;
+	TArray<float> Rhs;
+	TArray<int32> HeapIndex;
+	TArray<uint32> Stamps;
+	uint32 Stamp = 0;
+
+	TArray<int32> Heap;
+	TArray<FKey> HeapKeys;
+
+	// lattice, per heading
+	TArray<FPoseOffset> Footprints[NumHeadings];
+	FMotionTable Motions[NumHeadings][NumMotions];
+	TArray<FPredecessor> Predecessors[NumHeadings];
+	TArray<FPoseOffset> ClearanceOffsets[NumHeadings];
+	// motion samples of each heading, as the offset from the start of their motion and its heading
+	TArray<FPoseOffset> SampleSources[NumHeadings];
+
+	// poses that started colliding since the last plan, and the states they affect
+	TArray<int32> ChangedStates;
+	TArray<int32> RepairStates;
+
+	int32 StartState = INDEX_NONE;
+	int32 LastState = INDEX_NONE;
+	float KeyModifier = 0.0f;
+	bool bSearched = false;
+	int32 NumExpansions = 0;
+};
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Occupancy of a track in its own coordinates: rows run along the centerline (S, cm from the start),
+ * columns across it (D, cm from the centerline, positive right, within +-HalfWidth).
+ * One bit per cell, 8x8 cells per 64-bit word (a byte per row of the tile), the tiles of a stretch of track contiguous,
+ * so clearing a corridor tests a few masked words. Cells outside the grid count as occupied.
+ *
+ * Two layers: the walls, rasterized once, and the obstacles (discs, e.g. cones), moved incrementally:
+ * a move only rebuilds the rows of tiles the obstacle left and entered.
+ */
+class DRIVERLESSCORE_API FTrackOccupancyGrid
+{
+public:
+	static constexpr int32 TileSize = 8;
+
+	// empty grid over a track of the given length
+	void Init(float InLength, bool bInClosedLoop, float InHalfWidth, float InCellSize);
+
+	// walls of a row, as the offsets of the left (negative) and right wall. The cells from a wall outwards are occupied
+	void SetRowWalls(int32 Row, float LeftWall, float RightWall);
+
+	// obstacles, as discs in track coordinates. Returns the index to move it with
+	int32 AddObstacle(float S, float D, float Radius);
+	void MoveObstacle(int32 Index, float S, float D);
+	void RemoveObstacle(int32 Index);
+	void ClearObstacles();
+	int32 NumObstacles() const { return Obstacles.Num(); }
+	FVector2D GetObstacleLocation(int32 Index) const { return FVector2D(Obstacles[Index].S, Obstacles[Index].D); }
+
+	bool IsOccupied(float S, float D) const;
+	bool IsCellOccupied(int32 Row, int32 Col) const;
+
+	// true if no cell of [StartS, EndS] x [MinD, MaxD] is occupied. EndS may run past the end of a loop
+	bool IsCorridorClear(float StartS, float EndS, float MinD, float MaxD) const;
+
+	// free distance (cm) from S along the lane [MinD, MaxD] to the first occupied row, MaxDistance when clear
+	float GetFreeDistance(float S, float MinD, float MaxD, float MaxDistance) const;
+
+	int32 GetNumRows() const { return NumRows; }
+	int32 GetNumCols() const { return NumCols; }
+	float GetCellSize() const { return CellSize; }
+	float GetHalfWidth() const { return HalfWidth; }
+	bool IsClosedLoop() const { return bClosedLoop; }
+
+	// cell of a track coordinate (row wrapped on loops, clamped otherwise), and center of a cell
+	int32 GetRow(float S) const;
+	int32 GetCol(float D) const;
+	float GetRowS(int32 Row) const { return (Row + 0.5f) * CellSize; }
+	float GetColD(int32 Col) const { return (Col + 0.5f) * CellSize - HalfWidth; }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FObstacle
+	{
+		float S = 0.0f;
+		float D = 0.0f;
+		float Radius = 0.0f; // 0 = removed
+	};
+
+	float WrapS(float S) const;
+	int32 GetTileIndex(int32 Row, int32 Col) const { return (Row / TileSize) * NumTileCols + Col / TileSize; }
+	static uint64 GetCellBit(int32 Row, int32 Col) { return 1ull << ((Row % TileSize) * TileSize + Col % TileSize); }
+
+	// column span of an unclamped D range, false when it misses the grid
+	bool GetColSpan(float MinD, float MaxD, int32& OutFirst, int32& OutLast) const;
+	// rows within [FirstRow, LastRow] with no wrapping, and columns [FirstCol, LastCol]
+	bool IsRectClear(int32 FirstRow, int32 LastRow, int32 FirstCol, int32 LastCol) const;
+	int32 FindFirstOccupiedRow(int32 FirstRow, int32 LastRow, int32 FirstCol, int32 LastCol) const;
+
+	// rows of tiles an obstacle's disc touches, wrapped on loops
+	void GetObstacleTileRows(const FObstacle& Obstacle, TArray<int32, TInlineAllocator<4>>& OutTileRows) const;
+	void StampObstacle(const FObstacle& Obstacle);
+	void RebuildTileRows(const TArray<int32, TInlineAllocator<8>>& TileRows);
+	void SetRowSpan(TArray<uint64>& Layer, int32 Row, int32 FirstCol, int32 LastCol);
+
+	float Length = 0.0f;
+	bool bClosedLoop = false;
+	float HalfWidth = 0.0f;
+	float CellSize = 25.0f;
+	int32 NumRows = 0;
+	int32 NumCols = 0;
+	int32 NumTileRows = 0;
+	int32 NumTileCols = 0;
+
+	// tiles of the walls, of the obstacles, and of both, which the queries read
+	TArray<uint64> WallTiles;
+	TArray<uint64> ObstacleTiles;
+	TArray<uint64> Tiles;
+
+	TArray<FObstacle> Obstacles;
+	// obstacles touching each row of tiles
+	TArray<TArray<int32>> TileRowObstacles;
+};
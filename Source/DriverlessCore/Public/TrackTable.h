@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Track centerline resampled at a fixed arc-length step.
+ * It's plain data: once built it never touches the spline again, so lookups are cheap and it can be
+ * shared between every vehicle on the same track.
+ */
+struct DRIVERLESSCORE_API FTrackTable
+{
+	// distance between two samples (cm)
+	float SampleSpacing = 100.0f;
+
+	// total length of the track (cm)
+	float Length = 0.0f;
+
+	// whether the end of the track connects back to its start
+	bool bClosedLoop = false;
+
+	// one entry per sample
+	TArray<FVector> Locations;
+	TArray<FVector> Directions; // unit tangent
+	TArray<FVector> Tangents; // tangent as the spline reports it, the controller's curve measure depends on its length
+	TArray<float> Curvature; // 1/cm, positive when turning right
+	TArray<float> SpeedProfile; // target speed (cm/s)
+
+	// edges of the track, as offsets from the centerline (cm, left negative, right positive). Empty until InitBoundaries.
+	// With the centerline they make the left and right boundary polylines, see GetBoundaryLocation
+	TArray<float> LeftBoundary;
+	TArray<float> RightBoundary;
+	// how far the boundaries were looked for: a boundary this far out bounds nothing
+	float BoundaryRange = 0.0f;
+
+	// uniform grid over the track (XY) listing the segments near each cell, so a search without a hint scans a few of them
+	// instead of the whole track. Empty until BuildSpatialIndex
+	FVector2D IndexOrigin = FVector2D::ZeroVector; // corner of the grid
+	float IndexCellSize = 0.0f;
+	int32 IndexSizeX = 0;
+	int32 IndexSizeY = 0;
+	TArray<int32> IndexCellStarts; // first entry of each cell in IndexSegments, plus one past the last cell
+	TArray<int32> IndexSegments; // segment indices, in increasing order within a cell
+
+	// table from centerline samples taken every SampleSpacing, the last one at the very end of the track.
+	// Loops are detected from the ends meeting, curvature and a default speed profile are derived from the samples
+	static TSharedRef<FTrackTable> BuildFromSamples(TArray<FVector> Locations, TArray<FVector> Directions, TArray<FVector> Tangents, float SampleSpacing, bool bClosedLoop);
+
+	// target speed at each sample, limited by lateral grip and by how hard the car can accelerate and brake (cm/s, cm/s^2)
+	void BuildSpeedProfile(float MaxSpeed, float MaxLateralAccel, float MaxAccel, float MaxDecel);
+
+	// boundaries MaxOffset away on both sides of every sample, to be narrowed to the track edges and walls
+	void InitBoundaries(float MaxOffset);
+
+	// narrows the boundaries to points of the edges of the track (e.g. of its road mesh). Each point is projected on the centerline
+	// and bounds the side it lies on, the boundary between two points is interpolated along the track
+	void SetBoundariesFromEdges(TConstArrayView<FVector> EdgePoints);
+
+	bool HasBoundaries() const { return LeftBoundary.Num() == Num() && RightBoundary.Num() == Num(); }
+
+	// registers every segment in the cells within CellSize of it: a segment found that close to a location is the closest
+	void BuildSpatialIndex(float CellSize);
+
+	bool HasSpatialIndex() const { return IndexCellStarts.Num() == IndexSizeX * IndexSizeY + 1 && IndexSizeX > 0; }
+
+	int32 Num() const { return Locations.Num(); }
+	SIZE_T GetAllocatedSize() const;
+	bool IsValid() const { return Locations.Num() >= 2; }
+
+	// distance wrapped around the loop, or clamped on open tracks
+	float WrapDistance(float Distance) const;
+
+	FVector GetLocationAtDistance(float Distance) const;
+	FVector GetDirectionAtDistance(float Distance) const;
+	FVector GetTangentAtDistance(float Distance) const;
+	float GetCurvatureAtDistance(float Distance) const;
+	float GetSpeedAtDistance(float Distance) const;
+
+	// level unit vector to the right of the track
+	FVector GetRightAtDistance(float Distance) const;
+
+	// offsets of the left (X, negative) and right (Y) boundary. Requires HasBoundaries
+	FVector2D GetBoundariesAtDistance(float Distance) const;
+	// point of the left or right boundary polyline
+	FVector GetBoundaryLocation(float Distance, bool bRight) const;
+
+	// distance (cm) from the track coordinates (S, D) to the left (X) and right (Y) boundary, negative past it.
+	// Two lerps, no search. Requires HasBoundaries
+	FVector2D GetWallClearance(float S, float D) const;
+
+	// track coordinates of Location: X is the distance along the track, Y the signed offset from the centerline (cm, positive right).
+	// Hint as for FindDistanceClosestToLocation
+	FVector2D GetTrackCoordinates(const FVector& Location, float HintDistance = -1.0f) const;
+
+	// distance of the point of the track closest to Location.
+	// With a hint (e.g. last frame's distance) only a window around it is searched, otherwise the cell of the spatial index
+	// Location is in, or the whole track without an index or when nothing is near
+	float FindDistanceClosestToLocation(const FVector& Location, float HintDistance = -1.0f, float SearchWindow = 2000.0f) const;
+
+private:
+	// sample index and blend factor for a distance
+	void GetSegment(float Distance, int32& OutIndex, int32& OutNextIndex, float& OutAlpha) const;
+	float ProjectOnSegment(int32 Index, const FVector& Location, float& OutDistSq) const;
+};
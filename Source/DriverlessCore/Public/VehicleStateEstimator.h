@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FixedMatrix.h"
+
+struct FVehicleStateEstimatorParams
+{
+	// acceleration the model doesn't know about, IMU error included (cm/s^2, standard deviation)
+	double AccelNoise = 50.0;
+	// yaw acceleration the model doesn't know about (rad/s^2, standard deviation)
+	double YawAccelNoise = 0.5;
+
+	// measurement noise, standard deviations
+	double GyroNoise = 0.01; // rad/s
+	double OdometryNoise = 10.0; // cm/s
+	double PositionFixNoise = 30.0; // cm
+
+	// position fixes farther than this from the estimate (normalized squared distance) are rejected as outliers.
+	// 13.8 keeps 99.9% of the genuine ones, 0 accepts them all
+	double PositionFixGate = 13.8;
+};
+
+/**
+ * Extended Kalman filter of a vehicle's planar motion (constant turn rate and acceleration), on fixed-size matrices:
+ * a step allocates nothing and costs a few thousand flops, so it runs at hundreds of Hz for many vehicles.
+ * The IMU's longitudinal acceleration drives the prediction, its gyro, the wheel odometry and the position fixes correct it.
+ * Angles in radians, distances in cm.
+ */
+class DRIVERLESSCORE_API FVehicleStateEstimator
+{
+public:
+	enum EState : int32
+	{
+		X,
+		Y,
+		Yaw,
+		Speed, // along the heading
+		YawRate,
+		NumStates
+	};
+
+	using FState = TFixedVector<NumStates>;
+	using FCovariance = TFixedMatrix<NumStates, NumStates>;
+
+	FVehicleStateEstimator();
+
+	// starts over from a known state, with the uncertainty of a position fix
+	void Reset(const FVehicleStateEstimatorParams& InParams, const FVector2D& Location, double InYaw, double InSpeed);
+
+	// moves the estimate DeltaTime forward, with the longitudinal acceleration the IMU measured (cm/s^2)
+	void Predict(double DeltaTime, double LongitudinalAcceleration);
+
+	// the measurements. False when the update was rejected (outlier, or a degenerate covariance)
+	bool FuseGyro(double MeasuredYawRate);
+	bool FuseOdometry(double MeasuredSpeed);
+	bool FusePositionFix(const FVector2D& MeasuredLocation);
+
+	const FState& GetState() const { return State; }
+	const FCovariance& GetCovariance() const { return Covariance; }
+	FVector2D GetLocation() const { return FVector2D(State[X], State[Y]); }
+	double GetYaw() const { return State[Yaw]; }
+	double GetSpeed() const { return State[Speed]; }
+
+	// standard deviation of the position (cm), the larger axis
+	double GetPositionUncertainty() const;
+
+	const FVehicleStateEstimatorParams& GetParams() const { return Params; }
+
+private:
+	template <int32 NumMeasurements>
+	bool Update(const TFixedVector<NumMeasurements>& Innovation, const TFixedMatrix<NumMeasurements, NumStates>& H,
+		const TFixedMatrix<NumMeasurements, NumMeasurements>& R, double Gate);
+
+	FVehicleStateEstimatorParams Params;
+	FState State;
+	FCovariance Covariance;
+};
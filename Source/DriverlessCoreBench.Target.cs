@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+using System.Collections.Generic;
+
+// Standalone micro-benchmarks of DriverlessCore, built and run without the engine:
+//   Build.sh DriverlessCoreBench Linux Development -Project=DriverlessTask.uproject
+[SupportedPlatforms(UnrealPlatformClass.Desktop)]
+public class DriverlessCoreBenchTarget : TargetRules
+{
+	public DriverlessCoreBenchTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Program;
+		LinkType = TargetLinkType.Monolithic;
+		DefaultBuildSettings = BuildSettingsVersion.V5;
+		LaunchModuleName = "DriverlessCoreBench";
+
+		bBuildDeveloperTools = false;
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileICU = false;
+		bUseLoggingInShipping = true;
+
+		bIsBuildingConsoleApplication = true;
+	}
+}
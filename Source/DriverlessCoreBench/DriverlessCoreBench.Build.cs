@@ -0,0 +1,13 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class DriverlessCoreBench : ModuleRules
+{
+	public DriverlessCoreBench(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PublicIncludePathModuleNames.Add("Launch");
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "Core", "ApplicationCore", "Projects", "DriverlessCore" });
+	}
+}
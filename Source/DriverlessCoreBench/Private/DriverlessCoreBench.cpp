@@ -0,0 +1,529 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RequiredProgramMainCPPInclude.h"
+#include "Misc/CommandLine.h"
+#include "Misc/ScopeExit.h"
+#include "Math/RandomStream.h"
+#include "TrackTable.h"
+#include "FollowerControlLaw.h"
+#include "FollowerStuckState.h"
+#include "FollowerCommandQueue.h"
+#include "ConeDelaunay.h"
+#include "VehicleStateEstimator.h"
+#include "TrackOccupancyGrid.h"
+#include "RecoveryPlanner.h"
+#include "RacingLineOptimizer.h"
+
+/**
+ * Micro-benchmarks of the driverless control math, without the engine.
+ * Every kernel runs over a synthetic closed track and a trajectory driven along it, and reports the
+ * best and median time per call over several repetitions.
+ *
+ *   DriverlessCoreBench [-filter=<substring>] [-iterations=<calls per repetition>] [-repeat=<repetitions>]
+ */
+
+DEFINE_LOG_CATEGORY_STATIC(LogDriverlessCoreBench, Log, All);
+
+IMPLEMENT_APPLICATION(DriverlessCoreBench, "DriverlessCoreBench");
+
+namespace DriverlessCoreBench
+{
+	// results are folded into this so the compiler can't drop the benchmarked calls
+	static volatile float Sink = 0.0f;
+
+	struct FSettings
+	{
+		FString Filter;
+		int32 Iterations = 100000;
+		int32 Repeat = 7;
+	};
+
+	// closed track of the given length with a few corners of different radius (cm)
+	static TSharedRef<FTrackTable> MakeTrack(float Length, float SampleSpacing)
+	{
+		const int32 NumSamples = FMath::Max(3, FMath::CeilToInt32(Length / SampleSpacing) + 1);
+		const float BaseRadius = Length / UE_TWO_PI;
+
+		TArray<FVector> Locations, Directions, Tangents;
+		Locations.SetNumUninitialized(NumSamples);
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			const float Angle = UE_TWO_PI * i / (NumSamples - 1);
+			const float Radius = BaseRadius * (1.0f + 0.25f * FMath::Sin(3.0f * Angle));
+			Locations[i] = FVector(Radius * FMath::Cos(Angle), Radius * FMath::Sin(Angle), 0.0f);
+		}
+
+		Directions.SetNumUninitialized(NumSamples);
+		Tangents.SetNumUninitialized(NumSamples);
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			const FVector Delta = Locations[FMath::Min(i + 1, NumSamples - 1)] - Locations[FMath::Max(i - 1, 0)];
+			Directions[i] = Delta.GetSafeNormal();
+			// spline tangents are about as long as the segments between the spline points
+			Tangents[i] = Directions[i] * 2000.0f;
+		}
+
+		// resampled spacing, so the table ends exactly where the loop closes
+		float TrackLength = 0.0f;
+		for (int32 i = 1; i < NumSamples; i++)
+			TrackLength += FVector::Dist(Locations[i - 1], Locations[i]);
+
+		return FTrackTable::BuildFromSamples(MoveTemp(Locations), MoveTemp(Directions), MoveTemp(Tangents), TrackLength / (NumSamples - 1), true);
+	}
+
+	// a vehicle pose every frame of a lap at 60 Hz, weaving a little around the centerline
+	struct FTrajectory
+	{
+		TArray<FVector> Locations;
+		TArray<FVector> Forwards;
+		TArray<float> Distances;
+	};
+
+	static FTrajectory MakeTrajectory(const FTrackTable& Track, int32 NumFrames)
+	{
+		FRandomStream Stream(1337);
+		FTrajectory Trajectory;
+		Trajectory.Locations.SetNumUninitialized(NumFrames);
+		Trajectory.Forwards.SetNumUninitialized(NumFrames);
+		Trajectory.Distances.SetNumUninitialized(NumFrames);
+
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			const float Distance = Track.Length * i / NumFrames;
+			const FVector Direction = Track.GetDirectionAtDistance(Distance);
+			const FVector Right = FVector::CrossProduct(FVector::UpVector, Direction);
+
+			Trajectory.Distances[i] = Distance;
+			Trajectory.Locations[i] = Track.GetLocationAtDistance(Distance) + Right * 300.0f * FMath::Sin(i * 0.01f) + FVector(0.0f, 0.0f, 50.0f);
+			Trajectory.Forwards[i] = Direction.RotateAngleAxis(Stream.FRandRange(-10.0f, 10.0f), FVector::UpVector);
+		}
+		return Trajectory;
+	}
+
+	// runs Kernel(Index) Settings.Iterations times per repetition, and logs ns per call
+	template <typename KernelType>
+	static void Run(const FSettings& Settings, const FString& Name, KernelType&& Kernel)
+	{
+		if (!Settings.Filter.IsEmpty() && !Name.Contains(Settings.Filter))
+			return;
+
+		TArray<double> Timings;
+		for (int32 Repeat = 0; Repeat < Settings.Repeat; Repeat++)
+		{
+			float Accumulator = 0.0f;
+			const uint64 Start = FPlatformTime::Cycles64();
+			for (int32 i = 0; i < Settings.Iterations; i++)
+				Accumulator += Kernel(i);
+			const uint64 End = FPlatformTime::Cycles64();
+
+			Sink = Sink + Accumulator;
+			Timings.Add(FPlatformTime::ToSeconds64(End - Start) * 1e9 / Settings.Iterations);
+		}
+
+		Timings.Sort();
+		UE_LOG(LogDriverlessCoreBench, Display, TEXT("%-48s %10.1f ns/op (best) %10.1f ns/op (median)"), *Name, Timings[0], Timings[Timings.Num() / 2]);
+	}
+
+	static void RunTrackBenchmarks(const FSettings& Settings)
+	{
+		// same track at different resolutions, and longer tracks at the default one
+		struct FTrackSize { float Length; float Spacing; };
+		for (const FTrackSize Size : { FTrackSize{ 200000.0f, 100.0f }, FTrackSize{ 200000.0f, 10.0f }, FTrackSize{ 2000000.0f, 100.0f } })
+		{
+			const TSharedRef<FTrackTable> Track = MakeTrack(Size.Length, Size.Spacing);
+			const FTrajectory Trajectory = MakeTrajectory(*Track, 4096);
+			const int32 Mask = Trajectory.Locations.Num() - 1;
+			const FString Suffix = FString::Printf(TEXT("[%d samples]"), Track->Num());
+
+			Run(Settings, TEXT("TrackTable::FindDistance (hint) ") + Suffix, [&](int32 i)
+			{
+				const int32 Frame = i & Mask;
+				return Track->FindDistanceClosestToLocation(Trajectory.Locations[Frame], Trajectory.Distances[Frame]);
+			});
+
+			// a full search is much slower, keep the run short
+			FSettings Reduced = Settings;
+			Reduced.Iterations = FMath::Max(1, Settings.Iterations / 100);
+			Run(Reduced, TEXT("TrackTable::FindDistance (full) ") + Suffix, [&](int32 i)
+			{
+				return Track->FindDistanceClosestToLocation(Trajectory.Locations[i & Mask]);
+			});
+
+			Run(Settings, TEXT("TrackTable::GetLocationAtDistance ") + Suffix, [&](int32 i)
+			{
+				return Track->GetLocationAtDistance(Trajectory.Distances[i & Mask] + 1500.0f).X;
+			});
+
+			Run(Settings, TEXT("TrackTable::GetTangentAtDistance ") + Suffix, [&](int32 i)
+			{
+				return Track->GetTangentAtDistance(Trajectory.Distances[i & Mask] + 3000.0f).Y;
+			});
+
+			Run(Reduced, TEXT("TrackTable::BuildSpeedProfile ") + Suffix, [&](int32 i)
+			{
+				Track->BuildSpeedProfile(3000.0f, 900.0f, 400.0f, 800.0f);
+				return Track->SpeedProfile[i % Track->Num()];
+			});
+
+			// a road 10 to 14 m wide, with points of its edges every 5 m like a road mesh
+			TArray<FVector> EdgePoints;
+			for (float Distance = 0.0f; Distance < Track->Length; Distance += 500.0f)
+			{
+				const float HalfWidth = 600.0f + 100.0f * FMath::Sin(Distance * 0.001f);
+				const FVector Location = Track->GetLocationAtDistance(Distance);
+				const FVector Right = Track->GetRightAtDistance(Distance);
+				EdgePoints.Add(Location - Right * HalfWidth);
+				EdgePoints.Add(Location + Right * HalfWidth);
+			}
+
+			FSettings Build = Settings;
+			Build.Iterations = FMath::Max(1, Settings.Iterations / 10000);
+			Run(Build, TEXT("TrackTable::SetBoundariesFromEdges ") + Suffix, [&](int32 i)
+			{
+				Track->InitBoundaries(1500.0f);
+				Track->SetBoundariesFromEdges(EdgePoints);
+				return Track->RightBoundary[i % Track->Num()];
+			});
+
+			Run(Settings, TEXT("TrackTable::GetWallClearance ") + Suffix, [&](int32 i)
+			{
+				const int32 Frame = i & Mask;
+				return Track->GetWallClearance(Trajectory.Distances[Frame], 300.0f * FMath::Sin(Frame * 0.01f)).X;
+			});
+
+			Run(Build, TEXT("TrackTable::BuildSpatialIndex ") + Suffix, [&](int32 i)
+			{
+				Track->BuildSpatialIndex(2000.0f);
+				return (float)Track->IndexSegments[i % Track->IndexSegments.Num()];
+			});
+
+			// the same search without a hint as (full), once the index is built
+			Run(Settings, TEXT("TrackTable::FindDistance (index) ") + Suffix, [&](int32 i)
+			{
+				return Track->FindDistanceClosestToLocation(Trajectory.Locations[i & Mask]);
+			});
+		}
+	}
+
+	static void RunRacingLineBenchmarks(const FSettings& Settings)
+	{
+		// a road 12 m wide, a whole optimization per op
+		const TSharedRef<FTrackTable> Track = MakeTrack(200000.0f, 100.0f);
+		Track->InitBoundaries(600.0f);
+
+		FSettings Reduced = Settings;
+		Reduced.Iterations = FMath::Max(1, Settings.Iterations / 10000);
+
+		FRacingLineOptimizer Optimizer;
+		const FRacingLineParams Params;
+		TArray<float> Offsets;
+		Run(Reduced, FString::Printf(TEXT("FRacingLineOptimizer::Solve [%d samples]"), Track->Num()), [&](int32 i)
+		{
+			Optimizer.Solve(*Track, Params, Offsets);
+			return Offsets[i % Offsets.Num()];
+		});
+
+		Run(Reduced, TEXT("FRacingLineOptimizer::BuildLineTable"), [&](int32 i)
+		{
+			return FRacingLineOptimizer::BuildLineTable(*Track, Offsets, Track->SampleSpacing)->Length;
+		});
+	}
+
+	static void RunControlBenchmarks(const FSettings& Settings)
+	{
+		const TSharedRef<FTrackTable> Track = MakeTrack(200000.0f, 100.0f);
+		const FTrajectory Trajectory = MakeTrajectory(*Track, 4096);
+		const int32 Mask = Trajectory.Locations.Num() - 1;
+
+		const FFollowerControlParams Params;
+
+		Run(Settings, TEXT("FollowerControl::PlanSpeed"), [&](int32 i)
+		{
+			const float Distance = Trajectory.Distances[i & Mask];
+			const FFollowerSpeedPlan Plan = FollowerControl::PlanSpeed(Params, Track->GetTangentAtDistance(Distance + 10.0f), Track->GetTangentAtDistance(Distance + Params.BrakingLookAhead));
+			return Plan.SteeringLookAhead;
+		});
+
+		Run(Settings, TEXT("FollowerControl::ComputeCommands"), [&](int32 i)
+		{
+			const int32 Frame = i & Mask;
+			const FFollowerSpeedPlan Plan;
+
+			FFollowerControlInput Input;
+			Input.VehicleLocation = Trajectory.Locations[Frame];
+			Input.VehicleForward = Trajectory.Forwards[Frame];
+			Input.VehicleRight = FVector::CrossProduct(FVector::UpVector, Input.VehicleForward);
+			Input.TargetLocation = Track->GetLocationAtDistance(Trajectory.Distances[Frame] + 1500.0f);
+			Input.bAvoiding = (Frame & 7) == 0;
+			Input.SafeDirection = Input.VehicleRight;
+			Input.ObstacleHitDistance = 500.0f;
+
+			const FFollowerControlOutput Output = FollowerControl::ComputeCommands(Params, Plan, Input);
+			return Output.Steering + Output.Throttle;
+		});
+
+		const FFollowerProbeWeights Weights;
+		for (const int32 NumProbes : { 3, 7, 16 })
+		{
+			TArray<FVector> Directions;
+			TArray<float> Distances;
+			FRandomStream Stream(NumProbes);
+			for (int32 p = 0; p < NumProbes; p++)
+			{
+				Directions.Add(FVector::ForwardVector.RotateAngleAxis(FMath::Lerp(-30.0f, 30.0f, (float)p / FMath::Max(NumProbes - 1, 1)), FVector::UpVector));
+				Distances.Add(Stream.FRandRange(100.0f, Params.ObstacleTraceDistance));
+			}
+
+			FFollowerProbeScores Scratch;
+			Run(Settings, FString::Printf(TEXT("FollowerControl::ScoreProbeFan [%d probes]"), NumProbes), [&](int32 i)
+			{
+				return (float)FollowerControl::ScoreProbeFan(Params, Weights, Directions, Distances,
+					Trajectory.Forwards[i & Mask], FVector::ForwardVector, 0.1f, Scratch);
+			});
+		}
+
+		FFollowerStuckState StuckState;
+		const FFollowerStuckParams StuckParams;
+		Run(Settings, TEXT("FFollowerStuckState::Update"), [&](int32 i)
+		{
+			// alternate still and moving stretches, so every phase of the state machine is visited
+			const float ForwardSpeed = ((i >> 9) & 1) ? 0.0f : 1500.0f;
+			const FFollowerStuckOutput Output = StuckState.Update(StuckParams, 1.0f / 60.0f, ForwardSpeed);
+			if (Output.bStartRecovery)
+				StuckState.StartRecovery(StuckParams, (i & 1) != 0);
+			return Output.bOverride ? 1.0f : 0.0f;
+		});
+
+		// a controller pushing a few commands per vehicle frame, drained once per frame
+		FFollowerCommandQueue Queue(64);
+		Run(Settings, TEXT("FFollowerCommandQueue::Push x4 + Drain"), [&](int32 i)
+		{
+			const double Now = i * (1.0 / 60.0);
+			for (int32 c = 0; c < 4; c++)
+			{
+				FFollowerTimedCommand Command;
+				Command.Timestamp = Now - c * 0.01;
+				Command.Steering = Trajectory.Forwards[i & Mask].Y;
+				Queue.Push(Command);
+			}
+			const FFollowerCommandDrain Drain = Queue.Drain(Now, 0.025);
+			return Drain.Command.IsSet() ? Drain.Command->Steering : 0.0f;
+		});
+	}
+
+	static void RunConeBenchmarks(const FSettings& Settings)
+	{
+		// a cone pair every 3 m on the edges of a track 6 m wide, placed a little off
+		const TSharedRef<FTrackTable> Track = MakeTrack(200000.0f, 100.0f);
+		const FTrajectory Trajectory = MakeTrajectory(*Track, 4096);
+		const int32 Mask = Trajectory.Locations.Num() - 1;
+
+		FRandomStream Stream(42);
+		TArray<FVector> Cones;
+		TArray<EConeSide> Sides;
+		for (float Distance = 0.0f; Distance < Track->Length; Distance += 300.0f)
+		{
+			const FVector Right = FVector::CrossProduct(FVector::UpVector, Track->GetDirectionAtDistance(Distance));
+			for (const EConeSide Side : { EConeSide::Left, EConeSide::Right })
+			{
+				Cones.Add(Track->GetLocationAtDistance(Distance + Stream.FRandRange(-20.0f, 20.0f)) + Right * (int32)Side * Stream.FRandRange(280.0f, 320.0f));
+				Sides.Add(Side);
+			}
+		}
+
+		// cones come into view in driving order, the triangulation starts over once all of them are in
+		FConeDelaunay Triangulation;
+		Run(Settings, FString::Printf(TEXT("FConeDelaunay::AddCone [%d cones]"), Cones.Num()), [&](int32 i)
+		{
+			const int32 Cone = i % Cones.Num();
+			if (Cone == 0)
+				Triangulation.Reset(FVector2D::ZeroVector, Track->Length);
+			return (float)Triangulation.AddCone(Cones[Cone], Sides[Cone]);
+		});
+
+		Triangulation.Reset(FVector2D::ZeroVector, Track->Length);
+		for (int32 Cone = 0; Cone < Cones.Num(); Cone++)
+			Triangulation.AddCone(Cones[Cone], Sides[Cone]);
+		if (!Triangulation.Validate())
+			UE_LOG(LogDriverlessCoreBench, Error, TEXT("FConeDelaunay: triangulation of %d cones isn't valid"), Cones.Num());
+
+		TArray<FVector> Centerline;
+		Run(Settings, TEXT("FConeDelaunay::TraceCenterline [20 m]"), [&](int32 i)
+		{
+			const int32 Frame = i & Mask;
+			Triangulation.TraceCenterline(Trajectory.Locations[Frame], Trajectory.Forwards[Frame], 2000.0, Centerline);
+			return (float)Centerline.Num();
+		});
+	}
+
+	static void RunEstimatorBenchmarks(const FSettings& Settings)
+	{
+		const FVehicleStateEstimatorParams Params;
+		FVehicleStateEstimator Estimator;
+		Estimator.Reset(Params, FVector2D::ZeroVector, 0.0, 1500.0);
+
+		// one 500 Hz step: prediction and gyro every step, odometry every 5th, a position fix every 50th
+		Run(Settings, TEXT("FVehicleStateEstimator::Step [500 Hz]"), [&](int32 i)
+		{
+			Estimator.Predict(0.002, 10.0 * FMath::Sin(i * 0.001));
+			Estimator.FuseGyro(0.1 * FMath::Sin(i * 0.002));
+			if (i % 5 == 0)
+				Estimator.FuseOdometry(1500.0);
+			if (i % 50 == 0)
+				Estimator.FusePositionFix(Estimator.GetLocation() + FVector2D(20.0, -20.0));
+			return (float)Estimator.GetState()[FVehicleStateEstimator::Speed];
+		});
+	}
+
+	static void RunOccupancyBenchmarks(const FSettings& Settings)
+	{
+		// walls 6 m from the centerline, a cone every 3 m on each edge of the road
+		const TSharedRef<FTrackTable> Track = MakeTrack(200000.0f, 100.0f);
+		const FTrajectory Trajectory = MakeTrajectory(*Track, 4096);
+		const int32 Mask = Trajectory.Locations.Num() - 1;
+
+		FTrackOccupancyGrid Grid;
+		Grid.Init(Track->Length, true, 1500.0f, 25.0f);
+		for (int32 Row = 0; Row < Grid.GetNumRows(); Row++)
+			Grid.SetRowWalls(Row, -600.0f, 600.0f);
+
+		FRandomStream Stream(42);
+		for (float Distance = 0.0f; Distance < Track->Length; Distance += 300.0f)
+		{
+			Grid.AddObstacle(Distance, -300.0f, 15.0f);
+			Grid.AddObstacle(Distance, 300.0f, 15.0f);
+		}
+
+		TArray<FVector2D> Coordinates;
+		for (const FVector& Location : Trajectory.Locations)
+			Coordinates.Add(Track->GetTrackCoordinates(Location));
+
+		const FString Suffix = FString::Printf(TEXT("[%d x %d cells]"), Grid.GetNumRows(), Grid.GetNumCols());
+
+		Run(Settings, TEXT("FTrackOccupancyGrid::IsCorridorClear [10 m] ") + Suffix, [&](int32 i)
+		{
+			const FVector2D& Coordinate = Coordinates[i & Mask];
+			return Grid.IsCorridorClear(Coordinate.X, Coordinate.X + 1000.0f, Coordinate.Y - 100.0f, Coordinate.Y + 100.0f) ? 1.0f : 0.0f;
+		});
+
+		Run(Settings, TEXT("FTrackOccupancyGrid::GetFreeDistance [30 m] ") + Suffix, [&](int32 i)
+		{
+			const FVector2D& Coordinate = Coordinates[i & Mask];
+			return Grid.GetFreeDistance(Coordinate.X, Coordinate.Y - 100.0f, Coordinate.Y + 100.0f, 3000.0f);
+		});
+
+		// a cone knocked around its spot
+		Run(Settings, TEXT("FTrackOccupancyGrid::MoveObstacle ") + Suffix, [&](int32 i)
+		{
+			const int32 Index = i % Grid.NumObstacles();
+			const FVector2D Location = Grid.GetObstacleLocation(Index);
+			Grid.MoveObstacle(Index, Location.X + Stream.FRandRange(-30.0f, 30.0f), Location.Y + Stream.FRandRange(-30.0f, 30.0f));
+			return (float)Index;
+		});
+	}
+
+	static void RunRecoveryBenchmarks(const FSettings& Settings)
+	{
+		// a car nosed into a barrier at 30 degrees, a wall on its left, a few cones behind. The track runs along +X
+		TArray<FVector2D> Obstacles;
+		for (float Y = -1200.0f; Y <= 1200.0f; Y += 25.0f)
+			Obstacles.Add(FVector2D(300.0f, Y));
+		for (float X = -1200.0f; X <= 300.0f; X += 25.0f)
+			Obstacles.Add(FVector2D(X, -450.0f));
+		for (const FVector2D Cone : { FVector2D(-500.0f, 150.0f), FVector2D(-650.0f, -100.0f), FVector2D(-300.0f, 350.0f), FVector2D(-900.0f, 250.0f) })
+			Obstacles.Add(Cone);
+
+		const FVector2D StartLocation = FVector2D::ZeroVector;
+		const float StartYaw = FMath::DegreesToRadians(30.0f);
+		// the car only sees what's this close, more shows up as it moves
+		const float SenseRange = 600.0f;
+
+		auto Setup = [&](FRecoveryPlanner& Planner)
+		{
+			Planner.Init(FRecoveryPlannerParams(), StartLocation);
+			for (int32 Y = 0; Y < Planner.GetGridSize(); Y++)
+				for (int32 X = 0; X < Planner.GetGridSize(); X++)
+					Planner.SetGoalHeading(X, Y, 0.0f);
+		};
+
+		auto Sense = [&](FRecoveryPlanner& Planner, const FVector2D& Location, TBitArray<>& Seen)
+		{
+			for (int32 i = 0; i < Obstacles.Num(); i++)
+			{
+				if (Seen[i] || FVector2D::DistSquared(Location, Obstacles[i]) > FMath::Square(SenseRange)) continue;
+				Seen[i] = true;
+				Planner.AddObstacle(Obstacles[i]);
+			}
+		};
+
+		// drives the maneuver to its end, repairing the plan at each step or searching it again. Returns the steps taken
+		auto Maneuver = [&](bool bRepair)
+		{
+			FRecoveryPlanner Planner;
+			TBitArray<> Seen(false, Obstacles.Num());
+			FVector2D Location = StartLocation;
+			float Yaw = StartYaw;
+
+			Setup(Planner);
+			int32 Steps = 0;
+			for (; Steps < 64; Steps++)
+			{
+				if (!bRepair && Steps > 0)
+				{
+					// what the car has seen so far, on a new planner
+					Setup(Planner);
+					for (int32 i = 0; i < Obstacles.Num(); i++)
+						if (Seen[i]) Planner.AddObstacle(Obstacles[i]);
+				}
+
+				Sense(Planner, Location, Seen);
+				if (!Planner.Plan(Location, Yaw) || Planner.IsAtGoal() || !Planner.GetNextPose(Location, Yaw))
+					break;
+			}
+			return (float)Steps;
+		};
+
+		FSettings Reduced = Settings;
+		Reduced.Iterations = FMath::Max(1, Settings.Iterations / 10000);
+
+		Run(Reduced, TEXT("FRecoveryPlanner maneuver (repaired)"), [&](int32 i) { return Maneuver(true); });
+		Run(Reduced, TEXT("FRecoveryPlanner maneuver (searched every step)"), [&](int32 i) { return Maneuver(false); });
+
+		UE_LOG(LogDriverlessCoreBench, Display, TEXT("FRecoveryPlanner: %d motions to realign"), (int32)Maneuver(true));
+	}
+}
+
+INT32_MAIN_INT32_ARGC_TCHAR_ARGV()
+{
+	FTaskTagScope Scope(ETaskTag::EGameThread);
+	ON_SCOPE_EXIT
+	{
+		RequestEngineExit(TEXT("Exiting"));
+		FEngineLoop::AppPreExit();
+		FModuleManager::Get().UnloadModulesAtShutdown();
+		FEngineLoop::AppExit();
+	};
+
+	if (int32 Ret = GEngineLoop.PreInit(ArgC, ArgV))
+		return Ret;
+
+	DriverlessCoreBench::FSettings Settings;
+	FParse::Value(FCommandLine::Get(), TEXT("filter="), Settings.Filter);
+	FParse::Value(FCommandLine::Get(), TEXT("iterations="), Settings.Iterations);
+	FParse::Value(FCommandLine::Get(), TEXT("repeat="), Settings.Repeat);
+	Settings.Iterations = FMath::Max(Settings.Iterations, 1);
+	Settings.Repeat = FMath::Max(Settings.Repeat, 1);
+
+	UE_LOG(LogDriverlessCoreBench, Display, TEXT("DriverlessCoreBench: %d calls x %d repetitions per kernel"), Settings.Iterations, Settings.Repeat);
+
+	DriverlessCoreBench::RunTrackBenchmarks(Settings);
+	DriverlessCoreBench::RunRacingLineBenchmarks(Settings);
+	DriverlessCoreBench::RunControlBenchmarks(Settings);
+	DriverlessCoreBench::RunConeBenchmarks(Settings);
+	DriverlessCoreBench::RunEstimatorBenchmarks(Settings);
+	DriverlessCoreBench::RunOccupancyBenchmarks(Settings);
+	DriverlessCoreBench::RunRecoveryBenchmarks(Settings);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ConeCenterlineComponent.h"
+#include "ObstacleSpawnerActor.h"
+#include "DriverlessStats.h"
+#include "EngineUtils.h"
+#include "GameFramework/Actor.h"
+
+UConeCenterlineComponent::UConeCenterlineComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UConeCenterlineComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (ConeLayouts.Num() == 0)
+	{
+		for (TActorIterator<AObstacleSpawnerActor> It(GetWorld()); It; ++It)
+			ConeLayouts.Add(*It);
+	}
+
+	if (ConeLayouts.Num() == 0)
+		UE_LOG(LogTemp, Warning, TEXT("ConeCenterlineComponent: No cone layout in the level, '%s' won't see any cone."), *GetOwner()->GetName());
+
+	ResetCones();
+}
+
+void UConeCenterlineComponent::ResetCones()
+{
+	LLM_SCOPE_BYTAG(Driverless_Sensor);
+
+	// the vehicle starts near the cones it will see, the track fits well within the extent around it
+	const FVector Start = GetOwner()->GetActorLocation();
+	Triangulation.Reset(FVector2D(Start.X, Start.Y), 1.0e7);
+
+	SeenLayouts.Reset();
+	for (AObstacleSpawnerActor* Layout : ConeLayouts)
+	{
+		if (Layout)
+			SeenLayouts.Add({ Layout, TBitArray<>() });
+	}
+
+	Centerline.Reset();
+}
+
+void UConeCenterlineComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_ConeCenterline);
+	LLM_SCOPE_BYTAG(Driverless_Sensor);
+
+	const AActor* Owner = GetOwner();
+	const FVector Location = Owner->GetActorLocation();
+	const FVector Forward = Owner->GetActorForwardVector();
+
+	ObserveCones(Location, Forward);
+
+	CenterlineOrigin = Location;
+	Triangulation.TraceCenterline(Location, Forward, CenterlineLength, Centerline);
+}
+
+void UConeCenterlineComponent::ObserveCones(const FVector& Location, const FVector& Forward)
+{
+	const float CosHalfFOV = FMath::Cos(FMath::DegreesToRadians(0.5f * ViewFOV));
+	int32 NumAdded = 0;
+
+	for (FSeenLayout& SeenLayout : SeenLayouts)
+	{
+		const AObstacleSpawnerActor* Layout = SeenLayout.Layout.Get();
+		if (!Layout) continue;
+
+		const TArray<AActor*>& Cones = Layout->GetSpawnedObstacles();
+		const TArray<EConeSide>& Sides = Layout->GetSpawnedObstacleSides();
+
+		// a respawned layout is a new set of cones
+		if (SeenLayout.Seen.Num() != Cones.Num())
+		{
+			if (SeenLayout.Seen.Num() > 0)
+			{
+				ResetCones();
+				return;
+			}
+			SeenLayout.Seen.Init(false, Cones.Num());
+		}
+
+		for (int32 Index = 0; Index < Cones.Num(); Index++)
+		{
+			if (SeenLayout.Seen[Index] || !IsValid(Cones[Index])) continue;
+
+			// where the cone stands when it's first seen, later moves (knocked over) aren't tracked
+			const FVector ConeLocation = Cones[Index]->GetActorLocation();
+			const FVector ToCone = (ConeLocation - Location) * FVector(1.0, 1.0, 0.0);
+			const double Distance = ToCone.Size();
+			if (Distance > ViewRange || FVector::DotProduct(ToCone, Forward) < CosHalfFOV * Distance)
+				continue;
+
+			SeenLayout.Seen[Index] = true;
+			if (Triangulation.AddCone(ConeLocation, Sides.IsValidIndex(Index) ? Sides[Index] : EConeSide::Unknown, MergeDistance) != INDEX_NONE)
+				NumAdded++;
+		}
+	}
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ConesTriangulated, DriverlessConesTriangulated, NumAdded);
+}
+
+bool UConeCenterlineComponent::GetSteeringTarget(float LookAhead, FVector& OutTarget) const
+{
+	// walk the polyline from where the vehicle was when it was traced
+	FVector Previous = CenterlineOrigin;
+	float Remaining = LookAhead;
+	for (const FVector& Point : Centerline)
+	{
+		const float Segment = FVector::Dist2D(Previous, Point);
+		if (Segment >= Remaining)
+		{
+			OutTarget = FMath::Lerp(Previous, Point, Remaining / FMath::Max(Segment, UE_KINDA_SMALL_NUMBER));
+			return true;
+		}
+		Remaining -= Segment;
+		Previous = Point;
+	}
+
+	// too short to steer by, only its end is known
+	if (Remaining > 0.5f * LookAhead)
+		return false;
+
+	OutTarget = Previous;
+	return true;
+}
+
+SIZE_T UConeCenterlineComponent::GetAllocatedSize() const
+{
+	SIZE_T Size = Triangulation.GetAllocatedSize() + SeenLayouts.GetAllocatedSize() + Centerline.GetAllocatedSize();
+	for (const FSeenLayout& SeenLayout : SeenLayouts)
+		Size += SeenLayout.Seen.GetAllocatedSize();
+	return Size;
+}
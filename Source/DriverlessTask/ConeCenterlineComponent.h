@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ConeDelaunay.h"
+#include "ConeCenterlineComponent.generated.h"
+
+class AObstacleSpawnerActor;
+
+/**
+ * Estimates the centerline of a cone-delimited track from the cones the vehicle has seen, without the track spline.
+ * Cones of the spawners' layouts enter the view as the vehicle drives, and each is added once to an incremental
+ * Delaunay triangulation (FConeDelaunay). Every frame the centerline ahead is traced through the triangles between
+ * left and right cones. A USplineFollowerComponent with Follow Cone Centerline steers along it.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class DRIVERLESSTASK_API UConeCenterlineComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UConeCenterlineComponent();
+
+	// layouts the cones are seen from. Empty uses every spawner in the level
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Centerline")
+	TArray<AObstacleSpawnerActor*> ConeLayouts;
+
+	// cones farther than this aren't seen (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Centerline", meta = (ClampMin = "0.0"))
+	float ViewRange = 2500.0f;
+
+	// horizontal field of view, centered on the forward axis (degrees)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Centerline", meta = (ClampMin = "1.0", ClampMax = "360.0"))
+	float ViewFOV = 180.0f;
+
+	// a cone seen this close to one already in is the same cone (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Centerline", meta = (ClampMin = "0.0"))
+	float MergeDistance = 50.0f;
+
+	// length of the centerline traced ahead of the vehicle (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Centerline", meta = (ClampMin = "0.0"))
+	float CenterlineLength = 3000.0f;
+
+	// point LookAhead (cm) along the centerline traced this frame. False when it's less than half that long
+	bool GetSteeringTarget(float LookAhead, FVector& OutTarget) const;
+
+	// midpoints of the centerline ahead, from the vehicle's location this frame
+	const TArray<FVector>& GetCenterline() const { return Centerline; }
+	const FConeDelaunay& GetTriangulation() const { return Triangulation; }
+
+	// forgets every cone seen, e.g. after the layout is respawned
+	UFUNCTION(BlueprintCallable, Category = "Cone Centerline")
+	void ResetCones();
+
+	// heap memory held by the triangulation and the centerline, for memory reports
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	void ObserveCones(const FVector& Location, const FVector& Forward);
+
+	FConeDelaunay Triangulation;
+
+	// cones of each layout already in the triangulation, by index in the layout
+	struct FSeenLayout
+	{
+		TWeakObjectPtr<AObstacleSpawnerActor> Layout;
+		TBitArray<> Seen;
+	};
+	TArray<FSeenLayout> SeenLayouts;
+
+	TArray<FVector> Centerline;
+	FVector CenterlineOrigin = FVector::ZeroVector;
+};
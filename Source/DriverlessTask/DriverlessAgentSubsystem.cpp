@@ -0,0 +1,372 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessAgentSubsystem.h"
+#include "DriverlessSnapshotSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "DriverlessStats.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarAgentTimeoutMs(
+	TEXT("Driverless.AgentTimeoutMs"),
+	5000.0f,
+	TEXT("How long (ms) a lock-step waits for the external agent's actions before simulating without them."));
+
+static TAutoConsoleVariable<int32> CVarAgentSpinCount(
+	TEXT("Driverless.AgentSpinCount"),
+	20000,
+	TEXT("Polls of the agent's answer before the lock-step wait starts yielding the CPU. Higher = lower latency, more CPU burnt."));
+
+int32 UDriverlessAgentSubsystem::RegisterAgent(USplineFollowerComponent* Follower)
+{
+	if (!Header)
+		return INDEX_NONE;
+
+	int32 Slot = INDEX_NONE;
+	if (FreeSlots.Num() > 0)
+		FreeSlots.HeapPop(Slot, EAllowShrinking::No);
+	else if (Agents.Num() < (int32)Header->MaxVehicles)
+		Slot = Agents.AddDefaulted();
+	else
+		return INDEX_NONE;
+
+	Agents[Slot].Follower = Follower;
+	Agents[Slot].FirstStep = Header->ObservationSequence.load(std::memory_order_relaxed) / 2 + 1;
+	return Slot;
+}
+
+void UDriverlessAgentSubsystem::UnregisterAgent(USplineFollowerComponent* Follower)
+{
+	const int32 Slot = Agents.IndexOfByPredicate([Follower](const FAgentSlot& Agent) { return Agent.Follower == Follower; });
+	if (Slot == INDEX_NONE)
+		return;
+
+	Agents[Slot].Follower.Reset();
+	FreeSlots.HeapPush(Slot);
+
+	// free slots at the end leave the range the agent scans (NumVehicles is updated with the next observations)
+	while (Agents.Num() > 0 && FreeSlots.Contains(Agents.Num() - 1))
+	{
+		FreeSlots.Remove(Agents.Num() - 1);
+		Agents.Pop(EAllowShrinking::No);
+	}
+	FreeSlots.Heapify();
+}
+
+const FDriverlessAgentAction* UDriverlessAgentSubsystem::GetAction(int32 Slot) const
+{
+	if (!Header || !Agents.IsValidIndex(Slot) || !ActionBuffer.IsValidIndex(Slot) || ActionStep < Agents[Slot].FirstStep)
+		return nullptr;
+	return &ActionBuffer[Slot];
+}
+
+void UDriverlessAgentSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// opened before the actors begin play, so the followers can register
+	if (!FParse::Param(FCommandLine::Get(), TEXT("DriverlessAgent")))
+		return;
+
+	FString Name = TEXT("DriverlessAgent");
+	int32 MaxVehicles = 128;
+	int32 Port = 27600;
+	FParse::Value(FCommandLine::Get(), TEXT("DriverlessAgentName="), Name);
+	FParse::Value(FCommandLine::Get(), TEXT("DriverlessAgentMaxVehicles="), MaxVehicles);
+	FParse::Value(FCommandLine::Get(), TEXT("DriverlessAgentPort="), Port);
+
+	if (!Open(Name, FMath::Max(MaxVehicles, 1), Port))
+		Close();
+}
+
+void UDriverlessAgentSubsystem::Deinitialize()
+{
+	Close();
+	Super::Deinitialize();
+}
+
+bool UDriverlessAgentSubsystem::Open(const FString& Name, int32 MaxVehicles, int32 Port)
+{
+	const uint32 ObservationOffset = Align(sizeof(FDriverlessAgentHeader), PLATFORM_CACHE_LINE_SIZE);
+	const uint32 ActionOffset = Align(ObservationOffset + sizeof(FDriverlessAgentObservation) * MaxVehicles, PLATFORM_CACHE_LINE_SIZE);
+	const SIZE_T RegionSize = ActionOffset + sizeof(FDriverlessAgentAction) * MaxVehicles;
+
+	SharedMemory = FPlatformMemory::MapNamedSharedMemoryRegion(Name, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, RegionSize);
+	if (!SharedMemory)
+	{
+		UE_LOG(LogTemp, Error, TEXT("DriverlessAgentSubsystem: Unable to map the shared memory region '%s'."), *Name);
+		return false;
+	}
+
+	uint8* Base = (uint8*)SharedMemory->GetAddress();
+	FMemory::Memzero(Base, RegionSize);
+
+	Header = new (Base) FDriverlessAgentHeader();
+	Header->MaxVehicles = MaxVehicles;
+	ActionBuffer.SetNumZeroed(MaxVehicles);
+	ActionBackBuffer.SetNumZeroed(MaxVehicles);
+	Header->ObservationOffset = ObservationOffset;
+	Header->ObservationStride = sizeof(FDriverlessAgentObservation);
+	Header->ActionOffset = ActionOffset;
+	Header->ActionStride = sizeof(FDriverlessAgentAction);
+	Observations = (FDriverlessAgentObservation*)(Base + ObservationOffset);
+	Actions = (FDriverlessAgentAction*)(Base + ActionOffset);
+	RegionName = Name;
+
+	// control messages, on the loopback interface only
+	ISocketSubsystem* Sockets = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> Address = Sockets->CreateInternetAddr();
+	Address->SetLoopbackAddress();
+	Address->SetPort(Port);
+
+	ListenSocket = Sockets->CreateSocket(NAME_Stream, TEXT("DriverlessAgentControl"), Address->GetProtocolType());
+	if (!ListenSocket || !ListenSocket->SetReuseAddr() || !ListenSocket->SetNonBlocking() || !ListenSocket->Bind(*Address) || !ListenSocket->Listen(1))
+	{
+		UE_LOG(LogTemp, Error, TEXT("DriverlessAgentSubsystem: Unable to listen for the agent on port %d."), Port);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("DriverlessAgentSubsystem: shared memory '%s' (%llu bytes, %d vehicles), control port %d."), *Name, (uint64)RegionSize, MaxVehicles, Port);
+	return true;
+}
+
+void UDriverlessAgentSubsystem::Close()
+{
+	CloseControlConnection();
+
+	if (ListenSocket)
+	{
+		ListenSocket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ListenSocket);
+		ListenSocket = nullptr;
+	}
+
+	if (SharedMemory)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(SharedMemory);
+		SharedMemory = nullptr;
+	}
+
+	Header = nullptr;
+	Observations = nullptr;
+	Actions = nullptr;
+	Agents.Reset();
+	FreeSlots.Reset();
+	ActionBuffer.Reset();
+	ActionBackBuffer.Reset();
+	ActionStep = 0;
+}
+
+void UDriverlessAgentSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!Header) return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_AgentBridge);
+
+	// between two steps, so the agent never waits on the game thread for a reply
+	ServeControlConnection();
+
+	// the followers have ticked and physics has run: this is the state the next actions answer
+	PublishObservations(DeltaTime);
+
+	if (bAgentAttached && Header->Mode.load(std::memory_order_relaxed) == (uint32)EDriverlessAgentMode::LockStep)
+		WaitForActions();
+
+	// the followers apply them in their next tick
+	ReadActions();
+}
+
+void UDriverlessAgentSubsystem::PublishObservations(float DeltaTime)
+{
+	// written in place, the agent reads the very same memory: odd while writing, so it never takes a half written step
+	const uint64 Sequence = Header->ObservationSequence.load(std::memory_order_relaxed);
+	Header->ObservationSequence.store(Sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Header->NumVehicles.store(Agents.Num(), std::memory_order_relaxed);
+	for (int32 Slot = 0; Slot < Agents.Num(); Slot++)
+	{
+		if (USplineFollowerComponent* Follower = Agents[Slot].Follower.Get())
+			Follower->WriteAgentObservation(Observations[Slot]);
+		else
+			FMemory::Memzero(Observations[Slot]);
+	}
+
+	Header->SimTime = GetWorld()->GetTimeSeconds();
+	Header->DeltaTime = DeltaTime;
+
+	// everything above is visible to the agent once it sees the even sequence
+	Header->ObservationSequence.store(Sequence + 2, std::memory_order_release);
+}
+
+void UDriverlessAgentSubsystem::WaitForActions()
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_AgentWait);
+
+	const uint64 Step = Header->ObservationSequence.load(std::memory_order_relaxed) / 2;
+	const int32 SpinCount = CVarAgentSpinCount.GetValueOnGameThread();
+	const double Deadline = FPlatformTime::Seconds() + CVarAgentTimeoutMs.GetValueOnGameThread() / 1000.0;
+
+	// spin first: on the same machine an answer usually comes within microseconds
+	for (int32 Spin = 0; Header->ActionSequence.load(std::memory_order_acquire) < Step * 2; Spin++)
+	{
+		if (Spin < SpinCount)
+		{
+			FPlatformProcess::YieldCycles(64);
+			continue;
+		}
+
+		if (FPlatformTime::Seconds() > Deadline)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("DriverlessAgentSubsystem: no actions from the agent for step %llu, simulating without them."), Step);
+			return;
+		}
+		FPlatformProcess::YieldThread();
+	}
+}
+
+void UDriverlessAgentSubsystem::ReadActions()
+{
+	const int32 NumActions = Agents.Num();
+
+	// a few attempts when the agent is writing right now, otherwise the previous actions hold for another step
+	for (int32 Attempt = 0; Attempt < 4; Attempt++)
+	{
+		const uint64 Sequence = Header->ActionSequence.load(std::memory_order_acquire);
+		if (Sequence == 0)
+			return;
+		if (Sequence & 1)
+		{
+			FPlatformProcess::YieldCycles(64);
+			continue;
+		}
+
+		// into the back buffer, a torn copy must not replace the actions the followers use
+		FMemory::Memcpy(ActionBackBuffer.GetData(), Actions, sizeof(FDriverlessAgentAction) * NumActions);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (Header->ActionSequence.load(std::memory_order_relaxed) == Sequence)
+		{
+			Swap(ActionBuffer, ActionBackBuffer);
+			ActionStep = Sequence / 2;
+			return;
+		}
+	}
+}
+
+void UDriverlessAgentSubsystem::ServeControlConnection()
+{
+	if (!ControlSocket)
+	{
+		bool bPendingConnection = false;
+		if (!ListenSocket->HasPendingConnection(bPendingConnection) || !bPendingConnection)
+			return;
+
+		ControlSocket = ListenSocket->Accept(TEXT("DriverlessAgentConnection"));
+		if (!ControlSocket) return;
+		ControlSocket->SetNonBlocking();
+		ControlSocket->SetNoDelay();
+	}
+
+	uint32 PendingSize = 0;
+	while (ControlSocket->HasPendingData(PendingSize))
+	{
+		const int32 Offset = ControlBuffer.Num();
+		ControlBuffer.AddUninitialized(PendingSize);
+		int32 BytesRead = 0;
+		ControlSocket->Recv(ControlBuffer.GetData() + Offset, PendingSize, BytesRead);
+		ControlBuffer.SetNum(Offset + BytesRead, EAllowShrinking::No);
+	}
+
+	if (ControlSocket->GetConnectionState() != SCS_Connected)
+	{
+		CloseControlConnection();
+		return;
+	}
+
+	// one message per line
+	int32 LineEnd = INDEX_NONE;
+	while (ControlBuffer.Find((uint8)'\n', LineEnd))
+	{
+		const FString Message = FString::ConstructFromPtrSize((const ANSICHAR*)ControlBuffer.GetData(), LineEnd).TrimStartAndEnd();
+		ControlBuffer.RemoveAt(0, LineEnd + 1, EAllowShrinking::No);
+
+		const FTCHARToUTF8 Reply(*(HandleControlMessage(Message) + TEXT("\n")));
+		int32 BytesSent = 0;
+		ControlSocket->Send((const uint8*)Reply.Get(), Reply.Length(), BytesSent);
+	}
+}
+
+FString UDriverlessAgentSubsystem::HandleControlMessage(const FString& Message)
+{
+	TArray<FString> Args;
+	Message.ParseIntoArrayWS(Args);
+	if (Args.Num() == 0)
+		return TEXT("error empty message");
+
+	if (Args[0] == TEXT("hello"))
+	{
+		bAgentAttached = true;
+		const SIZE_T RegionSize = Header->ActionOffset + sizeof(FDriverlessAgentAction) * Header->MaxVehicles;
+		return FString::Printf(TEXT("ok %s %llu %u %u %u"), *RegionName, (uint64)RegionSize, Header->MaxVehicles, Header->MaxProbes, Header->Version);
+	}
+
+	if (Args[0] == TEXT("mode") && Args.Num() > 1)
+	{
+		if (Args[1] == TEXT("lockstep"))
+			Header->Mode.store((uint32)EDriverlessAgentMode::LockStep, std::memory_order_relaxed);
+		else if (Args[1] == TEXT("free"))
+			Header->Mode.store((uint32)EDriverlessAgentMode::FreeRunning, std::memory_order_relaxed);
+		else
+			return TEXT("error unknown mode");
+		return TEXT("ok");
+	}
+
+	if (Args[0] == TEXT("snapshot") && Args.Num() > 2)
+	{
+		UDriverlessSnapshotSubsystem* Snapshots = GetWorld()->GetSubsystem<UDriverlessSnapshotSubsystem>();
+		if (!Snapshots)
+			return TEXT("error no snapshots in this world");
+
+		if (Args[1] == TEXT("save"))
+		{
+			Snapshots->SaveSnapshot(FName(*Args[2]));
+			return TEXT("ok");
+		}
+		if (Args[1] == TEXT("restore"))
+			return Snapshots->RestoreSnapshot(FName(*Args[2])) ? TEXT("ok") : TEXT("error no such snapshot");
+	}
+
+	return FString::Printf(TEXT("error unknown message '%s'"), *Message);
+}
+
+void UDriverlessAgentSubsystem::CloseControlConnection()
+{
+	// without a connection there's nobody to wait for
+	bAgentAttached = false;
+	ControlBuffer.Reset();
+
+	if (ControlSocket)
+	{
+		ControlSocket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ControlSocket);
+		ControlSocket = nullptr;
+	}
+}
+
+TStatId UDriverlessAgentSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDriverlessAgentSubsystem, STATGROUP_Tickables);
+}
+
+bool UDriverlessAgentSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HAL/PlatformMemory.h"
+#include "DriverlessAgentProtocol.h"
+#include "DriverlessAgentSubsystem.generated.h"
+
+class USplineFollowerComponent;
+class FSocket;
+
+/**
+ * Lets an external process (learning, planning) drive the followers whose Control Source is External.
+ * Observations of all of them are written straight into a shared memory region every step, and the agent
+ * answers with a batch of actions in the same region (layout in DriverlessAgentProtocol.h).
+ * A loopback TCP connection carries the control messages, one per line:
+ *
+ *   hello                       -> ok <region name> <region size> <max vehicles> <max probes> <version>
+ *   mode lockstep|free          -> ok
+ *   snapshot save|restore Name  -> ok
+ *
+ * Opened with -DriverlessAgent [-DriverlessAgentName=DriverlessAgent] [-DriverlessAgentPort=27600] [-DriverlessAgentMaxVehicles=128].
+ * Lock-step only waits for the agent while its control connection is open, so the game never hangs on a missing agent.
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessAgentSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// slot of the follower in the observations and actions. INDEX_NONE when the bridge isn't open or is full
+	int32 RegisterAgent(USplineFollowerComponent* Follower);
+	void UnregisterAgent(USplineFollowerComponent* Follower);
+
+	bool IsOpen() const { return Header != nullptr; }
+
+	// latest action the agent sent for a slot, nullptr until it answers a step the slot's follower was part of
+	const FDriverlessAgentAction* GetAction(int32 Slot) const;
+
+	// UWorldSubsystem
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	bool Open(const FString& Name, int32 MaxVehicles, int32 Port);
+	void Close();
+
+	void PublishObservations(float DeltaTime);
+	void WaitForActions();
+	// copies the agent's latest complete actions out of the shared region
+	void ReadActions();
+
+	void ServeControlConnection();
+	FString HandleControlMessage(const FString& Message);
+	void CloseControlConnection();
+
+	FString RegionName;
+	FPlatformMemory::FSharedMemoryRegion* SharedMemory = nullptr;
+	FDriverlessAgentHeader* Header = nullptr;
+	FDriverlessAgentObservation* Observations = nullptr;
+	FDriverlessAgentAction* Actions = nullptr;
+
+	struct FAgentSlot
+	{
+		TWeakObjectPtr<USplineFollowerComponent> Follower;
+		// first step whose observations include the follower, older actions of the slot were meant for its previous owner
+		uint64 FirstStep = 0;
+	};
+
+	// followers by slot, the slots below NumVehicles. Freed slots are reused lowest first, so the range stays compact
+	TArray<FAgentSlot> Agents;
+	TArray<int32> FreeSlots;
+
+	// the actions as of the last complete read, and the step they answer
+	TArray<FDriverlessAgentAction> ActionBuffer;
+	TArray<FDriverlessAgentAction> ActionBackBuffer;
+	uint64 ActionStep = 0;
+
+	FSocket* ListenSocket = nullptr;
+	FSocket* ControlSocket = nullptr;
+	TArray<uint8> ControlBuffer;
+	bool bAgentAttached = false;
+};
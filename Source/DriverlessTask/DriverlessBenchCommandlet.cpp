@@ -0,0 +1,731 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessBenchCommandlet.h"
+#include "Async/ParallelFor.h"
+#include "Containers/Ticker.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Components/SplineComponent.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "LandscapeSplineActor.h"
+#include "LandscapeSplinesComponent.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+#include "DriverlessTrackSubsystem.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "ObstacleSpawnerActor.h"
+#include "SplineFollowerComponent.h"
+#include "RangeSensorComponent.h"
+#include "FollowerControlLaw.h"
+#include "TrackTable.h"
+
+#if WITH_EDITOR
+#include "WorldPartition/WorldPartition.h"
+#include "WorldPartition/LoaderAdapter/LoaderAdapterShape.h"
+#endif
+
+#if PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogDriverlessBench, Log, All);
+
+namespace DriverlessBench
+{
+	static FString GetTrajectoryDir()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("Driverless") / TEXT("Trajectories");
+	}
+
+	// vehicle pose at every recorded frame
+	struct FTrajectory
+	{
+		TArray<FVector> Locations;
+		TArray<FVector> Forwards;
+
+		int32 Num() const { return Locations.Num(); }
+	};
+
+	/* RECORDING */
+
+	// samples every follower each frame until the requested time has passed, then writes one file per vehicle
+	class FTrajectoryRecorder
+	{
+	public:
+		void Start(UWorld* World, float Seconds, FOutputDevice& Ar)
+		{
+			Stop(Ar);
+
+			RecordWorld = World;
+			RemainingTime = Seconds;
+			TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FTrajectoryRecorder::Tick));
+			Ar.Logf(TEXT("Recording the followers' trajectories for %.1f s."), Seconds);
+		}
+
+		void Stop(FOutputDevice& Ar)
+		{
+			if (!TickerHandle.IsValid())
+				return;
+
+			FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+
+			for (const TPair<FString, FString>& File : Files)
+			{
+				const FString Path = GetTrajectoryDir() / File.Key + TEXT(".csv");
+				FFileHelper::SaveStringToFile(File.Value, *Path);
+				Ar.Logf(TEXT("Saved %s"), *Path);
+			}
+			Files.Empty();
+		}
+
+	private:
+		bool Tick(float DeltaTime)
+		{
+			UWorld* World = RecordWorld.Get();
+			UDriverlessVehicleSubsystem* Vehicles = World ? World->GetSubsystem<UDriverlessVehicleSubsystem>() : nullptr;
+			RemainingTime -= DeltaTime;
+			if (!Vehicles || RemainingTime <= 0.0f)
+			{
+				Stop(*GLog);
+				return false;
+			}
+
+			for (const TWeakObjectPtr<USplineFollowerComponent>& FollowerPtr : Vehicles->GetFollowers())
+			{
+				const USplineFollowerComponent* Follower = FollowerPtr.Get();
+				if (!Follower || !Follower->TargetTrackActor) continue;
+
+				const AActor* Vehicle = Follower->GetOwner();
+				const FVector Location = Vehicle->GetActorLocation();
+				const FVector Forward = Vehicle->GetActorForwardVector();
+
+				FString& File = Files.FindOrAdd(Follower->TargetTrackActor->GetName() + TEXT("_") + Vehicle->GetName());
+				File += FString::Printf(TEXT("%.2f,%.2f,%.2f,%.4f,%.4f,%.4f\n"), Location.X, Location.Y, Location.Z, Forward.X, Forward.Y, Forward.Z);
+			}
+			return true;
+		}
+
+		TWeakObjectPtr<UWorld> RecordWorld;
+		float RemainingTime = 0.0f;
+		FTSTicker::FDelegateHandle TickerHandle;
+		TMap<FString, FString> Files;
+	};
+
+	static FTrajectoryRecorder GRecorder;
+
+	static void RecordTrajectories(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("stop"))
+		{
+			GRecorder.Stop(Ar);
+			return;
+		}
+
+		const float Seconds = (Args.Num() > 0) ? FCString::Atof(*Args[0]) : 60.0f;
+		GRecorder.Start(World, FMath::Max(Seconds, 1.0f), Ar);
+	}
+
+	static TArray<FTrajectory> LoadTrajectories(const FString& TrackName)
+	{
+		TArray<FString> FileNames;
+		IFileManager::Get().FindFiles(FileNames, *(GetTrajectoryDir() / TrackName + TEXT("_*.csv")), true, false);
+
+		TArray<FTrajectory> Trajectories;
+		for (const FString& FileName : FileNames)
+		{
+			TArray<FString> Lines;
+			if (!FFileHelper::LoadFileToStringArray(Lines, *(GetTrajectoryDir() / FileName)))
+				continue;
+
+			FTrajectory& Trajectory = Trajectories.AddDefaulted_GetRef();
+			for (const FString& Line : Lines)
+			{
+				TArray<FString> Values;
+				if (Line.ParseIntoArray(Values, TEXT(",")) != 6) continue;
+
+				Trajectory.Locations.Emplace(FCString::Atod(*Values[0]), FCString::Atod(*Values[1]), FCString::Atod(*Values[2]));
+				Trajectory.Forwards.Emplace(FCString::Atod(*Values[3]), FCString::Atod(*Values[4]), FCString::Atod(*Values[5]));
+			}
+		}
+		return Trajectories;
+	}
+
+	// one lap along the centerline, weaving a little as a driven car would
+	static FTrajectory MakeCenterlineTrajectory(const FTrackTable& Track, int32 NumFrames)
+	{
+		FTrajectory Trajectory;
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			const float Distance = Track.Length * i / NumFrames;
+			const FVector Direction = Track.GetDirectionAtDistance(Distance);
+			const FVector Right = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+
+			Trajectory.Locations.Add(Track.GetLocationAtDistance(Distance) + Right * 300.0f * FMath::Sin(i * 0.01f) + FVector(0.0f, 0.0f, 50.0f));
+			Trajectory.Forwards.Add(Direction);
+		}
+		return Trajectory;
+	}
+
+	/* MEASUREMENT */
+
+	// hardware cache misses of the calling thread, where perf events are available
+	class FCacheMissCounter
+	{
+	public:
+		FCacheMissCounter()
+		{
+#if PLATFORM_LINUX
+			perf_event_attr Attr = {};
+			Attr.type = PERF_TYPE_HARDWARE;
+			Attr.size = sizeof(Attr);
+			Attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			Attr.disabled = 1;
+			Attr.exclude_kernel = 1;
+			Attr.exclude_hv = 1;
+			Fd = static_cast<int32>(syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0));
+#endif
+		}
+
+		~FCacheMissCounter()
+		{
+#if PLATFORM_LINUX
+			if (Fd >= 0) close(Fd);
+#endif
+		}
+
+		bool IsAvailable() const { return Fd >= 0; }
+
+		void Start()
+		{
+#if PLATFORM_LINUX
+			if (Fd < 0) return;
+			ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+		}
+
+		uint64 Stop()
+		{
+			uint64 Count = 0;
+#if PLATFORM_LINUX
+			if (Fd < 0) return 0;
+			ioctl(Fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(Fd, &Count, sizeof(Count)) != sizeof(Count)) Count = 0;
+#endif
+			return Count;
+		}
+
+	private:
+		int32 Fd = -1;
+	};
+
+	struct FSettings
+	{
+		FString Filter;
+		int32 Iterations = 200000;
+		TArray<int32> ThreadCounts = { 1, 2, 4, 8 };
+	};
+
+	struct FResult
+	{
+		FString Name;
+		int32 Threads = 1;
+		int64 Ops = 0;
+		double NsPerOp = 0.0;
+		double CacheMissesPerOp = -1.0; // < 0 when unavailable
+	};
+
+	class FBench
+	{
+	public:
+		explicit FBench(const FSettings& InSettings) : Settings(InSettings) {}
+
+		// runs Kernel(OpIndex) Iterations times on the calling thread
+		template <typename KernelType>
+		void Run(const FString& Name, int32 Iterations, KernelType&& Kernel)
+		{
+			if (!Settings.Filter.IsEmpty() && !Name.Contains(Settings.Filter))
+				return;
+
+			// one untimed pass over a slice, so the first run doesn't pay for cold caches and page faults
+			double Accumulator = 0.0;
+			for (int32 i = 0; i < FMath::Min(Iterations, 1000); i++)
+				Accumulator += Kernel(i);
+
+			CacheMisses.Start();
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			for (int32 i = 0; i < Iterations; i++)
+				Accumulator += Kernel(i);
+			const uint64 EndCycles = FPlatformTime::Cycles64();
+			const uint64 Misses = CacheMisses.Stop();
+
+			Sink += Accumulator;
+			Add(Name, 1, Iterations, FPlatformTime::ToSeconds64(EndCycles - StartCycles), CacheMisses.IsAvailable() ? (double)Misses / Iterations : -1.0);
+		}
+
+		// runs Kernel(OpIndex) Iterations times split over each thread count of the settings.
+		// ns/op is wall time over all the ops, so it drops as the kernel scales
+		template <typename KernelType>
+		void RunThreaded(const FString& Name, int32 Iterations, KernelType&& Kernel)
+		{
+			for (const int32 NumThreads : Settings.ThreadCounts)
+			{
+				if (NumThreads <= 1)
+				{
+					Run(Name, Iterations, Kernel);
+					continue;
+				}
+
+				const FString ThreadedName = FString::Printf(TEXT("%s x%d"), *Name, NumThreads);
+				if (!Settings.Filter.IsEmpty() && !ThreadedName.Contains(Settings.Filter))
+					continue;
+
+				TArray<double> Accumulators;
+				Accumulators.SetNumZeroed(NumThreads);
+				const int32 OpsPerThread = FMath::DivideAndRoundUp(Iterations, NumThreads);
+
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				ParallelFor(NumThreads, [&](int32 Thread)
+				{
+					const int32 First = Thread * OpsPerThread;
+					const int32 Last = FMath::Min(First + OpsPerThread, Iterations);
+					for (int32 i = First; i < Last; i++)
+						Accumulators[Thread] += Kernel(i);
+				});
+				const uint64 EndCycles = FPlatformTime::Cycles64();
+
+				for (double Value : Accumulators)
+					Sink += Value;
+				Add(ThreadedName, NumThreads, Iterations, FPlatformTime::ToSeconds64(EndCycles - StartCycles), -1.0);
+			}
+		}
+
+		void Log() const
+		{
+			UE_LOG(LogDriverlessBench, Display, TEXT("%-72s %8s %12s %14s"), TEXT("Benchmark"), TEXT("Threads"), TEXT("ns/op"), TEXT("misses/op"));
+			for (const FResult& Result : Results)
+			{
+				const FString Misses = (Result.CacheMissesPerOp >= 0.0) ? FString::Printf(TEXT("%.2f"), Result.CacheMissesPerOp) : TEXT("n/a");
+				UE_LOG(LogDriverlessBench, Display, TEXT("%-72s %8d %12.1f %14s"), *Result.Name, Result.Threads, Result.NsPerOp, *Misses);
+			}
+
+			if (!CacheMisses.IsAvailable())
+				UE_LOG(LogDriverlessBench, Display, TEXT("Cache misses unavailable (Linux perf events only, check /proc/sys/kernel/perf_event_paranoid)."));
+		}
+
+		void SaveCsv(const FString& Path) const
+		{
+			FString Csv = TEXT("Benchmark,Threads,Ops,NsPerOp,CacheMissesPerOp\n");
+			for (const FResult& Result : Results)
+				Csv += FString::Printf(TEXT("\"%s\",%d,%lld,%.3f,%.3f\n"), *Result.Name, Result.Threads, Result.Ops, Result.NsPerOp, Result.CacheMissesPerOp);
+			FFileHelper::SaveStringToFile(Csv, *Path);
+		}
+
+		const FSettings& GetSettings() const { return Settings; }
+
+	private:
+		void Add(const FString& Name, int32 Threads, int64 Ops, double Seconds, double CacheMissesPerOp)
+		{
+			FResult& Result = Results.AddDefaulted_GetRef();
+			Result.Name = Name;
+			Result.Threads = Threads;
+			Result.Ops = Ops;
+			Result.NsPerOp = Seconds * 1e9 / FMath::Max<int64>(Ops, 1);
+			Result.CacheMissesPerOp = CacheMissesPerOp;
+		}
+
+		const FSettings& Settings;
+		FCacheMissCounter CacheMisses;
+		TArray<FResult> Results;
+
+		// results are folded into this so the compiler can't drop the benchmarked calls
+		volatile double Sink = 0.0;
+	};
+
+	/* SCENE */
+
+	// copy of Source with NumPoints points evenly spread along it, to see how queries scale with the point count
+	static USplineComponent* ResampleSpline(UObject* Outer, const USplineComponent& Source, int32 NumPoints)
+	{
+		USplineComponent* Spline = NewObject<USplineComponent>(Outer);
+		Spline->ClearSplinePoints(false);
+
+		const float Length = Source.GetSplineLength();
+		const int32 NumSpans = Source.IsClosedLoop() ? NumPoints : NumPoints - 1;
+		for (int32 i = 0; i < NumPoints; i++)
+			Spline->AddSplinePoint(Source.GetLocationAtDistanceAlongSpline(Length * i / NumSpans, ESplineCoordinateSpace::World), ESplineCoordinateSpace::World, false);
+
+		Spline->SetClosedLoop(Source.IsClosedLoop(), false);
+		Spline->UpdateSpline();
+		return Spline;
+	}
+
+	/* BENCHMARKS */
+
+	static void RunSplineBenchmarks(FBench& Bench, const FString& TrackName, const USplineComponent& Spline, const FTrackTable& Table, const FTrajectory& Trajectory)
+	{
+		const FSettings& Settings = Bench.GetSettings();
+		const int32 NumFrames = Trajectory.Num();
+		const float Length = Spline.GetSplineLength();
+
+		// distance of every recorded frame, as the follower gets it
+		TArray<float> Distances;
+		Distances.SetNumUninitialized(NumFrames);
+		for (int32 i = 0; i < NumFrames; i++)
+			Distances[i] = Spline.GetDistanceAlongSplineAtSplineInputKey(Spline.FindInputKeyClosestToWorldLocation(Trajectory.Locations[i]));
+
+		const FString Suffix = FString::Printf(TEXT(" [%s, %d points]"), *TrackName, Spline.GetNumberOfSplinePoints());
+
+		Bench.RunThreaded(TEXT("USplineComponent::FindInputKeyClosestToWorldLocation") + Suffix, Settings.Iterations / 10, [&](int32 i)
+		{
+			return Spline.FindInputKeyClosestToWorldLocation(Trajectory.Locations[i % NumFrames]);
+		});
+
+		Bench.RunThreaded(TEXT("USplineComponent::GetTangentAtDistanceAlongSpline") + Suffix, Settings.Iterations, [&](int32 i)
+		{
+			return Spline.GetTangentAtDistanceAlongSpline(FMath::Fmod(Distances[i % NumFrames] + 3000.0f, Length), ESplineCoordinateSpace::World).X;
+		});
+
+		Bench.RunThreaded(TEXT("USplineComponent::GetLocationAtDistanceAlongSpline") + Suffix, Settings.Iterations, [&](int32 i)
+		{
+			return Spline.GetLocationAtDistanceAlongSpline(FMath::Fmod(Distances[i % NumFrames] + 1500.0f, Length), ESplineCoordinateSpace::World).X;
+		});
+
+		// the track table replacements, for comparison
+		const FString TableSuffix = FString::Printf(TEXT(" [%s, %d samples]"), *TrackName, Table.Num());
+
+		Bench.RunThreaded(TEXT("FTrackTable::FindDistanceClosestToLocation (hint)") + TableSuffix, Settings.Iterations, [&](int32 i)
+		{
+			const int32 Frame = i % NumFrames;
+			return Table.FindDistanceClosestToLocation(Trajectory.Locations[Frame], Distances[Frame]);
+		});
+
+		Bench.RunThreaded(TEXT("FTrackTable::GetTangentAtDistance") + TableSuffix, Settings.Iterations, [&](int32 i)
+		{
+			return Table.GetTangentAtDistance(Distances[i % NumFrames] + 3000.0f).X;
+		});
+
+		Bench.RunThreaded(TEXT("FTrackTable::GetLocationAtDistance") + TableSuffix, Settings.Iterations, [&](int32 i)
+		{
+			return Table.GetLocationAtDistance(Distances[i % NumFrames] + 1500.0f).X;
+		});
+	}
+
+	static void RunSweepBenchmarks(FBench& Bench, UWorld& World, const FString& TrackName, const FTrackTable& Table, const FTrajectory& Trajectory)
+	{
+		const FSettings& Settings = Bench.GetSettings();
+		const int32 NumFrames = Trajectory.Num();
+
+		// same probes as the follower defaults
+		const float TraceDistance = 1000.0f;
+		const float TraceRadius = 50.0f;
+		constexpr int32 NumProbes = 3;
+		const float ProbeAngles[NumProbes] = { -30.0f, 0.0f, 30.0f };
+
+		auto GetTraceStart = [&](int32 Frame)
+		{
+			return Trajectory.Locations[Frame] + Trajectory.Forwards[Frame] * 150.0f + FVector::UpVector * 200.0f;
+		};
+
+		TArray<TEnumAsByte<EObjectTypeQuery>> ObjectTypes;
+		ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_WorldStatic));
+		ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_WorldDynamic));
+		ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_PhysicsBody));
+
+		const FString Suffix = FString::Printf(TEXT(" [%s]"), *TrackName);
+
+		Bench.Run(TEXT("UKismetSystemLibrary::SphereTraceSingleForObjects") + Suffix, Settings.Iterations / 10, [&](int32 i)
+		{
+			const int32 Frame = i % NumFrames;
+			const FVector Start = GetTraceStart(Frame);
+			FHitResult Hit;
+			UKismetSystemLibrary::SphereTraceSingleForObjects(&World, Start, Start + Trajectory.Forwards[Frame] * TraceDistance, TraceRadius,
+				ObjectTypes, false, TArray<AActor*>(), EDrawDebugTrace::None, Hit, true);
+			return Hit.Distance;
+		});
+
+		FCollisionObjectQueryParams ObjectParams;
+		ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+		ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+		ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+		const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(DriverlessBenchProbe), false);
+		const FCollisionShape Sphere = FCollisionShape::MakeSphere(TraceRadius);
+
+		Bench.RunThreaded(TEXT("UWorld::SweepSingleByObjectType") + Suffix, Settings.Iterations / 10, [&](int32 i)
+		{
+			const int32 Frame = i % NumFrames;
+			const FVector Start = GetTraceStart(Frame);
+			FHitResult Hit;
+			World.SweepSingleByObjectType(Hit, Start, Start + Trajectory.Forwards[Frame] * TraceDistance, FQuat::Identity, ObjectParams, Sphere, QueryParams);
+			return Hit.Distance;
+		});
+
+		// what a follower does in one planning step, minus the vehicle inputs:
+		// track lookups, the speed plan, a probe fan sweep, the fan scoring and the control law
+		const FFollowerControlParams Params;
+		const FFollowerProbeWeights Weights;
+		Bench.Run(TEXT("Follower step (lookups + 3 sweeps + control law)") + Suffix, Settings.Iterations / 20, [&](int32 i)
+		{
+			const int32 Frame = i % NumFrames;
+			const FVector Location = Trajectory.Locations[Frame];
+			const FVector Forward = Trajectory.Forwards[Frame];
+
+			const float Distance = Table.FindDistanceClosestToLocation(Location);
+			const FVector CurrentTangent = Table.GetTangentAtDistance(Distance + 10.0f);
+			const FFollowerSpeedPlan Plan = FollowerControl::PlanSpeed(Params, CurrentTangent, Table.GetTangentAtDistance(Distance + Params.BrakingLookAhead));
+
+			FFollowerControlInput Input;
+			Input.VehicleLocation = Location;
+			Input.VehicleForward = Forward;
+			Input.VehicleRight = FVector::CrossProduct(FVector::UpVector, Forward);
+			Input.TargetLocation = Table.GetLocationAtDistance(Distance + Plan.SteeringLookAhead);
+			Input.ObstacleHitDistance = TraceDistance;
+
+			FVector Directions[NumProbes];
+			float FreeDistances[NumProbes];
+			const FVector Start = GetTraceStart(Frame);
+			for (int32 Probe = 0; Probe < NumProbes; Probe++)
+			{
+				Directions[Probe] = Forward.RotateAngleAxis(ProbeAngles[Probe], FVector::UpVector);
+
+				FHitResult Hit;
+				const bool bHit = World.SweepSingleByObjectType(Hit, Start, Start + Directions[Probe] * TraceDistance, FQuat::Identity, ObjectParams, Sphere, QueryParams);
+				FreeDistances[Probe] = bHit ? Hit.Distance : TraceDistance;
+				if (bHit)
+				{
+					Input.bAvoiding = true;
+					Input.ObstacleHitDistance = FMath::Min(Input.ObstacleHitDistance, Hit.Distance);
+				}
+			}
+
+			if (Input.bAvoiding)
+			{
+				FFollowerProbeScores Scratch;
+				const int32 Best = FollowerControl::ScoreProbeFan(Params, Weights, Directions, FreeDistances, Forward, CurrentTangent, 0.0f, Scratch);
+				Input.SafeDirection = Directions[Best];
+			}
+
+			const FFollowerControlOutput Output = FollowerControl::ComputeCommands(Params, Plan, Input);
+			return Output.Steering + Output.Throttle;
+		});
+	}
+
+	// a full revolution of the default range sensor, mounted on the roof, from every frame of the trajectory
+	static void RunRangeSensorBenchmarks(FBench& Bench, UWorld& World, const FString& TrackName, const FTrajectory& Trajectory)
+	{
+		const FSettings& Settings = Bench.GetSettings();
+		const int32 NumFrames = Trajectory.Num();
+
+		AActor* Carrier = World.SpawnActor<AActor>();
+		URangeSensorComponent* Sensor = NewObject<URangeSensorComponent>(Carrier);
+		Carrier->SetRootComponent(Sensor);
+		Sensor->RegisterComponent();
+
+		for (const bool bParallel : { false, true })
+		{
+			Sensor->bParallelTraces = bParallel;
+			Sensor->Scan();
+
+			const FString Name = FString::Printf(TEXT("URangeSensorComponent::Scan %dx%d rays%s [%s]"),
+				Sensor->NumChannels, Sensor->GetNumRays() / Sensor->NumChannels, bParallel ? TEXT(" (parallel)") : TEXT(""), *TrackName);
+
+			Bench.Run(Name, FMath::Max(Settings.Iterations / 10000, 10), [&](int32 i)
+			{
+				const int32 Frame = i % NumFrames;
+				Carrier->SetActorLocationAndRotation(Trajectory.Locations[Frame] + FVector::UpVector * 180.0f, Trajectory.Forwards[Frame].Rotation());
+				Sensor->Scan();
+				return (double)Sensor->GetPointCloud().NumReturns;
+			});
+		}
+
+		Carrier->Destroy();
+	}
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GDriverlessRecordTrajectoriesCommand(
+	TEXT("Driverless.RecordTrajectories"),
+	TEXT("Records the followers' trajectories for DriverlessBench. Usage: Driverless.RecordTrajectories [Seconds=60 | stop]"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DriverlessBench::RecordTrajectories));
+
+UDriverlessBenchCommandlet::UDriverlessBenchCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+UWorld* UDriverlessBenchCommandlet::LoadWorld(const FString& MapName)
+{
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+		return nullptr;
+
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+
+	UWorld::InitializationValues InitValues;
+	InitValues.ShouldSimulatePhysics(false)
+		.EnableTraceCollision(true)
+		.CreatePhysicsScene(true)
+		.CreateNavigation(false)
+		.CreateAISystem(false)
+		.AllowAudioPlayback(false)
+		.RequiresHitProxies(false);
+	World->InitWorld(InitValues);
+	World->UpdateWorldComponents(true, false);
+
+#if WITH_EDITOR
+	// the tracks and walls of a partitioned map live in external actors, load all of them
+	if (World->GetWorldPartition())
+	{
+		// kept loaded for the whole run
+		FLoaderAdapterShape* LoadAll = new FLoaderAdapterShape(World, FBox(FVector(-HALF_WORLD_MAX), FVector(HALF_WORLD_MAX)), TEXT("DriverlessBench"));
+		LoadAll->Load();
+		World->UpdateWorldComponents(true, false);
+	}
+#endif
+
+	return World;
+}
+
+UObject* UDriverlessBenchCommandlet::FindOrCreateAsset(const FString& PackageName, UClass* Class)
+{
+	const FString AssetName = FPackageName::GetShortName(PackageName);
+	UPackage* Package = CreatePackage(*PackageName);
+	Package->FullyLoad();
+
+	UObject* Asset = StaticFindObject(Class, Package, *AssetName);
+	if (!Asset)
+		Asset = NewObject<UObject>(Package, Class, *AssetName, RF_Public | RF_Standalone);
+	return Asset;
+}
+
+bool UDriverlessBenchCommandlet::SaveAsset(UObject& Asset)
+{
+#if WITH_EDITOR
+	UPackage* Package = Asset.GetOutermost();
+	Package->MarkPackageDirty();
+
+	const FString FileName = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	SaveArgs.Error = GError;
+	return UPackage::SavePackage(Package, &Asset, *FileName, SaveArgs);
+#else
+	return false;
+#endif
+}
+
+int32 UDriverlessBenchCommandlet::Main(const FString& Params)
+{
+	using namespace DriverlessBench;
+
+	FSettings Settings;
+	FString MapName = TEXT("/Game/FirstLevel");
+	FString CsvPath;
+	FString ThreadCounts;
+	FParse::Value(*Params, TEXT("map="), MapName);
+	FParse::Value(*Params, TEXT("filter="), Settings.Filter);
+	FParse::Value(*Params, TEXT("iterations="), Settings.Iterations);
+	FParse::Value(*Params, TEXT("csv="), CsvPath);
+	if (FParse::Value(*Params, TEXT("threads="), ThreadCounts))
+	{
+		TArray<FString> Counts;
+		ThreadCounts.ParseIntoArray(Counts, TEXT(","));
+		Settings.ThreadCounts.Reset();
+		for (const FString& Count : Counts)
+			Settings.ThreadCounts.Add(FMath::Max(1, FCString::Atoi(*Count)));
+	}
+	Settings.Iterations = FMath::Max(Settings.Iterations, 100);
+
+	UWorld* World = LoadWorld(MapName);
+	if (!World)
+	{
+		UE_LOG(LogDriverlessBench, Error, TEXT("Unable to load map '%s'."), *MapName);
+		return 1;
+	}
+
+	// the same cones on every run
+	for (TActorIterator<AObstacleSpawnerActor> It(World); It; ++It)
+	{
+		It->RandomSeed = 1337;
+		It->RespawnObstacles();
+	}
+
+	FBench Bench(Settings);
+	int32 NumTracks = 0;
+
+	for (TActorIterator<ALandscapeSplineActor> It(World); It; ++It)
+	{
+		ULandscapeSplinesComponent* LandscapeSplines = It->GetSplinesComponent();
+		if (!LandscapeSplines) continue;
+
+		USplineComponent* Spline = NewObject<USplineComponent>(*It);
+		Spline->RegisterComponentWithWorld(World);
+		LandscapeSplines->CopyToSplineComponent(Spline);
+		if (Spline->GetNumberOfSplinePoints() < 2) continue;
+
+		const FString TrackName = It->GetName();
+		const TSharedRef<FTrackTable> Table = UDriverlessTrackSubsystem::BuildTrackTable(*Spline, 100.0f);
+
+		TArray<FTrajectory> Trajectories = LoadTrajectories(TrackName);
+		if (Trajectories.Num() == 0)
+		{
+			UE_LOG(LogDriverlessBench, Display, TEXT("No recorded trajectory for '%s', driving along the centerline."), *TrackName);
+			Trajectories.Add(MakeCenterlineTrajectory(*Table, 4096));
+		}
+
+		// all the recorded vehicles back to back
+		FTrajectory Trajectory;
+		for (const FTrajectory& Recorded : Trajectories)
+		{
+			Trajectory.Locations.Append(Recorded.Locations);
+			Trajectory.Forwards.Append(Recorded.Forwards);
+		}
+		if (Trajectory.Num() == 0) continue;
+
+		UE_LOG(LogDriverlessBench, Display, TEXT("Track '%s': %.0f m, %d spline points, %d trajectory frames."),
+			*TrackName, Spline->GetSplineLength() / 100.0f, Spline->GetNumberOfSplinePoints(), Trajectory.Num());
+
+		RunSplineBenchmarks(Bench, TrackName, *Spline, *Table, Trajectory);
+
+		// the same track with more and more spline points
+		for (const int32 NumPoints : { 16, 64, 256, 1024 })
+		{
+			const USplineComponent* Resampled = ResampleSpline(GetTransientPackage(), *Spline, NumPoints);
+			RunSplineBenchmarks(Bench, TrackName, *Resampled, *Table, Trajectory);
+		}
+
+		RunSweepBenchmarks(Bench, *World, TrackName, *Table, Trajectory);
+		RunRangeSensorBenchmarks(Bench, *World, TrackName, Trajectory);
+		NumTracks++;
+	}
+
+	if (NumTracks == 0)
+	{
+		UE_LOG(LogDriverlessBench, Error, TEXT("No landscape spline track found in '%s'."), *MapName);
+		return 1;
+	}
+
+	Bench.Log();
+	if (!CsvPath.IsEmpty())
+	{
+		Bench.SaveCsv(CsvPath);
+		UE_LOG(LogDriverlessBench, Display, TEXT("Results written to %s"), *CsvPath);
+	}
+
+	World->RemoveFromRoot();
+	return 0;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DriverlessBenchCommandlet.generated.h"
+
+/**
+ * Micro-benchmarks of the queries the follower hammers, on the real tracks of a map:
+ * spline lookups (and their track table counterparts), sphere sweeps against the static scene, a
+ * full follower control step and range sensor revolutions, run over recorded vehicle trajectories.
+ * Reports ns/op, cache misses per op (Linux perf events) and how the costs scale with the number of
+ * spline points and of threads.
+ *
+ *   UnrealEditor-Cmd DriverlessTask.uproject -run=DriverlessBench [-map=/Game/FirstLevel] [-filter=<substring>]
+ *                    [-iterations=<ops per run>] [-threads=1,2,4,8] [-csv=<output file>]
+ *
+ * Trajectories are read from Saved/Driverless/Trajectories/<Track>_*.csv, recorded in game with
+ * Driverless.RecordTrajectories. Tracks without recordings are driven along their centerline instead.
+ */
+UCLASS()
+class UDriverlessBenchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDriverlessBenchCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	// loads MapName for a commandlet to run queries on: collision on, and every actor of a partitioned map loaded
+	static UWorld* LoadWorld(const FString& MapName);
+
+	// for the commandlets that bake assets: the asset of a package, loaded to be overwritten when it already exists, and its saving
+	static UObject* FindOrCreateAsset(const FString& PackageName, UClass* Class);
+	static bool SaveAsset(UObject& Asset);
+
+	template<typename T>
+	static T* FindOrCreateAsset(const FString& PackageName) { return CastChecked<T>(FindOrCreateAsset(PackageName, T::StaticClass())); }
+};
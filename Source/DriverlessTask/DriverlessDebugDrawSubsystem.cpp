@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessDebugDrawSubsystem.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "DriverlessStats.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarDebugDraw(
+	TEXT("Driverless.DebugDraw"),
+	1,
+	TEXT("Draws the followers' trails, probe fans and targets."));
+
+static TAutoConsoleVariable<int32> CVarDebugTrailLength(
+	TEXT("Driverless.DebugTrailLength"),
+	200,
+	TEXT("Points kept in each follower's debug trail. Older points are overwritten."));
+
+static TAutoConsoleVariable<float> CVarDebugTrailSpacing(
+	TEXT("Driverless.DebugTrailSpacing"),
+	50.0f,
+	TEXT("Minimum distance (cm) between two points of a debug trail."));
+
+void FFollowerDebugHistory::AddTrailPoint(const FVector& Location, int32 Capacity, float MinSpacing)
+{
+	// a new capacity starts a new trail
+	if (Trail.Num() != Capacity)
+	{
+		Trail.SetNumUninitialized(Capacity);
+		ResetTrail();
+	}
+
+	if (TrailCount > 0 && FVector::DistSquared(GetTrailPoint(0), Location) < FMath::Square(MinSpacing))
+		return;
+
+	Trail[TrailHead] = Location;
+	TrailHead = (TrailHead + 1) % Capacity;
+	TrailCount = FMath::Min(TrailCount + 1, Capacity);
+}
+
+void FFollowerDebugHistory::SetProbe(int32 Index, int32 NumProbes, const FVector& Start, const FVector& End, bool bHit)
+{
+	Probes.SetNum(NumProbes, EAllowShrinking::No);
+	Probes[Index].Start = Start;
+	Probes[Index].End = End;
+	Probes[Index].bHit = bHit;
+}
+
+void FFollowerDebugHistory::SetTarget(const FVector& Location)
+{
+	Target = Location;
+	bHasTarget = true;
+}
+
+void FFollowerDebugHistory::ResetTrail()
+{
+	TrailHead = 0;
+	TrailCount = 0;
+}
+
+bool UDriverlessDebugDrawSubsystem::IsEnabled()
+{
+	return CVarDebugDraw.GetValueOnGameThread() != 0;
+}
+
+int32 UDriverlessDebugDrawSubsystem::GetTrailCapacity()
+{
+	return FMath::Clamp(CVarDebugTrailLength.GetValueOnGameThread(), 2, 10000);
+}
+
+float UDriverlessDebugDrawSubsystem::GetTrailSpacing()
+{
+	return FMath::Max(CVarDebugTrailSpacing.GetValueOnGameThread(), 0.0f);
+}
+
+void UDriverlessDebugDrawSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// our own batcher, so the world's persistent one only holds what others draw
+	LineBatcher = NewObject<ULineBatchComponent>(this, TEXT("DriverlessLineBatcher"));
+	LineBatcher->bCalculateAccurateBounds = false;
+	LineBatcher->RegisterComponentWithWorld(&InWorld);
+}
+
+void UDriverlessDebugDrawSubsystem::Deinitialize()
+{
+	if (LineBatcher && LineBatcher->IsRegistered())
+		LineBatcher->UnregisterComponent();
+	LineBatcher = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UDriverlessDebugDrawSubsystem::AddCross(const FVector& Center, float Size, const FLinearColor& Color, float Thickness)
+{
+	Lines.Emplace(Center - FVector(Size, 0.0f, 0.0f), Center + FVector(Size, 0.0f, 0.0f), Color, 0.0f, Thickness, SDPG_World);
+	Lines.Emplace(Center - FVector(0.0f, Size, 0.0f), Center + FVector(0.0f, Size, 0.0f), Color, 0.0f, Thickness, SDPG_World);
+	Lines.Emplace(Center - FVector(0.0f, 0.0f, Size), Center + FVector(0.0f, 0.0f, Size), Color, 0.0f, Thickness, SDPG_World);
+}
+
+void UDriverlessDebugDrawSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!LineBatcher) return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_DebugDraw);
+	LLM_SCOPE_BYTAG(Driverless_Debug);
+
+	// only this frame's lines are ever in the batch
+	LineBatcher->Flush();
+
+	if (!IsEnabled()) return;
+
+	const UDriverlessVehicleSubsystem* VehicleSubsystem = GetWorld()->GetSubsystem<UDriverlessVehicleSubsystem>();
+	if (!VehicleSubsystem) return;
+
+	Lines.Reset();
+	for (const TWeakObjectPtr<USplineFollowerComponent>& Follower : VehicleSubsystem->GetFollowers())
+	{
+		const USplineFollowerComponent* Component = Follower.Get();
+		if (!Component) continue;
+
+		const FFollowerDebugHistory& History = Component->GetDebugHistory();
+
+		// Vehicle's trail line
+		for (int32 Age = 0; Age + 1 < History.TrailCount; Age++)
+			Lines.Emplace(History.GetTrailPoint(Age + 1), History.GetTrailPoint(Age), FLinearColor(FColor::Cyan), 0.0f, 5.0f, SDPG_World);
+
+		// probe fan, red where it hit something
+		for (const FFollowerDebugHistory::FProbe& Probe : History.Probes)
+			Lines.Emplace(Probe.Start, Probe.End, FLinearColor(Probe.bHit ? FColor::Red : FColor::Yellow), 0.0f, 5.0f, SDPG_World);
+
+		// Target point
+		if (History.bHasTarget)
+			AddCross(History.Target, 50.0f, FLinearColor(FColor::Green), 10.0f);
+	}
+
+	LineBatcher->DrawLines(Lines);
+}
+
+TStatId UDriverlessDebugDrawSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDriverlessDebugDrawSubsystem, STATGROUP_Tickables);
+}
+
+bool UDriverlessDebugDrawSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/LineBatchComponent.h"
+#include "DriverlessDebugDrawSubsystem.generated.h"
+
+// last trail points, probe fan and target of a follower. Fixed capacity, so it never grows with the session length
+struct FFollowerDebugHistory
+{
+	struct FProbe
+	{
+		FVector Start = FVector::ZeroVector;
+		FVector End = FVector::ZeroVector;
+		bool bHit = false;
+	};
+
+	// trail as a ring buffer, TrailHead is the slot the next point goes to
+	TArray<FVector> Trail;
+	int32 TrailHead = 0;
+	int32 TrailCount = 0;
+
+	TArray<FProbe> Probes;
+	FVector Target = FVector::ZeroVector;
+	bool bHasTarget = false;
+
+	// adds a trail point if the vehicle moved at least MinSpacing (cm) since the last one
+	void AddTrailPoint(const FVector& Location, int32 Capacity, float MinSpacing);
+	void SetProbe(int32 Index, int32 NumProbes, const FVector& Start, const FVector& End, bool bHit);
+	void SetTarget(const FVector& Location);
+
+	// breaks the trail, e.g. after a teleport
+	void ResetTrail();
+
+	const FVector& GetTrailPoint(int32 Age) const { return Trail[(TrailHead - 1 - Age + Trail.Num()) % Trail.Num()]; }
+
+	SIZE_T GetAllocatedSize() const { return Trail.GetAllocatedSize() + Probes.GetAllocatedSize(); }
+};
+
+/**
+ * Debug visualization of every follower through a single line batch component owned by the world's subsystem.
+ * The batch is rebuilt each frame from the followers' ring buffers, so the number of lines is bounded by
+ * vehicles * (trail length + probes) no matter how long the session runs.
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessDebugDrawSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// whether followers should record their debug history at all
+	static bool IsEnabled();
+	static int32 GetTrailCapacity();
+	static float GetTrailSpacing();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// the batch the followers are drawn through, null before the world begins play
+	const ULineBatchComponent* GetLineBatcher() const { return LineBatcher; }
+	SIZE_T GetAllocatedSize() const { return Lines.GetAllocatedSize(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void AddCross(const FVector& Center, float Size, const FLinearColor& Color, float Thickness);
+
+	UPROPERTY()
+	ULineBatchComponent* LineBatcher = nullptr;
+
+	// lines of the current frame, kept between frames so the rebuild doesn't allocate
+	TArray<FBatchedLine> Lines;
+};
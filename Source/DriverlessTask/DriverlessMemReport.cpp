@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Components/LineBatchComponent.h"
+#include "Components/SplineComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "LandscapeSplineActor.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "DriverlessTrackSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "RangeSensorComponent.h"
+#include "ConeCenterlineComponent.h"
+#include "ObstacleSpawnerActor.h"
+#include "DriverlessDebugDrawSubsystem.h"
+
+/**
+ * Driverless.MemReport: memory held by the driverless systems, per track and per vehicle.
+ * UObjects are measured the same way `obj list` does (serialized size plus their resources),
+ * plain data through the containers' allocated size.
+ */
+
+static TAutoConsoleVariable<int32> CVarMemBudgetPerVehicleKB(
+	TEXT("Driverless.MemBudgetPerVehicleKB"),
+	256,
+	TEXT("Memory budget (KB) of a single vehicle's driverless data. Vehicles over budget are flagged by Driverless.MemReport. 0 = no budget."));
+
+static TAutoConsoleVariable<int32> CVarMemBudgetPerTrackKB(
+	TEXT("Driverless.MemBudgetPerTrackKB"),
+	8192,
+	TEXT("Memory budget (KB) of a track's driverless data (track table, cones). Tracks over budget are flagged by Driverless.MemReport. 0 = no budget."));
+
+namespace DriverlessMemReport
+{
+	// memory of an object itself, plus the resources it owns (render data, physics bodies...)
+	static SIZE_T GetObjectSize(UObject* Object)
+	{
+		if (!Object) return 0;
+
+		FArchiveCountMem CountBytes(Object);
+		return CountBytes.GetMax() + Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	}
+
+	static SIZE_T GetActorSize(AActor* Actor)
+	{
+		if (!Actor) return 0;
+
+		SIZE_T Size = GetObjectSize(Actor);
+		for (UActorComponent* Component : Actor->GetComponents())
+			Size += GetObjectSize(Component);
+		return Size;
+	}
+
+	static const TCHAR* OverBudget(SIZE_T Size, int32 BudgetKB)
+	{
+		return (BudgetKB > 0 && Size > (SIZE_T)BudgetKB * 1024) ? TEXT("  OVER BUDGET") : TEXT("");
+	}
+
+	static void Dump(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (!World)
+		{
+			Ar.Logf(TEXT("Driverless.MemReport: no world."));
+			return;
+		}
+
+		const int32 TrackBudgetKB = CVarMemBudgetPerTrackKB.GetValueOnGameThread();
+		const int32 VehicleBudgetKB = CVarMemBudgetPerVehicleKB.GetValueOnGameThread();
+		SIZE_T Total = 0;
+
+		/* TRACKS: shared track table and occupancy grid, and the cones spawned along them */
+		Ar.Logf(TEXT("---- Driverless memory: tracks ----"));
+		Ar.Logf(TEXT("%-32s %12s %12s %8s %12s %12s"), TEXT("Track"), TEXT("Table KB"), TEXT("Spawner KB"), TEXT("Cones"), TEXT("Cones KB"), TEXT("Total KB"));
+
+		TMap<const AActor*, SIZE_T> TableSizes;
+		if (const UDriverlessTrackSubsystem* TrackSubsystem = World->GetSubsystem<UDriverlessTrackSubsystem>())
+		{
+			for (const TPair<TObjectKey<AActor>, TSharedPtr<const FTrackTable>>& Pair : TrackSubsystem->GetTrackTables())
+			{
+				if (const AActor* Track = Pair.Key.ResolveObjectPtr())
+					TableSizes.Add(Track, sizeof(FTrackTable) + Pair.Value->GetAllocatedSize() + TrackSubsystem->GetOccupancyGridSize(Track));
+			}
+		}
+
+		TMap<const AActor*, SIZE_T> SpawnerSizes;
+		TMap<const AActor*, SIZE_T> ConeSizes;
+		TMap<const AActor*, int32> ConeCounts;
+		for (TActorIterator<AObstacleSpawnerActor> It(World); It; ++It)
+		{
+			const AActor* Track = It->GetTrackSplineActor();
+			SpawnerSizes.FindOrAdd(Track) += GetActorSize(*It);
+
+			for (AActor* Cone : It->GetSpawnedObstacles())
+			{
+				ConeSizes.FindOrAdd(Track) += GetActorSize(Cone);
+				ConeCounts.FindOrAdd(Track)++;
+			}
+		}
+
+		TSet<const AActor*> Tracks;
+		for (const TPair<const AActor*, SIZE_T>& Pair : TableSizes) Tracks.Add(Pair.Key);
+		for (const TPair<const AActor*, SIZE_T>& Pair : SpawnerSizes) Tracks.Add(Pair.Key);
+
+		for (const AActor* Track : Tracks)
+		{
+			const SIZE_T TableSize = TableSizes.FindRef(Track);
+			const SIZE_T SpawnerSize = SpawnerSizes.FindRef(Track);
+			const SIZE_T ConeSize = ConeSizes.FindRef(Track);
+			const SIZE_T TrackTotal = TableSize + SpawnerSize + ConeSize;
+			Total += TrackTotal;
+
+			Ar.Logf(TEXT("%-32s %12.1f %12.1f %8d %12.1f %12.1f%s"), Track ? *Track->GetName() : TEXT("<none>"),
+				TableSize / 1024.0f, SpawnerSize / 1024.0f, ConeCounts.FindRef(Track), ConeSize / 1024.0f, TrackTotal / 1024.0f,
+				OverBudget(TrackTotal, TrackBudgetKB));
+		}
+
+		/* VEHICLES: follower component, its own copy of the spline, probe buffers, range sensors */
+		Ar.Logf(TEXT("---- Driverless memory: vehicles ----"));
+		Ar.Logf(TEXT("%-32s %12s %12s %12s %12s %12s"), TEXT("Vehicle"), TEXT("Follower KB"), TEXT("Spline KB"), TEXT("Buffers KB"), TEXT("Sensors KB"), TEXT("Total KB"));
+
+		if (const UDriverlessVehicleSubsystem* VehicleSubsystem = World->GetSubsystem<UDriverlessVehicleSubsystem>())
+		{
+			for (const TWeakObjectPtr<USplineFollowerComponent>& FollowerPtr : VehicleSubsystem->GetFollowers())
+			{
+				USplineFollowerComponent* Follower = FollowerPtr.Get();
+				if (!Follower) continue;
+
+				const SIZE_T FollowerSize = GetObjectSize(Follower);
+
+				// only the splines converted from a landscape spline belong to the follower
+				USplineComponent* Spline = Follower->GetSplineToFollow();
+				const SIZE_T SplineSize = (Spline && Spline->GetOuter() == Follower) ? GetObjectSize(Spline) : 0;
+
+				const SIZE_T BufferSize = Follower->GetAllocatedSize();
+
+				// point clouds and cone maps scale with the sensor configuration, they're kept out of the vehicle budget
+				SIZE_T SensorSize = 0;
+				TInlineComponentArray<URangeSensorComponent*> Sensors(Follower->GetOwner());
+				for (URangeSensorComponent* Sensor : Sensors)
+					SensorSize += GetObjectSize(Sensor) + Sensor->GetAllocatedSize();
+				if (UConeCenterlineComponent* ConeCenterline = Follower->GetOwner()->FindComponentByClass<UConeCenterlineComponent>())
+					SensorSize += GetObjectSize(ConeCenterline) + ConeCenterline->GetAllocatedSize();
+
+				const SIZE_T VehicleTotal = FollowerSize + SplineSize + BufferSize;
+				Total += VehicleTotal + SensorSize;
+
+				Ar.Logf(TEXT("%-32s %12.1f %12.1f %12.1f %12.1f %12.1f%s"), *Follower->GetOwner()->GetName(),
+					FollowerSize / 1024.0f, SplineSize / 1024.0f, BufferSize / 1024.0f, SensorSize / 1024.0f, (VehicleTotal + SensorSize) / 1024.0f,
+					OverBudget(VehicleTotal, VehicleBudgetKB));
+			}
+		}
+
+		/* DEBUG: lines of the followers' own batch, plus the per-frame staging array */
+		const UDriverlessDebugDrawSubsystem* DebugDraw = World->GetSubsystem<UDriverlessDebugDrawSubsystem>();
+		if (const ULineBatchComponent* LineBatcher = DebugDraw ? DebugDraw->GetLineBatcher() : nullptr)
+		{
+			Ar.Logf(TEXT("---- Debug lines ----"));
+			Ar.Logf(TEXT("%d lines, %.1f KB"), LineBatcher->BatchedLines.Num(),
+				(LineBatcher->BatchedLines.GetAllocatedSize() + DebugDraw->GetAllocatedSize()) / 1024.0f);
+		}
+
+		Ar.Logf(TEXT("Driverless total (tracks + vehicles): %.1f KB"), Total / 1024.0f);
+	}
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GDriverlessMemReportCommand(
+	TEXT("Driverless.MemReport"),
+	TEXT("Dumps the memory held by the driverless systems, per track and per vehicle."),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DriverlessMemReport::Dump));
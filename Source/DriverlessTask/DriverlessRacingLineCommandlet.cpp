@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessRacingLineCommandlet.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Components/SplineComponent.h"
+#include "LandscapeSplineActor.h"
+#include "LandscapeSplinesComponent.h"
+#include "DriverlessBenchCommandlet.h"
+#include "DriverlessTrackSubsystem.h"
+#include "RacingLineAsset.h"
+#include "RacingLineOptimizer.h"
+#include "TrackTable.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDriverlessRacingLine, Log, All);
+
+namespace DriverlessRacingLine
+{
+	struct FSettings
+	{
+		FString TrackFilter;
+		FString OutputPath = TEXT("/Game/RacingLines");
+		FRacingLineParams Params;
+		float SampleSpacing = 100.0f;
+
+		// speed profile limits
+		float MaxSpeed = 3000.0f;
+		float MaxLateralAccel = 900.0f;
+		float MaxAccel = 400.0f;
+		float MaxDecel = 800.0f;
+	};
+}
+
+UDriverlessRacingLineCommandlet::UDriverlessRacingLineCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UDriverlessRacingLineCommandlet::Main(const FString& Params)
+{
+	using namespace DriverlessRacingLine;
+
+	FSettings Settings;
+	FString MapName = TEXT("/Game/FirstLevel");
+	FParse::Value(*Params, TEXT("map="), MapName);
+	FParse::Value(*Params, TEXT("track="), Settings.TrackFilter);
+	FParse::Value(*Params, TEXT("output="), Settings.OutputPath);
+	FParse::Value(*Params, TEXT("margin="), Settings.Params.Margin);
+	FParse::Value(*Params, TEXT("spacing="), Settings.SampleSpacing);
+	FParse::Value(*Params, TEXT("linearizations="), Settings.Params.NumLinearizations);
+	FParse::Value(*Params, TEXT("maxspeed="), Settings.MaxSpeed);
+	FParse::Value(*Params, TEXT("lateralaccel="), Settings.MaxLateralAccel);
+	FParse::Value(*Params, TEXT("accel="), Settings.MaxAccel);
+	FParse::Value(*Params, TEXT("decel="), Settings.MaxDecel);
+	Settings.SampleSpacing = FMath::Max(Settings.SampleSpacing, 10.0f);
+
+	UWorld* World = UDriverlessBenchCommandlet::LoadWorld(MapName);
+	UDriverlessTrackSubsystem* TrackSubsystem = World ? World->GetSubsystem<UDriverlessTrackSubsystem>() : nullptr;
+	if (!TrackSubsystem)
+	{
+		UE_LOG(LogDriverlessRacingLine, Error, TEXT("Unable to load map '%s'."), *MapName);
+		return 1;
+	}
+
+	int32 NumSaved = 0;
+	int32 NumFailed = 0;
+
+	for (TActorIterator<ALandscapeSplineActor> It(World); It; ++It)
+	{
+		const FString TrackName = It->GetName();
+		if (!Settings.TrackFilter.IsEmpty() && !TrackName.Contains(Settings.TrackFilter))
+			continue;
+
+		ULandscapeSplinesComponent* LandscapeSplines = It->GetSplinesComponent();
+		if (!LandscapeSplines) continue;
+
+		USplineComponent* Spline = NewObject<USplineComponent>(*It);
+		Spline->RegisterComponentWithWorld(World);
+		LandscapeSplines->CopyToSplineComponent(Spline);
+
+		// the table the followers get, with the boundaries of the road and the walls
+		const TSharedPtr<const FTrackTable> Track = TrackSubsystem->GetTrackTable(*It, Spline);
+		if (!Track || !Track->HasBoundaries())
+		{
+			UE_LOG(LogDriverlessRacingLine, Warning, TEXT("No track table for '%s', skipped."), *TrackName);
+			continue;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		FRacingLineOptimizer Optimizer;
+		TArray<float> Offsets;
+		if (!Optimizer.Solve(*Track, Settings.Params, Offsets))
+		{
+			UE_LOG(LogDriverlessRacingLine, Error, TEXT("Unable to optimize the racing line of '%s'."), *TrackName);
+			NumFailed++;
+			continue;
+		}
+		const double SolveTime = FPlatformTime::Seconds() - StartTime;
+
+		const TSharedRef<FTrackTable> Line = FRacingLineOptimizer::BuildLineTable(*Track, Offsets, Settings.SampleSpacing);
+		Line->BuildSpeedProfile(Settings.MaxSpeed, Settings.MaxLateralAccel, Settings.MaxAccel, Settings.MaxDecel);
+
+		// how much faster the line is, driven at its speed profile, than the centerline at the same limits
+		auto GetLapTime = [](const FTrackTable& Table)
+		{
+			double Time = 0.0;
+			for (const float Speed : Table.SpeedProfile)
+				Time += Table.SampleSpacing / FMath::Max(Speed, 1.0f);
+			return Time;
+		};
+		const TSharedRef<FTrackTable> Centerline = MakeShared<FTrackTable>(*Track);
+		Centerline->BuildSpeedProfile(Settings.MaxSpeed, Settings.MaxLateralAccel, Settings.MaxAccel, Settings.MaxDecel);
+
+		UE_LOG(LogDriverlessRacingLine, Display, TEXT("'%s': %d samples, %d active set steps%s in %.1f ms. %.0f m -> %.0f m, lap %.1f s -> %.1f s."),
+			*TrackName, Track->Num(), Optimizer.GetNumIterations(), Optimizer.HasConverged() ? TEXT("") : TEXT(" (not converged)"), SolveTime * 1000.0,
+			Track->Length / 100.0f, Line->Length / 100.0f, GetLapTime(*Centerline), GetLapTime(*Line));
+
+		const FString PackageName = Settings.OutputPath / TEXT("RL_") + TrackName;
+		URacingLineAsset* Asset = UDriverlessBenchCommandlet::FindOrCreateAsset<URacingLineAsset>(PackageName);
+		Asset->SetFromTable(TrackName, *Track, *Line, Settings.Params.Margin);
+
+		if (!UDriverlessBenchCommandlet::SaveAsset(*Asset))
+		{
+			UE_LOG(LogDriverlessRacingLine, Error, TEXT("Unable to save '%s'."), *PackageName);
+			NumFailed++;
+			continue;
+		}
+
+		UE_LOG(LogDriverlessRacingLine, Display, TEXT("Saved %s"), *PackageName);
+		NumSaved++;
+	}
+
+	World->RemoveFromRoot();
+
+	if (NumSaved == 0 && NumFailed == 0)
+	{
+		UE_LOG(LogDriverlessRacingLine, Error, TEXT("No landscape spline track found in '%s'."), *MapName);
+		return 1;
+	}
+	return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DriverlessRacingLineCommandlet.generated.h"
+
+/**
+ * Optimizes the minimum curvature racing line of every landscape spline track of a map, within its boundaries,
+ * plans the speed profile along it and saves both as a URacingLineAsset per track, for the followers' RacingLine.
+ *
+ *   UnrealEditor-Cmd DriverlessTask.uproject -run=DriverlessRacingLine [-map=/Game/FirstLevel] [-track=<substring>]
+ *                    [-output=/Game/RacingLines] [-margin=150] [-spacing=100] [-linearizations=3]
+ *                    [-maxspeed=3000] [-lateralaccel=900] [-accel=400] [-decel=800]
+ *
+ * Assets are named RL_<Track> and overwritten on every run. Lengths in cm, speeds in cm/s, accelerations in cm/s^2.
+ */
+UCLASS()
+class UDriverlessRacingLineCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDriverlessRacingLineCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessSnapshotSubsystem.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "ObstacleSpawnerActor.h"
+#include "DriverlessStats.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+namespace DriverlessSnapshot
+{
+	static void Snapshot(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		UDriverlessSnapshotSubsystem* Subsystem = World ? World->GetSubsystem<UDriverlessSnapshotSubsystem>() : nullptr;
+		if (!Subsystem)
+		{
+			Ar.Log(TEXT("Driverless.Snapshot: only available in game worlds."));
+			return;
+		}
+
+		const FString Command = Args.Num() > 0 ? Args[0] : TEXT("list");
+		const FName Name = Args.Num() > 1 ? FName(*Args[1]) : FName(TEXT("Default"));
+
+		if (Command == TEXT("save"))
+		{
+			Subsystem->SaveSnapshot(Name);
+			const FDriverlessScenarioSnapshot* Saved = Subsystem->FindSnapshot(Name);
+			Ar.Logf(TEXT("Driverless.Snapshot: saved '%s' (%d vehicles, %d cones)."), *Name.ToString(), Saved->Followers.Num(), Saved->Obstacles.Num());
+		}
+		else if (Command == TEXT("restore"))
+		{
+			if (Subsystem->RestoreSnapshot(Name))
+				Ar.Logf(TEXT("Driverless.Snapshot: restored '%s'."), *Name.ToString());
+			else
+				Ar.Logf(TEXT("Driverless.Snapshot: no snapshot named '%s'."), *Name.ToString());
+		}
+		else if (Command == TEXT("delete"))
+		{
+			if (!Subsystem->DeleteSnapshot(Name))
+				Ar.Logf(TEXT("Driverless.Snapshot: no snapshot named '%s'."), *Name.ToString());
+		}
+		else
+		{
+			TArray<FName> Names;
+			Subsystem->GetSnapshotNames(Names);
+			for (const FName& SnapshotName : Names)
+			{
+				const FDriverlessScenarioSnapshot* Saved = Subsystem->FindSnapshot(SnapshotName);
+				Ar.Logf(TEXT("  %-24s t=%.2fs  %d vehicles  %d cones"), *SnapshotName.ToString(), Saved->WorldTime, Saved->Followers.Num(), Saved->Obstacles.Num());
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GDriverlessSnapshotCommand(
+	TEXT("Driverless.Snapshot"),
+	TEXT("Saves and restores the state of the vehicles and cones in place. Usage: Driverless.Snapshot save|restore|delete [Name=Default] | list"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DriverlessSnapshot::Snapshot));
+
+void UDriverlessSnapshotSubsystem::SaveSnapshot(FName Name)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Snapshot);
+
+	UWorld* World = GetWorld();
+	FDriverlessScenarioSnapshot& Snapshot = Snapshots.FindOrAdd(Name);
+	Snapshot.WorldTime = World->GetTimeSeconds();
+	Snapshot.Followers.Reset();
+	Snapshot.Obstacles.Reset();
+
+	if (const UDriverlessVehicleSubsystem* VehicleSubsystem = World->GetSubsystem<UDriverlessVehicleSubsystem>())
+	{
+		for (const TWeakObjectPtr<USplineFollowerComponent>& Follower : VehicleSubsystem->GetFollowers())
+		{
+			if (const USplineFollowerComponent* Component = Follower.Get())
+			{
+				FFollowerSnapshot& FollowerSnapshot = Snapshot.Followers.AddDefaulted_GetRef();
+				FollowerSnapshot.Follower = Follower;
+				Component->SaveSnapshot(FollowerSnapshot);
+			}
+		}
+	}
+
+	for (TActorIterator<AObstacleSpawnerActor> It(World); It; ++It)
+	{
+		for (AActor* Obstacle : It->GetSpawnedObstacles())
+		{
+			const UPrimitiveComponent* Body = Obstacle ? Cast<UPrimitiveComponent>(Obstacle->GetRootComponent()) : nullptr;
+			if (!Body) continue;
+
+			FObstacleSnapshot& ObstacleSnapshot = Snapshot.Obstacles.AddDefaulted_GetRef();
+			ObstacleSnapshot.Obstacle = Obstacle;
+			SaveBody(*Body, ObstacleSnapshot.Body);
+		}
+	}
+}
+
+bool UDriverlessSnapshotSubsystem::RestoreSnapshot(FName Name)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Snapshot);
+
+	const FDriverlessScenarioSnapshot* Snapshot = Snapshots.Find(Name);
+	if (!Snapshot) return false;
+
+	int32 NumMissing = 0;
+	for (const FFollowerSnapshot& FollowerSnapshot : Snapshot->Followers)
+	{
+		if (USplineFollowerComponent* Component = FollowerSnapshot.Follower.Get())
+			Component->RestoreSnapshot(FollowerSnapshot);
+		else
+			NumMissing++;
+	}
+
+	for (const FObstacleSnapshot& ObstacleSnapshot : Snapshot->Obstacles)
+	{
+		AActor* Obstacle = ObstacleSnapshot.Obstacle.Get();
+		UPrimitiveComponent* Body = Obstacle ? Cast<UPrimitiveComponent>(Obstacle->GetRootComponent()) : nullptr;
+		if (Body)
+			RestoreBody(*Body, ObstacleSnapshot.Body);
+		else
+			NumMissing++;
+	}
+
+	if (NumMissing > 0)
+		UE_LOG(LogTemp, Warning, TEXT("DriverlessSnapshotSubsystem: %d actors of snapshot '%s' no longer exist and were not restored."), NumMissing, *Name.ToString());
+
+	return true;
+}
+
+void UDriverlessSnapshotSubsystem::SaveBody(const UPrimitiveComponent& Body, FDriverlessBodySnapshot& OutSnapshot)
+{
+	OutSnapshot.Transform = Body.GetComponentTransform();
+	OutSnapshot.LinearVelocity = Body.GetPhysicsLinearVelocity();
+	OutSnapshot.AngularVelocity = Body.GetPhysicsAngularVelocityInDegrees();
+	OutSnapshot.bAwake = Body.RigidBodyIsAwake();
+}
+
+void UDriverlessSnapshotSubsystem::RestoreBody(UPrimitiveComponent& Body, const FDriverlessBodySnapshot& Snapshot)
+{
+	Body.SetWorldTransform(Snapshot.Transform, false, nullptr, ETeleportType::TeleportPhysics);
+	if (!Body.IsSimulatingPhysics())
+		return;
+
+	Body.SetPhysicsLinearVelocity(Snapshot.LinearVelocity);
+	Body.SetPhysicsAngularVelocityInDegrees(Snapshot.AngularVelocity);
+
+	// resting cones go back to sleep, or they would all be simulated again after every restore
+	if (Snapshot.bAwake)
+		Body.WakeRigidBody();
+	else
+		Body.PutRigidBodyToSleep();
+}
+
+bool UDriverlessSnapshotSubsystem::DeleteSnapshot(FName Name)
+{
+	return Snapshots.Remove(Name) > 0;
+}
+
+bool UDriverlessSnapshotSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
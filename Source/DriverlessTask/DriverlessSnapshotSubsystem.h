@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FollowerStuckState.h"
+#include "DriverlessDebugDrawSubsystem.h"
+#include "DriverlessSnapshotSubsystem.generated.h"
+
+class USplineFollowerComponent;
+class UPrimitiveComponent;
+
+// physics body state of a vehicle or a cone
+struct FDriverlessBodySnapshot
+{
+	FTransform Transform;
+	FVector LinearVelocity = FVector::ZeroVector;
+	FVector AngularVelocity = FVector::ZeroVector; // degrees/s
+	bool bAwake = true;
+};
+
+// everything a follower needs to carry on from where it was
+struct FFollowerSnapshot
+{
+	TWeakObjectPtr<USplineFollowerComponent> Follower;
+	FDriverlessBodySnapshot Body;
+
+	// vehicle inputs
+	int32 Gear = 0;
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+
+	// controller internals
+	FFollowerStuckState StuckState;
+	float ControlAccumulator = 0.0f;
+	bool bAvoidingObstacle = false;
+	float AvoidanceAngle = 0.0f;
+	float PhysicsTrackDistance = 0.0f;
+	FFollowerDebugHistory DebugHistory;
+
+	// kinematic playback
+	bool bKinematicLOD = false;
+	float KinematicDistance = 0.0f;
+	float KinematicSpeed = 0.0f;
+	float KinematicLateralOffset = 0.0f;
+	float KinematicHeightOffset = 0.0f;
+};
+
+struct FObstacleSnapshot
+{
+	TWeakObjectPtr<AActor> Obstacle;
+	FDriverlessBodySnapshot Body;
+};
+
+// state of the whole scenario at one instant
+struct FDriverlessScenarioSnapshot
+{
+	double WorldTime = 0.0;
+	TArray<FFollowerSnapshot> Followers;
+	TArray<FObstacleSnapshot> Obstacles;
+};
+
+/**
+ * Named in-memory snapshots of the scenario (vehicles, their controllers and the cones), restored in place
+ * without reloading the level, so many variations can branch from the same point of a lap.
+ * Actors spawned or destroyed since a snapshot was taken are left as they are.
+ *
+ *   Driverless.Snapshot save|restore|delete [Name]
+ *   Driverless.Snapshot list
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessSnapshotSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// captures the current scenario under Name, replacing any snapshot with the same name
+	void SaveSnapshot(FName Name);
+
+	// puts the scenario back in the state it was captured in. False if there is no snapshot named Name
+	bool RestoreSnapshot(FName Name);
+
+	bool DeleteSnapshot(FName Name);
+
+	const FDriverlessScenarioSnapshot* FindSnapshot(FName Name) const { return Snapshots.Find(Name); }
+	void GetSnapshotNames(TArray<FName>& OutNames) const { Snapshots.GetKeys(OutNames); }
+
+	static void SaveBody(const UPrimitiveComponent& Body, FDriverlessBodySnapshot& OutSnapshot);
+	static void RestoreBody(UPrimitiveComponent& Body, const FDriverlessBodySnapshot& Snapshot);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	TMap<FName, FDriverlessScenarioSnapshot> Snapshots;
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessStats.h"
+
+UE_TRACE_CHANNEL_DEFINE(DriverlessChannel);
+
+DEFINE_STAT(STAT_Driverless_FollowerTick);
+DEFINE_STAT(STAT_Driverless_SplineLookup);
+DEFINE_STAT(STAT_Driverless_ProbeSweeps);
+DEFINE_STAT(STAT_Driverless_AvoidanceDecision);
+DEFINE_STAT(STAT_Driverless_Traffic);
+DEFINE_STAT(STAT_Driverless_StuckHandling);
+DEFINE_STAT(STAT_Driverless_Kinematic);
+DEFINE_STAT(STAT_Driverless_PhysicsThreadControl);
+DEFINE_STAT(STAT_Driverless_Telemetry);
+DEFINE_STAT(STAT_Driverless_DebugDraw);
+DEFINE_STAT(STAT_Driverless_VehicleSubsystem);
+DEFINE_STAT(STAT_Driverless_SpawnObstacles);
+DEFINE_STAT(STAT_Driverless_Snapshot);
+DEFINE_STAT(STAT_Driverless_AgentBridge);
+DEFINE_STAT(STAT_Driverless_AgentWait);
+DEFINE_STAT(STAT_Driverless_RangeSensor);
+DEFINE_STAT(STAT_Driverless_ConeCenterline);
+DEFINE_STAT(STAT_Driverless_StateEstimator);
+DEFINE_STAT(STAT_Driverless_OccupancyGrid);
+DEFINE_STAT(STAT_Driverless_RecoveryPlanner);
+DEFINE_STAT(STAT_Driverless_TrackBoundaries);
+DEFINE_STAT(STAT_Driverless_TrackSetup);
+
+DEFINE_STAT(STAT_Driverless_ProbesIssued);
+DEFINE_STAT(STAT_Driverless_ProbesHit);
+DEFINE_STAT(STAT_Driverless_ProbeSweepsSkipped);
+DEFINE_STAT(STAT_Driverless_StaleCommands);
+DEFINE_STAT(STAT_Driverless_RangeSensorRays);
+DEFINE_STAT(STAT_Driverless_ConesTriangulated);
+DEFINE_STAT(STAT_Driverless_EstimatorSteps);
+DEFINE_STAT(STAT_Driverless_GridObstaclesMoved);
+DEFINE_STAT(STAT_Driverless_RecoveryExpansions);
+
+DEFINE_STAT(STAT_Driverless_ConesSpawned);
+DEFINE_STAT(STAT_Driverless_SpawnAttempts);
+
+TRACE_DECLARE_INT_COUNTER(DriverlessProbesIssued, TEXT("Driverless/Probes Issued"));
+TRACE_DECLARE_INT_COUNTER(DriverlessProbesHit, TEXT("Driverless/Probes Hit"));
+TRACE_DECLARE_INT_COUNTER(DriverlessStaleCommands, TEXT("Driverless/Stale Commands Dropped"));
+TRACE_DECLARE_INT_COUNTER(DriverlessRangeSensorRays, TEXT("Driverless/Range Sensor Rays"));
+TRACE_DECLARE_INT_COUNTER(DriverlessConesTriangulated, TEXT("Driverless/Cones Triangulated"));
+TRACE_DECLARE_INT_COUNTER(DriverlessEstimatorSteps, TEXT("Driverless/Estimator Steps"));
+TRACE_DECLARE_INT_COUNTER(DriverlessGridObstaclesMoved, TEXT("Driverless/Grid Obstacles Moved"));
+TRACE_DECLARE_INT_COUNTER(DriverlessRecoveryExpansions, TEXT("Driverless/Recovery Expansions"));
+TRACE_DECLARE_INT_COUNTER(DriverlessConesSpawned, TEXT("Driverless/Cones Spawned"));
+TRACE_DECLARE_INT_COUNTER(DriverlessSpawnAttempts, TEXT("Driverless/Spawn Attempts"));
+
+LLM_DEFINE_TAG(Driverless_Follower);
+LLM_DEFINE_TAG(Driverless_Spawner);
+LLM_DEFINE_TAG(Driverless_Track);
+LLM_DEFINE_TAG(Driverless_Debug);
+LLM_DEFINE_TAG(Driverless_Sensor);
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/**
+ * Instrumentation of the driverless module.
+ * Timings show up with `stat Driverless` and, on the "Driverless" trace channel, in Unreal Insights
+ * (-trace=cpu,counters,driverless). Allocations are tagged for the low level memory tracker (-llm, `stat LLMFULL`),
+ * and `Driverless.MemReport` breaks them down per track and per vehicle.
+ */
+
+DECLARE_STATS_GROUP(TEXT("Driverless"), STATGROUP_Driverless, STATCAT_Advanced);
+
+UE_TRACE_CHANNEL_EXTERN(DriverlessChannel, DRIVERLESSTASK_API);
+
+// timings
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Follower Tick"), STAT_Driverless_FollowerTick, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spline Lookup"), STAT_Driverless_SplineLookup, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Probe Sweeps"), STAT_Driverless_ProbeSweeps, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Avoidance Decision"), STAT_Driverless_AvoidanceDecision, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Traffic"), STAT_Driverless_Traffic, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Stuck Handling"), STAT_Driverless_StuckHandling, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Kinematic Playback"), STAT_Driverless_Kinematic, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Physics Thread Control"), STAT_Driverless_PhysicsThreadControl, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Telemetry"), STAT_Driverless_Telemetry, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Debug Drawing"), STAT_Driverless_DebugDraw, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Vehicle Subsystem"), STAT_Driverless_VehicleSubsystem, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Obstacles"), STAT_Driverless_SpawnObstacles, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Scenario Snapshot"), STAT_Driverless_Snapshot, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Agent Bridge"), STAT_Driverless_AgentBridge, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Agent Wait"), STAT_Driverless_AgentWait, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Range Sensor"), STAT_Driverless_RangeSensor, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cone Centerline"), STAT_Driverless_ConeCenterline, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("State Estimator"), STAT_Driverless_StateEstimator, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Occupancy Grid"), STAT_Driverless_OccupancyGrid, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Recovery Planner"), STAT_Driverless_RecoveryPlanner, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Track Boundaries"), STAT_Driverless_TrackBoundaries, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Track Setup"), STAT_Driverless_TrackSetup, STATGROUP_Driverless, DRIVERLESSTASK_API);
+
+// per frame counters
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probes Issued"), STAT_Driverless_ProbesIssued, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probes Hit"), STAT_Driverless_ProbesHit, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probe Sweeps Skipped"), STAT_Driverless_ProbeSweepsSkipped, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Stale Commands Dropped"), STAT_Driverless_StaleCommands, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Range Sensor Rays"), STAT_Driverless_RangeSensorRays, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Cones Triangulated"), STAT_Driverless_ConesTriangulated, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Estimator Steps"), STAT_Driverless_EstimatorSteps, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Grid Obstacles Moved"), STAT_Driverless_GridObstaclesMoved, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Recovery Expansions"), STAT_Driverless_RecoveryExpansions, STATGROUP_Driverless, DRIVERLESSTASK_API);
+
+// running totals
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Cones Spawned"), STAT_Driverless_ConesSpawned, STATGROUP_Driverless, DRIVERLESSTASK_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Spawn Attempts"), STAT_Driverless_SpawnAttempts, STATGROUP_Driverless, DRIVERLESSTASK_API);
+
+// the same counters, as Insights tracks
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessProbesIssued);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessProbesHit);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessStaleCommands);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessRangeSensorRays);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessConesTriangulated);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessEstimatorSteps);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessGridObstaclesMoved);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessRecoveryExpansions);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessConesSpawned);
+TRACE_DECLARE_INT_COUNTER_EXTERN(DriverlessSpawnAttempts);
+
+// times a scope both for `stat Driverless` and for Insights
+#define DRIVERLESS_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, DriverlessChannel)
+
+// adds to a stat counter and to its Insights counter
+#define DRIVERLESS_COUNTER_ADD(Stat, TraceCounter, Amount) \
+	INC_DWORD_STAT_BY(Stat, Amount); \
+	TRACE_COUNTER_ADD(TraceCounter, Amount)
+
+// low level memory tracker tags
+LLM_DECLARE_TAG_API(Driverless_Follower, DRIVERLESSTASK_API);
+LLM_DECLARE_TAG_API(Driverless_Spawner, DRIVERLESSTASK_API);
+LLM_DECLARE_TAG_API(Driverless_Track, DRIVERLESSTASK_API);
+LLM_DECLARE_TAG_API(Driverless_Debug, DRIVERLESSTASK_API);
+LLM_DECLARE_TAG_API(Driverless_Sensor, DRIVERLESSTASK_API);
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessTelemetrySubsystem.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "DriverlessStats.h"
+#include "Debug/DebugDrawService.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "Engine/Font.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarTelemetry(
+	TEXT("Driverless.Telemetry"),
+	1,
+	TEXT("Shows the followers' telemetry overlay."));
+
+static TAutoConsoleVariable<float> CVarTelemetryRefreshHz(
+	TEXT("Driverless.TelemetryRefreshHz"),
+	10.0f,
+	TEXT("How many times per second the telemetry overlay gathers and formats the followers' state. The overlay is drawn every frame regardless."));
+
+static TAutoConsoleVariable<int32> CVarTelemetryRowsPerPage(
+	TEXT("Driverless.TelemetryRowsPerPage"),
+	20,
+	TEXT("Vehicles shown on a page of the telemetry overlay."));
+
+static TAutoConsoleVariable<int32> CVarTelemetryPage(
+	TEXT("Driverless.TelemetryPage"),
+	0,
+	TEXT("Page of the telemetry overlay to show (0 = first). Wraps around past the last page."));
+
+static TAutoConsoleVariable<int32> CVarTelemetrySort(
+	TEXT("Driverless.TelemetrySort"),
+	2,
+	TEXT("Order of the vehicles in the telemetry overlay. 0 = display index, 1 = speed, 2 = stuck/avoiding first, 3 = tick time."));
+
+namespace DriverlessTelemetry
+{
+	static const TCHAR* GetStateName(EFollowerTelemetryState State)
+	{
+		switch (State)
+		{
+		case EFollowerTelemetryState::Stuck: return TEXT("STUCK");
+		case EFollowerTelemetryState::Reversing: return TEXT("REVERSING");
+		case EFollowerTelemetryState::Recovering: return TEXT("RECOVERING");
+		case EFollowerTelemetryState::Kinematic: return TEXT("KINEMATIC");
+		default: return TEXT("NORMAL");
+		}
+	}
+
+	static FColor GetRowColor(const FFollowerTelemetry& Row)
+	{
+		switch (Row.State)
+		{
+		case EFollowerTelemetryState::Stuck: return FColor::Yellow;
+		case EFollowerTelemetryState::Reversing: return FColor::Red;
+		case EFollowerTelemetryState::Recovering: return FColor::Orange;
+		case EFollowerTelemetryState::Kinematic: return FColor::Silver;
+		default: return Row.bAvoiding ? FColor::Cyan : FColor::Green;
+		}
+	}
+
+	// lower comes first: recoveries, then avoidance, then everything else
+	static int32 GetAttentionRank(const FFollowerTelemetry& Row)
+	{
+		if (Row.State == EFollowerTelemetryState::Stuck || Row.State == EFollowerTelemetryState::Reversing || Row.State == EFollowerTelemetryState::Recovering)
+			return 0;
+		return Row.bAvoiding ? 1 : 2;
+	}
+}
+
+void UDriverlessTelemetrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Collection.InitializeDependency<UDriverlessVehicleSubsystem>();
+
+	DrawHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &UDriverlessTelemetrySubsystem::Draw));
+}
+
+void UDriverlessTelemetrySubsystem::Deinitialize()
+{
+	UDebugDrawService::Unregister(DrawHandle);
+	DrawHandle.Reset();
+	Super::Deinitialize();
+}
+
+void UDriverlessTelemetrySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (CVarTelemetry.GetValueOnGameThread() == 0)
+	{
+		VisibleRows.Reset();
+		return;
+	}
+
+	TimeSinceRefresh += DeltaTime;
+	const float RefreshPeriod = 1.0f / FMath::Max(CVarTelemetryRefreshHz.GetValueOnGameThread(), 0.1f);
+	if (TimeSinceRefresh < RefreshPeriod && VisibleRows.Num() > 0)
+		return;
+
+	TimeSinceRefresh = 0.0f;
+	Refresh();
+}
+
+TStatId UDriverlessTelemetrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDriverlessTelemetrySubsystem, STATGROUP_Tickables);
+}
+
+bool UDriverlessTelemetrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UDriverlessTelemetrySubsystem::Refresh()
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Telemetry);
+	LLM_SCOPE_BYTAG(Driverless_Debug);
+
+	const UDriverlessVehicleSubsystem* VehicleSubsystem = GetWorld()->GetSubsystem<UDriverlessVehicleSubsystem>();
+	if (!VehicleSubsystem) return;
+
+	// numbers only for every vehicle, it's cheap
+	Rows.Reset();
+	for (const TWeakObjectPtr<USplineFollowerComponent>& Follower : VehicleSubsystem->GetFollowers())
+	{
+		if (const USplineFollowerComponent* Component = Follower.Get())
+			Component->GetTelemetry(Rows.AddDefaulted_GetRef());
+	}
+
+	using namespace DriverlessTelemetry;
+	switch (CVarTelemetrySort.GetValueOnGameThread())
+	{
+	case 1:
+		Rows.Sort([](const FFollowerTelemetry& A, const FFollowerTelemetry& B) { return A.SpeedKmh > B.SpeedKmh; });
+		break;
+	case 2:
+		Rows.Sort([](const FFollowerTelemetry& A, const FFollowerTelemetry& B)
+		{
+			const int32 RankA = GetAttentionRank(A), RankB = GetAttentionRank(B);
+			return (RankA != RankB) ? RankA < RankB : A.DisplayIndex < B.DisplayIndex;
+		});
+		break;
+	case 3:
+		Rows.Sort([](const FFollowerTelemetry& A, const FFollowerTelemetry& B) { return A.TickTimeUs > B.TickTimeUs; });
+		break;
+	default:
+		Rows.Sort([](const FFollowerTelemetry& A, const FFollowerTelemetry& B) { return A.DisplayIndex < B.DisplayIndex; });
+		break;
+	}
+
+	const int32 RowsPerPage = FMath::Max(CVarTelemetryRowsPerPage.GetValueOnGameThread(), 1);
+	const int32 NumPages = FMath::Max(FMath::DivideAndRoundUp(Rows.Num(), RowsPerPage), 1);
+	const int32 Page = FMath::Abs(CVarTelemetryPage.GetValueOnGameThread()) % NumPages;
+
+	int32 NumStuck = 0, NumAvoiding = 0;
+	for (const FFollowerTelemetry& Row : Rows)
+	{
+		NumStuck += (GetAttentionRank(Row) == 0) ? 1 : 0;
+		NumAvoiding += Row.bAvoiding ? 1 : 0;
+	}
+
+	Header = FString::Printf(TEXT("DRIVERLESS  %d vehicles  %d stuck  %d avoiding  |  page %d/%d"), Rows.Num(), NumStuck, NumAvoiding, Page + 1, NumPages);
+
+	// strings only for the rows on screen
+	VisibleRows.Reset();
+	VisibleColors.Reset();
+	const int32 First = Page * RowsPerPage;
+	const int32 Last = FMath::Min(First + RowsPerPage, Rows.Num());
+	for (int32 i = First; i < Last; i++)
+	{
+		const FFollowerTelemetry& Row = Rows[i];
+
+		const FString State = (Row.StateDuration > 0.0f)
+			? FString::Printf(TEXT("%s %.1f/%.1f"), GetStateName(Row.State), Row.StateTime, Row.StateDuration)
+			: FString(GetStateName(Row.State));
+		const FString Avoid = Row.bAvoiding ? FString::Printf(TEXT("AVOID %+.0f deg"), Row.AvoidanceAngle) : FString();
+
+		VisibleRows.Add(FString::Printf(TEXT("#%-3d %-20s %6.1f km/h  steer %+.2f  thr %.2f  brk %.2f  %5.0f us  %s"),
+			Row.DisplayIndex, *State, Row.SpeedKmh, Row.Steering, Row.Throttle, Row.Brake, Row.TickTimeUs, *Avoid));
+		VisibleColors.Add(GetRowColor(Row));
+	}
+}
+
+void UDriverlessTelemetrySubsystem::Draw(UCanvas* Canvas, APlayerController* PlayerController)
+{
+	// the draw service is shared by every world, only draw into our own viewports
+	if (!Canvas || !GEngine || !PlayerController || PlayerController->GetWorld() != GetWorld())
+		return;
+
+	if (CVarTelemetry.GetValueOnGameThread() == 0 || VisibleRows.Num() == 0)
+		return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Telemetry);
+
+	UFont* Font = GEngine->GetSmallFont();
+	const float LineHeight = Font->GetMaxCharHeight() + 2.0f;
+	const FFontRenderInfo RenderInfo = Canvas->CreateFontRenderInfo(false, true);
+
+	float Y = 50.0f;
+	const float X = 20.0f;
+
+	Canvas->SetDrawColor(FColor::White);
+	Canvas->DrawText(Font, Header, X, Y, 1.0f, 1.0f, RenderInfo);
+	Y += LineHeight;
+
+	for (int32 i = 0; i < VisibleRows.Num(); i++)
+	{
+		Canvas->SetDrawColor(VisibleColors[i]);
+		Canvas->DrawText(Font, VisibleRows[i], X, Y, 1.0f, 1.0f, RenderInfo);
+		Y += LineHeight;
+	}
+}
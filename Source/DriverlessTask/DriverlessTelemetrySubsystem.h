@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "DriverlessTelemetrySubsystem.generated.h"
+
+class UCanvas;
+class APlayerController;
+class USplineFollowerComponent;
+
+enum class EFollowerTelemetryState : uint8
+{
+	Normal,
+	Stuck,
+	Reversing,
+	Recovering,
+	Kinematic,
+};
+
+// what a follower reports to the overlay, numbers only
+struct FFollowerTelemetry
+{
+	int32 DisplayIndex = 0;
+	EFollowerTelemetryState State = EFollowerTelemetryState::Normal;
+	float StateTime = 0.0f; // seconds spent in the current stuck/recovery phase
+	float StateDuration = 0.0f; // length of that phase
+	float SpeedKmh = 0.0f;
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+	bool bAvoiding = false;
+	float AvoidanceAngle = 0.0f;
+	float TickTimeUs = 0.0f;
+};
+
+/**
+ * Telemetry of every follower in a single overlay.
+ * At a throttled rate it pulls the numeric state of all the followers, sorts them and formats only the rows
+ * of the visible page; every frame it just draws those rows on the game canvas.
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessTelemetrySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void Refresh();
+	void Draw(UCanvas* Canvas, APlayerController* PlayerController);
+
+	FDelegateHandle DrawHandle;
+	float TimeSinceRefresh = 0.0f;
+
+	// gathered telemetry and the formatted rows of the visible page
+	TArray<FFollowerTelemetry> Rows;
+	FString Header;
+	TArray<FString> VisibleRows;
+	TArray<FColor> VisibleColors;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessTrackDataCommandlet.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Components/SplineComponent.h"
+#include "LandscapeSplineActor.h"
+#include "LandscapeSplinesComponent.h"
+#include "DriverlessBenchCommandlet.h"
+#include "DriverlessTrackSubsystem.h"
+#include "TrackDataAsset.h"
+#include "TrackTable.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDriverlessTrackData, Log, All);
+
+UDriverlessTrackDataCommandlet::UDriverlessTrackDataCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UDriverlessTrackDataCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/FirstLevel");
+	FString TrackFilter;
+	FParse::Value(*Params, TEXT("map="), MapName);
+	FParse::Value(*Params, TEXT("track="), TrackFilter);
+
+	UWorld* World = UDriverlessBenchCommandlet::LoadWorld(MapName);
+	UDriverlessTrackSubsystem* TrackSubsystem = World ? World->GetSubsystem<UDriverlessTrackSubsystem>() : nullptr;
+	if (!TrackSubsystem)
+	{
+		UE_LOG(LogDriverlessTrackData, Error, TEXT("Unable to load map '%s'."), *MapName);
+		return 1;
+	}
+
+	int32 NumSaved = 0;
+	int32 NumFailed = 0;
+
+	for (TActorIterator<ALandscapeSplineActor> It(World); It; ++It)
+	{
+		const FString TrackName = It->GetName();
+		if (!TrackFilter.IsEmpty() && !TrackName.Contains(TrackFilter))
+			continue;
+
+		ULandscapeSplinesComponent* LandscapeSplines = It->GetSplinesComponent();
+		if (!LandscapeSplines) continue;
+
+		// what every follower did at startup before: convert, resample, trace the walls
+		const double StartTime = FPlatformTime::Seconds();
+		USplineComponent* Spline = NewObject<USplineComponent>(*It);
+		Spline->RegisterComponentWithWorld(World);
+		LandscapeSplines->CopyToSplineComponent(Spline);
+
+		if (Spline->GetNumberOfSplinePoints() < 2)
+		{
+			UE_LOG(LogDriverlessTrackData, Warning, TEXT("Unable to convert '%s' to a spline, skipped."), *TrackName);
+			continue;
+		}
+
+		const TSharedRef<FTrackTable> Table = TrackSubsystem->BuildTrackData(*It, *Spline);
+		const double BuildTime = FPlatformTime::Seconds() - StartTime;
+
+		const FString PackageName = UDriverlessTrackSubsystem::GetTrackDataPackageName(*It);
+		UTrackDataAsset* Asset = UDriverlessBenchCommandlet::FindOrCreateAsset<UTrackDataAsset>(PackageName);
+		Asset->SetFromTable(TrackName, UDriverlessTrackSubsystem::HashTrackSource(*It), *Table);
+
+		if (!UDriverlessBenchCommandlet::SaveAsset(*Asset))
+		{
+			UE_LOG(LogDriverlessTrackData, Error, TEXT("Unable to save '%s'."), *PackageName);
+			NumFailed++;
+			continue;
+		}
+
+		UE_LOG(LogDriverlessTrackData, Display, TEXT("Saved %s: %d samples, %.0f m%s, %d x %d index cells, %.1f KB, built in %.1f ms."),
+			*PackageName, Table->Num(), Table->Length / 100.0f, Table->bClosedLoop ? TEXT(" loop") : TEXT(""),
+			Table->IndexSizeX, Table->IndexSizeY, Table->GetAllocatedSize() / 1024.0f, BuildTime * 1000.0);
+		NumSaved++;
+	}
+
+	World->RemoveFromRoot();
+
+	if (NumSaved == 0 && NumFailed == 0)
+	{
+		UE_LOG(LogDriverlessTrackData, Error, TEXT("No landscape spline track found in '%s'."), *MapName);
+		return 1;
+	}
+	return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DriverlessTrackDataCommandlet.generated.h"
+
+/**
+ * Bakes the track table of every landscape spline track of a map (samples, curvature, speed profile, boundaries and
+ * spatial index) into a UTrackDataAsset per track, which the track subsystem loads instead of converting the spline,
+ * resampling it and tracing the walls at startup.
+ *
+ *   UnrealEditor-Cmd DriverlessTask.uproject -run=DriverlessTrackData [-map=/Game/FirstLevel] [-track=<substring>]
+ *
+ * Assets are saved to Driverless.TrackDataPath as TD_<Map>_<Track> and overwritten on every run, at the current
+ * Driverless.TrackSampleSpacing and Driverless.TrackBoundaryRange. A track whose spline was edited since is built
+ * at runtime again, with a warning, until it's baked again. Moved walls are not detected.
+ */
+UCLASS()
+class UDriverlessTrackDataCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDriverlessTrackDataCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,457 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessTrackSubsystem.h"
+#include "ObstacleSpawnerActor.h"
+#include "RacingLineAsset.h"
+#include "TrackDataAsset.h"
+#include "Components/SplineComponent.h"
+#include "LandscapeSplineActor.h"
+#include "LandscapeSplinesComponent.h"
+#include "LandscapeSplineSegment.h"
+#include "LandscapeSplineControlPoint.h"
+#include "Misc/PackageName.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "CollisionQueryParams.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "DriverlessStats.h"
+
+// resolution of the track tables (cm between samples)
+static TAutoConsoleVariable<float> CVarTrackSampleSpacing(
+	TEXT("Driverless.TrackSampleSpacing"),
+	100.0f,
+	TEXT("Distance (cm) between two samples of a track table. Only affects tracks built after the change."));
+
+static TAutoConsoleVariable<float> CVarTrackBoundaryRange(
+	TEXT("Driverless.TrackBoundaryRange"),
+	1500.0f,
+	TEXT("How far (cm) from the centerline the edges and walls of a track are looked for. Only affects tracks built after the change."));
+
+static TAutoConsoleVariable<float> CVarTrackIndexCellSize(
+	TEXT("Driverless.TrackIndexCellSize"),
+	2000.0f,
+	TEXT("Size (cm) of a cell of the spatial index of the track tables. Only affects tracks built after the change."));
+
+static TAutoConsoleVariable<bool> CVarUseTrackData(
+	TEXT("Driverless.UseTrackData"),
+	true,
+	TEXT("Load the track tables baked by the DriverlessTrackData commandlet instead of building them from the splines."));
+
+static TAutoConsoleVariable<FString> CVarTrackDataPath(
+	TEXT("Driverless.TrackDataPath"),
+	TEXT("/Game/TrackData"),
+	TEXT("Content folder of the baked track data."));
+
+static TAutoConsoleVariable<float> CVarOccupancyCellSize(
+	TEXT("Driverless.OccupancyCellSize"),
+	25.0f,
+	TEXT("Size (cm) of a cell of the track occupancy grids. Only affects grids built after the change."));
+
+static TAutoConsoleVariable<float> CVarOccupancyHalfWidth(
+	TEXT("Driverless.OccupancyHalfWidth"),
+	1500.0f,
+	TEXT("How far (cm) the track occupancy grids reach on each side of the centerline. Only affects grids built after the change."));
+
+namespace
+{
+	// height above the centerline the walls are traced at, low enough for kerbs and barriers
+	constexpr float WallTraceHeight = 50.0f;
+	// a hit facing up this much is the road rising (banking, a crest), not a wall
+	constexpr float MaxWallNormalZ = 0.7f;
+}
+
+TSharedPtr<const FTrackTable> UDriverlessTrackSubsystem::GetTrackTable(const AActor* TrackActor, const USplineComponent* Spline)
+{
+	if (!TrackActor)
+		return nullptr;
+
+	if (const TSharedPtr<const FTrackTable>* Existing = TrackTables.Find(TrackActor))
+		return *Existing;
+
+	if (const TSharedPtr<const FTrackTable> Baked = GetBakedTrackTable(TrackActor))
+		return Baked;
+
+	if (!Spline || Spline->GetNumberOfSplinePoints() < 2)
+		return nullptr;
+
+	LLM_SCOPE_BYTAG(Driverless_Track);
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_TrackSetup);
+
+	const TSharedRef<FTrackTable> Table = BuildTrackData(TrackActor, *Spline);
+	TrackTables.Add(TrackActor, Table);
+
+	UE_LOG(LogTemp, Log, TEXT("DriverlessTrackSubsystem: built track table for '%s' (%d samples, %.0f m%s)."),
+		*TrackActor->GetName(), Table->Num(), Table->Length / 100.0f, Table->bClosedLoop ? TEXT(", loop") : TEXT(""));
+
+	return Table;
+}
+
+TSharedPtr<const FTrackTable> UDriverlessTrackSubsystem::GetBakedTrackTable(const AActor* TrackActor)
+{
+	if (!TrackActor || UnbakedTracks.Contains(TrackActor))
+		return nullptr;
+
+	// every table built at runtime was looked for first, so what's here was baked
+	if (const TSharedPtr<const FTrackTable>* Existing = TrackTables.Find(TrackActor))
+		return *Existing;
+
+	if (!CVarUseTrackData.GetValueOnGameThread())
+	{
+		UnbakedTracks.Add(TrackActor);
+		return nullptr;
+	}
+
+	LLM_SCOPE_BYTAG(Driverless_Track);
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_TrackSetup);
+
+	const FString PackageName = GetTrackDataPackageName(TrackActor);
+	const UTrackDataAsset* TrackData = FPackageName::DoesPackageExist(PackageName)
+		? LoadObject<UTrackDataAsset>(nullptr, *(PackageName + TEXT(".") + FPackageName::GetShortName(PackageName)))
+		: nullptr;
+	if (!TrackData)
+	{
+		UnbakedTracks.Add(TrackActor);
+		return nullptr;
+	}
+
+	const FString StaleReason = TrackData->GetStaleReason(TrackActor, HashTrackSource(TrackActor),
+		CVarTrackSampleSpacing.GetValueOnGameThread(), CVarTrackBoundaryRange.GetValueOnGameThread());
+	if (!StaleReason.IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("DriverlessTrackSubsystem: track data '%s' is stale (%s), building the table of '%s' from its spline. Run the DriverlessTrackData commandlet again."),
+			*PackageName, *StaleReason, *TrackActor->GetName());
+		UnbakedTracks.Add(TrackActor);
+		return nullptr;
+	}
+
+	const TSharedRef<FTrackTable> Table = TrackData->BuildTable();
+	TrackTables.Add(TrackActor, Table);
+
+	UE_LOG(LogTemp, Log, TEXT("DriverlessTrackSubsystem: loaded track table for '%s' from '%s' (%d samples, %.0f m%s)."),
+		*TrackActor->GetName(), *PackageName, Table->Num(), Table->Length / 100.0f, Table->bClosedLoop ? TEXT(", loop") : TEXT(""));
+
+	return Table;
+}
+
+TSharedRef<FTrackTable> UDriverlessTrackSubsystem::BuildTrackData(const AActor* TrackActor, const USplineComponent& Spline) const
+{
+	const TSharedRef<FTrackTable> Table = BuildTrackTable(Spline, CVarTrackSampleSpacing.GetValueOnGameThread());
+	BuildBoundaries(*Table, TrackActor);
+	Table->BuildSpatialIndex(CVarTrackIndexCellSize.GetValueOnGameThread());
+	return Table;
+}
+
+uint32 UDriverlessTrackSubsystem::HashTrackSource(const AActor* TrackActor)
+{
+	uint32 Hash = 0;
+	auto HashValue = [&Hash](const auto& Value) { Hash = FCrc::MemCrc32(&Value, sizeof(Value), Hash); };
+
+	// a landscape spline is converted from its control points and the tangents of the segments between them
+	if (const ALandscapeSplineActor* LandscapeActor = Cast<ALandscapeSplineActor>(TrackActor))
+	{
+		const ULandscapeSplinesComponent* LandscapeSplines = LandscapeActor->GetSplinesComponent();
+		if (!LandscapeSplines)
+			return Hash;
+
+		HashValue(LandscapeSplines->GetComponentTransform().ToMatrixWithScale());
+
+		const TArray<TObjectPtr<ULandscapeSplineControlPoint>>& ControlPoints = LandscapeSplines->GetControlPoints();
+		for (const ULandscapeSplineControlPoint* ControlPoint : ControlPoints)
+		{
+			if (!ControlPoint) continue;
+
+			HashValue(ControlPoint->Location);
+			HashValue(ControlPoint->Rotation);
+			HashValue(ControlPoint->Width);
+		}
+
+		for (const ULandscapeSplineSegment* Segment : LandscapeSplines->GetSegments())
+		{
+			if (!Segment) continue;
+
+			for (const FLandscapeSplineSegmentConnection& Connection : Segment->Connections)
+			{
+				HashValue(ControlPoints.IndexOfByKey(Connection.ControlPoint));
+				HashValue(Connection.TangentLen);
+			}
+		}
+		return Hash;
+	}
+
+	if (const USplineComponent* Spline = TrackActor ? TrackActor->FindComponentByClass<USplineComponent>() : nullptr)
+	{
+		HashValue(Spline->GetComponentTransform().ToMatrixWithScale());
+		HashValue(Spline->IsClosedLoop());
+
+		for (int32 i = 0; i < Spline->GetNumberOfSplinePoints(); i++)
+		{
+			HashValue(Spline->GetLocationAtSplinePoint(i, ESplineCoordinateSpace::Local));
+			HashValue(Spline->GetArriveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local));
+			HashValue(Spline->GetLeaveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local));
+			HashValue((uint8)Spline->GetSplinePointType(i));
+		}
+	}
+	return Hash;
+}
+
+FString UDriverlessTrackSubsystem::GetTrackDataPackageName(const AActor* TrackActor)
+{
+	const UWorld* World = TrackActor ? TrackActor->GetWorld() : nullptr;
+	const FString MapName = World ? UWorld::RemovePIEPrefix(World->GetMapName()) : FString();
+	return CVarTrackDataPath.GetValueOnGameThread() / FString::Printf(TEXT("TD_%s_%s"), *MapName, TrackActor ? *TrackActor->GetName() : TEXT(""));
+}
+
+TSharedPtr<const FTrackTable> UDriverlessTrackSubsystem::GetRacingLineTable(const URacingLineAsset* RacingLine)
+{
+	if (!RacingLine || RacingLine->Locations.Num() < 2)
+		return nullptr;
+
+	if (const TSharedPtr<const FTrackTable>* Existing = RacingLineTables.Find(RacingLine))
+		return *Existing;
+
+	LLM_SCOPE_BYTAG(Driverless_Track);
+
+	const TSharedRef<FTrackTable> Table = RacingLine->BuildTable();
+	RacingLineTables.Add(RacingLine, Table);
+	return Table;
+}
+
+void UDriverlessTrackSubsystem::BuildBoundaries(FTrackTable& Table, const AActor* TrackActor) const
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_TrackBoundaries);
+
+	const float Range = CVarTrackBoundaryRange.GetValueOnGameThread();
+	Table.InitBoundaries(Range);
+
+	// the road of a landscape spline: the edges of its mesh, as the spline's width lays them out
+	if (const ALandscapeSplineActor* LandscapeActor = Cast<ALandscapeSplineActor>(TrackActor))
+	{
+		if (const ULandscapeSplinesComponent* LandscapeSplines = LandscapeActor->GetSplinesComponent())
+		{
+			const FTransform& Transform = LandscapeSplines->GetComponentTransform();
+
+			TArray<FVector> EdgePoints;
+			for (const ULandscapeSplineSegment* Segment : LandscapeSplines->GetSegments())
+			{
+				if (!Segment) continue;
+
+				for (const FLandscapeSplineInterpPoint& Point : Segment->GetPoints())
+				{
+					EdgePoints.Add(Transform.TransformPosition(Point.Left));
+					EdgePoints.Add(Transform.TransformPosition(Point.Right));
+				}
+			}
+			Table.SetBoundariesFromEdges(EdgePoints);
+		}
+	}
+
+	// the walls: static geometry across the track at every sample, where it's closer than the edges.
+	// Each sample only writes its own entries, so the traces run in parallel
+	const UWorld* World = GetWorld();
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(TrackWalls), false);
+
+	ParallelFor(TEXT("TrackWalls"), Table.Num(), 64, [&](int32 i)
+	{
+		const FVector Center = Table.Locations[i] + FVector::UpVector * WallTraceHeight;
+		const FVector Right = FVector::CrossProduct(FVector::UpVector, Table.Directions[i]).GetSafeNormal();
+
+		auto TraceWall = [&](float Offset)
+		{
+			FHitResult Hit;
+			if (World->LineTraceSingleByObjectType(Hit, Center, Center + Right * Offset, ObjectParams, QueryParams)
+				&& !Hit.bStartPenetrating && Hit.ImpactNormal.Z < MaxWallNormalZ)
+				return FMath::Sign(Offset) * (float)Hit.Distance;
+			return Offset;
+		};
+
+		Table.LeftBoundary[i] = TraceWall(Table.LeftBoundary[i]);
+		Table.RightBoundary[i] = TraceWall(Table.RightBoundary[i]);
+	});
+}
+
+TSharedRef<FTrackTable> UDriverlessTrackSubsystem::BuildTrackTable(const USplineComponent& Spline, float SampleSpacing)
+{
+	const float SplineLength = Spline.GetSplineLength();
+	const int32 NumSamples = FMath::Max(2, FMath::CeilToInt32(SplineLength / FMath::Max(SampleSpacing, 1.0f)) + 1);
+
+	// spacing is stretched a little so the last sample lands exactly at the end of the spline
+	const float Spacing = SplineLength / (NumSamples - 1);
+
+	TArray<FVector> Locations, Directions, Tangents;
+	Locations.SetNumUninitialized(NumSamples);
+	Directions.SetNumUninitialized(NumSamples);
+	Tangents.SetNumUninitialized(NumSamples);
+	for (int32 i = 0; i < NumSamples; i++)
+	{
+		const float Distance = i * Spacing;
+		Locations[i] = Spline.GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+		Directions[i] = Spline.GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+		Tangents[i] = Spline.GetTangentAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+	}
+
+	return FTrackTable::BuildFromSamples(MoveTemp(Locations), MoveTemp(Directions), MoveTemp(Tangents), Spacing, Spline.IsClosedLoop());
+}
+
+TSharedPtr<const FTrackOccupancyGrid> UDriverlessTrackSubsystem::GetOccupancyGrid(const AActor* TrackActor)
+{
+	if (!TrackActor)
+		return nullptr;
+
+	if (const FTrackGrid* Existing = OccupancyGrids.Find(TrackActor))
+		return Existing->Grid;
+
+	const TSharedPtr<const FTrackTable>* Table = TrackTables.Find(TrackActor);
+	if (!Table || !(*Table)->IsValid())
+		return nullptr;
+
+	LLM_SCOPE_BYTAG(Driverless_Track);
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_OccupancyGrid);
+
+	FTrackGrid& TrackGrid = OccupancyGrids.Add(TrackActor);
+	TrackGrid.Table = *Table;
+	TrackGrid.Grid = MakeShared<FTrackOccupancyGrid>();
+	TrackGrid.Grid->Init((*Table)->Length, (*Table)->bClosedLoop, CVarOccupancyHalfWidth.GetValueOnGameThread(), CVarOccupancyCellSize.GetValueOnGameThread());
+
+	for (TActorIterator<AObstacleSpawnerActor> It(GetWorld()); It; ++It)
+	{
+		if (It->GetTrackSplineActor() == TrackActor)
+			TrackGrid.Spawners.Add(*It);
+	}
+
+	RasterizeWalls(TrackGrid);
+	SyncCones(TrackGrid);
+
+	UE_LOG(LogTemp, Log, TEXT("DriverlessTrackSubsystem: built occupancy grid for '%s' (%d x %d cells, %d cones, %llu KB)."),
+		*TrackActor->GetName(), TrackGrid.Grid->GetNumRows(), TrackGrid.Grid->GetNumCols(), TrackGrid.Cones.Num(), (uint64)(TrackGrid.Grid->GetAllocatedSize() / 1024));
+
+	return TrackGrid.Grid;
+}
+
+SIZE_T UDriverlessTrackSubsystem::GetOccupancyGridSize(const AActor* TrackActor) const
+{
+	const FTrackGrid* TrackGrid = OccupancyGrids.Find(TrackActor);
+	if (!TrackGrid)
+		return 0;
+
+	return sizeof(FTrackOccupancyGrid) + TrackGrid->Grid->GetAllocatedSize()
+		+ TrackGrid->Spawners.GetAllocatedSize() + TrackGrid->Cones.GetAllocatedSize() + TrackGrid->ConeLocations.GetAllocatedSize();
+}
+
+void UDriverlessTrackSubsystem::RasterizeWalls(FTrackGrid& TrackGrid)
+{
+	FTrackOccupancyGrid& Grid = *TrackGrid.Grid;
+	const FTrackTable& Table = *TrackGrid.Table;
+	const float HalfWidth = Grid.GetHalfWidth();
+	const float NoWall = HalfWidth + Grid.GetCellSize();
+
+	// the boundaries of the table are the walls, the cells past them are occupied. A side left unbounded stays open
+	for (int32 Row = 0; Row < Grid.GetNumRows(); Row++)
+	{
+		const FVector2D Boundaries = Table.HasBoundaries() ? Table.GetBoundariesAtDistance(Grid.GetRowS(Row)) : FVector2D(-NoWall, NoWall);
+		const float LeftWall = (Boundaries.X > -Table.BoundaryRange) ? Boundaries.X : -NoWall;
+		const float RightWall = (Boundaries.Y < Table.BoundaryRange) ? Boundaries.Y : NoWall;
+		Grid.SetRowWalls(Row, LeftWall, RightWall);
+	}
+}
+
+void UDriverlessTrackSubsystem::SyncCones(FTrackGrid& TrackGrid)
+{
+	FTrackOccupancyGrid& Grid = *TrackGrid.Grid;
+	const FTrackTable& Table = *TrackGrid.Table;
+
+	Grid.ClearObstacles();
+	TrackGrid.Cones.Reset();
+	TrackGrid.ConeLocations.Reset();
+
+	for (const TWeakObjectPtr<AObstacleSpawnerActor>& Spawner : TrackGrid.Spawners)
+	{
+		if (!Spawner.IsValid()) continue;
+
+		for (AActor* Cone : Spawner->GetSpawnedObstacles())
+		{
+			if (!IsValid(Cone)) continue;
+
+			float Radius, HalfHeight;
+			Cone->GetSimpleCollisionCylinder(Radius, HalfHeight);
+
+			const FVector Location = Cone->GetActorLocation();
+			const FVector2D TrackCoordinates = Table.GetTrackCoordinates(Location);
+			Grid.AddObstacle(TrackCoordinates.X, TrackCoordinates.Y, Radius);
+
+			TrackGrid.Cones.Add(Cone);
+			TrackGrid.ConeLocations.Add(Location);
+		}
+	}
+}
+
+int32 UDriverlessTrackSubsystem::CountCones(const FTrackGrid& TrackGrid)
+{
+	int32 NumCones = 0;
+	for (const TWeakObjectPtr<AObstacleSpawnerActor>& Spawner : TrackGrid.Spawners)
+	{
+		if (!Spawner.IsValid()) continue;
+
+		for (const AActor* Cone : Spawner->GetSpawnedObstacles())
+			NumCones += IsValid(Cone) ? 1 : 0;
+	}
+	return NumCones;
+}
+
+void UDriverlessTrackSubsystem::Tick(float DeltaTime)
+{
+	if (OccupancyGrids.Num() == 0) return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_OccupancyGrid);
+	LLM_SCOPE_BYTAG(Driverless_Track);
+
+	int32 NumMoved = 0;
+	for (TPair<TObjectKey<AActor>, FTrackGrid>& Pair : OccupancyGrids)
+	{
+		FTrackGrid& TrackGrid = Pair.Value;
+		FTrackOccupancyGrid& Grid = *TrackGrid.Grid;
+
+		// cones respawned or destroyed: start over, it doesn't happen during a run
+		bool bResync = CountCones(TrackGrid) != TrackGrid.Cones.Num();
+		for (int32 i = 0; i < TrackGrid.Cones.Num() && !bResync; i++)
+			bResync = !TrackGrid.Cones[i].IsValid();
+
+		if (bResync)
+		{
+			SyncCones(TrackGrid);
+			continue;
+		}
+
+		// cones knocked over or pushed along: only the ones that moved by half a cell are rewritten
+		const float MoveThresholdSquared = FMath::Square(0.5f * Grid.GetCellSize());
+		for (int32 i = 0; i < TrackGrid.Cones.Num(); i++)
+		{
+			const FVector Location = TrackGrid.Cones[i]->GetActorLocation();
+			if (FVector::DistSquared(Location, TrackGrid.ConeLocations[i]) < MoveThresholdSquared)
+				continue;
+
+			const FVector2D TrackCoordinates = TrackGrid.Table->GetTrackCoordinates(Location, Grid.GetObstacleLocation(i).X);
+			Grid.MoveObstacle(i, TrackCoordinates.X, TrackCoordinates.Y);
+			TrackGrid.ConeLocations[i] = Location;
+			NumMoved++;
+		}
+	}
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_GridObstaclesMoved, DriverlessGridObstaclesMoved, NumMoved);
+}
+
+TStatId UDriverlessTrackSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDriverlessTrackSubsystem, STATGROUP_Tickables);
+}
+
+void UDriverlessTrackSubsystem::Deinitialize()
+{
+	OccupancyGrids.Empty();
+	TrackTables.Empty();
+	UnbakedTracks.Empty();
+	RacingLineTables.Empty();
+	Super::Deinitialize();
+}
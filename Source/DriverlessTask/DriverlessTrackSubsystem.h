@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "TrackTable.h"
+#include "TrackOccupancyGrid.h"
+#include "DriverlessTrackSubsystem.generated.h"
+
+class USplineComponent;
+class AObstacleSpawnerActor;
+class URacingLineAsset;
+class UTrackDataAsset;
+
+/**
+ * Owns the per-track data shared by every vehicle and spawner on the same track,
+ * so it's built once per track instead of once per vehicle.
+ * Ticks to keep the occupancy grids in step with the cones they hold.
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessTrackSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// track table of TrackActor, loaded from its baked track data the first time it's requested, or built from Spline
+	// when there is none (or it's stale). Spline can be null for a track known to be baked, see GetBakedTrackTable
+	TSharedPtr<const FTrackTable> GetTrackTable(const AActor* TrackActor, const USplineComponent* Spline = nullptr);
+
+	// track table of TrackActor from the asset baked by the DriverlessTrackData commandlet. Null, without building anything,
+	// when there is no asset or it no longer matches the track
+	TSharedPtr<const FTrackTable> GetBakedTrackTable(const AActor* TrackActor);
+
+	const TMap<TObjectKey<AActor>, TSharedPtr<const FTrackTable>>& GetTrackTables() const { return TrackTables; }
+
+	// samples the spline every SampleSpacing cm (world space) into a new track table
+	static TSharedRef<FTrackTable> BuildTrackTable(const USplineComponent& Spline, float SampleSpacing);
+
+	// the complete table of TrackActor from Spline, at the current settings: samples, boundaries and spatial index.
+	// Not cached, it's what GetTrackTable builds and what the track data is baked from
+	TSharedRef<FTrackTable> BuildTrackData(const AActor* TrackActor, const USplineComponent& Spline) const;
+
+	// hash of what the table of TrackActor is built from: the control points of a landscape spline, or the points of its spline.
+	// The walls are not part of it
+	static uint32 HashTrackSource(const AActor* TrackActor);
+
+	// package the track data of TrackActor is baked to: <Driverless.TrackDataPath>/TD_<Map>_<Actor>
+	static FString GetTrackDataPackageName(const AActor* TrackActor);
+
+	// track table of an optimized racing line, built from the asset the first time it's requested
+	TSharedPtr<const FTrackTable> GetRacingLineTable(const URacingLineAsset* RacingLine);
+
+	// occupancy grid of TrackActor, built from its track table the first time it's requested (null before the table exists).
+	// The walls are the boundaries of the table, the obstacles are the cones of the spawners on it and follow them as they move
+	TSharedPtr<const FTrackOccupancyGrid> GetOccupancyGrid(const AActor* TrackActor);
+
+	SIZE_T GetOccupancyGridSize(const AActor* TrackActor) const;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+private:
+	struct FTrackGrid
+	{
+		TSharedPtr<FTrackOccupancyGrid> Grid;
+		TSharedPtr<const FTrackTable> Table;
+		TArray<TWeakObjectPtr<AObstacleSpawnerActor>> Spawners;
+
+		// actor of each obstacle of the grid, and where it was when last written to the grid
+		TArray<TWeakObjectPtr<AActor>> Cones;
+		TArray<FVector> ConeLocations;
+	};
+
+	void BuildBoundaries(FTrackTable& Table, const AActor* TrackActor) const;
+	static void RasterizeWalls(FTrackGrid& TrackGrid);
+	// puts the cones of the spawners back into the grid from scratch, e.g. after a respawn
+	static void SyncCones(FTrackGrid& TrackGrid);
+	static int32 CountCones(const FTrackGrid& TrackGrid);
+
+	TMap<TObjectKey<AActor>, TSharedPtr<const FTrackTable>> TrackTables;
+	// tracks whose track data was looked for and not usable, so the next vehicles don't look again
+	TSet<TObjectKey<AActor>> UnbakedTracks;
+	TMap<TObjectKey<URacingLineAsset>, TSharedPtr<const FTrackTable>> RacingLineTables;
+	TMap<TObjectKey<AActor>, FTrackGrid> OccupancyGrids;
+};
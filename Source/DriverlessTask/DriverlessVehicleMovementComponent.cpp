@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessVehicleMovementComponent.h"
+#include "Engine/World.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PBDRigidsSolver.h"
+#include "FollowerPhysicsCallback.h"
+
+void FDriverlessVehicleSimulation::ApplyInput(const FControlInputs& ControlInputs, float DeltaTime)
+{
+	// the state of this step was captured before the inputs are applied. While the follower drives from the game thread
+	// (stuck, recovering) the control computes nothing and its inputs go through
+	FFollowerControlOutput Commands;
+	if (FollowerControl && FollowerControl->ComputeCommands(VehicleState.VehicleWorldTransform, Commands))
+	{
+		FControlInputs FollowerInputs = ControlInputs;
+		FollowerInputs.SteeringInput = Commands.Steering;
+		FollowerInputs.ThrottleInput = Commands.Throttle;
+		FollowerInputs.BrakeInput = Commands.Brake;
+		FChaosWheeledVehicleSimulation::ApplyInput(FollowerInputs, DeltaTime);
+		return;
+	}
+
+	FChaosWheeledVehicleSimulation::ApplyInput(ControlInputs, DeltaTime);
+}
+
+void UDriverlessVehicleMovementComponent::SetFollowerControl(const TSharedPtr<FFollowerPhysicsControl, ESPMode::ThreadSafe>& Control)
+{
+	FollowerControl = Control;
+
+	FPhysScene* PhysScene = GetWorld() ? GetWorld()->GetPhysicsScene() : nullptr;
+	Chaos::FPhysicsSolver* Solver = PhysScene ? PhysScene->GetSolver() : nullptr;
+	if (!VehicleSimulationPT || !Solver)
+		return;
+
+	// the simulation is read on the physics thread, it only changes there. It's looked up when the command runs, the
+	// physics state may have been recreated since
+	Solver->EnqueueCommandImmediate([WeakThis = TWeakObjectPtr<UDriverlessVehicleMovementComponent>(this), Control]()
+	{
+		UDriverlessVehicleMovementComponent* Movement = WeakThis.Get();
+		if (FDriverlessVehicleSimulation* Simulation = Movement ? static_cast<FDriverlessVehicleSimulation*>(Movement->VehicleSimulationPT.Get()) : nullptr)
+			Simulation->FollowerControl = Control;
+	});
+}
+
+TUniquePtr<Chaos::FSimpleWheeledVehicle> UDriverlessVehicleMovementComponent::CreatePhysicsVehicle()
+{
+	// as UChaosWheeledVehicleMovementComponent, with our simulation
+	TUniquePtr<FDriverlessVehicleSimulation> Simulation = MakeUnique<FDriverlessVehicleSimulation>();
+	Simulation->FollowerControl = FollowerControl;
+	VehicleSimulationPT = MoveTemp(Simulation);
+
+	return UChaosVehicleMovementComponent::CreatePhysicsVehicle();
+}
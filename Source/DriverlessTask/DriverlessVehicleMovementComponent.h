@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChaosWheeledVehicleMovementComponent.h"
+#include "DriverlessVehicleMovementComponent.generated.h"
+
+class FFollowerPhysicsControl;
+
+// wheeled vehicle simulation whose inputs, when a follower controls it from the physics thread, are the commands computed
+// at the same step from the pose of that step
+class FDriverlessVehicleSimulation : public FChaosWheeledVehicleSimulation
+{
+public:
+	virtual void ApplyInput(const FControlInputs& ControlInputs, float DeltaTime) override;
+
+	// physics thread only
+	TSharedPtr<FFollowerPhysicsControl, ESPMode::ThreadSafe> FollowerControl;
+};
+
+/**
+ * Wheeled vehicle movement that lets a follower's control law drive it from within the physics step
+ * (USplineFollowerComponent's "Run Control On Physics Thread"). Without a follower on the physics thread it's a plain
+ * UChaosWheeledVehicleMovementComponent. ADriverlessVehiclePawn uses it, vehicle Blueprints get it by being reparented to it.
+ */
+UCLASS(ClassGroup = (Physics), meta = (BlueprintSpawnableComponent))
+class DRIVERLESSTASK_API UDriverlessVehicleMovementComponent : public UChaosWheeledVehicleMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	// hands the control to the simulation, on the physics thread before its next step. Null gives the inputs back to the game thread
+	void SetFollowerControl(const TSharedPtr<FFollowerPhysicsControl, ESPMode::ThreadSafe>& Control);
+
+protected:
+	virtual TUniquePtr<Chaos::FSimpleWheeledVehicle> CreatePhysicsVehicle() override;
+
+private:
+	// kept for a simulation created later, e.g. when the physics state is recreated
+	TSharedPtr<FFollowerPhysicsControl, ESPMode::ThreadSafe> FollowerControl;
+};
@@ -0,0 +1,10 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessVehiclePawn.h"
+#include "DriverlessVehicleMovementComponent.h"
+
+ADriverlessVehiclePawn::ADriverlessVehiclePawn(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UDriverlessVehicleMovementComponent>(AWheeledVehiclePawn::VehicleMovementComponentName))
+{
+}
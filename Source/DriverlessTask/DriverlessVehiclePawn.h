@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WheeledVehiclePawn.h"
+#include "DriverlessVehiclePawn.generated.h"
+
+/**
+ * Wheeled vehicle pawn with a UDriverlessVehicleMovementComponent, so its follower can run the control law on the physics thread.
+ * Vehicle Blueprints based on AWheeledVehiclePawn can be reparented to it, their movement settings carry over.
+ */
+UCLASS()
+class DRIVERLESSTASK_API ADriverlessVehiclePawn : public AWheeledVehiclePawn
+{
+	GENERATED_BODY()
+
+public:
+	ADriverlessVehiclePawn(const FObjectInitializer& ObjectInitializer);
+};
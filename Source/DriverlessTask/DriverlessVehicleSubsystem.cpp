@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DriverlessVehicleSubsystem.h"
+#include "SplineFollowerComponent.h"
+#include "DriverlessStats.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+// size of a spatial hash cell (cm). Queries up to this radius only touch the 3x3 cells around the vehicle
+static TAutoConsoleVariable<float> CVarVehicleHashCellSize(
+	TEXT("Driverless.VehicleHashCellSize"),
+	3000.0f,
+	TEXT("Cell size (cm) of the spatial hash used for vehicle to vehicle queries."));
+
+// distance (cm) from every focus point past which a vehicle drops to kinematic playback. 0 disables the physics LOD
+static TAutoConsoleVariable<float> CVarPhysicsLODDistance(
+	TEXT("Driverless.PhysicsLODDistance"),
+	15000.0f,
+	TEXT("Distance (cm) from the closest camera or focus actor past which a follower switches to kinematic playback. 0 = always simulate."));
+
+// how much closer (cm) a kinematic vehicle must come before switching back, so it doesn't flip every frame at the border
+static TAutoConsoleVariable<float> CVarPhysicsLODHysteresis(
+	TEXT("Driverless.PhysicsLODHysteresis"),
+	2000.0f,
+	TEXT("Hysteresis (cm) between leaving and re-entering the physics LOD region."));
+
+void UDriverlessVehicleSubsystem::RegisterFollower(USplineFollowerComponent* Follower)
+{
+	if (Follower) Followers.AddUnique(Follower);
+}
+
+void UDriverlessVehicleSubsystem::UnregisterFollower(USplineFollowerComponent* Follower)
+{
+	Followers.Remove(Follower);
+}
+
+void UDriverlessVehicleSubsystem::AddFocusActor(AActor* Actor)
+{
+	if (Actor) FocusActors.AddUnique(Actor);
+}
+
+void UDriverlessVehicleSubsystem::RemoveFocusActor(AActor* Actor)
+{
+	FocusActors.Remove(Actor);
+}
+
+void UDriverlessVehicleSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_VehicleSubsystem);
+
+	// per frame Insights counters start over, like their stat counterparts
+	TRACE_COUNTER_SET(DriverlessProbesIssued, 0);
+	TRACE_COUNTER_SET(DriverlessProbesHit, 0);
+
+	RebuildSpatialHash();
+	UpdatePhysicsLOD();
+}
+
+TStatId UDriverlessVehicleSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDriverlessVehicleSubsystem, STATGROUP_Tickables);
+}
+
+bool UDriverlessVehicleSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FIntPoint UDriverlessVehicleSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+}
+
+void UDriverlessVehicleSubsystem::RebuildSpatialHash()
+{
+	CellSize = FMath::Max(CVarVehicleHashCellSize.GetValueOnGameThread(), 100.0f);
+
+	// drop followers whose owner was destroyed without unregistering
+	Followers.RemoveAllSwap([](const TWeakObjectPtr<USplineFollowerComponent>& Follower) { return !Follower.IsValid(); });
+
+	// containers keep their memory between frames, so the rebuild doesn't allocate once warmed up
+	VehicleStates.Reset();
+	NextInCell.Reset();
+	CellHeads.Reset();
+
+	for (const TWeakObjectPtr<USplineFollowerComponent>& Follower : Followers)
+	{
+		const APawn* Pawn = Cast<APawn>(Follower->GetOwner());
+		if (!Pawn) continue;
+
+		FDriverlessVehicleState& State = VehicleStates.AddDefaulted_GetRef();
+		State.Follower = Follower;
+		State.Location = Pawn->GetActorLocation();
+		State.Forward = Pawn->GetActorForwardVector();
+		State.Velocity = Pawn->GetVelocity();
+
+		// push the vehicle at the front of its cell's chain
+		const int32 Index = VehicleStates.Num() - 1;
+		int32& Head = CellHeads.FindOrAdd(GetCell(State.Location), INDEX_NONE);
+		NextInCell.Add(Head);
+		Head = Index;
+	}
+}
+
+void UDriverlessVehicleSubsystem::QueryNearbyVehicles(const FVector& Location, float Radius, const USplineFollowerComponent* Self, TArray<const FDriverlessVehicleState*, TInlineAllocator<16>>& OutVehicles) const
+{
+	OutVehicles.Reset();
+
+	const FIntPoint MinCell = GetCell(Location - FVector(Radius, Radius, 0.0f));
+	const FIntPoint MaxCell = GetCell(Location + FVector(Radius, Radius, 0.0f));
+	const float RadiusSq = FMath::Square(Radius);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			const int32* Head = CellHeads.Find(FIntPoint(X, Y));
+			if (!Head) continue;
+
+			for (int32 Index = *Head; Index != INDEX_NONE; Index = NextInCell[Index])
+			{
+				const FDriverlessVehicleState& State = VehicleStates[Index];
+				if (State.Follower.Get() == Self) continue;
+
+				if (FVector::DistSquared2D(State.Location, Location) <= RadiusSq)
+					OutVehicles.Add(&State);
+			}
+		}
+	}
+}
+
+void UDriverlessVehicleSubsystem::UpdatePhysicsLOD()
+{
+	const float LODDistance = CVarPhysicsLODDistance.GetValueOnGameThread();
+
+	// what the players are looking from, plus whatever was explicitly marked as interesting
+	FocusPoints.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			FocusPoints.Add(ViewLocation);
+		}
+	}
+
+	FocusActors.RemoveAllSwap([](const TWeakObjectPtr<AActor>& Actor) { return !Actor.IsValid(); });
+	for (const TWeakObjectPtr<AActor>& Actor : FocusActors)
+		FocusPoints.Add(Actor->GetActorLocation());
+
+	// physics LOD disabled: everything goes back to full simulation
+	if (LODDistance <= 0.0f)
+	{
+		for (const FDriverlessVehicleState& State : VehicleStates)
+		{
+			if (USplineFollowerComponent* Follower = State.Follower.Get())
+				Follower->SetKinematicLOD(false);
+		}
+		return;
+	}
+
+	// nobody is watching (e.g. a headless run): leave every vehicle as it is
+	if (FocusPoints.Num() == 0) return;
+
+	const float EnterDistSq = FMath::Square(FMath::Max(LODDistance - CVarPhysicsLODHysteresis.GetValueOnGameThread(), 0.0f));
+	const float LeaveDistSq = FMath::Square(LODDistance);
+
+	for (const FDriverlessVehicleState& State : VehicleStates)
+	{
+		USplineFollowerComponent* Follower = State.Follower.Get();
+		if (!Follower) continue;
+
+		float ClosestDistSq = MAX_flt;
+		for (const FVector& FocusPoint : FocusPoints)
+			ClosestDistSq = FMath::Min(ClosestDistSq, FVector::DistSquared(FocusPoint, State.Location));
+
+		if (Follower->IsKinematicLOD() && ClosestDistSq < EnterDistSq)
+			Follower->SetKinematicLOD(false);
+		else if (!Follower->IsKinematicLOD() && ClosestDistSq > LeaveDistSq)
+			Follower->SetKinematicLOD(true);
+	}
+}
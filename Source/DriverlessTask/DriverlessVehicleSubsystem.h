@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "DriverlessVehicleSubsystem.generated.h"
+
+class USplineFollowerComponent;
+
+// pose and velocity of a follower, snapshotted once per frame
+struct FDriverlessVehicleState
+{
+	TWeakObjectPtr<USplineFollowerComponent> Follower;
+	FVector Location = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	FVector Velocity = FVector::ZeroVector;
+};
+
+/**
+ * Keeps track of every spline follower in the world.
+ * Once per frame it rebuilds a spatial hash of their poses, so each follower can look up
+ * the vehicles around it without sweeping for them or looping over the whole grid.
+ */
+UCLASS()
+class DRIVERLESSTASK_API UDriverlessVehicleSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void RegisterFollower(USplineFollowerComponent* Follower);
+	void UnregisterFollower(USplineFollowerComponent* Follower);
+
+	// vehicles within Radius (cm) of Location, excluding the one driven by Self
+	void QueryNearbyVehicles(const FVector& Location, float Radius, const USplineFollowerComponent* Self, TArray<const FDriverlessVehicleState*, TInlineAllocator<16>>& OutVehicles) const;
+
+	const TArray<TWeakObjectPtr<USplineFollowerComponent>>& GetFollowers() const { return Followers; }
+
+	// actors that keep the vehicles around them on full physics, on top of the players' cameras
+	void AddFocusActor(AActor* Actor);
+	void RemoveFocusActor(AActor* Actor);
+
+	// UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void RebuildSpatialHash();
+	void UpdatePhysicsLOD();
+	FIntPoint GetCell(const FVector& Location) const;
+
+	TArray<TWeakObjectPtr<USplineFollowerComponent>> Followers;
+
+	// snapshot of all vehicles and, for each hash cell, the first vehicle in it. Vehicles in the same cell are chained by NextInCell
+	TArray<FDriverlessVehicleState> VehicleStates;
+	TArray<int32> NextInCell;
+	TMap<FIntPoint, int32> CellHeads;
+	float CellSize = 3000.0f;
+
+	TArray<TWeakObjectPtr<AActor>> FocusActors;
+	TArray<FVector> FocusPoints;
+};
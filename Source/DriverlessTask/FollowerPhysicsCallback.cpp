@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FollowerPhysicsCallback.h"
+#include "DriverlessStats.h"
+
+bool FFollowerPhysicsControl::ComputeCommands(const FTransform& Pose, FFollowerControlOutput& OutCommands)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(FollowerPhysicsControl, DriverlessChannel);
+
+	if (!bEnabled || !TrackTable || !TrackTable->IsValid())
+		return false;
+
+	// pose of the vehicle at this very step
+	const FVector VehicleLocation = Pose.GetLocation();
+	const FQuat VehicleRotation = Pose.GetRotation();
+
+	TrackDistance = TrackTable->FindDistanceClosestToLocation(VehicleLocation, TrackDistance);
+
+	/* PREDICTIVE BRAKING (based on curve sharpness) */
+	const FVector FutureTangent = TrackTable->GetTangentAtDistance(TrackDistance + Params.BrakingLookAhead);
+	const FVector CurrentTangent = TrackTable->GetTangentAtDistance(TrackDistance + 10.0f);
+	const FFollowerSpeedPlan Plan = FollowerControl::PlanSpeed(Params, CurrentTangent, FutureTangent);
+
+	/* STEERING */
+	FFollowerControlInput ControlInput;
+	ControlInput.VehicleLocation = VehicleLocation;
+	ControlInput.VehicleForward = VehicleRotation.GetForwardVector();
+	ControlInput.VehicleRight = VehicleRotation.GetRightVector();
+	ControlInput.TargetLocation = TrackTable->GetLocationAtDistance(TrackDistance + Plan.SteeringLookAhead) + Perception.TargetOffset;
+	ControlInput.bAvoiding = Perception.bAvoiding;
+	ControlInput.SafeDirection = Perception.SafeDirection;
+	ControlInput.ObstacleHitDistance = Perception.ObstacleHitDistance;
+	ControlInput.TrafficThrottleScale = Perception.TrafficThrottleScale;
+	ControlInput.TrafficBrake = Perception.TrafficBrake;
+
+	Commands = FollowerControl::ComputeCommands(Params, Plan, ControlInput);
+	TargetLocation = ControlInput.TargetLocation;
+	bHasCommands = true;
+
+	OutCommands = Commands;
+	return true;
+}
+
+void FFollowerPhysicsCallback::OnPreSimulate_Internal()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(FollowerPhysicsCallback, DriverlessChannel);
+
+	FFollowerPhysicsControl& State = *Control;
+	if (const FFollowerAsyncInput* Input = GetConsumerInput_Internal())
+	{
+		State.TrackTable = Input->TrackTable;
+		State.Params = Input->Params;
+		State.Perception = Input->Perception;
+		State.bEnabled = Input->bEnabled;
+		if (Input->bResetTrackDistance)
+			State.TrackDistance = -1.0f;
+	}
+
+	// nothing applied while the game thread drives, no output piles up for it to pop
+	if (!State.bEnabled)
+		State.bHasCommands = false;
+
+	// the commands the vehicle applied at its last step, whether it ran before or after this callback
+	if (State.bHasCommands)
+	{
+		FFollowerAsyncOutput& Output = GetProducerOutputData_Internal();
+		Output.bValid = true;
+		Output.Commands = State.Commands;
+		Output.TrackDistance = State.TrackDistance;
+		Output.TargetLocation = State.TargetLocation;
+	}
+}
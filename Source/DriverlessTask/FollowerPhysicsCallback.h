@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chaos/SimCallbackObject.h"
+#include "Chaos/SimCallbackInput.h"
+#include "FollowerControlLaw.h"
+#include "TrackTable.h"
+
+// what the game thread perceived last frame (probes, other vehicles). It's reused by every physics step until the next frame
+struct FFollowerPerception
+{
+	bool bAvoiding = false;
+	FVector SafeDirection = FVector::ForwardVector;
+	float ObstacleHitDistance = 0.0f;
+
+	FVector TargetOffset = FVector::ZeroVector;
+	float TrafficThrottleScale = 1.0f;
+	float TrafficBrake = 0.0f;
+};
+
+// game thread -> physics thread
+struct FFollowerAsyncInput : public Chaos::FSimCallbackInput
+{
+	TSharedPtr<const FTrackTable> TrackTable;
+	FFollowerControlParams Params;
+	FFollowerPerception Perception;
+
+	// cleared while the game thread drives the vehicle itself (stuck, recovery maneuvers), its inputs are applied as they are
+	bool bEnabled = true;
+
+	// the vehicle was teleported, its last distance along the track is no longer a valid hint
+	bool bResetTrackDistance = false;
+
+	void Reset()
+	{
+		TrackTable.Reset();
+		Params = FFollowerControlParams();
+		Perception = FFollowerPerception();
+		bEnabled = true;
+		bResetTrackDistance = false;
+	}
+};
+
+// physics thread -> game thread
+struct FFollowerAsyncOutput : public Chaos::FSimCallbackOutput
+{
+	bool bValid = false;
+	FFollowerControlOutput Commands;
+	float TrackDistance = 0.0f;
+	FVector TargetLocation = FVector::ZeroVector;
+
+	void Reset()
+	{
+		bValid = false;
+	}
+};
+
+/**
+ * The follower's control law as it runs on the physics thread: the latest input received from the game thread,
+ * and the commands of the last step. Only touched from the physics thread once the callback is registered.
+ */
+class FFollowerPhysicsControl
+{
+public:
+	// commands for the vehicle at Pose, called by its simulation right before its inputs are applied. False until an input
+	// arrived, and while the game thread drives
+	bool ComputeCommands(const FTransform& Pose, FFollowerControlOutput& OutCommands);
+
+private:
+	friend class FFollowerPhysicsCallback;
+
+	TSharedPtr<const FTrackTable> TrackTable;
+	FFollowerControlParams Params;
+	FFollowerPerception Perception;
+	bool bEnabled = true;
+
+	// last distance along the track, to search around it at the next step
+	float TrackDistance = -1.0f;
+
+	// last step's results, for the game thread
+	bool bHasCommands = false;
+	FFollowerControlOutput Commands;
+	FVector TargetLocation = FVector::ZeroVector;
+};
+
+/**
+ * Hands the game thread's perception to the follower's physics thread control, and its commands back.
+ * The commands themselves are computed and applied by the vehicle's simulation (UDriverlessVehicleMovementComponent) within
+ * the same physics step, so the control rate follows the physics step rate instead of the frame rate.
+ */
+class FFollowerPhysicsCallback : public Chaos::TSimCallbackObject<FFollowerAsyncInput, FFollowerAsyncOutput>
+{
+public:
+	// to hand to the vehicle's simulation, before the first physics step
+	const TSharedRef<FFollowerPhysicsControl, ESPMode::ThreadSafe>& GetControl() const { return Control; }
+
+private:
+	virtual void OnPreSimulate_Internal() override;
+
+	TSharedRef<FFollowerPhysicsControl, ESPMode::ThreadSafe> Control = MakeShared<FFollowerPhysicsControl, ESPMode::ThreadSafe>();
+};
@@ -9,6 +9,7 @@
 #include "Engine/StaticMesh.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Engine/Engine.h"
+#include "DriverlessStats.h"
 
 // Sets default values
 AObstacleSpawnerActor::AObstacleSpawnerActor()
@@ -29,6 +30,9 @@ void AObstacleSpawnerActor::BeginPlay()
 
 void AObstacleSpawnerActor::SpawnObstacles()
 {
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_SpawnObstacles);
+	LLM_SCOPE_BYTAG(Driverless_Spawner);
+
 	if (!CheckRequirements()) return;
 
 	/* SPAWN LOGIC */
@@ -36,7 +40,12 @@ void AObstacleSpawnerActor::SpawnObstacles()
 	if (!World) return;
 
 	const float SplineLength = PathSplineComponent->GetSplineLength();
-	SpawnedObstaclesLocations.Empty();
+	ClearObstacles();
+
+	if (RandomSeed != 0)
+		RandomStream.Initialize(RandomSeed);
+	else
+		RandomStream.GenerateNewSeed();
 
 	// attempt to place the desired number of obstacles, with cap number of attempts
 	int ObstaclesPlaced = 0;
@@ -45,7 +54,8 @@ void AObstacleSpawnerActor::SpawnObstacles()
 
 	for (attempts = 0; attempts < MaxAttempts && ObstaclesPlaced < NumberOfObstacles; attempts++)
 	{
-		FVector SpawnLocation = GetRandomPointAlongSpline(SplineLength);
+		EConeSide Side;
+		FVector SpawnLocation = GetRandomPointAlongSpline(SplineLength, Side);
 
 		bool tooClose = false;
 		for (const FVector& ExistingLocation : SpawnedObstaclesLocations)
@@ -59,13 +69,33 @@ void AObstacleSpawnerActor::SpawnObstacles()
 
 		if (tooClose) continue;
 
-		if (CreateObstacle(SpawnLocation))
+		if (CreateObstacle(SpawnLocation, Side))
 			ObstaclesPlaced++;
 	}
 
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ConesSpawned, DriverlessConesSpawned, ObstaclesPlaced);
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_SpawnAttempts, DriverlessSpawnAttempts, attempts);
+
 	UE_LOG(LogTemp, Log, TEXT("Placed %d obstacles along Landscape Spline after %d attempts."), ObstaclesPlaced, attempts);
 }
 
+void AObstacleSpawnerActor::RespawnObstacles()
+{
+	SpawnObstacles();
+}
+
+void AObstacleSpawnerActor::ClearObstacles()
+{
+	for (AActor* Obstacle : SpawnedObstacles)
+	{
+		if (IsValid(Obstacle))
+			Obstacle->Destroy();
+	}
+	SpawnedObstaclesLocations.Empty();
+	SpawnedObstacles.Empty();
+	SpawnedObstacleSides.Empty();
+}
+
 bool AObstacleSpawnerActor::CheckRequirements()
 {
 	// Initial checks and path's conversion
@@ -101,20 +131,21 @@ bool AObstacleSpawnerActor::CheckRequirements()
 	return true;
 }
 
-FVector AObstacleSpawnerActor::GetRandomPointAlongSpline(const float SplineLength)
+FVector AObstacleSpawnerActor::GetRandomPointAlongSpline(const float SplineLength, EConeSide& OutSide)
 {
-	float RandomDistance = FMath::FRandRange(0.0f, SplineLength);
+	float RandomDistance = RandomStream.FRandRange(0.0f, SplineLength);
 	FTransform SplineTransform = PathSplineComponent->GetTransformAtDistanceAlongSpline(RandomDistance, ESplineCoordinateSpace::World);
 	FVector SplineLocation = SplineTransform.GetLocation();
 	FVector SplineRightVector = SplineTransform.GetRotation().GetRightVector();
 
-	float RandomOffset = FMath::FRandRange(MinOffsetDistance, MaxOffsetDistance);
-	float Direction = FMath::RandBool() ? 1.0f : -1.0f; // left or right
+	float RandomOffset = RandomStream.FRandRange(MinOffsetDistance, MaxOffsetDistance);
+	float Direction = RandomStream.RandRange(0, 1) ? 1.0f : -1.0f; // left or right
 	FVector Offset = SplineRightVector * RandomOffset * Direction;
+	OutSide = Direction > 0.0f ? EConeSide::Right : EConeSide::Left;
 	return SplineLocation + Offset;
 }
 
-AActor* AObstacleSpawnerActor::CreateObstacle(const FVector &SpawnLocation)
+AActor* AObstacleSpawnerActor::CreateObstacle(const FVector &SpawnLocation, EConeSide Side)
 {
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.Owner = this;
@@ -139,6 +170,8 @@ AActor* AObstacleSpawnerActor::CreateObstacle(const FVector &SpawnLocation)
 			MeshComp->SetSimulatePhysics(true);
 
 			SpawnedObstaclesLocations.Add(SpawnLocation);
+			SpawnedObstacles.Add(NewObstacle);
+			SpawnedObstacleSides.Add(Side);
 		}
 		else
 		{
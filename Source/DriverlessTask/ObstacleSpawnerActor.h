@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Engine/World.h"
+#include "ConeDelaunay.h"
 #include "ObstacleSpawnerActor.generated.h"
 
 class ALandscapeSplineActor;
@@ -43,6 +44,23 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Spawning|Parameters", meta = (ClampMin = "0"))
 	float MinDistanceBetweenObstacles = 150.0f;
 
+	// Seed for cone placement, 0 picks a new seed every run
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cone Spawning|Parameters")
+	int32 RandomSeed = 0;
+
+	// Destroys the current cones and places a new set with the current parameters
+	UFUNCTION(BlueprintCallable, Category = "Cone Spawning")
+	void RespawnObstacles();
+
+	UFUNCTION(BlueprintCallable, Category = "Cone Spawning")
+	void ClearObstacles();
+
+	const TArray<AActor*>& GetSpawnedObstacles() const { return SpawnedObstacles; }
+	// side of the track each spawned obstacle was placed on, same order as GetSpawnedObstacles
+	const TArray<EConeSide>& GetSpawnedObstacleSides() const { return SpawnedObstacleSides; }
+	ALandscapeSplineActor* GetTrackSplineActor() const { return TrackSplineActor; }
+	USplineComponent* GetPathSplineComponent() const { return PathSplineComponent; }
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -50,8 +68,8 @@ protected:
 private:
 	void SpawnObstacles();
 	bool CheckRequirements();
-	FVector GetRandomPointAlongSpline(const float SplineLength);
-	AActor* CreateObstacle(const FVector &SpawnLocation);
+	FVector GetRandomPointAlongSpline(const float SplineLength, EConeSide& OutSide);
+	AActor* CreateObstacle(const FVector &SpawnLocation, EConeSide Side);
 
 	// temp spline component to access spline points
 	UPROPERTY()
@@ -60,6 +78,13 @@ private:
 	// already placed obstacles
 	TArray<FVector> SpawnedObstaclesLocations;
 
+	UPROPERTY()
+	TArray<AActor*> SpawnedObstacles;
+
+	TArray<EConeSide> SpawnedObstacleSides;
+
 	UWorld* World;
 
+	FRandomStream RandomStream;
+
 };
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RacingLineAsset.h"
+#include "GameFramework/Actor.h"
+#include "TrackTable.h"
+
+void URacingLineAsset::SetFromTable(const FString& InTrackName, const FTrackTable& Track, const FTrackTable& Line, float InMargin)
+{
+	TrackName = InTrackName;
+	TrackLength = Track.Length;
+	Margin = InMargin;
+
+	Length = Line.Length;
+	SampleSpacing = Line.SampleSpacing;
+	bClosedLoop = Line.bClosedLoop;
+	Locations = Line.Locations;
+	Tangents = Line.Tangents;
+	SpeedProfile = Line.SpeedProfile;
+}
+
+TSharedRef<FTrackTable> URacingLineAsset::BuildTable() const
+{
+	check(Locations.Num() >= 2 && Tangents.Num() == Locations.Num());
+
+	// the table drops the closing sample of a loop, it's expected back
+	TArray<FVector> LineLocations = Locations;
+	TArray<FVector> LineTangents = Tangents;
+	if (bClosedLoop)
+	{
+		LineLocations.Add(Locations[0]);
+		LineTangents.Add(Tangents[0]);
+	}
+
+	TArray<FVector> Directions;
+	Directions.SetNumUninitialized(LineTangents.Num());
+	for (int32 i = 0; i < LineTangents.Num(); i++)
+		Directions[i] = LineTangents[i].GetSafeNormal();
+
+	TSharedRef<FTrackTable> Table = FTrackTable::BuildFromSamples(MoveTemp(LineLocations), MoveTemp(Directions), MoveTemp(LineTangents), SampleSpacing, bClosedLoop);
+	if (SpeedProfile.Num() == Table->Num())
+		Table->SpeedProfile = SpeedProfile;
+
+	return Table;
+}
+
+bool URacingLineAsset::IsForTrack(const AActor* TrackActor, const FTrackTable& Track) const
+{
+	return TrackActor && TrackActor->GetName() == TrackName && FMath::Abs(Track.Length - TrackLength) < FMath::Max(Track.SampleSpacing, SampleSpacing)
+		&& Locations.Num() >= 2 && Tangents.Num() == Locations.Num();
+}
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "RacingLineAsset.generated.h"
+
+struct FTrackTable;
+
+/**
+ * Racing line of a track, optimized offline by the DriverlessRacingLine commandlet:
+ * the samples of the line's own track table, with the speed profile planned along it.
+ */
+UCLASS(BlueprintType)
+class DRIVERLESSTASK_API URacingLineAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// name of the track actor the line was optimized for, and the length of its centerline then (cm)
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	FString TrackName;
+
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	float TrackLength = 0.0f;
+
+	// distance the line keeps from the boundaries (cm)
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	float Margin = 0.0f;
+
+	// length of the line (cm), shorter than the centerline's where it cuts the corners
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	float Length = 0.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	float SampleSpacing = 100.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Racing Line")
+	bool bClosedLoop = false;
+
+	// one entry per sample of the line, as in its track table
+	UPROPERTY()
+	TArray<FVector> Locations;
+
+	UPROPERTY()
+	TArray<FVector> Tangents;
+
+	UPROPERTY()
+	TArray<float> SpeedProfile;
+
+	void SetFromTable(const FString& InTrackName, const FTrackTable& Track, const FTrackTable& Line, float InMargin);
+
+	// the line's track table, speed profile included
+	TSharedRef<FTrackTable> BuildTable() const;
+
+	// whether the line was optimized for this track as it is now: same actor name, and a centerline of the same length
+	bool IsForTrack(const AActor* TrackActor, const FTrackTable& Track) const;
+};
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RangeSensorComponent.h"
+#include "DriverlessStats.h"
+#include "Engine/World.h"
+#include "CollisionQueryParams.h"
+#include "Async/ParallelFor.h"
+
+URangeSensorComponent::URangeSensorComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	// after the vehicle has moved, so the rays leave from where it is this frame
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+}
+
+void URangeSensorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+	BuildRays();
+}
+
+void URangeSensorComponent::BuildRays()
+{
+	LLM_SCOPE_BYTAG(Driverless_Sensor);
+
+	NumColumns = FMath::Max(FMath::FloorToInt32(HorizontalFOV / FMath::Max(HorizontalResolution, 0.05f)), 1);
+	const int32 NumRays = NumColumns * NumChannels;
+
+	RayDirections.SetNumUninitialized(NumRays);
+	for (int32 Column = 0; Column < NumColumns; Column++)
+	{
+		const float Azimuth = -0.5f * HorizontalFOV + (Column + 0.5f) * HorizontalFOV / NumColumns;
+		for (int32 Channel = 0; Channel < NumChannels; Channel++)
+		{
+			const float Elevation = (NumChannels > 1) ? FMath::Lerp(MinElevation, MaxElevation, (float)Channel / (NumChannels - 1)) : 0.5f * (MinElevation + MaxElevation);
+			RayDirections[Column * NumChannels + Channel] = FVector3f(FRotator3f(Elevation, Azimuth, 0.0f).Vector());
+		}
+	}
+
+	// both buffers are allocated once, scans only overwrite them
+	for (FRangeSensorPointCloud& Buffer : Buffers)
+	{
+		Buffer.Points.SetNumZeroed(NumRays);
+		Buffer.Ranges.SetNumZeroed(NumRays);
+		Buffer.NumChannels = NumChannels;
+		Buffer.NumColumns = NumColumns;
+		Buffer.NumReturns = 0;
+		Buffer.ScanIndex = 0;
+	}
+
+	NextColumn = 0;
+	ColumnAccumulator = 0.0f;
+}
+
+void URangeSensorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (NumColumns == 0) return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_RangeSensor);
+
+	// the columns swept since the last frame. After a long frame the missed part of the revolution is dropped
+	ColumnAccumulator += DeltaTime * ScanRateHz * NumColumns;
+	int32 ColumnsDue = FMath::FloorToInt32(ColumnAccumulator);
+	ColumnAccumulator -= ColumnsDue;
+	ColumnsDue = FMath::Min(ColumnsDue, NumColumns);
+
+	while (ColumnsDue > 0)
+	{
+		const int32 Count = FMath::Min(ColumnsDue, NumColumns - NextColumn);
+		TraceColumns(NextColumn, Count);
+		NextColumn += Count;
+		ColumnsDue -= Count;
+
+		if (NextColumn == NumColumns)
+		{
+			CompleteRevolution();
+			NextColumn = 0;
+		}
+	}
+}
+
+void URangeSensorComponent::Scan()
+{
+	if (NumColumns == 0)
+		BuildRays();
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_RangeSensor);
+
+	TraceColumns(0, NumColumns);
+	CompleteRevolution();
+	NextColumn = 0;
+}
+
+void URangeSensorComponent::TraceColumns(int32 FirstColumn, int32 Count)
+{
+	UWorld* World = GetWorld();
+	if (!World || Count <= 0) return;
+
+	FRangeSensorPointCloud& Back = Buffers[1 - FrontBuffer];
+	const FTransform Pose = GetComponentTransform();
+	const FVector Origin = Pose.GetLocation();
+	const int32 FirstRay = FirstColumn * NumChannels;
+	const int32 NumRays = Count * NumChannels;
+	const ECollisionChannel Channel = TraceChannel;
+	const float Near = MinRange;
+	const float Far = FMath::Max(MaxRange, MinRange);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(RangeSensor), false, GetOwner());
+
+	// scene queries only read the physics scene, so the rays of a frame go wide. Every ray writes its own slot
+	ParallelFor(TEXT("RangeSensor"), NumRays, 64, [&](int32 i)
+	{
+		const int32 Ray = FirstRay + i;
+		const FVector Direction = Pose.TransformVectorNoScale(FVector(RayDirections[Ray]));
+
+		FHitResult Hit;
+		if (World->LineTraceSingleByChannel(Hit, Origin + Direction * Near, Origin + Direction * Far, Channel, QueryParams) && !Hit.bStartPenetrating)
+		{
+			const float Range = Near + Hit.Distance;
+			Back.Ranges[Ray] = Range;
+			Back.Points[Ray] = RayDirections[Ray] * Range;
+		}
+		else
+		{
+			Back.Ranges[Ray] = 0.0f;
+			Back.Points[Ray] = FVector3f::ZeroVector;
+		}
+	}, bParallelTraces ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_RangeSensorRays, DriverlessRangeSensorRays, NumRays);
+}
+
+SIZE_T URangeSensorComponent::GetAllocatedSize() const
+{
+	SIZE_T Size = RayDirections.GetAllocatedSize();
+	for (const FRangeSensorPointCloud& Buffer : Buffers)
+		Size += Buffer.Points.GetAllocatedSize() + Buffer.Ranges.GetAllocatedSize();
+	return Size;
+}
+
+void URangeSensorComponent::CompleteRevolution()
+{
+	FRangeSensorPointCloud& Back = Buffers[1 - FrontBuffer];
+
+	Back.NumReturns = 0;
+	for (const float Range : Back.Ranges)
+		Back.NumReturns += (Range > 0.0f) ? 1 : 0;
+
+	Back.Timestamp = GetWorld() ? GetWorld()->GetTimeSeconds() : 0.0;
+	Back.ScanIndex = Buffers[FrontBuffer].ScanIndex + 1;
+
+	FrontBuffer = 1 - FrontBuffer;
+}
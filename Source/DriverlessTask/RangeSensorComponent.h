@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "RangeSensorComponent.generated.h"
+
+// one revolution of a range sensor, in sensor space. Ray i is channel (i % NumChannels) of column (i / NumChannels)
+struct FRangeSensorPointCloud
+{
+	TArray<FVector3f> Points; // zero without a return
+	TArray<float> Ranges; // cm, 0 = no return
+	int32 NumChannels = 0;
+	int32 NumColumns = 0;
+	int32 NumReturns = 0;
+	double Timestamp = 0.0; // world time the revolution was completed at
+	uint32 ScanIndex = 0; // 0 = no revolution completed yet
+};
+
+/**
+ * Scanning range sensor (LiDAR-like): NumChannels lasers stacked vertically, rotating at ScanRateHz.
+ * Each frame it traces the columns swept since the last one, spread over worker threads, into the back buffer
+ * of a preallocated double-buffered point cloud. Once a revolution is complete the buffers swap, and consumers
+ * read the latest complete cloud in place. The ray layout is read at BeginPlay.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class DRIVERLESSTASK_API URangeSensorComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	URangeSensorComponent();
+
+	// lasers, evenly spread between MinElevation and MaxElevation
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "1", ClampMax = "128"))
+	int32 NumChannels = 32;
+
+	// elevation of the lowest and highest laser (degrees)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor")
+	float MinElevation = -15.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor")
+	float MaxElevation = 15.0f;
+
+	// angle between two columns (degrees)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "0.05"))
+	float HorizontalResolution = 1.0f;
+
+	// horizontal field of view, centered on the forward axis (degrees)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "1.0", ClampMax = "360.0"))
+	float HorizontalFOV = 360.0f;
+
+	// returns closer than MinRange (the car itself) or farther than MaxRange are ignored (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "0.0"))
+	float MinRange = 100.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "1.0"))
+	float MaxRange = 10000.0f;
+
+	// revolutions per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor", meta = (ClampMin = "0.1"))
+	float ScanRateHz = 10.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor")
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	// Trace the rays of a frame on worker threads instead of the game thread alone
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Range Sensor")
+	bool bParallelTraces = true;
+
+	// latest complete revolution. It's read in place, and stays valid until the next revolution completes
+	const FRangeSensorPointCloud& GetPointCloud() const { return Buffers[FrontBuffer]; }
+
+	int32 GetNumRays() const { return RayDirections.Num(); }
+
+	// heap memory held by the rays and both point clouds, for memory reports
+	SIZE_T GetAllocatedSize() const;
+
+	// traces a whole revolution right now, from the current pose, and makes it the latest
+	void Scan();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	void BuildRays();
+	void TraceColumns(int32 FirstColumn, int32 NumColumns);
+	void CompleteRevolution();
+
+	// unit ray directions in sensor space, in point cloud order
+	TArray<FVector3f> RayDirections;
+	int32 NumColumns = 0;
+
+	FRangeSensorPointCloud Buffers[2];
+	int32 FrontBuffer = 0;
+
+	// columns of the revolution in progress already traced, and the fraction of a column owed to the next frame
+	int32 NextColumn = 0;
+	float ColumnAccumulator = 0.0f;
+};
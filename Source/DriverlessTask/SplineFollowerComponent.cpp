@@ -2,10 +2,34 @@
 
 
 #include "SplineFollowerComponent.h"
+#include "DriverlessVehicleSubsystem.h"
+#include "DriverlessTrackSubsystem.h"
+#include "RacingLineAsset.h"
+#include "DriverlessTelemetrySubsystem.h"
+#include "DriverlessSnapshotSubsystem.h"
+#include "DriverlessAgentSubsystem.h"
+#include "ConeCenterlineComponent.h"
+#include "StateEstimatorComponent.h"
+#include "FollowerPhysicsCallback.h"
+#include "DriverlessVehicleMovementComponent.h"
+#include "DriverlessStats.h"
 #include "Engine/Engine.h"
-// circles to see projected path points
-#include "DrawDebugHelpers.h"
-#include "Kismet/KismetSystemLibrary.h"
+#include "DriverlessDebugDrawSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "CollisionQueryParams.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PBDRigidsSolver.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	// sensing and progress of a planned recovery
+	constexpr int32 RecoverySenseRays = 90;
+	constexpr float RecoverySenseHeight = 40.0f; // cm above the vehicle origin
+	constexpr float RecoveryStillSpeed = 20.0f; // cm/s
+}
 
 // Sets default values for this component's properties
 USplineFollowerComponent::USplineFollowerComponent()
@@ -20,6 +44,8 @@ USplineFollowerComponent::USplineFollowerComponent()
 // Called when the game starts
 void USplineFollowerComponent::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Driverless_Follower);
+
 	Super::BeginPlay();
 
 	bool bSetupSuccess = true;
@@ -31,7 +57,6 @@ void USplineFollowerComponent::BeginPlay()
 	if (OwnerPawn)
 	{
 		VehicleMovementComponent = Cast<UChaosVehicleMovementComponent>(OwnerPawn->GetMovementComponent());
-		PreviousLocation = OwnerPawn->GetActorLocation();
 	}
 	else
 	{
@@ -48,9 +73,16 @@ void USplineFollowerComponent::BeginPlay()
 	else
 	{
 		SplineToFollow = TargetTrackActor->FindComponentByClass<USplineComponent>();
+
+		// a landscape spline baked by the DriverlessTrackData commandlet needs no spline: its table is loaded as is
+		if (!SplineToFollow)
+		{
+			if (UDriverlessTrackSubsystem* TrackSubsystem = GetWorld()->GetSubsystem<UDriverlessTrackSubsystem>())
+				TrackTable = TrackSubsystem->GetBakedTrackTable(TargetTrackActor);
+		}
 		
 		// if it's not a USPlineComponent, check if it's a LandscapeSplineActor, cast in case
-		if (!SplineToFollow)
+		if (!SplineToFollow && !TrackTable)
 		{
 			class ALandscapeSplineActor* LandscapeActor = Cast<ALandscapeSplineActor>(TargetTrackActor);
 			if (LandscapeActor)
@@ -76,132 +108,641 @@ void USplineFollowerComponent::BeginPlay()
 		}
 
 
-		if (!SplineToFollow)
+		if (!SplineToFollow && !TrackTable)
 		{
 			bSetupSuccess = false;
 			UE_LOG(LogTemp, Error, TEXT("SplineFollowerComponent: TargetTrackActor '%s' does not have a SplineComponent!"), *TargetTrackActor->GetName());
 		}
 	}
 
+	// shared resampled copy of the track, used where the spline itself would be too slow
+	if (SplineToFollow || TrackTable)
+	{
+		if (UDriverlessTrackSubsystem* TrackSubsystem = GetWorld()->GetSubsystem<UDriverlessTrackSubsystem>())
+		{
+			TrackTable = TrackSubsystem->GetTrackTable(TargetTrackActor, SplineToFollow);
+			if (bUseOccupancyGrid)
+				OccupancyGrid = TrackSubsystem->GetOccupancyGrid(TargetTrackActor);
+
+			// without a spline, the plan is made on the table
+			PathTable = TrackTable;
+			bPlanOnTable = !SplineToFollow && PathTable.IsValid();
+			if (RacingLine && TrackTable)
+			{
+				if (RacingLine->IsForTrack(TargetTrackActor, *TrackTable))
+				{
+					PathTable = TrackSubsystem->GetRacingLineTable(RacingLine);
+					bPlanOnTable = PathTable.IsValid();
+				}
+				else
+				{
+					UE_LOG(LogTemp, Warning, TEXT("SplineFollowerComponent: racing line '%s' was not optimized for '%s' as it is now, following the centerline. Run the DriverlessRacingLine commandlet again."),
+						*RacingLine->GetName(), *TargetTrackActor->GetName());
+				}
+				if (!PathTable)
+				{
+					PathTable = TrackTable;
+					bPlanOnTable = !SplineToFollow && PathTable.IsValid();
+				}
+			}
+		}
+	}
+
 	if (!bSetupSuccess || !VehicleMovementComponent)
 	{
 		UE_LOG(LogTemp, Error, TEXT("SplineFollowerComponent: Setup Failed. Disabling tick."));
 		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// make this vehicle visible to the others
+	VehicleSubsystem = GetWorld()->GetSubsystem<UDriverlessVehicleSubsystem>();
+	if (VehicleSubsystem)
+	{
+		VehicleSubsystem->RegisterFollower(this);
+
+		// spread the planning updates of the vehicles over the control period (golden ratio sequence)
+		if (ControlRateHz > 0.0f)
+			ControlAccumulator = FMath::Frac(VehicleSubsystem->GetFollowers().Num() * 0.618034f) / ControlRateHz;
+	}
+
+	// commands to replay instead of running the controller
+	if (IsReplaying())
+	{
+		if (CommandRecording.LoadFromFile(GetRecordingFileName()) && CommandRecording.Frames.Num() > 0)
+		{
+			// start from the recorded initial state
+			const FFollowerCommandFrame& First = CommandRecording.Frames[0];
+			OwnerPawn->SetActorLocationAndRotation(First.Location, First.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+			if (UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent()))
+			{
+				Body->SetPhysicsLinearVelocity(First.Velocity);
+				Body->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+			}
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("SplineFollowerComponent: Unable to load the recording '%s', driving with the controller."), *GetRecordingFileName());
+			ControlSource = EFollowerControlSource::Controller;
+		}
+	}
+
+	// an external agent sends the commands
+	if (ControlSource == EFollowerControlSource::External)
+	{
+		AgentSubsystem = GetWorld()->GetSubsystem<UDriverlessAgentSubsystem>();
+		AgentSlot = AgentSubsystem ? AgentSubsystem->RegisterAgent(this) : INDEX_NONE;
+		if (AgentSlot == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Error, TEXT("SplineFollowerComponent: No room on the agent bridge (is it open with -DriverlessAgent?), driving with the controller."));
+			ControlSource = EFollowerControlSource::Controller;
+		}
+	}
+
+	// steer along the centerline of the cones seen, estimated before the follower plans
+	if (bFollowConeCenterline)
+	{
+		ConeCenterline = GetOwner()->FindComponentByClass<UConeCenterlineComponent>();
+		if (ConeCenterline)
+			AddTickPrerequisiteComponent(ConeCenterline);
+		else
+			UE_LOG(LogTemp, Warning, TEXT("SplineFollowerComponent: '%s' has no ConeCenterlineComponent, following the spline."), *GetOwner()->GetName());
+	}
+
+	// drive from the estimated pose, updated before the follower plans
+	StateEstimator = GetOwner()->FindComponentByClass<UStateEstimatorComponent>();
+	if (StateEstimator)
+		AddTickPrerequisiteComponent(StateEstimator);
+
+	// another thread sends the commands
+	if (ControlSource == EFollowerControlSource::CommandQueue)
+		CommandQueue = MakeShared<FFollowerCommandQueue, ESPMode::ThreadSafe>(CommandQueueCapacity);
+
+	// hook the control law into the physics solver
+	if (bRunControlOnPhysicsThread && ControlSource == EFollowerControlSource::Controller && !ConeCenterline && !StateEstimator)
+	{
+		FPhysScene* PhysScene = GetWorld()->GetPhysicsScene();
+		Chaos::FPhysicsSolver* Solver = PhysScene ? PhysScene->GetSolver() : nullptr;
+
+		// the vehicle's own simulation applies the commands, at the step that computes them
+		UDriverlessVehicleMovementComponent* DriverlessMovement = Cast<UDriverlessVehicleMovementComponent>(VehicleMovementComponent);
+
+		if (Solver && PathTable && DriverlessMovement)
+		{
+			PhysicsCallback = Solver->CreateAndRegisterSimCallbackObject_External<FFollowerPhysicsCallback>();
+			DriverlessMovement->SetFollowerControl(PhysicsCallback->GetControl());
+		}
+		else if (!DriverlessMovement)
+			UE_LOG(LogTemp, Warning, TEXT("SplineFollowerComponent: '%s' has no DriverlessVehicleMovementComponent (see ADriverlessVehiclePawn), running the controller on the game thread."), *GetOwner()->GetName());
+		else
+			UE_LOG(LogTemp, Warning, TEXT("SplineFollowerComponent: Unable to run the controller on the physics thread, running it on the game thread."));
+	}
+}
+
+void USplineFollowerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bRecordCommands && !IsReplaying() && CommandRecording.Frames.Num() > 0)
+	{
+		if (CommandRecording.SaveToFile(GetRecordingFileName()))
+			UE_LOG(LogTemp, Log, TEXT("SplineFollowerComponent: saved %d recorded frames to '%s'."), CommandRecording.Frames.Num(), *GetRecordingFileName());
+		else
+			UE_LOG(LogTemp, Error, TEXT("SplineFollowerComponent: Unable to save the recording '%s'."), *GetRecordingFileName());
 	}
 
+	if (IsReplaying() && !bReplayFinished && ReplayDivergence.NumFrames > 0)
+		UE_LOG(LogTemp, Log, TEXT("SplineFollowerComponent: '%s' replay stopped early: %s"), *GetOwner()->GetName(), *ReplayDivergence.ToString());
+
+	if (VehicleSubsystem)
+		VehicleSubsystem->UnregisterFollower(this);
+
+	if (AgentSubsystem)
+		AgentSubsystem->UnregisterAgent(this);
+
+	if (PhysicsCallback)
+	{
+		if (UDriverlessVehicleMovementComponent* DriverlessMovement = Cast<UDriverlessVehicleMovementComponent>(VehicleMovementComponent))
+			DriverlessMovement->SetFollowerControl(nullptr);
+
+		FPhysScene* PhysScene = GetWorld()->GetPhysicsScene();
+		if (Chaos::FPhysicsSolver* Solver = PhysScene ? PhysScene->GetSolver() : nullptr)
+			Solver->UnregisterAndFreeSimCallbackObject_External(PhysicsCallback);
+		PhysicsCallback = nullptr;
+	}
 
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void USplineFollowerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_FollowerTick);
+	LLM_SCOPE_BYTAG(Driverless_Follower);
+
+	const uint64 TickStartCycles = FPlatformTime::Cycles64();
+	ON_SCOPE_EXIT { LastTickSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - TickStartCycles); };
+
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
 	// Ensure all necessary components are valid
-	if (!OwnerPawn || !VehicleMovementComponent || !SplineToFollow)
+	if (!OwnerPawn || !VehicleMovementComponent || (!SplineToFollow && !PathTable))
+		return;
+
+	// recorded commands drive the vehicle, bypassing the follower logic
+	if (IsReplaying())
+	{
+		SuspendPhysicsThreadControl();
+		TickReplay(DeltaTime);
+		return;
+	}
+
+	// pose the commands of this tick are computed from
+	const FTransform RecordPose = OwnerPawn->GetActorTransform();
+	const FVector RecordVelocity = OwnerPawn->GetVelocity();
+	ON_SCOPE_EXIT { if (bRecordCommands && !bKinematicLOD) RecordCommands(RecordPose, RecordVelocity); };
+
+	// external commands replace the follower logic, and get recorded like its own
+	if (IsExternallyControlled())
+	{
+		TickExternal(DeltaTime);
+		return;
+	}
+
+	// far from the cameras the car just plays back along the track
+	if (bKinematicLOD)
+	{
+		TickKinematic(DeltaTime);
+		return;
+	}
+
+	// if stuck, the handler has its own logic. Once it's done, the plan starts over
+	if (HandleStuckState(DeltaTime))
+	{
+		SuspendPhysicsThreadControl();
+		bHasPlan = false;
+		return;
+	}
+
+	// perception and planning run at the control rate, actuation every frame
+	const bool bPlan = ConsumeControlStep(DeltaTime) || !bHasPlan;
+
+	// the control law runs on the physics thread, here we only feed it what we perceive
+	if (PhysicsCallback)
+	{
+		TickPhysicsThreadControl(bPlan);
 		return;
+	}
+
+	if (bPlan)
+		UpdatePlan();
+	else if (PendingProbeTraces.Num() > 0)
+		CollectAsyncProbes(); // async results only live for one frame
+
+	Actuate();
+}
 
-	PrintTelemetry();
-	// if stuck, the handler has its own logic
-	if (HandleStuckState(DeltaTime)) return;
+bool USplineFollowerComponent::ConsumeControlStep(float DeltaTime)
+{
+	if (ControlRateHz <= 0.0f) return true;
+
+	const float ControlPeriod = 1.0f / ControlRateHz;
+	ControlAccumulator += DeltaTime;
+	if (ControlAccumulator < ControlPeriod) return false;
 
+	// after a long frame the plan is updated once, the missed updates are dropped
+	ControlAccumulator = FMath::Fmod(ControlAccumulator, ControlPeriod);
+	return true;
+}
 
+void USplineFollowerComponent::UpdatePlan()
+{
 	/* PATH FOLLOWING */
 
 	// Position of the vehicle
-	FVector VehicleLocation = OwnerPawn->GetActorLocation();
-	FVector VehicleForward = OwnerPawn->GetActorForwardVector();
-	float SplineInputKey = SplineToFollow->FindInputKeyClosestToWorldLocation(VehicleLocation); // closest point of the spline to the vehicle
-	float CurrentDistance = SplineToFollow->GetDistanceAlongSplineAtSplineInputKey(SplineInputKey);
-
-	/* PREDICTIVE BRAKING (based on curve sharpness) */
-	// direction (tangent) at a future point on the spline
-	const FVector FutureTangent = SplineToFollow->GetTangentAtDistanceAlongSpline(CurrentDistance + BrakingLookAhead, ESplineCoordinateSpace::World);
+	FVector VehicleLocation, VehicleForward, VehicleRight;
+	GetControlPose(VehicleLocation, VehicleForward, VehicleRight);
+	FVector CurrentTangent;
+	FVector TargetLocation;
+	{
+		DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_SplineLookup);
 
-	// diraction at the current point on the spline, right ahead of the vehicle
-	const FVector CurrentTangent = SplineToFollow->GetTangentAtDistanceAlongSpline(CurrentDistance + 10.0f, ESplineCoordinateSpace::World);
+		if (bPlanOnTable)
+		{
+			// same plan along the table (racing line or baked track), it keeps the tangent lengths of the spline
+			PathDistance = PathTable->FindDistanceClosestToLocation(VehicleLocation, PathDistance);
+			const FVector FutureTangent = PathTable->GetTangentAtDistance(PathDistance + BrakingLookAhead);
+			CurrentTangent = PathTable->GetTangentAtDistance(PathDistance + 10.0f);
+			CurrentPlan = FollowerControl::PlanSpeed(MakeControlParams(), CurrentTangent, FutureTangent);
+			TargetLocation = PathTable->GetLocationAtDistance(PathDistance + CurrentPlan.SteeringLookAhead);
+		}
+		else
+		{
+			float SplineInputKey = SplineToFollow->FindInputKeyClosestToWorldLocation(VehicleLocation); // closest point of the spline to the vehicle
+			float CurrentDistance = SplineToFollow->GetDistanceAlongSplineAtSplineInputKey(SplineInputKey);
 
-	// dot product of the two directions, it indicates how sharp the curve is between current and future point
-	// 1.0 = Perfectly , 0.0 = 90 turn , 1.0 = A 180 U-turn
-	const float Curvature = FVector::DotProduct(CurrentTangent, FutureTangent);
+			/* PREDICTIVE BRAKING (based on curve sharpness) */
+			// direction (tangent) at a future point on the spline
+			const FVector FutureTangent = SplineToFollow->GetTangentAtDistanceAlongSpline(CurrentDistance + BrakingLookAhead, ESplineCoordinateSpace::World);
 
+			// diraction at the current point on the spline, right ahead of the vehicle
+			CurrentTangent = SplineToFollow->GetTangentAtDistanceAlongSpline(CurrentDistance + 10.0f, ESplineCoordinateSpace::World);
 
-	/* DYNAMIC LOOK-AHEAD & THROTTLE / BRAKE */
+			CurrentPlan = FollowerControl::PlanSpeed(MakeControlParams(), CurrentTangent, FutureTangent);
 
-	// map the curvature (1.0 to -1.0) to a "sharpness" factor (0.0 to 1.0)
-	// BrakingSharpness indicates the sharpness that triggers full braking eg. the default is 0.8 = gentle
-	float TurnSharpness = FMath::Clamp(1.0f - (Curvature / BrakingSharpness), 0.0f, 1.0f);
-	
-	// as the turn gets sharper, reduce look-ahead distance, to prevent cutting corners, and lower throttle + apply brakes
-	// A linear interpolation is applied to smooth the transitions
-	float PredictiveThrottle = FMath::Lerp(1.0f, 0.0f, TurnSharpness * 1.2f); // reduce throttle
-	float CurvatureBrake = FMath::Lerp(0.0f, 1.0f, TurnSharpness * 1.5f); // apply brakes if the turn is sharp enough
+			/* STEERING */
 
-	float SteeringLookAhead = FMath::Lerp(MaxLookAheadDistance, MinLookAheadDistance, TurnSharpness);
+			// Lookahead projection on the spline
+			TargetLocation = SplineToFollow->GetLocationAtDistanceAlongSpline(CurrentDistance + CurrentPlan.SteeringLookAhead, ESplineCoordinateSpace::World);
+		}
+	}
 
-	/* STEERING */
+	// or on the centerline of the cones seen, when it reaches far enough
+	FVector ConeTarget;
+	if (ConeCenterline && ConeCenterline->GetSteeringTarget(CurrentPlan.SteeringLookAhead, ConeTarget))
+		TargetLocation = ConeTarget;
 
-	// Lookahead projection on the spline
-	FVector TargetLocation = SplineToFollow->GetLocationAtDistanceAlongSpline(CurrentDistance + SteeringLookAhead, ESplineCoordinateSpace::World);
+	/* TRAFFIC */
+	const FTrafficResponse Traffic = ComputeTrafficResponse(VehicleLocation, VehicleForward);
+	TargetLocation += Traffic.TargetOffset;
 
-	// Calculate steering input
-	FVector DirectionToTarget = (TargetLocation - VehicleLocation).GetSafeNormal();
+	PlannedInput.TargetLocation = TargetLocation;
+	PlannedInput.TrafficThrottleScale = Traffic.ThrottleScale;
+	PlannedInput.TrafficBrake = Traffic.Brake;
 
 	/* OBSTACLE AVOIDANCE */
-	float ObstacleHitDistance = ObstacleTraceDistance;
-	FVector SafeDirection = VehicleForward;
-	float AvoidanceFactor = 0.0f;
-	// float AvoidanceSteering = CalculateAvoidanceSteering(AvoidanceFactor);
-	bool isAvoiding = FindSafeAvoidancePath(ObstacleHitDistance, SafeDirection);
-	
-	// proportionally blend steering and braking based on distance to obstacle, if any
-	if (isAvoiding) {
+	PlannedInput.bAvoiding = FindSafeAvoidancePath(CurrentTangent, PlannedInput.ObstacleHitDistance, PlannedInput.SafeDirection);
+
+	bHasPlan = true;
+}
+
+FFollowerControlInput USplineFollowerComponent::MakeControlInput() const
+{
+	// steer towards the planned target from where the vehicle is now
+	FFollowerControlInput ControlInput = PlannedInput;
+	GetControlPose(ControlInput.VehicleLocation, ControlInput.VehicleForward, ControlInput.VehicleRight);
+	return ControlInput;
+}
 
-		AvoidanceFactor = FMath::Clamp(1.0f - (ObstacleHitDistance / ObstacleTraceDistance), 0.0f, 1.0f);
-		DirectionToTarget = FMath::Lerp(VehicleForward, SafeDirection, AvoidanceStrength).GetSafeNormal();
+void USplineFollowerComponent::GetControlPose(FVector& OutLocation, FVector& OutForward, FVector& OutRight) const
+{
+	if (StateEstimator)
+	{
+		OutLocation = StateEstimator->GetEstimatedLocation();
+		OutForward = StateEstimator->GetEstimatedForward();
+		OutRight = StateEstimator->GetEstimatedRight();
+	}
+	else
+	{
+		OutLocation = OwnerPawn->GetActorLocation();
+		OutForward = OwnerPawn->GetActorForwardVector();
+		OutRight = OwnerPawn->GetActorRightVector();
 	}
+}
+
+void USplineFollowerComponent::Actuate()
+{
+	const FFollowerControlInput ControlInput = MakeControlInput();
+	const FFollowerControlOutput Commands = FollowerControl::ComputeCommands(MakeControlParams(), CurrentPlan, ControlInput);
+
+	// Apply inputs to the vehicle movement component
+	VehicleMovementComponent->SetSteeringInput(Commands.Steering);
+	VehicleMovementComponent->SetThrottleInput(Commands.Throttle);
+	VehicleMovementComponent->SetBrakeInput(Commands.Brake);
+
+	// the trail is where the vehicle really went, whatever it believed
+	SeeDebugTrails(OwnerPawn->GetActorLocation(), ControlInput.TargetLocation);
+}
+
+SIZE_T USplineFollowerComponent::GetAllocatedSize() const
+{
+	SIZE_T Size = ProbeCache.Probes.GetAllocatedSize() + PendingProbeTraces.GetAllocatedSize();
+	Size += ProbeAngles.GetAllocatedSize() + ProbeDirections.GetAllocatedSize() + ProbeDistances.GetAllocatedSize();
+	Size += ProbeScoring.GetAllocatedSize();
+	Size += DebugHistory.GetAllocatedSize();
+	Size += RecoveryPlanner.GetAllocatedSize();
+	return Size;
+}
+
+int32 USplineFollowerComponent::GetPhysicsFrame() const
+{
+	const FPhysScene* PhysScene = GetWorld()->GetPhysicsScene();
+	const Chaos::FPhysicsSolver* Solver = PhysScene ? PhysScene->GetSolver() : nullptr;
+	return Solver ? Solver->GetCurrentFrame() : (int32)GFrameCounter;
+}
+
+FString USplineFollowerComponent::GetRecordingFileName() const
+{
+	const FString Name = RecordingName.IsEmpty() ? GetOwner()->GetName() : RecordingName;
+	return FPaths::ProjectSavedDir() / TEXT("Driverless") / TEXT("Recordings") / Name + TEXT(".drec");
+}
+
+void USplineFollowerComponent::RecordCommands(const FTransform& Pose, const FVector& Velocity)
+{
+	const int32 PhysicsFrame = GetPhysicsFrame();
+	if (FirstPhysicsFrame == INDEX_NONE)
+		FirstPhysicsFrame = PhysicsFrame;
+
+	FFollowerCommandFrame& Frame = CommandRecording.Frames.AddDefaulted_GetRef();
+	Frame.PhysicsFrame = PhysicsFrame - FirstPhysicsFrame;
+	Frame.Steering = VehicleMovementComponent->GetSteeringInput();
+	Frame.Throttle = VehicleMovementComponent->GetThrottleInput();
+	Frame.Brake = VehicleMovementComponent->GetBrakeInput();
+	Frame.Gear = VehicleMovementComponent->GetTargetGear();
+	Frame.Location = Pose.GetLocation();
+	Frame.Rotation = Pose.GetRotation();
+	Frame.Velocity = Velocity;
+}
+
+void USplineFollowerComponent::TickReplay(float DeltaTime)
+{
+	if (bReplayFinished) return;
 
-	const FVector CrossProduct = FVector::CrossProduct(VehicleForward, DirectionToTarget);
-	float SteeringInput = FMath::Clamp(CrossProduct.Z, -1.0f, 1.0f);
+	// commands change at the same physics step, relative to the start, as when they were recorded
+	const int32 PhysicsFrame = GetPhysicsFrame();
+	if (FirstPhysicsFrame == INDEX_NONE)
+		FirstPhysicsFrame = PhysicsFrame;
+	const int32 ReplayFrame = PhysicsFrame - FirstPhysicsFrame;
 
-	// 180 stall correction
-	if (FMath::IsNearlyZero(SteeringInput, 0.01f))
+	if (CommandRecording.IsFinished(ReplayFrame))
 	{
-		if (FVector::DotProduct(VehicleForward, DirectionToTarget) < 0.0f) // if facing backwards
-		{
-			// determine which direction to turn
-			FVector RightVector = OwnerPawn->GetActorRightVector();
-			float RightDot = FVector::DotProduct(RightVector, DirectionToTarget);
-			SteeringInput = (RightDot >= 0.0f) ? 1.0f : -1.0f; // turn right or left
-		}
+		bReplayFinished = true;
+		VehicleMovementComponent->SetThrottleInput(0.0f);
+		VehicleMovementComponent->SetBrakeInput(1.0f);
+		UE_LOG(LogTemp, Log, TEXT("SplineFollowerComponent: '%s' replay finished: %s"), *GetOwner()->GetName(), *ReplayDivergence.ToString());
+		return;
 	}
 
-	// Combine path following and obstacle avoidance
-	float AvoidanceBrake = FMath::Lerp(0.0f, 0.8f, FMath::Clamp((AvoidanceFactor - 0.6f) * 2.5f, 0.0f, 1.0f));;
+	const FFollowerCommandFrame* Recorded = CommandRecording.FindFrame(ReplayFrame, ReplayCursor);
+	if (!Recorded) return;
 
-	/* FINAL THROTTLE AND BRAKE */
+	// the recorded pose is where the vehicle was when the recorded commands were computed
+	if (Recorded->PhysicsFrame == ReplayFrame)
+		ReplayDivergence.AddPose(*Recorded, OwnerPawn->GetActorLocation(), OwnerPawn->GetActorQuat());
 
-	// reduce throttle based on final steering input
-	float ReactiveThrottle = 1.0f - (FMath::Abs(SteeringInput) * 0.8f);
-	// combine throttle factors (steering and predictive braking)
-	// minimum throttle reduced based on avoidance factor
-	float ThrottleInput = FMath::Min(PredictiveThrottle, ReactiveThrottle) * FMath::Lerp(1.0f, 0.2f, AvoidanceFactor);
+	// the follower logic runs on the replayed state, and what it would command is compared with the recording
+	if (ControlSource == EFollowerControlSource::ReplayVerify)
+	{
+		if (ConsumeControlStep(DeltaTime) || !bHasPlan)
+			UpdatePlan();
+		else if (PendingProbeTraces.Num() > 0)
+			CollectAsyncProbes();
 
-	float BrakeInput = FMath::Max(CurvatureBrake, AvoidanceBrake);
+		const FFollowerControlOutput Commands = FollowerControl::ComputeCommands(MakeControlParams(), CurrentPlan, MakeControlInput());
+		ReplayDivergence.AddCommands(*Recorded, Commands.Steering, Commands.Throttle, Commands.Brake, ReplayCommandTolerance);
+	}
 
-	// Apply inputs to the vehicle movement component
-	VehicleMovementComponent->SetSteeringInput(SteeringInput);
-	VehicleMovementComponent->SetThrottleInput(ThrottleInput);
-	VehicleMovementComponent->SetBrakeInput(BrakeInput);
+	if (VehicleMovementComponent->GetTargetGear() != Recorded->Gear)
+		VehicleMovementComponent->SetTargetGear(Recorded->Gear, true);
+	VehicleMovementComponent->SetSteeringInput(Recorded->Steering);
+	VehicleMovementComponent->SetThrottleInput(Recorded->Throttle);
+	VehicleMovementComponent->SetBrakeInput(Recorded->Brake);
+}
 
-	SeeDebugTrails(VehicleLocation, TargetLocation);
+void USplineFollowerComponent::TickExternal(float DeltaTime)
+{
+	// perception keeps running at the control rate, so external controllers can observe the probes
+	if (ConsumeControlStep(DeltaTime) || !bHasPlan)
+		UpdatePlan();
+	else if (PendingProbeTraces.Num() > 0)
+		CollectAsyncProbes();
+
+	SeeDebugTrails(OwnerPawn->GetActorLocation(), PlannedInput.TargetLocation);
+
+	if (ControlSource == EFollowerControlSource::CommandQueue)
+	{
+		ApplyQueuedCommands();
+		return;
+	}
+
+	// hold still until the agent answers
+	const FDriverlessAgentAction* Action = AgentSubsystem ? AgentSubsystem->GetAction(AgentSlot) : nullptr;
+	if (Action)
+		ApplyExternalCommand(Action->Steering, Action->Throttle, Action->Brake, Action->Gear);
+	else
+		ApplyExternalCommand(0.0f, 0.0f, 1.0f, 0);
+}
+
+void USplineFollowerComponent::ApplyQueuedCommands()
+{
+	// drained right when the inputs are set, so a command pushed during the frame is applied on this one
+	const double Now = FPlatformTime::Seconds();
+	const FFollowerCommandDrain Drain = CommandQueue->Drain(Now, CommandMaxAge);
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_StaleCommands, DriverlessStaleCommands, Drain.NumStale);
+
+	if (Drain.Command.IsSet())
+		LastQueuedCommand = Drain.Command;
+
+	// the controller went quiet: stop rather than keep its last command forever
+	if (!LastQueuedCommand.IsSet() || Now - LastQueuedCommand->Timestamp > CommandMaxAge)
+	{
+		ApplyExternalCommand(0.0f, 0.0f, 1.0f, 0);
+		return;
+	}
+
+	ApplyExternalCommand(LastQueuedCommand->Steering, LastQueuedCommand->Throttle, LastQueuedCommand->Brake, LastQueuedCommand->Gear);
 }
 
-bool USplineFollowerComponent::FindSafeAvoidancePath(float& OutHitDistance, FVector& OutSafeDirection)
+void USplineFollowerComponent::ApplyExternalCommand(float Steering, float Throttle, float Brake, int32 Gear)
 {
+	if (Gear != 0 && VehicleMovementComponent->GetTargetGear() != Gear)
+		VehicleMovementComponent->SetTargetGear(Gear, true);
+	VehicleMovementComponent->SetSteeringInput(FMath::Clamp(Steering, -1.0f, 1.0f));
+	VehicleMovementComponent->SetThrottleInput(FMath::Clamp(Throttle, 0.0f, 1.0f));
+	VehicleMovementComponent->SetBrakeInput(FMath::Clamp(Brake, 0.0f, 1.0f));
+}
+
+void USplineFollowerComponent::WriteAgentObservation(FDriverlessAgentObservation& OutObservation)
+{
+	if (!OwnerPawn || !VehicleMovementComponent)
+	{
+		FMemory::Memzero(OutObservation);
+		return;
+	}
+
+	const FTransform Transform = OwnerPawn->GetActorTransform();
+	const FVector Location = Transform.GetLocation();
+	const FVector Forward = Transform.GetUnitAxis(EAxis::X);
+	const FQuat Rotation = Transform.GetRotation();
+	const FVector Velocity = OwnerPawn->GetVelocity();
+	const UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent());
+	const FVector AngularVelocity = (Body && Body->IsSimulatingPhysics()) ? Body->GetPhysicsAngularVelocityInDegrees() : FVector::ZeroVector;
+
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		OutObservation.Location[Axis] = Location[Axis];
+		OutObservation.Velocity[Axis] = Velocity[Axis];
+		OutObservation.AngularVelocity[Axis] = AngularVelocity[Axis];
+	}
+	OutObservation.Rotation[0] = Rotation.X;
+	OutObservation.Rotation[1] = Rotation.Y;
+	OutObservation.Rotation[2] = Rotation.Z;
+	OutObservation.Rotation[3] = Rotation.W;
+
+	if (TrackTable)
+	{
+		AgentTrackDistance = TrackTable->FindDistanceClosestToLocation(Location, AgentTrackDistance);
+		const FVector TrackDirection = TrackTable->GetDirectionAtDistance(AgentTrackDistance);
+		const FVector TrackRight = FVector::CrossProduct(FVector::UpVector, TrackDirection).GetSafeNormal();
+
+		OutObservation.TrackDistance = AgentTrackDistance;
+		OutObservation.LateralOffset = FVector::DotProduct(Location - TrackTable->GetLocationAtDistance(AgentTrackDistance), TrackRight);
+		OutObservation.HeadingError = FMath::RadiansToDegrees(FMath::Atan2(FVector::DotProduct(Forward, TrackRight), FVector::DotProduct(Forward, TrackDirection)));
+		OutObservation.TrackLength = TrackTable->Length;
+	}
+
+	OutObservation.ForwardSpeed = VehicleMovementComponent->GetForwardSpeed();
+	OutObservation.Gear = VehicleMovementComponent->GetCurrentGear();
+	OutObservation.Flags = (StuckState.StuckTime > 0.0f || StuckState.bPostRecovery || bPlannedRecovery ? DriverlessAgentFlag_Stuck : 0)
+		| (bAvoidingObstacle ? DriverlessAgentFlag_Avoiding : 0)
+		| (bKinematicLOD ? DriverlessAgentFlag_Kinematic : 0);
+
+	const int32 NumProbes = FMath::Min(ProbeDistances.Num(), DriverlessAgent::MaxProbes);
+	OutObservation.NumProbes = NumProbes;
+	FMemory::Memcpy(OutObservation.ProbeDistances, ProbeDistances.GetData(), NumProbes * sizeof(float));
+}
+
+FFollowerControlParams USplineFollowerComponent::MakeControlParams() const
+{
+	FFollowerControlParams Params;
+	Params.BrakingLookAhead = BrakingLookAhead;
+	Params.MinLookAheadDistance = MinLookAheadDistance;
+	Params.MaxLookAheadDistance = MaxLookAheadDistance;
+	Params.BrakingSharpness = BrakingSharpness;
+	Params.ObstacleTraceDistance = ObstacleTraceDistance;
+	Params.AvoidanceStrength = AvoidanceStrength;
+	return Params;
+}
+
+void USplineFollowerComponent::TickPhysicsThreadControl(bool bPlan)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_PhysicsThreadControl);
+
+	// every physics step since last frame applied its own commands, the latest one is what the vehicle is doing now
+	while (Chaos::TSimCallbackOutputHandle<FFollowerAsyncOutput> Output = PhysicsCallback->PopOutputData_External())
+	{
+		if (!Output->bValid) continue;
+
+		PhysicsCommands = Output->Commands;
+		PhysicsTrackDistance = Output->TrackDistance;
+		PhysicsTargetLocation = Output->TargetLocation;
+	}
+
+	// the simulation overrides these at every step. They're mirrored so the game thread (steering rate of the probe
+	// scoring, telemetry, recordings) reads what's applied
+	VehicleMovementComponent->SetSteeringInput(PhysicsCommands.Steering);
+	VehicleMovementComponent->SetThrottleInput(PhysicsCommands.Throttle);
+	VehicleMovementComponent->SetBrakeInput(PhysicsCommands.Brake);
+
+	const FVector VehicleLocation = OwnerPawn->GetActorLocation();
+	const FVector VehicleForward = OwnerPawn->GetActorForwardVector();
+	SeeDebugTrails(VehicleLocation, PhysicsTargetLocation);
+
+	// between two planning updates the physics thread keeps using the last perception it received
+	if (!bPlan)
+	{
+		if (PendingProbeTraces.Num() > 0) CollectAsyncProbes();
+		return;
+	}
+
+	// perception for the next physics steps
+	FFollowerAsyncInput* Input = PhysicsCallback->GetProducerInputData_External();
+	Input->TrackTable = PathTable;
+	Input->Params = MakeControlParams();
+	Input->bEnabled = true;
+	Input->bResetTrackDistance = bResetPhysicsTrackDistance;
+	bResetPhysicsTrackDistance = false;
+
+	const FTrafficResponse Traffic = ComputeTrafficResponse(VehicleLocation, VehicleForward);
+	Input->Perception.TargetOffset = Traffic.TargetOffset;
+	Input->Perception.TrafficThrottleScale = Traffic.ThrottleScale;
+	Input->Perception.TrafficBrake = Traffic.Brake;
+
+	const FVector TrackDirection = PathTable->GetTangentAtDistance(PhysicsTrackDistance + 10.0f);
+	Input->Perception.bAvoiding = FindSafeAvoidancePath(TrackDirection, Input->Perception.ObstacleHitDistance, Input->Perception.SafeDirection);
+
+	bHasPlan = true;
+}
+
+void USplineFollowerComponent::SuspendPhysicsThreadControl()
+{
+	if (!PhysicsCallback) return;
+
+	// the inputs set on the game thread reach the wheels until the next planning update hands the control back. Sent every
+	// frame, a physics step that skips a frame's input still gets it from the next one
+	PhysicsCallback->GetProducerInputData_External()->bEnabled = false;
+
+	// the maneuver moves the vehicle away from where the physics thread last found it
+	bResetPhysicsTrackDistance = true;
+}
+
+bool USplineFollowerComponent::IsLaneClearOnGrid(const FVector& VehicleLocation)
+{
+	const FVector2D TrackCoordinates = TrackTable->GetTrackCoordinates(VehicleLocation, GridTrackDistance);
+	GridTrackDistance = TrackCoordinates.X;
+
+	if (!OccupancyGrid->IsCorridorClear(TrackCoordinates.X, TrackCoordinates.X + ObstacleTraceDistance,
+		TrackCoordinates.Y - ObstacleTraceRadius, TrackCoordinates.Y + ObstacleTraceRadius))
+		return false;
+
+	// the grid doesn't hold the vehicles, the probes still have to see them
+	if (VehicleSubsystem)
+	{
+		TArray<const FDriverlessVehicleState*, TInlineAllocator<16>> NearbyVehicles;
+		VehicleSubsystem->QueryNearbyVehicles(VehicleLocation, ObstacleTraceDistance + ObstacleTraceRadius, this, NearbyVehicles);
+		if (NearbyVehicles.Num() > 0)
+			return false;
+	}
+
+	return true;
+}
+
+bool USplineFollowerComponent::FindSafeAvoidancePath(const FVector& TrackDirection, float& OutHitDistance, FVector& OutSafeDirection)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_AvoidanceDecision);
+
 	OutHitDistance = ObstacleTraceDistance; // assume clear initially
 	OutSafeDirection = OwnerPawn->GetActorForwardVector(); // it goes forward by default
 	bool obstacleDetected = false;
+	bAvoidingObstacle = false;
 
 	if (ObstacleTraceDistance <= 0.0f || ObstacleTraceRadius <= 0.0f)
 		return false;
@@ -209,181 +750,770 @@ bool USplineFollowerComponent::FindSafeAvoidancePath(float& OutHitDistance, FVec
 	const FVector VehicleLocation = OwnerPawn->GetActorLocation();
 	const FVector VehicleForward = OwnerPawn->GetActorForwardVector();
 
+	// the lane ahead is clear on the grid: nothing for the probes to find but other vehicles
+	if (OccupancyGrid && TrackTable && IsLaneClearOnGrid(VehicleLocation))
+	{
+		INC_DWORD_STAT(STAT_Driverless_ProbeSweepsSkipped);
+		return false;
+	}
+
 	const float StartForwardOffset = 150.0f;
 	const float StartUpOffset = FMath::Max(ObstacleTraceRadius, 200.0f);
 	const FVector TraceStart = VehicleLocation + (VehicleForward * StartForwardOffset) + FVector::UpVector * StartUpOffset;
 
-	FHitResult CenterHit, LeftHit, RightHit;
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(OwnerPawn);
-	TArray<AActor*> ActorsToIgnore;
-	ActorsToIgnore.Add(OwnerPawn);
-
-	TArray<TEnumAsByte<EObjectTypeQuery>> ObjectTypes;
-	ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_WorldStatic));
-	ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_WorldDynamic));
-	ObjectTypes.Add(UEngineTypes::ConvertToObjectType(ECC_PhysicsBody));
+	UpdateProbeFan(VehicleForward);
 
-	EDrawDebugTrace::Type DebugDrawType = EDrawDebugTrace::ForOneFrame;
+	// reuse the previous sweep if the vehicle barely moved since, otherwise sweep again
+	if (bUseAsyncProbes)
+	{
+		// a batch issued last frame is the freshest data we can get
+		const bool bCollected = CollectAsyncProbes();
+		if (ReprojectProbeCache(TraceStart, bCollected))
+		{
+			if (!bCollected) INC_DWORD_STAT(STAT_Driverless_ProbeSweepsSkipped);
+		}
+		else if (PendingProbeTraces.Num() == 0)
+		{
+			IssueAsyncProbes(TraceStart);
+		}
 
-	// 1. Center Trace
-	const FVector CenterTraceEnd = TraceStart + VehicleForward * ObstacleTraceDistance;
-	bool bCenterHit = UKismetSystemLibrary::SphereTraceSingleForObjects(GetWorld(), TraceStart, CenterTraceEnd, ObstacleTraceRadius, ObjectTypes, false, ActorsToIgnore, DebugDrawType, CenterHit, true, FLinearColor::Yellow, FLinearColor::Red, 0.1f);
-	if (bCenterHit) OutHitDistance = FMath::Min(OutHitDistance, CenterHit.Distance);
+		// while the new batch is in flight, keep steering with the previous one
+		if (!ReprojectProbeCache(TraceStart, true))
+			return false;
+	}
+	else if (!ReprojectProbeCache(TraceStart, false))
+	{
+		SweepProbes(TraceStart);
+		ReprojectProbeCache(TraceStart, true);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_Driverless_ProbeSweepsSkipped);
+	}
 
-	// 2. Left Probe Trace
-	const FVector LeftDirection = VehicleForward.RotateAngleAxis(-AvoidanceProbeAngle, FVector::UpVector);
-	const FVector LeftTraceEnd = TraceStart + LeftDirection * ObstacleTraceDistance;
-	bool bLeftHit = UKismetSystemLibrary::SphereTraceSingleForObjects(GetWorld(), TraceStart, LeftTraceEnd, ObstacleTraceRadius, ObjectTypes, false, ActorsToIgnore, DebugDrawType, LeftHit, true, FLinearColor::Blue, FLinearColor::Red, 0.1f);
-	if (bLeftHit) OutHitDistance = FMath::Min(OutHitDistance, LeftHit.Distance);
+	const int32 NumProbes = ProbeAngles.Num();
+	const bool bDebugDraw = UDriverlessDebugDrawSubsystem::IsEnabled();
+	for (int32 i = 0; i < NumProbes; i++)
+	{
+		const bool bHit = ProbeCache.Probes[i].bHit;
+		if (bDebugDraw)
+			DebugHistory.SetProbe(i, NumProbes, TraceStart, TraceStart + ProbeDirections[i] * ProbeDistances[i], bHit);
 
-	// 3. Right Probe Trace
-	const FVector RightDirection = VehicleForward.RotateAngleAxis(AvoidanceProbeAngle, FVector::UpVector);
-	const FVector RightTraceEnd = TraceStart + RightDirection * ObstacleTraceDistance;
-	bool bRightHit = UKismetSystemLibrary::SphereTraceSingleForObjects(GetWorld(), TraceStart, RightTraceEnd, ObstacleTraceRadius, ObjectTypes, false, ActorsToIgnore, DebugDrawType, RightHit, true, FLinearColor::MakeRandomColor(), FLinearColor::Red, 0.1f);
-	if (bRightHit) OutHitDistance = FMath::Min(OutHitDistance, RightHit.Distance);
+		if (!bHit) continue;
 
-	obstacleDetected = bCenterHit || bLeftHit || bRightHit;
+		OutHitDistance = FMath::Min(OutHitDistance, ProbeDistances[i]);
+		obstacleDetected = true;
+	}
 
 	if (obstacleDetected)
 	{
-		// choose safe direction
-		float LeftDist = bLeftHit ? LeftHit.Distance : ObstacleTraceDistance;
-		float RightDist = bRightHit ? RightHit.Distance : ObstacleTraceDistance;
+		// choose the probe with the best trade-off between free space, track direction and steering effort
+		const int32 BestProbe = ScoreProbeFan(VehicleForward, TrackDirection);
+		OutSafeDirection = ProbeDirections[BestProbe];
+
+		bAvoidingObstacle = true;
+		AvoidanceAngle = ProbeAngles[BestProbe];
+	}
+	// If !obstacleDetected, OutSafeDirection remains VehicleForward
+
+	return obstacleDetected;
+}
+
+void USplineFollowerComponent::UpdateProbeFan(const FVector& VehicleForward)
+{
+	// angles are either user provided or evenly spread across the fan
+	ProbeAngles.Reset();
+	if (CustomProbeAngles.Num() > 0)
+	{
+		ProbeAngles.Append(CustomProbeAngles);
+	}
+	else if (NumAvoidanceProbes <= 1)
+	{
+		ProbeAngles.Add(0.0f);
+	}
+	else
+	{
+		for (int32 i = 0; i < NumAvoidanceProbes; i++)
+			ProbeAngles.Add(FMath::Lerp(-AvoidanceProbeAngle, AvoidanceProbeAngle, (float)i / (NumAvoidanceProbes - 1)));
+	}
+
+	const int32 NumProbes = ProbeAngles.Num();
+	ProbeDirections.SetNumUninitialized(NumProbes, EAllowShrinking::No);
+	ProbeDistances.SetNumUninitialized(NumProbes, EAllowShrinking::No);
+
+	// every probe starts clear, whatever path fills the distances (or fails to) afterwards
+	for (int32 i = 0; i < NumProbes; i++)
+	{
+		ProbeDirections[i] = VehicleForward.RotateAngleAxis(ProbeAngles[i], FVector::UpVector);
+		ProbeDistances[i] = ObstacleTraceDistance;
+	}
+
+	// a different fan makes the cached sweep meaningless
+	if (ProbeCache.Probes.Num() != NumProbes)
+	{
+		ProbeCache.bValid = false;
+		ProbeCache.Probes.SetNum(NumProbes);
+	}
+}
+
+void USplineFollowerComponent::SweepProbes(const FVector& TraceStart)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_ProbeSweeps);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(SplineFollowerProbe), false, OwnerPawn);
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(ObstacleTraceRadius);
+
+	for (int32 i = 0; i < ProbeDirections.Num(); i++)
+	{
+		FHitResult Hit;
+		const FVector TraceEnd = TraceStart + ProbeDirections[i] * ObstacleTraceDistance;
+		const bool bHit = GetWorld()->SweepSingleByObjectType(Hit, TraceStart, TraceEnd, FQuat::Identity, ObjectParams, Sphere, QueryParams);
+
+		FProbeResult& Probe = ProbeCache.Probes[i];
+		Probe.bHit = bHit;
+		Probe.HitLocation = Hit.Location;
+		Probe.HitActor = Hit.GetActor();
+		Probe.HitActorTransform = Hit.GetActor() ? Hit.GetActor()->GetActorTransform() : FTransform::Identity;
+	}
+
+	ProbeCache.bValid = true;
+	ProbeCache.Pose = OwnerPawn->GetActorTransform();
+	ProbeCache.Time = GetWorld()->GetTimeSeconds();
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ProbesIssued, DriverlessProbesIssued, ProbeDirections.Num());
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ProbesHit, DriverlessProbesHit, CountProbeHits());
+}
+
+void USplineFollowerComponent::IssueAsyncProbes(const FVector& TraceStart)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_ProbeSweeps);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(SplineFollowerProbe), false, OwnerPawn);
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(ObstacleTraceRadius);
+
+	// the whole fan goes out in the same frame, the engine runs the batch in parallel
+	PendingProbeTraces.Reset();
+	for (int32 i = 0; i < ProbeDirections.Num(); i++)
+	{
+		const FVector TraceEnd = TraceStart + ProbeDirections[i] * ObstacleTraceDistance;
+		PendingProbeTraces.Add(GetWorld()->AsyncSweepByObjectType(EAsyncTraceType::Single, TraceStart, TraceEnd, FQuat::Identity, ObjectParams, Sphere, QueryParams));
+	}
+
+	PendingProbePose = OwnerPawn->GetActorTransform();
+	PendingProbeTime = GetWorld()->GetTimeSeconds();
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ProbesIssued, DriverlessProbesIssued, PendingProbeTraces.Num());
+}
+
+bool USplineFollowerComponent::CollectAsyncProbes()
+{
+	if (PendingProbeTraces.Num() == 0) return false;
+
+	// the fan changed while the batch was in flight, throw it away
+	if (PendingProbeTraces.Num() != ProbeCache.Probes.Num())
+	{
+		PendingProbeTraces.Reset();
+		return false;
+	}
+
+	UWorld* World = GetWorld();
+
+	// the batch was issued too long ago and its results are gone, a new one will be issued
+	if (!World->IsTraceHandleValid(PendingProbeTraces[0], false))
+	{
+		PendingProbeTraces.Reset();
+		return false;
+	}
+
+	// the whole batch completes together, so checking the first trace is enough
+	FTraceDatum Datum;
+	if (!World->QueryTraceData(PendingProbeTraces[0], Datum))
+		return false;
+
+	for (int32 i = 0; i < PendingProbeTraces.Num(); i++)
+	{
+		if (i > 0) World->QueryTraceData(PendingProbeTraces[i], Datum);
+
+		const FHitResult* Hit = FHitResult::GetFirstBlockingHit(Datum.OutHits);
+
+		FProbeResult& Probe = ProbeCache.Probes[i];
+		Probe.bHit = Hit != nullptr;
+		Probe.HitLocation = Hit ? Hit->Location : FVector::ZeroVector;
+		Probe.HitActor = Hit ? Hit->GetActor() : nullptr;
+		Probe.HitActorTransform = (Hit && Hit->GetActor()) ? Hit->GetActor()->GetActorTransform() : FTransform::Identity;
+	}
+
+	ProbeCache.bValid = true;
+	ProbeCache.Pose = PendingProbePose;
+	ProbeCache.Time = PendingProbeTime;
+	PendingProbeTraces.Reset();
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_ProbesHit, DriverlessProbesHit, CountProbeHits());
+
+	return true;
+}
+
+int32 USplineFollowerComponent::CountProbeHits() const
+{
+	int32 NumHits = 0;
+	for (const FProbeResult& Probe : ProbeCache.Probes)
+		NumHits += Probe.bHit ? 1 : 0;
+	return NumHits;
+}
+
+bool USplineFollowerComponent::ReprojectProbeCache(const FVector& TraceStart, bool bIgnoreThresholds)
+{
+	if (!ProbeCache.bValid) return false;
+
+	// thresholds only gate reuse of an old sweep, a fresh one is always reprojected
+	const FTransform CurrentPose = OwnerPawn->GetActorTransform();
+
+	if (!bIgnoreThresholds)
+	{
+		if (!bUseProbeCache) return false;
+
+		// the vehicle moved or turned too much since the cached sweep
+		if (FVector::DistSquared(CurrentPose.GetLocation(), ProbeCache.Pose.GetLocation()) > FMath::Square(ProbeCacheMaxTranslation))
+			return false;
+
+		const float YawDelta = FMath::Abs(FRotator::NormalizeAxis(CurrentPose.Rotator().Yaw - ProbeCache.Pose.Rotator().Yaw));
+		if (YawDelta > ProbeCacheMaxRotation)
+			return false;
+
+		if (GetWorld()->GetTimeSeconds() - ProbeCache.Time > ProbeCacheMaxAge)
+			return false;
+	}
+
+	for (int32 i = 0; i < ProbeCache.Probes.Num(); i++)
+	{
+		const FProbeResult& Probe = ProbeCache.Probes[i];
+		ProbeDistances[i] = ObstacleTraceDistance;
 
-		// move either left or right, based on which side has more space
-		if (LeftDist > RightDist + KINDA_SMALL_NUMBER)
+		if (!Probe.bHit) continue;
+
+		if (!bIgnoreThresholds)
 		{
-			OutSafeDirection = LeftDirection;
-			if (GEngine) GEngine->AddOnScreenDebugMessage(5, 0.0f, FColor::Cyan, TEXT("AVOID: Steering Left"));
+			// the obstacle we hit was destroyed or has moved (e.g. a cone was knocked over)
+			const AActor* HitActor = Probe.HitActor.Get();
+			if (!HitActor || !HitActor->GetActorTransform().Equals(Probe.HitActorTransform, 1.0f))
+				return false;
 		}
-		else if (RightDist > LeftDist + KINDA_SMALL_NUMBER)
+
+		// distance of the cached impact along the new probe ray
+		const FVector ToHit = Probe.HitLocation - TraceStart;
+		const float AlongRay = FVector::DotProduct(ToHit, ProbeDirections[i]);
+
+		// the impact drifted out of the probe's reach, it needs a real sweep
+		if (!bIgnoreThresholds && (ToHit - ProbeDirections[i] * AlongRay).SizeSquared() > FMath::Square(ObstacleTraceRadius))
+			return false;
+
+		ProbeDistances[i] = FMath::Clamp(AlongRay, 0.0f, ObstacleTraceDistance);
+	}
+
+	return true;
+}
+
+int32 USplineFollowerComponent::ScoreProbeFan(const FVector& VehicleForward, const FVector& TrackDirection)
+{
+	FFollowerProbeWeights Weights;
+	Weights.Clearance = ClearanceWeight;
+	Weights.TrackAlignment = TrackAlignmentWeight;
+	Weights.SteeringChange = SteeringChangeWeight;
+
+	return FollowerControl::ScoreProbeFan(MakeControlParams(), Weights, ProbeDirections, ProbeDistances,
+		VehicleForward, TrackDirection, VehicleMovementComponent->GetSteeringInput(), ProbeScoring);
+}
+
+USplineFollowerComponent::FTrafficResponse USplineFollowerComponent::ComputeTrafficResponse(const FVector& VehicleLocation, const FVector& VehicleForward)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Traffic);
+
+	FTrafficResponse Response;
+
+	if (!VehicleSubsystem || VehicleAwarenessRadius <= 0.0f)
+		return Response;
+
+	// room for the steering target to shift into on each side before the probes would find the wall, from the track boundaries.
+	// Measured every update so the track distance stays a good hint
+	float LeftRoom = OvertakeLateralOffset;
+	float RightRoom = OvertakeLateralOffset;
+	if (TrackTable && TrackTable->HasBoundaries())
+	{
+		const FVector2D TrackCoordinates = TrackTable->GetTrackCoordinates(VehicleLocation, WallTrackDistance);
+		WallTrackDistance = TrackCoordinates.X;
+
+		const FVector2D Clearance = TrackTable->GetWallClearance(TrackCoordinates.X, TrackCoordinates.Y);
+		LeftRoom = FMath::Clamp(Clearance.X - ObstacleTraceRadius, 0.0f, OvertakeLateralOffset);
+		RightRoom = FMath::Clamp(Clearance.Y - ObstacleTraceRadius, 0.0f, OvertakeLateralOffset);
+	}
+
+	TArray<const FDriverlessVehicleState*, TInlineAllocator<16>> NearbyVehicles;
+	VehicleSubsystem->QueryNearbyVehicles(VehicleLocation, VehicleAwarenessRadius, this, NearbyVehicles);
+
+	if (NearbyVehicles.Num() == 0)
+		return Response;
+
+	const FVector VehicleRight = OwnerPawn->GetActorRightVector();
+	const FVector VehicleVelocity = OwnerPawn->GetVelocity();
+
+	const FDriverlessVehicleState* LeadVehicle = nullptr;
+	float LeadDistance = MAX_flt;
+	float LeadLateral = 0.0f;
+
+	// cars alongside or just ahead, on each side, that would block an overtake
+	bool bLeftBlocked = LeftRoom <= 0.0f;
+	bool bRightBlocked = RightRoom <= 0.0f;
+
+	for (const FDriverlessVehicleState* Other : NearbyVehicles)
+	{
+		const FVector ToOther = Other->Location - VehicleLocation;
+		const float Ahead = FVector::DotProduct(ToOther, VehicleForward);
+		const float Lateral = FVector::DotProduct(ToOther, VehicleRight);
+
+		// closest car in our lane is the one to follow
+		if (Ahead > 0.0f && FMath::Abs(Lateral) < FollowingLaneHalfWidth && Ahead < LeadDistance)
 		{
-			OutSafeDirection = RightDirection;
-			if (GEngine) GEngine->AddOnScreenDebugMessage(5, 0.0f, FColor::Cyan, TEXT("AVOID: Steering Right"));
+			LeadVehicle = Other;
+			LeadDistance = Ahead;
+			LeadLateral = Lateral;
 		}
-		else // If both sides are blocked similarly (or center is blocked but sides are clear)
+		else if (FMath::Abs(Ahead) < MinFollowingDistance)
 		{
-			// Default to turning towards the side with slightly more space, or pick one if equal
-			OutSafeDirection = (LeftDist >= RightDist) ? LeftDirection : RightDirection;
-
-			if (GEngine) GEngine->AddOnScreenDebugMessage(5, 0.0f, FColor::Cyan, FString::Printf(TEXT("AVOID: Center blocked, choosing %s"), (LeftDist >= RightDist) ? TEXT("Left") : TEXT("Right")));
+			bLeftBlocked |= Lateral < 0.0f;
+			bRightBlocked |= Lateral > 0.0f;
 		}
+
+		// closest approach, assuming both vehicles keep their velocity
+		const FVector RelativeVelocity = Other->Velocity - VehicleVelocity;
+		const float RelativeSpeedSq = RelativeVelocity.SizeSquared2D();
+		const float TimeToClosest = (RelativeSpeedSq > KINDA_SMALL_NUMBER)
+			? FMath::Clamp(-FVector::DotProduct(ToOther, RelativeVelocity) / RelativeSpeedSq, 0.0f, CollisionPredictionTime)
+			: 0.0f;
+		const float MissDistance = (ToOther + RelativeVelocity * TimeToClosest).Size2D();
+
+		// only brake for what's in front, the cars behind are the ones who should brake
+		if (Ahead > 0.0f && MissDistance < 2.0f * VehicleCollisionRadius && CollisionPredictionTime > 0.0f)
+			Response.Brake = FMath::Max(Response.Brake, 1.0f - TimeToClosest / CollisionPredictionTime);
 	}
-	// If !obstacleDetected, OutSafeDirection remains VehicleForward
 
-	return obstacleDetected;
+	if (LeadVehicle)
+	{
+		// keep a speed dependent gap to the car ahead
+		const float Speed = FMath::Abs(VehicleMovementComponent->GetForwardSpeed());
+		const float DesiredGap = MinFollowingDistance + Speed * FollowingTimeGap;
+		Response.ThrottleScale = FMath::Clamp((LeadDistance - MinFollowingDistance) / FMath::Max(DesiredGap - MinFollowingDistance, 1.0f), 0.0f, 1.0f);
+
+		// pass on the side the lead car leaves open, unless another car or the wall is already there
+		float Side = (LeadLateral > 0.0f) ? -1.0f : 1.0f;
+		if ((Side < 0.0f && bLeftBlocked) || (Side > 0.0f && bRightBlocked))
+			Side = -Side;
+
+		if (!(bLeftBlocked && bRightBlocked))
+			Response.TargetOffset = VehicleRight * Side * (Side < 0.0f ? LeftRoom : RightRoom) * (1.0f - Response.ThrottleScale);
+	}
+
+	return Response;
+}
+
+void USplineFollowerComponent::SetKinematicLOD(bool bKinematic)
+{
+	if (bKinematic == bKinematicLOD || !OwnerPawn || !VehicleMovementComponent || !PathTable)
+		return;
+
+	// a recording, a replay or an external agent needs every step simulated
+	if (bKinematic && (!bAllowPhysicsLOD || bRecordCommands || ControlSource != EFollowerControlSource::Controller))
+		return;
+
+	UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent());
+	if (!Body) return;
+
+	if (bKinematic)
+	{
+		// carry the current state over to the track, so the car doesn't jump
+		const FVector Location = OwnerPawn->GetActorLocation();
+		KinematicDistance = PathTable->FindDistanceClosestToLocation(Location);
+
+		const FVector TrackLocation = PathTable->GetLocationAtDistance(KinematicDistance);
+		const FVector TrackRight = FVector::CrossProduct(FVector::UpVector, PathTable->GetDirectionAtDistance(KinematicDistance)).GetSafeNormal();
+		KinematicLateralOffset = FVector::DotProduct(Location - TrackLocation, TrackRight);
+		KinematicHeightOffset = Location.Z - TrackLocation.Z;
+		KinematicSpeed = FMath::Max(VehicleMovementComponent->GetForwardSpeed(), 0.0f);
+
+		Body->SetSimulatePhysics(false);
+		VehicleMovementComponent->SetComponentTickEnabled(false);
+
+		// whatever the car was doing doesn't make sense anymore
+		StuckState.Reset();
+		EndPlannedRecovery();
+	}
+	else
+	{
+		// hand the playback speed back to the physics body, the controller takes it from there
+		Body->SetSimulatePhysics(true);
+		Body->SetPhysicsLinearVelocity(OwnerPawn->GetActorForwardVector() * KinematicSpeed);
+		Body->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+
+		VehicleMovementComponent->SetComponentTickEnabled(true);
+		VehicleMovementComponent->SetTargetGear(1, true);
+
+		ProbeCache.bValid = false;
+		bHasPlan = false;
+		DebugHistory.ResetTrail();
+
+		// the playback moved the car anywhere along the track, the distances it was last found at are no longer valid hints
+		bResetPhysicsTrackDistance = true;
+		PhysicsTrackDistance = KinematicDistance; // until the physics thread reports its own
+		AgentTrackDistance = -1.0f;
+		GridTrackDistance = -1.0f;
+		WallTrackDistance = -1.0f;
+		PathDistance = -1.0f;
+	}
+
+	bKinematicLOD = bKinematic;
 }
 
-void USplineFollowerComponent::PrintTelemetry()
+void USplineFollowerComponent::SaveSnapshot(FFollowerSnapshot& OutSnapshot) const
 {
-	if (!GEngine) return;
+	if (!OwnerPawn || !VehicleMovementComponent) return;
+
+	if (const UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent()))
+		UDriverlessSnapshotSubsystem::SaveBody(*Body, OutSnapshot.Body);
+
+	OutSnapshot.Gear = VehicleMovementComponent->GetTargetGear();
+	OutSnapshot.Steering = VehicleMovementComponent->GetSteeringInput();
+	OutSnapshot.Throttle = VehicleMovementComponent->GetThrottleInput();
+	OutSnapshot.Brake = VehicleMovementComponent->GetBrakeInput();
+
+	OutSnapshot.StuckState = StuckState;
+	OutSnapshot.ControlAccumulator = ControlAccumulator;
+	OutSnapshot.bAvoidingObstacle = bAvoidingObstacle;
+	OutSnapshot.AvoidanceAngle = AvoidanceAngle;
+	OutSnapshot.PhysicsTrackDistance = PhysicsTrackDistance;
+	OutSnapshot.DebugHistory = DebugHistory;
+
+	OutSnapshot.bKinematicLOD = bKinematicLOD;
+	OutSnapshot.KinematicDistance = KinematicDistance;
+	OutSnapshot.KinematicSpeed = KinematicSpeed;
+	OutSnapshot.KinematicLateralOffset = KinematicLateralOffset;
+	OutSnapshot.KinematicHeightOffset = KinematicHeightOffset;
+}
 
-	FString DebugMsg;
+void USplineFollowerComponent::RestoreSnapshot(const FFollowerSnapshot& Snapshot)
+{
+	if (!OwnerPawn || !VehicleMovementComponent) return;
 
-	/* STATE in key 1 */
-	FString State = TEXT("NORMAL");
+	UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent());
+	if (!Body) return;
 
-	if (StuckTime != 0.0f) {
+	// switch the body to the physics LOD it had first, the pose and velocities are applied over it
+	SetKinematicLOD(Snapshot.bKinematicLOD);
+	UDriverlessSnapshotSubsystem::RestoreBody(*Body, Snapshot.Body);
 
-		if (StuckTime > 0.0f) { // either stuck
-			State = FString::Printf(TEXT("STUCK for %.2f / %.2f"), StuckTime, MaxStuckTime);
-		}
-		else { // or reversing
-			State = FString::Printf(TEXT("REVERSING for %.2f / %.2f"), (UnstuckTime + StuckTime), UnstuckTime);
-		}
+	if (!bKinematicLOD)
+	{
+		if (VehicleMovementComponent->GetTargetGear() != Snapshot.Gear)
+			VehicleMovementComponent->SetTargetGear(Snapshot.Gear, true);
+		VehicleMovementComponent->SetSteeringInput(Snapshot.Steering);
+		VehicleMovementComponent->SetThrottleInput(Snapshot.Throttle);
+		VehicleMovementComponent->SetBrakeInput(Snapshot.Brake);
 	}
 
-	DebugMsg = FString::Printf(TEXT("Vehicle %d State: %s"), TelemetryDisplayIndex, *State);
-	GEngine->AddOnScreenDebugMessage(TelemetryDisplayIndex * 5 + 1, 0.0f, FColor::Cyan, DebugMsg);
+	StuckState = Snapshot.StuckState;
+	EndPlannedRecovery();
+	ControlAccumulator = Snapshot.ControlAccumulator;
+	bAvoidingObstacle = Snapshot.bAvoidingObstacle;
+	AvoidanceAngle = Snapshot.AvoidanceAngle;
+	PhysicsTrackDistance = Snapshot.PhysicsTrackDistance;
+	DebugHistory = Snapshot.DebugHistory;
+
+	KinematicDistance = Snapshot.KinematicDistance;
+	KinematicSpeed = Snapshot.KinematicSpeed;
+	KinematicLateralOffset = Snapshot.KinematicLateralOffset;
+	KinematicHeightOffset = Snapshot.KinematicHeightOffset;
+
+	// perception and plan were taken somewhere else, they are redone from the restored pose at the next tick
+	bHasPlan = false;
+	ProbeCache.bValid = false;
+	PendingProbeTraces.Reset();
+	bResetPhysicsTrackDistance = true;
+	AgentTrackDistance = -1.0f;
+	GridTrackDistance = -1.0f;
+	WallTrackDistance = -1.0f;
+	PathDistance = -1.0f;
+
+	if (StateEstimator)
+		StateEstimator->ResetEstimate();
+}
+
+void USplineFollowerComponent::TickKinematic(float DeltaTime)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_Kinematic);
 
-	/* SPEED in key 2 */
-	float CurrentSpeed = FMath::Abs(VehicleMovementComponent->GetForwardSpeed()) * 0.036f; //km/h
+	// follow the speed profile of the track, with a plausible acceleration
+	const float TargetSpeed = PathTable->GetSpeedAtDistance(KinematicDistance);
+	KinematicSpeed = FMath::FInterpConstantTo(KinematicSpeed, TargetSpeed, DeltaTime, KinematicAcceleration);
+	KinematicDistance = PathTable->WrapDistance(KinematicDistance + KinematicSpeed * DeltaTime);
 
-	DebugMsg = FString::Printf(TEXT("Vehicle %d Speed: %.1f km/h"), TelemetryDisplayIndex, CurrentSpeed);
-	GEngine->AddOnScreenDebugMessage(TelemetryDisplayIndex * 5 + 2, 0.0f, FColor::Yellow, DebugMsg);
+	// slowly drift back onto the path
+	KinematicLateralOffset = FMath::FInterpTo(KinematicLateralOffset, 0.0f, DeltaTime, 0.5f);
 
-	/* STEERING in key 3 */
-	DebugMsg = FString::Printf(TEXT("Vehicle %d Steering: %.2f"), TelemetryDisplayIndex, VehicleMovementComponent->GetSteeringInput());
-	GEngine->AddOnScreenDebugMessage(TelemetryDisplayIndex * 5 + 3, 0.0f, FColor::Green, DebugMsg);
+	const FVector Direction = PathTable->GetDirectionAtDistance(KinematicDistance);
+	const FVector Right = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+	const FVector Location = PathTable->GetLocationAtDistance(KinematicDistance) + Right * KinematicLateralOffset + FVector::UpVector * KinematicHeightOffset;
 
-	/* THROTTLE & BRAKE in key 4 */
-	DebugMsg = FString::Printf(TEXT("Vehicle %d Throttle: %.2f | Brake: %.2f"), TelemetryDisplayIndex, VehicleMovementComponent->GetThrottleInput(), VehicleMovementComponent->GetBrakeInput());
-	GEngine->AddOnScreenDebugMessage(TelemetryDisplayIndex * 5 + 4, 0.0f, FColor::Blue, DebugMsg);
+	OwnerPawn->SetActorLocationAndRotation(Location, Direction.Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
 }
 
-bool USplineFollowerComponent::HandleStuckState(float DeltaTime)
+void USplineFollowerComponent::GetTelemetry(FFollowerTelemetry& OutTelemetry) const
 {
-	if (StuckTime < 0.0f) // reversing
+	OutTelemetry.DisplayIndex = TelemetryDisplayIndex;
+	OutTelemetry.bAvoiding = bAvoidingObstacle;
+	OutTelemetry.AvoidanceAngle = AvoidanceAngle;
+	OutTelemetry.TickTimeUs = LastTickSeconds * 1e6;
+
+	if (!VehicleMovementComponent) return;
+
+	OutTelemetry.SpeedKmh = FMath::Abs(VehicleMovementComponent->GetForwardSpeed()) * 0.036f; //km/h
+	OutTelemetry.Steering = VehicleMovementComponent->GetSteeringInput();
+	OutTelemetry.Throttle = VehicleMovementComponent->GetThrottleInput();
+	OutTelemetry.Brake = VehicleMovementComponent->GetBrakeInput();
+
+	if (bKinematicLOD)
+	{
+		OutTelemetry.State = EFollowerTelemetryState::Kinematic;
+	}
+	else if (bPlannedRecovery)
+	{
+		OutTelemetry.State = RecoveryMotion.Direction < 0 ? EFollowerTelemetryState::Reversing : EFollowerTelemetryState::Recovering;
+		OutTelemetry.StateTime = PlannedRecoveryTime;
+		OutTelemetry.StateDuration = PlannedRecoveryTimeout;
+	}
+	else if (StuckState.IsReversing())
+	{
+		OutTelemetry.State = EFollowerTelemetryState::Reversing;
+		OutTelemetry.StateTime = UnstuckTime + StuckState.StuckTime;
+		OutTelemetry.StateDuration = UnstuckTime;
+	}
+	else if (StuckState.bPostRecovery)
+	{
+		OutTelemetry.State = EFollowerTelemetryState::Recovering;
+		OutTelemetry.StateTime = StuckState.StuckTime;
+		OutTelemetry.StateDuration = MaxStuckTime / 2;
+	}
+	else if (StuckState.StuckTime > 0.0f)
 	{
-		VehicleMovementComponent->SetTargetGear(-1, true); // reverse
-		VehicleMovementComponent->SetThrottleInput(1.0f);
-		VehicleMovementComponent->SetSteeringInput(RecoverySteer);
-		VehicleMovementComponent->SetBrakeInput(0.0f);
+		OutTelemetry.State = EFollowerTelemetryState::Stuck;
+		OutTelemetry.StateTime = StuckState.StuckTime;
+		OutTelemetry.StateDuration = MaxStuckTime;
+	}
+	else
+	{
+		OutTelemetry.State = EFollowerTelemetryState::Normal;
+	}
+}
 
-		StuckTime += DeltaTime;
+FFollowerStuckParams USplineFollowerComponent::MakeStuckParams() const
+{
+	FFollowerStuckParams Params;
+	Params.MaxStuckTime = MaxStuckTime;
+	Params.UnstuckTime = UnstuckTime;
+	return Params;
+}
 
-		if (StuckTime >= 0.0f) {
-			StuckTime = MaxStuckTime / 2;
-			isPostRecovery = true;
-			VehicleMovementComponent->SetTargetGear(1, true); // forward
-		}
+bool USplineFollowerComponent::HandleStuckState(float DeltaTime)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_StuckHandling);
 
+	// a planned maneuver that gives up leaves the stuck state reversing blindly
+	if (bPlannedRecovery && TickPlannedRecovery(DeltaTime))
 		return true;
+
+	const FFollowerStuckParams Params = MakeStuckParams();
+	const FFollowerStuckOutput Output = StuckState.Update(Params, DeltaTime, VehicleMovementComponent->GetForwardSpeed());
+
+	if (Output.bStartRecovery)
+	{
+		// plan it rather than reverse blindly, when a way out can be found
+		if (bPlanRecovery && StartPlannedRecovery())
+		{
+			StuckState.Reset();
+			return TickPlannedRecovery(DeltaTime);
+		}
+
+		// the side is only drawn here, seeded and replayed runs see the random stream advance when a vehicle gets stuck
+		StuckState.StartRecovery(Params, FMath::RandBool());
 	}
 
-	if (StuckTime > 0.0f && isPostRecovery) {
-		// after recovery, drive forward for a short while
-		StuckTime -= DeltaTime;
+	if (Output.TargetGear != 0)
+		VehicleMovementComponent->SetTargetGear(Output.TargetGear, true);
+	if (Output.Throttle.IsSet())
+		VehicleMovementComponent->SetThrottleInput(Output.Throttle.GetValue());
+	if (Output.Steering.IsSet())
+		VehicleMovementComponent->SetSteeringInput(Output.Steering.GetValue());
+	if (Output.Brake.IsSet())
+		VehicleMovementComponent->SetBrakeInput(Output.Brake.GetValue());
+
+	return Output.bOverride;
+}
+
+bool USplineFollowerComponent::StartPlannedRecovery()
+{
+	if (!TrackTable)
+		return false;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_RecoveryPlanner);
+	LLM_SCOPE_BYTAG(Driverless_Follower);
+
+	// the maneuver is planned from the true pose, like the perception it relies on
+	const FVector Location = OwnerPawn->GetActorLocation();
+	const FVector Forward = OwnerPawn->GetActorForwardVector();
 
-		if (StuckTime <= 0.0f) {
-			StuckTime = 0.0f;
-			isPostRecovery = false;
-			VehicleMovementComponent->SetThrottleInput(0.0f);
+	FRecoveryPlannerParams Params;
+	Params.MinTurnRadius = RecoveryTurnRadius;
+	if (const UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(OwnerPawn->GetRootComponent()))
+	{
+		const FVector Size = 2.0 * Body->CalcLocalBounds().BoxExtent * Body->GetComponentScale();
+		Params.VehicleLength = Size.X;
+		Params.VehicleWidth = Size.Y;
+	}
+	RecoveryPlanner.Init(Params, FVector2D(Location));
+
+	// the vehicle has to end up heading along the track
+	const float TrackDistance = TrackTable->FindDistanceClosestToLocation(Location);
+	const int32 GridSize = RecoveryPlanner.GetGridSize();
+	for (int32 Y = 0; Y < GridSize; Y++)
+	{
+		for (int32 X = 0; X < GridSize; X++)
+		{
+			const FVector Cell(RecoveryPlanner.GetCellCenter(X, Y), Location.Z);
+			const FVector Direction = TrackTable->GetDirectionAtDistance(TrackTable->FindDistanceClosestToLocation(Cell, TrackDistance));
+			RecoveryPlanner.SetGoalHeading(X, Y, FMath::Atan2(Direction.Y, Direction.X));
 		}
-		return true;
 	}
 
-	const float StuckSpeedTreshold = 0.5f; // cm/s
-	// if we're practically still, update the stuck timer. Otherwise, reset it
-	if (FMath::Abs(VehicleMovementComponent->GetForwardSpeed()) < StuckSpeedTreshold)
-		StuckTime += DeltaTime;
-	else
-		StuckTime = 0.0f;
+	SenseRecoveryObstacles();
 
-	// if we're stuck for too long, initiate reversing
-	if (StuckTime > MaxStuckTime)
+	// nothing to plan when no way out is seen, or the vehicle looks free already (something the traces can't see holds it)
+	if (!RecoveryPlanner.Plan(FVector2D(Location), FMath::Atan2(Forward.Y, Forward.X)) || RecoveryPlanner.IsAtGoal())
 	{
-		StuckTime = -UnstuckTime;
-		RecoverySteer = (FMath::RandBool()) ? 1.0f : -1.0f;
-		return true;
+		RecoveryPlanner.Reset();
+		return false;
 	}
 
-	return false;
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_RecoveryExpansions, DriverlessRecoveryExpansions, RecoveryPlanner.GetNumExpansions());
+
+	bPlannedRecovery = true;
+	PlannedRecoveryTime = 0.0f;
+	RecoveryStillTime = 0.0f;
+	RecoveryMotion = FRecoveryMotion();
+	return true;
+}
+
+bool USplineFollowerComponent::TickPlannedRecovery(float DeltaTime)
+{
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_RecoveryPlanner);
+
+	const FVector Location = OwnerPawn->GetActorLocation();
+	const FVector Forward = OwnerPawn->GetActorForwardVector();
+	const FVector2D Location2D(Location);
+
+	// out of the local grid, the vehicle is well clear of where it was stuck
+	if (!RecoveryPlanner.IsInside(Location2D))
+	{
+		EndPlannedRecovery();
+		return false;
+	}
+
+	// a maneuver that takes too long, or wedges the vehicle again, is given up
+	PlannedRecoveryTime += DeltaTime;
+	RecoveryStillTime = FMath::Abs(VehicleMovementComponent->GetForwardSpeed()) < RecoveryStillSpeed ? RecoveryStillTime + DeltaTime : 0.0f;
+	bool bGiveUp = PlannedRecoveryTime > PlannedRecoveryTimeout || RecoveryStillTime > MaxStuckTime;
+
+	// only what changed since the last step is searched again: the new obstacles and the move of the vehicle
+	if (!bGiveUp)
+	{
+		LLM_SCOPE_BYTAG(Driverless_Follower);
+		SenseRecoveryObstacles();
+		bGiveUp = !RecoveryPlanner.Plan(Location2D, FMath::Atan2(Forward.Y, Forward.X));
+		DRIVERLESS_COUNTER_ADD(STAT_Driverless_RecoveryExpansions, DriverlessRecoveryExpansions, RecoveryPlanner.GetNumExpansions());
+	}
+
+	if (bGiveUp)
+	{
+		EndPlannedRecovery();
+		StuckState.StartRecovery(MakeStuckParams(), FMath::RandBool());
+		return false;
+	}
+
+	if (RecoveryPlanner.IsAtGoal())
+	{
+		EndPlannedRecovery();
+		VehicleMovementComponent->SetTargetGear(1, true);
+		return false;
+	}
+
+	const FRecoveryMotion Motion = RecoveryPlanner.GetNextMotion();
+	if (Motion.Direction != RecoveryMotion.Direction)
+		VehicleMovementComponent->SetTargetGear(Motion.Direction, true);
+	RecoveryMotion = Motion;
+
+	VehicleMovementComponent->SetSteeringInput(Motion.Steer);
+	VehicleMovementComponent->SetThrottleInput(RecoveryThrottle);
+	VehicleMovementComponent->SetBrakeInput(0.0f);
+	return true;
+}
+
+void USplineFollowerComponent::SenseRecoveryObstacles()
+{
+	// a ring of traces at bumper height, as far as the grid reaches. Other vehicles and cones are obstacles too
+	const FVector Origin = OwnerPawn->GetActorLocation() + FVector::UpVector * RecoverySenseHeight;
+	const float Range = 0.5f * RecoveryPlanner.GetGridSize() * RecoveryPlanner.GetCellSize();
+
+	FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+	ObjectParams.AddObjectTypesToQuery(ECC_Vehicle);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(RecoverySense), false, OwnerPawn);
+
+	for (int32 i = 0; i < RecoverySenseRays; i++)
+	{
+		const float Angle = UE_TWO_PI * i / RecoverySenseRays;
+		const FVector Direction(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f);
+
+		// a hit facing up is the ground rising, not an obstacle
+		FHitResult Hit;
+		if (GetWorld()->LineTraceSingleByObjectType(Hit, Origin, Origin + Direction * Range, ObjectParams, QueryParams)
+			&& !Hit.bStartPenetrating && Hit.ImpactNormal.Z < 0.7f)
+			RecoveryPlanner.AddObstacle(FVector2D(Hit.ImpactPoint));
+	}
+}
+
+void USplineFollowerComponent::EndPlannedRecovery()
+{
+	bPlannedRecovery = false;
+	RecoveryMotion = FRecoveryMotion();
+	RecoveryPlanner.Reset();
 }
 
 void USplineFollowerComponent::SeeDebugTrails(const FVector& VehicleLocation, const FVector &TargetLocation)
 {
-	// Vehicle's trail line
-	DrawDebugLine(
-		GetWorld(), // context
-		PreviousLocation, VehicleLocation, // start and end
-		FColor::Cyan,
-		false, // persistence
-		5.0f, // lifetime (s)
-		0, // depth priority, irrelevant here
-		5.0f // thickness
-	);
-
-	// Target point sphere
-	DrawDebugSphere(
-		GetWorld(), TargetLocation, // context and location
-		50.0f, // sphere's radius (cm)
-		10, // # segments in the sphere eg. 3 = pyramid end
-		// the following are the same params as line's (from color onward)
-		FColor::Green, false, 0.0f, 0, 10.0f
-	);
-
-	// we keep track of previous locations for debug lines
-	PreviousLocation = VehicleLocation;
-}
\ No newline at end of file
+	if (!UDriverlessDebugDrawSubsystem::IsEnabled())
+		return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_DebugDraw);
+	LLM_SCOPE_BYTAG(Driverless_Debug);
+
+	// recorded only, the debug draw subsystem renders every vehicle in one batch
+	DebugHistory.AddTrailPoint(VehicleLocation, UDriverlessDebugDrawSubsystem::GetTrailCapacity(), UDriverlessDebugDrawSubsystem::GetTrailSpacing());
+	DebugHistory.SetTarget(TargetLocation);
+}
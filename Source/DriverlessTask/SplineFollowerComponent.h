@@ -12,12 +12,46 @@
 #include "LandscapeSplineActor.h"
 #include "GameFramework/Pawn.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "WorldCollision.h"
+#include "TrackTable.h"
+#include "TrackOccupancyGrid.h"
+#include "FollowerControlLaw.h"
+#include "FollowerStuckState.h"
+#include "RecoveryPlanner.h"
+#include "DriverlessDebugDrawSubsystem.h"
+#include "FollowerCommandRecording.h"
+#include "FollowerCommandQueue.h"
 
 #include "SplineFollowerComponent.generated.h"
 
 class USplineComponent;
 class UChaosVehicleMovementComponent;
 class APawn;
+class UDriverlessVehicleSubsystem;
+class FFollowerPhysicsCallback;
+struct FFollowerTelemetry;
+struct FFollowerSnapshot;
+struct FDriverlessAgentObservation;
+class UDriverlessAgentSubsystem;
+class UConeCenterlineComponent;
+class UStateEstimatorComponent;
+class URacingLineAsset;
+
+// where the vehicle's commands come from
+UENUM(BlueprintType)
+enum class EFollowerControlSource : uint8
+{
+	// the follower logic drives the vehicle
+	Controller,
+	// recorded commands are applied at their physics steps, the follower logic doesn't run
+	Replay,
+	// as Replay, while the follower logic runs in the shadow and its commands are compared to the recorded ones
+	ReplayVerify,
+	// an external agent sends the commands through UDriverlessAgentSubsystem. Perception still runs, to be observed
+	External,
+	// commands are pushed from any thread into the follower's command queue. Perception still runs
+	CommandQueue,
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class DRIVERLESSTASK_API USplineFollowerComponent : public UActorComponent
@@ -32,6 +66,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Setup")
 	AActor* TargetTrackActor;
 
+	// racing line of the track (DriverlessRacingLine commandlet) to drive along instead of the centerline. Ignored when it was
+	// optimized for another track, or before the track changed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Setup")
+	URacingLineAsset* RacingLine;
+
 
 	/* TUNING PARAMS (cm or seconds) */
 
@@ -61,14 +100,149 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance", meta = (ClampMin = "10.0"))
 	float ObstacleTraceRadius = 220.0f;
 
-	// angle (in degrees) of the avoidance probes (left and right)
+	// angle (in degrees) of the outermost avoidance probes (left and right)
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance")
 	float AvoidanceProbeAngle = 30.0f;
 
+	// number of probes, evenly spread between -AvoidanceProbeAngle and +AvoidanceProbeAngle. 3 = center, left and right
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance", meta = (ClampMin = "1", ClampMax = "64"))
+	int32 NumAvoidanceProbes = 3;
+
+	// explicit probe angles (degrees, negative = left). When set, it overrides NumAvoidanceProbes and AvoidanceProbeAngle
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance")
+	TArray<float> CustomProbeAngles;
+
+	// Sweep the probes as one async batch, consumed on the next frame, instead of one blocking sweep per probe
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance")
+	bool bUseAsyncProbes = true;
+
+	// Skip the probe sweeps while the track's occupancy grid shows the lane ahead clear of walls and cones and no other vehicle is near
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance")
+	bool bUseOccupancyGrid = false;
+
+	// weight of the free distance in front of a probe when scoring the safe direction
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance|Scoring")
+	float ClearanceWeight = 1.0f;
+
+	// weight of the alignment between a probe and the track direction
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance|Scoring")
+	float TrackAlignmentWeight = 0.3f;
+
+	// penalty for the steering change a probe would require
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance|Scoring")
+	float SteeringChangeWeight = 0.2f;
+
 	// How strongly the vehicle steers away from obstacles. Higher values = sharper turns.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Obstacle Avoidance")
 	float AvoidanceStrength = 3.0f;
 
+	/* PROBE CACHE PARAMS */
+
+	// Reuse the last probe sweep, reprojected to the current pose, while the vehicle stays close to where it was taken
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Probe Cache")
+	bool bUseProbeCache = true;
+
+	// distance the vehicle can travel (cm) since the last sweep before sweeping again
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Probe Cache", meta = (ClampMin = "0.0"))
+	float ProbeCacheMaxTranslation = 150.0f;
+
+	// yaw change (degrees) since the last sweep before sweeping again
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Probe Cache", meta = (ClampMin = "0.0"))
+	float ProbeCacheMaxRotation = 3.0f;
+
+	// max age of a cached sweep (seconds), so new obstacles entering the probes are never missed for long
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Probe Cache", meta = (ClampMin = "0.0"))
+	float ProbeCacheMaxAge = 0.25f;
+
+
+	/* TRAFFIC PARAMS */
+
+	// radius (cm) in which other vehicles are taken into account
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float VehicleAwarenessRadius = 3000.0f;
+
+	// half width (cm) of the lane in front of the vehicle in which another car counts as the one to follow
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float FollowingLaneHalfWidth = 250.0f;
+
+	// gap kept to the car ahead when standing still (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float MinFollowingDistance = 600.0f;
+
+	// extra gap kept to the car ahead for each cm/s of speed (seconds)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float FollowingTimeGap = 0.8f;
+
+	// lateral shift (cm) of the steering target when passing the car ahead
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float OvertakeLateralOffset = 300.0f;
+
+	// how far in the future (s) collisions with other vehicles are predicted
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float CollisionPredictionTime = 1.5f;
+
+	// radius (cm) of a vehicle for collision prediction
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Traffic", meta = (ClampMin = "0.0"))
+	float VehicleCollisionRadius = 250.0f;
+
+	/* SCHEDULING PARAMS */
+
+	// rate (Hz) of perception and planning (track lookups, probes, traffic). Steering is still updated every frame
+	// against the latest plan. 0 = plan every frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Scheduling", meta = (ClampMin = "0.0"))
+	float ControlRateHz = 0.0f;
+
+	/* PHYSICS THREAD PARAMS */
+
+	// Run the control law at every physics step on the physics thread, from the vehicle state of that step, and apply its
+	// commands in the same step. Needs a UDriverlessVehicleMovementComponent (ADriverlessVehiclePawn).
+	// Probes and traffic stay on the game thread. Pair it with "Tick Physics Async" for a fixed control rate
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Physics Thread")
+	bool bRunControlOnPhysicsThread = false;
+
+	/* REPLAY PARAMS */
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Replay")
+	EFollowerControlSource ControlSource = EFollowerControlSource::Controller;
+
+	// Record the commands sent to the vehicle, saved when play ends. Physics LOD is off while recording
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Replay")
+	bool bRecordCommands = false;
+
+	// file under Saved/Driverless/Recordings the commands are recorded to and replayed from. Empty = name of the vehicle
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Replay")
+	FString RecordingName;
+
+	// difference between the shadow controller's and the recorded commands still counted as a match
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Replay", meta = (ClampMin = "0.0"))
+	float ReplayCommandTolerance = 0.001f;
+
+	/* CONE CENTERLINE PARAMS */
+
+	// Steer along the centerline estimated from the cones seen (UConeCenterlineComponent on the same actor) instead of the spline.
+	// The spline still gives the speed plan, and takes over where no centerline is known
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Cone Centerline")
+	bool bFollowConeCenterline = false;
+
+	/* EXTERNAL CONTROL PARAMS */
+
+	// commands older than this (seconds) are dropped, and the vehicle brakes once the last one it got is that old
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|External Control", meta = (ClampMin = "0.0"))
+	float CommandMaxAge = 0.1f;
+
+	// size of the command queue, rounded up to a power of two with one slot always empty (64 holds 63 commands)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|External Control", meta = (ClampMin = "2"))
+	int32 CommandQueueCapacity = 64;
+
+	/* PHYSICS LOD PARAMS */
+
+	// Let the vehicle switch to kinematic playback along the track when it's far from every camera
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Physics LOD")
+	bool bAllowPhysicsLOD = true;
+
+	// acceleration (cm/s^2) used to reach the speed profile while in kinematic playback
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Physics LOD", meta = (ClampMin = "0.0"))
+	float KinematicAcceleration = 400.0f;
 
 	/* STUCK RECOVERY PARAMS */
 
@@ -80,13 +254,63 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Stuck")
 	float UnstuckTime = 2.0f;
 
+	// Plan the way out as a short reverse-and-realign maneuver around the obstacles seen near the vehicle, instead of reversing blindly
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Stuck")
+	bool bPlanRecovery = false;
+
+	// a planned recovery taking longer than this falls back to reversing blindly (seconds)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Stuck", meta = (ClampMin = "1.0"))
+	float PlannedRecoveryTimeout = 8.0f;
+
+	// radius of the full lock turns the maneuver is planned with (cm)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Stuck", meta = (ClampMin = "100.0"))
+	float RecoveryTurnRadius = 600.0f;
+
+	// throttle while maneuvering, forward or in reverse
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Stuck", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float RecoveryThrottle = 0.5f;
+
 	/* TELEMETRY PARAMS */
+	// label of the vehicle in the telemetry overlay
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Telemetry")
 	int32 TelemetryDisplayIndex = 0;
 
+	// numeric state for the telemetry overlay, formatting is left to it
+	void GetTelemetry(FFollowerTelemetry& OutTelemetry) const;
+
+	const FFollowerDebugHistory& GetDebugHistory() const { return DebugHistory; }
+
+	// drift of the current replay from its recording
+	const FFollowerReplayDivergence& GetReplayDivergence() const { return ReplayDivergence; }
+	bool IsReplayFinished() const { return bReplayFinished; }
+
+	// queue to push commands into from any one thread, when the Control Source is CommandQueue. Valid from BeginPlay.
+	// Held by reference, so the producer can keep pushing safely after the vehicle is gone
+	TSharedPtr<FFollowerCommandQueue, ESPMode::ThreadSafe> GetCommandQueue() const { return CommandQueue; }
+
+	// what the external agent sees of this vehicle, written in place into the shared observations
+	void WriteAgentObservation(FDriverlessAgentObservation& OutObservation);
+
+	// state of the vehicle and of its controller, to branch scenarios from with UDriverlessSnapshotSubsystem
+	void SaveSnapshot(FFollowerSnapshot& OutSnapshot) const;
+	void RestoreSnapshot(const FFollowerSnapshot& Snapshot);
+
+	// Switches between full Chaos physics and cheap kinematic playback along the track, carrying the vehicle state over
+	void SetKinematicLOD(bool bKinematic);
+	bool IsKinematicLOD() const { return bKinematicLOD; }
+
+	USplineComponent* GetSplineToFollow() const { return SplineToFollow; }
+
+	// heap memory held by the follower's own buffers (probes, caches), for memory reports
+	SIZE_T GetAllocatedSize() const;
+
+	// wall time of the last TickComponent (seconds), sampled by the perf tests
+	double GetLastTickSeconds() const { return LastTickSeconds; }
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 private:
@@ -99,16 +323,166 @@ private:
 	UPROPERTY()
 	USplineComponent* SplineToFollow;
 
+	UPROPERTY()
+	UDriverlessVehicleSubsystem* VehicleSubsystem;
+
+	// resampled track, shared with the other vehicles on it
+	TSharedPtr<const FTrackTable> TrackTable;
+
+	// what the vehicle drives along: the racing line when one is set, otherwise the track table.
+	// Perception (walls, grid, recovery, agent observations) stays on the track table
+	TSharedPtr<const FTrackTable> PathTable;
+	// plan on PathTable instead of the spline: following a racing line, or a baked track without a spline
+	bool bPlanOnTable = false;
+	float PathDistance = -1.0f;
+
+	// walls and cones of the track in track coordinates, when bUseOccupancyGrid
+	TSharedPtr<const FTrackOccupancyGrid> OccupancyGrid;
+	float GridTrackDistance = -1.0f;
+
+	// where the vehicle was along the track when its room to the walls was last measured
+	float WallTrackDistance = -1.0f;
+
+	// latest plan, held between two planning updates
+	bool bHasPlan = false;
+	FFollowerSpeedPlan CurrentPlan;
+	FFollowerControlInput PlannedInput;
+
+	// time since the last planning update. Vehicles start at different phases so they don't all plan in the same frame
+	float ControlAccumulator = 0.0f;
+
+	// control law running on the physics thread, and the latest commands the vehicle applied
+	FFollowerPhysicsCallback* PhysicsCallback = nullptr;
+	FFollowerControlOutput PhysicsCommands;
+	float PhysicsTrackDistance = 0.0f;
+	FVector PhysicsTargetLocation = FVector::ZeroVector;
+	bool bResetPhysicsTrackDistance = false;
+
+	// kinematic playback state
+	bool bKinematicLOD = false;
+	float KinematicDistance = 0.0f;
+	float KinematicSpeed = 0.0f;
+	float KinematicLateralOffset = 0.0f;
+	float KinematicHeightOffset = 0.0f;
+
 	// State variable for recovery
-	float StuckTime = 0.0f;
-	float RecoverySteer = 0.0f;
-	bool isPostRecovery = false;
+	FFollowerStuckState StuckState;
+
+	// planned recovery in progress, see bPlanRecovery
+	FRecoveryPlanner RecoveryPlanner;
+	bool bPlannedRecovery = false;
+	float PlannedRecoveryTime = 0.0f;
+	float RecoveryStillTime = 0.0f;
+	FRecoveryMotion RecoveryMotion;
+
+	double LastTickSeconds = 0.0;
+
+	// latest avoidance decision, for telemetry
+	bool bAvoidingObstacle = false;
+	float AvoidanceAngle = 0.0f;
+
+	// external agent driving the vehicle, and its slot in the shared observations and actions
+	UPROPERTY()
+	UDriverlessAgentSubsystem* AgentSubsystem;
+	int32 AgentSlot = INDEX_NONE;
+	float AgentTrackDistance = -1.0f;
+
+	// centerline estimated from the cones, when following it
+	UPROPERTY()
+	UConeCenterlineComponent* ConeCenterline;
+
+	// pose the controller drives from, estimated from noisy sensors. Null uses the true pose
+	UPROPERTY()
+	UStateEstimatorComponent* StateEstimator;
+
+	// commands from another thread, and the last one applied
+	TSharedPtr<FFollowerCommandQueue, ESPMode::ThreadSafe> CommandQueue;
+	TOptional<FFollowerTimedCommand> LastQueuedCommand;
+
+	// command recording, or the one being replayed
+	FFollowerCommandRecording CommandRecording;
+	int32 FirstPhysicsFrame = INDEX_NONE;
+	int32 ReplayCursor = 0;
+	bool bReplayFinished = false;
+	FFollowerReplayDivergence ReplayDivergence;
+
+	// Debug: trail, probes and target, drawn by UDriverlessDebugDrawSubsystem
+	FFollowerDebugHistory DebugHistory;
+
+	// result of a single probe sweep, kept in world space so it can be reprojected to a later pose
+	struct FProbeResult
+	{
+		bool bHit = false;
+		FVector HitLocation = FVector::ZeroVector; // sphere center at impact
+		TWeakObjectPtr<AActor> HitActor;
+		FTransform HitActorTransform;
+	};
+
+	// last probe sweep and the pose it was taken at
+	struct FProbeCache
+	{
+		bool bValid = false;
+		FTransform Pose;
+		double Time = 0.0; // world time, GetTimeSeconds is double and a float loses the frames of a long run
+		TArray<FProbeResult> Probes;
+	};
+
+	FProbeCache ProbeCache;
+
+	// async probe batch in flight, collected on the next frame
+	TArray<FTraceHandle> PendingProbeTraces;
+	FTransform PendingProbePose;
+	double PendingProbeTime = 0.0;
+
+	// probe fan, stored as structure of arrays so it can be scored 4 probes at a time
+	TArray<float> ProbeAngles;
+	TArray<FVector> ProbeDirections;
+	TArray<float> ProbeDistances;
+	FFollowerProbeScores ProbeScoring;
 
-	// Debug: trail line
-	FVector PreviousLocation;
+	// how the vehicle reacts to the other cars around it
+	struct FTrafficResponse
+	{
+		FVector TargetOffset = FVector::ZeroVector; // lateral shift of the steering target, to overtake
+		float ThrottleScale = 1.0f; // keeps the gap to the car ahead
+		float Brake = 0.0f; // predicted collisions
+	};
 
-	void PrintTelemetry();
+	void TickKinematic(float DeltaTime);
+	void TickPhysicsThreadControl(bool bPlan);
+	void SuspendPhysicsThreadControl();
+	bool ConsumeControlStep(float DeltaTime);
+	void UpdatePlan();
+	void Actuate();
+	FFollowerControlInput MakeControlInput() const;
+	void GetControlPose(FVector& OutLocation, FVector& OutForward, FVector& OutRight) const;
+	void TickReplay(float DeltaTime);
+	void TickExternal(float DeltaTime);
+	void ApplyQueuedCommands();
+	void ApplyExternalCommand(float Steering, float Throttle, float Brake, int32 Gear);
+	bool IsExternallyControlled() const { return ControlSource == EFollowerControlSource::External || ControlSource == EFollowerControlSource::CommandQueue; }
+	void RecordCommands(const FTransform& Pose, const FVector& Velocity);
+	int32 GetPhysicsFrame() const;
+	FString GetRecordingFileName() const;
+	bool IsReplaying() const { return ControlSource == EFollowerControlSource::Replay || ControlSource == EFollowerControlSource::ReplayVerify; }
+	FFollowerControlParams MakeControlParams() const;
+	FTrafficResponse ComputeTrafficResponse(const FVector& VehicleLocation, const FVector& VehicleForward);
 	bool HandleStuckState(float DeltaTime);
+	FFollowerStuckParams MakeStuckParams() const;
+	bool StartPlannedRecovery();
+	// drives the planned maneuver, false once it's over: done, or given up for a blind recovery
+	bool TickPlannedRecovery(float DeltaTime);
+	void SenseRecoveryObstacles();
+	void EndPlannedRecovery();
 	void SeeDebugTrails(const FVector& VehicleLocation, const FVector& TargetLocation);
-	bool FindSafeAvoidancePath(float& OutHitDistance, FVector& OutSafeDirection);
+	// true when the grid shows no wall or cone in the lane ahead (ObstacleTraceDistance long, ObstacleTraceRadius each side)
+	bool IsLaneClearOnGrid(const FVector& VehicleLocation);
+	bool FindSafeAvoidancePath(const FVector& TrackDirection, float& OutHitDistance, FVector& OutSafeDirection);
+	void UpdateProbeFan(const FVector& VehicleForward);
+	void SweepProbes(const FVector& TraceStart);
+	void IssueAsyncProbes(const FVector& TraceStart);
+	bool CollectAsyncProbes();
+	int32 CountProbeHits() const;
+	bool ReprojectProbeCache(const FVector& TraceStart, bool bIgnoreThresholds);
+	int32 ScoreProbeFan(const FVector& VehicleForward, const FVector& TrackDirection);
 };
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StateEstimatorComponent.h"
+#include "DriverlessStats.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Actor.h"
+
+namespace
+{
+	// after a hitch, the steps beyond these are dropped rather than stalling the frame
+	constexpr int32 MaxStepsPerFrame = 64;
+}
+
+UStateEstimatorComponent::UStateEstimatorComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UStateEstimatorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (RandomSeed != 0)
+		RandomStream.Initialize(RandomSeed);
+	else
+		RandomStream.GenerateNewSeed();
+
+	ResetEstimate();
+}
+
+FVehicleStateEstimatorParams UStateEstimatorComponent::MakeParams() const
+{
+	FVehicleStateEstimatorParams Params;
+	Params.GyroNoise = FMath::DegreesToRadians(FMath::Max(GyroNoise, 0.01f));
+	Params.OdometryNoise = FMath::Max(OdometryNoise, 0.1f);
+	Params.PositionFixNoise = FMath::Max(PositionFixNoise, 0.1f);
+	// the accelerometer drives the prediction, its noise adds to what the model misses
+	Params.AccelNoise = FMath::Sqrt(FMath::Square(Params.AccelNoise) + FMath::Square(AccelerometerNoise));
+	return Params;
+}
+
+UStateEstimatorComponent::FTrueState UStateEstimatorComponent::ReadTrueState() const
+{
+	const AActor* Owner = GetOwner();
+	const FVector Forward = Owner->GetActorForwardVector();
+
+	FTrueState Truth;
+	Truth.Location = Owner->GetActorLocation();
+	Truth.Yaw = FMath::Atan2(Forward.Y, Forward.X);
+	Truth.Speed = FVector::DotProduct(Owner->GetVelocity(), Forward);
+
+	if (const UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(Owner->GetRootComponent()))
+		Truth.YawRate = FMath::DegreesToRadians(Body->GetPhysicsAngularVelocityInDegrees().Z);
+
+	return Truth;
+}
+
+double UStateEstimatorComponent::Noise(double StandardDeviation)
+{
+	// Box-Muller
+	const double U1 = FMath::Max((double)RandomStream.GetFraction(), UE_DOUBLE_SMALL_NUMBER);
+	const double U2 = RandomStream.GetFraction();
+	return StandardDeviation * FMath::Sqrt(-2.0 * FMath::Loge(U1)) * FMath::Cos(UE_DOUBLE_TWO_PI * U2);
+}
+
+void UStateEstimatorComponent::ResetEstimate()
+{
+	const FTrueState Truth = ReadTrueState();
+	Estimator.Reset(MakeParams(), FVector2D(Truth.Location.X, Truth.Location.Y), Truth.Yaw, Truth.Speed);
+
+	PreviousTruth = Truth;
+	FixHeight = Truth.Location.Z;
+	StepAccumulator = OdometryAccumulator = FixAccumulator = 0.0;
+	bInitialized = true;
+}
+
+void UStateEstimatorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bInitialized || DeltaTime <= 0.0f) return;
+
+	DRIVERLESS_SCOPE_CYCLE_COUNTER(STAT_Driverless_StateEstimator);
+
+	const FTrueState Truth = ReadTrueState();
+	const double StepTime = 1.0 / EstimatorRateHz;
+	const double Acceleration = (Truth.Speed - PreviousTruth.Speed) / DeltaTime;
+
+	StepAccumulator += DeltaTime;
+	int32 NumSteps = FMath::FloorToInt32(StepAccumulator / StepTime);
+	StepAccumulator -= NumSteps * StepTime;
+	NumSteps = FMath::Min(NumSteps, MaxStepsPerFrame);
+
+	for (int32 Step = 1; Step <= NumSteps; Step++)
+	{
+		// the sensors sample the motion in between the two frames
+		const double Alpha = (double)Step / NumSteps;
+
+		Estimator.Predict(StepTime, Acceleration + Noise(AccelerometerNoise));
+		Estimator.FuseGyro(FMath::Lerp(PreviousTruth.YawRate, Truth.YawRate, Alpha) + Noise(FMath::DegreesToRadians(GyroNoise)));
+
+		OdometryAccumulator += StepTime;
+		if (OdometryRateHz > 0.0f && OdometryAccumulator >= 1.0 / OdometryRateHz)
+		{
+			OdometryAccumulator -= 1.0 / OdometryRateHz;
+			Estimator.FuseOdometry(FMath::Lerp(PreviousTruth.Speed, Truth.Speed, Alpha) + Noise(OdometryNoise));
+		}
+
+		FixAccumulator += StepTime;
+		if (PositionFixRateHz > 0.0f && FixAccumulator >= 1.0 / PositionFixRateHz)
+		{
+			FixAccumulator -= 1.0 / PositionFixRateHz;
+			const FVector Location = FMath::Lerp(PreviousTruth.Location, Truth.Location, Alpha);
+			Estimator.FusePositionFix(FVector2D(Location.X + Noise(PositionFixNoise), Location.Y + Noise(PositionFixNoise)));
+			// the height isn't part of the filter, the fixes are only smoothed
+			FixHeight = FMath::Lerp(FixHeight, Location.Z + Noise(PositionFixNoise), 0.2);
+		}
+	}
+
+	DRIVERLESS_COUNTER_ADD(STAT_Driverless_EstimatorSteps, DriverlessEstimatorSteps, NumSteps);
+
+	PreviousTruth = Truth;
+}
+
+FVector UStateEstimatorComponent::GetEstimatedLocation() const
+{
+	const FVector2D Location = Estimator.GetLocation();
+	return FVector(Location.X, Location.Y, FixHeight);
+}
+
+FVector UStateEstimatorComponent::GetEstimatedForward() const
+{
+	double Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, Estimator.GetYaw());
+	return FVector(Cos, Sin, 0.0);
+}
+
+FVector UStateEstimatorComponent::GetEstimatedRight() const
+{
+	double Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, Estimator.GetYaw());
+	return FVector(-Sin, Cos, 0.0);
+}
+
+float UStateEstimatorComponent::GetPositionError() const
+{
+	return (float)FVector::Dist2D(GetEstimatedLocation(), GetOwner()->GetActorLocation());
+}
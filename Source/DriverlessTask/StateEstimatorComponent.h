@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Math/RandomStream.h"
+#include "VehicleStateEstimator.h"
+#include "StateEstimatorComponent.generated.h"
+
+/**
+ * Estimates the pose of its vehicle the way a real car would: noisy IMU, wheel odometry and position fixes are
+ * simulated from the true motion and fused by an extended Kalman filter (FVehicleStateEstimator) stepped at EstimatorRateHz.
+ * The steps owed by a frame run back to back, the measurements interpolated over the frame.
+ * A USplineFollowerComponent on the same actor drives from this estimate instead of the true pose.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class DRIVERLESSTASK_API UStateEstimatorComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UStateEstimatorComponent();
+
+	// filter steps per second, each with an IMU sample
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator", meta = (ClampMin = "1.0"))
+	float EstimatorRateHz = 500.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator", meta = (ClampMin = "0.0"))
+	float OdometryRateHz = 100.0f;
+
+	// 0 disables the position fixes, the estimate then drifts like dead reckoning
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator", meta = (ClampMin = "0.0"))
+	float PositionFixRateHz = 10.0f;
+
+	// sensor noise, standard deviations
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator|Noise", meta = (ClampMin = "0.0"))
+	float GyroNoise = 0.5f; // deg/s
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator|Noise", meta = (ClampMin = "0.0"))
+	float AccelerometerNoise = 20.0f; // cm/s^2
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator|Noise", meta = (ClampMin = "0.0"))
+	float OdometryNoise = 10.0f; // cm/s
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator|Noise", meta = (ClampMin = "0.0"))
+	float PositionFixNoise = 30.0f; // cm
+
+	// Seed of the sensor noise, 0 picks a new seed every run
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State Estimator|Noise")
+	int32 RandomSeed = 0;
+
+	// estimated pose. The estimate is planar: the height comes from the last position fix, pitch and roll are ignored
+	FVector GetEstimatedLocation() const;
+	FVector GetEstimatedForward() const;
+	FVector GetEstimatedRight() const;
+	float GetEstimatedSpeed() const { return (float)Estimator.GetSpeed(); }
+
+	// distance between the estimated and the true location (cm), for telemetry
+	float GetPositionError() const;
+
+	const FVehicleStateEstimator& GetEstimator() const { return Estimator; }
+
+	// starts the estimate over from the true state, e.g. after the vehicle was teleported
+	void ResetEstimate();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	// the true motion, read from the vehicle body
+	struct FTrueState
+	{
+		FVector Location = FVector::ZeroVector;
+		double Yaw = 0.0; // rad
+		double Speed = 0.0; // cm/s along the heading
+		double YawRate = 0.0; // rad/s
+	};
+
+	FTrueState ReadTrueState() const;
+	FVehicleStateEstimatorParams MakeParams() const;
+	double Noise(double StandardDeviation);
+
+	FVehicleStateEstimator Estimator;
+	FRandomStream RandomStream;
+
+	bool bInitialized = false;
+	FTrueState PreviousTruth;
+	double FixHeight = 0.0;
+
+	// time owed to the filter and to the slower sensors (seconds)
+	double StepAccumulator = 0.0;
+	double OdometryAccumulator = 0.0;
+	double FixAccumulator = 0.0;
+};
@@ -0,0 +1,340 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Misc/AutomationTest.h"
+#include "ConeDelaunay.h"
+#include "RecoveryPlanner.h"
+#include "RacingLineOptimizer.h"
+#include "TrackTable.h"
+
+/**
+ * Unit tests of the DriverlessCore algorithms, no world needed.
+ *
+ * Run with: -ExecCmds="Automation RunTests Driverless.Core"
+ */
+
+namespace DriverlessCoreTests
+{
+	// cones placed the way AObstacleSpawnerActor does it, on a round track of the given radius: random distance along it,
+	// random offset to either side, none closer than MinDistance to another
+	static void MakeSpawnerLayout(int32 Seed, int32 NumberOfCones, double Radius, TArray<FVector>& OutCones, TArray<EConeSide>& OutSides)
+	{
+		const double MinOffsetDistance = 200.0, MaxOffsetDistance = 400.0, MinDistance = 150.0;
+		const double Length = UE_TWO_PI * Radius;
+
+		FRandomStream Stream(Seed);
+		for (int32 Attempt = 0; Attempt < NumberOfCones * 10 && OutCones.Num() < NumberOfCones; Attempt++)
+		{
+			const double Angle = Stream.FRandRange(0.0, Length) / Radius;
+			const double Offset = Stream.FRandRange(MinOffsetDistance, MaxOffsetDistance);
+			const double Direction = Stream.RandRange(0, 1) ? 1.0 : -1.0;
+			// counter-clockwise, so the right is outwards
+			const FVector Location = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * (Radius + Offset * Direction);
+
+			if (!OutCones.ContainsByPredicate([&](const FVector& Cone) { return FVector::DistSquared(Cone, Location) < FMath::Square(MinDistance); }))
+			{
+				OutCones.Add(Location);
+				OutSides.Add(Direction > 0.0 ? EConeSide::Right : EConeSide::Left);
+			}
+		}
+	}
+
+	// a vehicle at the origin across a track running along X, its nose against a wall
+	static void InitRecoveryIncident(FRecoveryPlanner& Planner)
+	{
+		Planner.Init(FRecoveryPlannerParams(), FVector2D::ZeroVector);
+		for (int32 X = 0; X < Planner.GetGridSize(); X++)
+		{
+			for (int32 Y = 0; Y < Planner.GetGridSize(); Y++)
+				Planner.SetGoalHeading(X, Y, 0.0f);
+		}
+		for (int32 Cone = -6; Cone <= 6; Cone++)
+			Planner.AddObstacle(FVector2D(Cone * 50.0, 300.0));
+	}
+
+	// obstacles seen once the maneuver started: walls on both sides of the vehicle
+	static void AddLateRecoveryObstacles(FRecoveryPlanner& Planner)
+	{
+		for (int32 Cone = -3; Cone <= 3; Cone++)
+			Planner.AddObstacle(FVector2D(400.0, Cone * 50.0));
+		for (int32 Cone = -4; Cone <= 4; Cone++)
+			Planner.AddObstacle(FVector2D(-400.0, Cone * 50.0 - 100.0));
+	}
+
+	// a loop of straights, chicanes and hairpins, 13 m wide, sampled every SampleSpacing. The geometry is traced finely first,
+	// so every spacing samples the very same track
+	static TSharedRef<FTrackTable> MakeRacingTrack(float SampleSpacing)
+	{
+		struct FPiece
+		{
+			double Length;
+			double Curvature;
+		};
+		const FPiece Chicane[] = { { UE_PI / 4.0 * 1000.0, -1.0 / 1000.0 }, { UE_PI / 2.0 * 1000.0, 1.0 / 1000.0 }, { UE_PI / 4.0 * 1000.0, -1.0 / 1000.0 } };
+		const FPiece Straight = { 20000.0, 0.0 };
+		const FPiece Hairpin = { UE_PI * 1500.0, 1.0 / 1500.0 };
+
+		TArray<FPiece> Pieces;
+		for (int32 Half = 0; Half < 2; Half++)
+		{
+			Pieces.Add(Straight);
+			Pieces.Append(Chicane, UE_ARRAY_COUNT(Chicane));
+			Pieces.Add(Straight);
+			Pieces.Add(Hairpin);
+		}
+
+		const double TraceStep = 5.0;
+		TArray<FVector> Points;
+		double X = 0.0, Y = 0.0, Heading = 0.0;
+		for (const FPiece& Piece : Pieces)
+		{
+			const int32 NumSteps = FMath::Max(1, FMath::RoundToInt32(Piece.Length / TraceStep));
+			const double Step = Piece.Length / NumSteps;
+			for (int32 i = 0; i < NumSteps; i++)
+			{
+				Points.Add(FVector(X, Y, 0.0));
+				Heading += Piece.Curvature * Step;
+				X += FMath::Cos(Heading) * Step;
+				Y += FMath::Sin(Heading) * Step;
+			}
+		}
+
+		// spread what the tracing missed in closing the loop, and close it
+		const FVector Gap(X - Points[0].X, Y - Points[0].Y, 0.0);
+		for (int32 i = 0; i < Points.Num(); i++)
+			Points[i] -= Gap * ((double)i / Points.Num());
+		Points.Add(Points[0]);
+
+		TArray<double> Distances;
+		Distances.Add(0.0);
+		for (int32 i = 1; i < Points.Num(); i++)
+			Distances.Add(Distances.Last() + FVector::Dist(Points[i - 1], Points[i]));
+
+		const double Length = Distances.Last();
+		const int32 NumSamples = FMath::CeilToInt32(Length / SampleSpacing) + 1;
+		const double Spacing = Length / (NumSamples - 1);
+
+		TArray<FVector> Locations, Directions, Tangents;
+		int32 Segment = 0;
+		for (int32 Sample = 0; Sample < NumSamples; Sample++)
+		{
+			const double Distance = FMath::Min(Sample * Spacing, Length);
+			while (Segment < Points.Num() - 2 && Distances[Segment + 1] < Distance)
+				Segment++;
+			const double Alpha = (Distance - Distances[Segment]) / (Distances[Segment + 1] - Distances[Segment]);
+			Locations.Add(FMath::Lerp(Points[Segment], Points[Segment + 1], Alpha));
+		}
+		for (int32 Sample = 0; Sample < NumSamples; Sample++)
+		{
+			// the last sample is the first one again
+			const int32 Prev = Sample == 0 ? NumSamples - 2 : Sample - 1;
+			const int32 Next = Sample == NumSamples - 1 ? 1 : Sample + 1;
+			Directions.Add((Locations[Next] - Locations[Prev]).GetSafeNormal());
+			Tangents.Add(Directions.Last() * Spacing);
+		}
+
+		TSharedRef<FTrackTable> Track = FTrackTable::BuildFromSamples(MoveTemp(Locations), MoveTemp(Directions), MoveTemp(Tangents), Spacing, true);
+		Track->InitBoundaries(650.0f);
+		return Track;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDriverlessConeDelaunayTest, "Driverless.Core.ConeDelaunay",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FDriverlessConeDelaunayTest::RunTest(const FString& Parameters)
+{
+	// the spawner's layout, sparse like the benchmark and dense
+	for (const int32 NumberOfCones : { 50, 500 })
+	{
+		TArray<FVector> Cones;
+		TArray<EConeSide> Sides;
+		DriverlessCoreTests::MakeSpawnerLayout(1337, NumberOfCones, 5000.0, Cones, Sides);
+
+		FConeDelaunay Triangulation;
+		for (int32 Cone = 0; Cone < Cones.Num(); Cone++)
+			Triangulation.AddCone(Cones[Cone], Sides[Cone]);
+
+		TestEqual(FString::Printf(TEXT("Cones of the %d cone layout"), NumberOfCones), Triangulation.NumCones(), Cones.Num());
+		TestTrue(FString::Printf(TEXT("Triangulation of the %d cone layout is valid"), NumberOfCones), Triangulation.Validate());
+	}
+
+	// collinear cones, in shuffled order: no triangle between them, then a second line makes a strip
+	{
+		FConeDelaunay Triangulation;
+		for (int32 Cone = 0; Cone < 50; Cone++)
+			Triangulation.AddCone(FVector((Cone * 37 % 50) * 100.0, 0.0, 0.0), EConeSide::Left);
+		TestEqual(TEXT("Triangles between collinear cones"), Triangulation.NumTriangles(), 0);
+		TestTrue(TEXT("Triangulation of collinear cones is valid"), Triangulation.Validate());
+
+		for (int32 Cone = 0; Cone < 50; Cone++)
+			Triangulation.AddCone(FVector(Cone * 100.0, 300.0, 0.0), EConeSide::Right);
+		TestEqual(TEXT("Triangles between two lines of cones"), Triangulation.NumTriangles(), 98);
+		TestTrue(TEXT("Triangulation of two lines of cones is valid"), Triangulation.Validate());
+	}
+
+	// a grid (four cones on every circumcircle) seen three times: the second and third passes merge into the first
+	{
+		FConeDelaunay Triangulation;
+		bool bMerged = true;
+		for (int32 Pass = 0; Pass < 3; Pass++)
+		{
+			for (int32 X = 0; X < 10; X++)
+			{
+				for (int32 Y = 0; Y < 10; Y++)
+				{
+					const int32 Cone = Triangulation.AddCone(FVector(X * 100.0, Y * 100.0, 0.0), EConeSide::Left);
+					bMerged &= Pass == 0 || Cone == X * 10 + Y;
+				}
+			}
+		}
+		TestTrue(TEXT("Duplicate cones merge into the first ones"), bMerged);
+		TestEqual(TEXT("Cones of the grid"), Triangulation.NumCones(), 100);
+		TestTrue(TEXT("Triangulation of the grid is valid"), Triangulation.Validate());
+	}
+
+	// a cone seen again across an edge from where it was: the triangle the new sighting falls in (0, 1, 2) doesn't touch it
+	{
+		FConeDelaunay Triangulation;
+		Triangulation.AddCone(FVector(0.0, 0.0, 0.0), EConeSide::Left);
+		Triangulation.AddCone(FVector(200.0, 0.0, 0.0), EConeSide::Left);
+		Triangulation.AddCone(FVector(100.0, 10000.0, 0.0), EConeSide::Left);
+		Triangulation.AddCone(FVector(100.0, -10000.0, 0.0), EConeSide::Left);
+		const int32 Cone = Triangulation.AddCone(FVector(100.0, -5.0, 0.0), EConeSide::Right);
+
+		TestEqual(TEXT("Cone merged across an edge"), Triangulation.AddCone(FVector(100.0, 20.0, 0.0), EConeSide::Right, 50.0), Cone);
+		TestEqual(TEXT("Cones after the merge across an edge"), Triangulation.NumCones(), 5);
+		TestTrue(TEXT("Triangulation after the merge across an edge is valid"), Triangulation.Validate());
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDriverlessRecoveryPlannerTest, "Driverless.Core.RecoveryPlanner",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FDriverlessRecoveryPlannerTest::RunTest(const FString& Parameters)
+{
+	using namespace DriverlessCoreTests;
+
+	const FVector2D Start = FVector2D::ZeroVector;
+	const float StartYaw = 0.5f * UE_PI;
+
+	FRecoveryPlanner Planner;
+	InitRecoveryIncident(Planner);
+	if (!TestTrue(TEXT("A way out is found"), Planner.Plan(Start, StartYaw)))
+		return false;
+	const float InitialCost = Planner.GetPlanCost();
+
+	// repaired in place: the same cost as searching the grid as it is now from scratch
+	AddLateRecoveryObstacles(Planner);
+	TestTrue(TEXT("A way out is found after the repair"), Planner.Plan(Start, StartYaw));
+	{
+		FRecoveryPlanner Fresh;
+		InitRecoveryIncident(Fresh);
+		AddLateRecoveryObstacles(Fresh);
+		TestTrue(TEXT("A way out is found by the fresh search"), Fresh.Plan(Start, StartYaw));
+		TestTrue(TEXT("The repair doesn't make the way out cheaper"), Planner.GetPlanCost() >= InitialCost);
+		TestEqual(TEXT("Cost of the repaired plan"), Planner.GetPlanCost(), Fresh.GetPlanCost(), 0.01f);
+	}
+
+	// repaired after the first motion, with one more obstacle
+	FVector2D Next;
+	float NextYaw;
+	if (!TestTrue(TEXT("The plan has a first motion"), Planner.GetNextPose(Next, NextYaw)))
+		return false;
+	Planner.AddObstacle(FVector2D(-200.0, -300.0));
+	TestTrue(TEXT("A way out is found after moving"), Planner.Plan(Next, NextYaw));
+	{
+		FRecoveryPlanner Fresh;
+		InitRecoveryIncident(Fresh);
+		AddLateRecoveryObstacles(Fresh);
+		Fresh.AddObstacle(FVector2D(-200.0, -300.0));
+		TestTrue(TEXT("A way out is found by the fresh search after moving"), Fresh.Plan(Next, NextYaw));
+		TestEqual(TEXT("Cost of the plan repaired after moving"), Planner.GetPlanCost(), Fresh.GetPlanCost(), 0.01f);
+	}
+
+	// the next incident reuses the buffers and starts from a clean grid
+	const SIZE_T AllocatedSize = Planner.GetAllocatedSize();
+	Planner.Reset();
+	InitRecoveryIncident(Planner);
+	TestEqual(TEXT("Memory of the next incident"), (int64)Planner.GetAllocatedSize(), (int64)AllocatedSize);
+	TestTrue(TEXT("A way out is found in the next incident"), Planner.Plan(Start, StartYaw));
+	TestEqual(TEXT("Cost of the next incident"), Planner.GetPlanCost(), InitialCost, 0.01f);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDriverlessRacingLineTest, "Driverless.Core.RacingLine",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FDriverlessRacingLineTest::RunTest(const FString& Parameters)
+{
+	using namespace DriverlessCoreTests;
+
+	// the line is a property of the track, not of how finely it's sampled
+	const TSharedRef<FTrackTable> Coarse = MakeRacingTrack(100.0f);
+	const TSharedRef<FTrackTable> Fine = MakeRacingTrack(50.0f);
+
+	FRacingLineOptimizer Optimizer;
+	const FRacingLineParams Params;
+	TArray<float> CoarseOffsets, FineOffsets;
+	if (!TestTrue(TEXT("The line of the coarse track is solved"), Optimizer.Solve(*Coarse, Params, CoarseOffsets)))
+		return false;
+	TestTrue(TEXT("The line of the coarse track converged"), Optimizer.HasConverged());
+	if (!TestTrue(TEXT("The line of the fine track is solved"), Optimizer.Solve(*Fine, Params, FineOffsets)))
+		return false;
+	TestTrue(TEXT("The line of the fine track converged"), Optimizer.HasConverged());
+
+	// both lines at the coarse samples, the fine one interpolated
+	float MaxDifference = 0.0f;
+	for (int32 i = 0; i < Coarse->Num(); i++)
+	{
+		const float Position = i * Coarse->SampleSpacing / Fine->SampleSpacing;
+		const int32 Index = FMath::Min(FMath::FloorToInt32(Position), Fine->Num() - 1);
+		const float FineOffset = FMath::Lerp(FineOffsets[Index], FineOffsets[(Index + 1) % Fine->Num()], Position - Index);
+		MaxDifference = FMath::Max(MaxDifference, FMath::Abs(FineOffset - CoarseOffsets[i]));
+	}
+	TestTrue(FString::Printf(TEXT("The lines at 100 cm and 50 cm spacing agree (%.1f cm apart at most)"), MaxDifference), MaxDifference < 15.0f);
+
+	// 40 m narrower than the margins where the line leaves the centerline the most: it's held in the middle there, and
+	// still converges around it
+	int32 Apex = 0;
+	for (int32 i = 0; i < Coarse->Num(); i++)
+	{
+		if (FMath::Abs(CoarseOffsets[i]) > FMath::Abs(CoarseOffsets[Apex]))
+			Apex = i;
+	}
+	for (int32 i = Apex - 20; i <= Apex + 20; i++)
+	{
+		const int32 Index = (i + Coarse->Num()) % Coarse->Num();
+		Coarse->LeftBoundary[Index] = -100.0f;
+		Coarse->RightBoundary[Index] = 100.0f;
+	}
+
+	TArray<float> NarrowOffsets;
+	if (!TestTrue(TEXT("The line of the narrowed track is solved"), Optimizer.Solve(*Coarse, Params, NarrowOffsets)))
+		return false;
+	TestTrue(TEXT("The line of the narrowed track converged"), Optimizer.HasConverged());
+
+	float MaxNarrowOffset = 0.0f, MaxOutside = 0.0f;
+	for (int32 i = 0; i < Coarse->Num(); i++)
+	{
+		const float Lower = Coarse->LeftBoundary[i] + Params.Margin;
+		const float Upper = Coarse->RightBoundary[i] - Params.Margin;
+		if (Lower > Upper)
+			MaxNarrowOffset = FMath::Max(MaxNarrowOffset, FMath::Abs(NarrowOffsets[i]));
+		else
+			MaxOutside = FMath::Max(MaxOutside, FMath::Max(Lower - NarrowOffsets[i], NarrowOffsets[i] - Upper));
+	}
+	TestTrue(FString::Printf(TEXT("The line is held in the middle of the narrow stretch (%.2f cm off)"), MaxNarrowOffset), MaxNarrowOffset < 0.01f);
+	TestTrue(FString::Printf(TEXT("The line stays within the margins elsewhere (%.2f cm past them)"), MaxOutside), MaxOutside < 0.01f);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,239 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Misc/AutomationTest.h"
+#include "Tests/AutomationCommon.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "SplineFollowerComponent.h"
+#include "DriverlessTrackSubsystem.h"
+#include "DriverlessAgentProtocol.h"
+#include "TrackTable.h"
+
+/**
+ * Follower behaviour in the test level: its first vehicle drives for a while, is switched to the kinematic LOD,
+ * jumps far along the track as the playback does, and is switched back to full physics. The distances along the
+ * track it reports and drives from afterwards must come from where it is, not from where it was.
+ *
+ * Run with: -ExecCmds="Automation RunTests Driverless.Follower"
+ */
+
+namespace DriverlessFollowerTests
+{
+	static const TCHAR* MapName = TEXT("/Game/FirstLevel");
+	static constexpr float SettleSeconds = 2.0f;
+	static constexpr float DriveSeconds = 3.0f;
+	// well past the window a hinted search looks in
+	static constexpr float JumpDistance = 10000.0f;
+	// tolerance on the distance along the track (cm)
+	static constexpr float DistanceTolerance = 100.0f;
+
+	// signed distance from From to To along the track, the short way round a closed one
+	static float GetTrackDelta(const FTrackTable& Table, float From, float To)
+	{
+		float Delta = To - From;
+		if (Table.bClosedLoop)
+		{
+			if (Delta < -0.5f * Table.Length) Delta += Table.Length;
+			else if (Delta > 0.5f * Table.Length) Delta -= Table.Length;
+		}
+		return Delta;
+	}
+}
+
+class FDriverlessKinematicJumpCommand : public IAutomationLatentCommand
+{
+public:
+	explicit FDriverlessKinematicJumpCommand(FAutomationTestBase* InTest)
+		: Test(InTest)
+	{
+	}
+
+	virtual ~FDriverlessKinematicJumpCommand() override
+	{
+		if (!bSettingsChanged) return;
+
+		if (IConsoleVariable* LODDistance = IConsoleManager::Get().FindConsoleVariable(TEXT("Driverless.PhysicsLODDistance")))
+			LODDistance->Set(PrevLODDistance, ECVF_SetByCode);
+	}
+
+	virtual bool Update() override
+	{
+		UWorld* World = GetGameWorld();
+		if (!World)
+		{
+			Test->AddError(TEXT("No game world, the map failed to load."));
+			return true;
+		}
+
+		switch (Phase)
+		{
+		case EPhase::Setup:
+			if (!Setup(*World))
+				return true;
+			Phase = EPhase::Settle;
+			PhaseStartTime = World->GetTimeSeconds();
+			return false;
+
+		case EPhase::Settle:
+			// the follower finds itself along the track, every distance it keeps gets a hint
+			if (World->GetTimeSeconds() - PhaseStartTime < DriverlessFollowerTests::SettleSeconds)
+				return false;
+			if (!Jump())
+				return true;
+			Phase = EPhase::Drive;
+			PhaseStartTime = World->GetTimeSeconds();
+			return false;
+
+		case EPhase::Drive:
+			if (World->GetTimeSeconds() - PhaseStartTime < DriverlessFollowerTests::DriveSeconds)
+				return false;
+			CheckProgress();
+			return true;
+		}
+		return true;
+	}
+
+private:
+	enum class EPhase : uint8 { Setup, Settle, Drive };
+
+	static UWorld* GetGameWorld()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			if ((Context.WorldType == EWorldType::PIE || Context.WorldType == EWorldType::Game) && Context.World())
+				return Context.World();
+		}
+		return nullptr;
+	}
+
+	bool Setup(UWorld& World)
+	{
+		// the LOD is switched by hand, the vehicle subsystem keeps every vehicle simulated
+		if (IConsoleVariable* LODDistance = IConsoleManager::Get().FindConsoleVariable(TEXT("Driverless.PhysicsLODDistance")))
+		{
+			PrevLODDistance = LODDistance->GetFloat();
+			LODDistance->Set(0.0f, ECVF_SetByCode);
+			bSettingsChanged = true;
+		}
+
+		for (TActorIterator<APawn> It(&World); It && !Follower.IsValid(); ++It)
+			Follower = It->FindComponentByClass<USplineFollowerComponent>();
+
+		USplineFollowerComponent* FollowerComponent = Follower.Get();
+		if (!FollowerComponent || !FollowerComponent->TargetTrackActor)
+		{
+			Test->AddError(TEXT("The test map has no vehicle with a SplineFollowerComponent."));
+			return false;
+		}
+
+		UDriverlessTrackSubsystem* TrackSubsystem = World.GetSubsystem<UDriverlessTrackSubsystem>();
+		TrackTable = TrackSubsystem ? TrackSubsystem->GetTrackTable(FollowerComponent->TargetTrackActor, FollowerComponent->GetSplineToFollow()) : nullptr;
+		if (!TrackTable.IsValid() || !TrackTable->IsValid())
+		{
+			Test->AddError(TEXT("Unable to build the track table of the test track."));
+			return false;
+		}
+		if (TrackTable->Length < 4.0f * DriverlessFollowerTests::JumpDistance)
+		{
+			Test->AddError(FString::Printf(TEXT("The test track is too short (%.0f cm) for the jump."), TrackTable->Length));
+			return false;
+		}
+		return true;
+	}
+
+	bool Jump()
+	{
+		using namespace DriverlessFollowerTests;
+
+		USplineFollowerComponent* FollowerComponent = Follower.Get();
+		if (!FollowerComponent)
+		{
+			Test->AddError(TEXT("The follower was destroyed."));
+			return false;
+		}
+		APawn* Pawn = CastChecked<APawn>(FollowerComponent->GetOwner());
+
+		// the agent's distance along the track gets its hint here, near the start
+		FDriverlessAgentObservation Observation;
+		FollowerComponent->WriteAgentObservation(Observation);
+
+		FollowerComponent->SetKinematicLOD(true);
+		if (!FollowerComponent->IsKinematicLOD())
+		{
+			Test->AddError(TEXT("The follower refused the kinematic LOD (recording, replay or physics LOD not allowed)."));
+			return false;
+		}
+
+		// what the playback does over a few seconds, in a single move
+		const float StartDistance = TrackTable->FindDistanceClosestToLocation(Pawn->GetActorLocation());
+		JumpTrackDistance = TrackTable->WrapDistance(StartDistance + JumpDistance);
+		const FVector JumpLocation = TrackTable->GetLocationAtDistance(JumpTrackDistance) + FVector::UpVector * (Pawn->GetActorLocation().Z - TrackTable->GetLocationAtDistance(StartDistance).Z);
+		Pawn->SetActorLocationAndRotation(JumpLocation, TrackTable->GetDirectionAtDistance(JumpTrackDistance).Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+
+		FollowerComponent->SetKinematicLOD(false);
+		if (FollowerComponent->IsKinematicLOD())
+		{
+			Test->AddError(TEXT("The follower did not leave the kinematic LOD."));
+			return false;
+		}
+
+		FollowerComponent->WriteAgentObservation(Observation);
+		const float Error = FMath::Abs(GetTrackDelta(*TrackTable, JumpTrackDistance, Observation.TrackDistance));
+		Test->TestTrue(FString::Printf(TEXT("Distance along the track right after the jump is off by %.0f cm"), Error), Error < DistanceTolerance);
+		return true;
+	}
+
+	void CheckProgress()
+	{
+		using namespace DriverlessFollowerTests;
+
+		USplineFollowerComponent* FollowerComponent = Follower.Get();
+		if (!FollowerComponent)
+		{
+			Test->AddError(TEXT("The follower was destroyed."));
+			return;
+		}
+
+		// a follower still steering for where it was before the jump turns around instead
+		const float Distance = TrackTable->FindDistanceClosestToLocation(FollowerComponent->GetOwner()->GetActorLocation());
+		const float Progress = GetTrackDelta(*TrackTable, JumpTrackDistance, Distance);
+		Test->TestTrue(FString::Printf(TEXT("The follower drove on from where it landed (%.0f cm in %.0f s)"), Progress, DriveSeconds), Progress > 0.0f);
+
+		FDriverlessAgentObservation Observation;
+		FollowerComponent->WriteAgentObservation(Observation);
+		const float Error = FMath::Abs(GetTrackDelta(*TrackTable, Distance, Observation.TrackDistance));
+		Test->TestTrue(FString::Printf(TEXT("Distance along the track after driving on is off by %.0f cm"), Error), Error < DistanceTolerance);
+	}
+
+	FAutomationTestBase* Test;
+
+	EPhase Phase = EPhase::Setup;
+	double PhaseStartTime = 0.0;
+
+	TWeakObjectPtr<USplineFollowerComponent> Follower;
+	TSharedPtr<const FTrackTable> TrackTable;
+	float JumpTrackDistance = 0.0f;
+
+	bool bSettingsChanged = false;
+	float PrevLODDistance = 0.0f;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDriverlessKinematicLODTest, "Driverless.Follower.KinematicLOD",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FDriverlessKinematicLODTest::RunTest(const FString& Parameters)
+{
+	AutomationOpenMap(DriverlessFollowerTests::MapName);
+	ADD_LATENT_AUTOMATION_COMMAND(FDriverlessKinematicJumpCommand(this));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
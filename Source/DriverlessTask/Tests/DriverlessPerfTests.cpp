@@ -0,0 +1,428 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Misc/AutomationTest.h"
+#include "Tests/AutomationCommon.h"
+#include "Misc/App.h"
+#include "Misc/Paths.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/CommandLine.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "ComponentInstanceDataCache.h"
+#include "GameFramework/Pawn.h"
+#include "Components/SplineComponent.h"
+#include "LandscapeSplineActor.h"
+#include "SplineFollowerComponent.h"
+#include "ObstacleSpawnerActor.h"
+#include "DriverlessTrackSubsystem.h"
+#include "TrackTable.h"
+
+/**
+ * Closed-loop performance benchmark: loads the test track, places a fixed set of cones and N followers,
+ * drives them for a fixed number of simulated seconds at a fixed time step and reports the follower tick
+ * cost (average and p99), the spawn time and the laps completed. Results are compared against the
+ * baseline stored in Config/DriverlessPerfBaseline.ini. A missing baseline is recorded from the run, with a
+ * warning; -DriverlessPerfUpdateBaseline records it again, e.g. on the reference machine after an intended change.
+ *
+ * Run with: -ExecCmds="Automation RunTests Driverless.Perf" (the tests carry the Perf filter)
+ */
+
+namespace DriverlessPerf
+{
+	static const TCHAR* MapName = TEXT("/Game/FirstLevel");
+	static constexpr int32 RandomSeed = 1337;
+	static constexpr int32 NumberOfCones = 50;
+	static constexpr float FixedDeltaTime = 1.0f / 60.0f;
+	static constexpr float WarmupSeconds = 2.0f;
+	static constexpr float MeasureSeconds = 30.0f;
+	// allowed relative regression before the test fails
+	static constexpr double DefaultTolerance = 0.25;
+
+	static FString GetBaselineFile()
+	{
+		return FConfigCacheIni::NormalizeConfigIniPath(FPaths::ProjectConfigDir() / TEXT("DriverlessPerfBaseline.ini"));
+	}
+
+	struct FResults
+	{
+		double SpawnMs = 0.0;
+		double AvgTickUs = 0.0;
+		double P99TickUs = 0.0;
+		double Laps = 0.0;
+		int32 NumSamples = 0;
+	};
+}
+
+class FDriverlessPerfRunCommand : public IAutomationLatentCommand
+{
+public:
+	FDriverlessPerfRunCommand(FAutomationTestBase* InTest, int32 InNumFollowers)
+		: Test(InTest)
+		, NumFollowers(InNumFollowers)
+	{
+	}
+
+	virtual ~FDriverlessPerfRunCommand() override
+	{
+		RestoreSettings();
+	}
+
+	virtual bool Update() override
+	{
+		UWorld* World = GetGameWorld();
+		if (!World)
+		{
+			Test->AddError(TEXT("No game world, the map failed to load."));
+			return true;
+		}
+
+		switch (Phase)
+		{
+		case EPhase::Setup:
+			if (!Setup(*World))
+				return true;
+			Phase = EPhase::Warmup;
+			PhaseStartTime = World->GetTimeSeconds();
+			return false;
+
+		case EPhase::Warmup:
+			// let the vehicles settle on their wheels before measuring
+			if (World->GetTimeSeconds() - PhaseStartTime >= DriverlessPerf::WarmupSeconds)
+			{
+				Phase = EPhase::Measure;
+				PhaseStartTime = World->GetTimeSeconds();
+				ResetProgress();
+			}
+			return false;
+
+		case EPhase::Measure:
+			Sample();
+			if (World->GetTimeSeconds() - PhaseStartTime < DriverlessPerf::MeasureSeconds)
+				return false;
+			Report();
+			return true;
+		}
+		return true;
+	}
+
+private:
+	enum class EPhase : uint8 { Setup, Warmup, Measure };
+
+	struct FTrackedFollower
+	{
+		TWeakObjectPtr<USplineFollowerComponent> Follower;
+		TSharedPtr<const FTrackTable> TrackTable;
+		float LastDistance = 0.0f;
+		double TravelledDistance = 0.0;
+	};
+
+	static UWorld* GetGameWorld()
+	{
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			if ((Context.WorldType == EWorldType::PIE || Context.WorldType == EWorldType::Game) && Context.World())
+				return Context.World();
+		}
+		return nullptr;
+	}
+
+	bool Setup(UWorld& World)
+	{
+		// deterministic frame time and full physics for every vehicle
+		bPrevFixedTimeStep = FApp::UseFixedTimeStep();
+		PrevFixedDeltaTime = FApp::GetFixedDeltaTime();
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(DriverlessPerf::FixedDeltaTime);
+
+		if (IConsoleVariable* LODDistance = IConsoleManager::Get().FindConsoleVariable(TEXT("Driverless.PhysicsLODDistance")))
+		{
+			PrevLODDistance = LODDistance->GetFloat();
+			LODDistance->Set(0.0f, ECVF_SetByCode);
+		}
+		bSettingsChanged = true;
+
+		const double SpawnStart = FPlatformTime::Seconds();
+
+		AObstacleSpawnerActor* Spawner = nullptr;
+		for (TActorIterator<AObstacleSpawnerActor> It(&World); It; ++It)
+		{
+			Spawner = *It;
+			break;
+		}
+		if (!Spawner || !Spawner->GetTrackSplineActor())
+		{
+			Test->AddError(TEXT("The benchmark map has no configured ObstacleSpawnerActor."));
+			return false;
+		}
+		Spawner->RandomSeed = DriverlessPerf::RandomSeed;
+		Spawner->NumberOfObstacles = DriverlessPerf::NumberOfCones;
+		Spawner->RespawnObstacles();
+
+		// the level's own followers act as template, the benchmark replaces them with its own set
+		APawn* TemplatePawn = nullptr;
+		USplineFollowerComponent* TemplateFollower = nullptr;
+		TArray<APawn*> LevelPawns;
+		for (TActorIterator<APawn> It(&World); It; ++It)
+		{
+			if (USplineFollowerComponent* Follower = It->FindComponentByClass<USplineFollowerComponent>())
+			{
+				if (!TemplatePawn)
+				{
+					TemplatePawn = *It;
+					TemplateFollower = Follower;
+				}
+				LevelPawns.Add(*It);
+			}
+		}
+		if (!TemplatePawn || !TemplateFollower->TargetTrackActor)
+		{
+			Test->AddError(TEXT("The benchmark map has no vehicle with a SplineFollowerComponent to use as template."));
+			return false;
+		}
+
+		AActor* TrackActor = TemplateFollower->TargetTrackActor;
+		UDriverlessTrackSubsystem* TrackSubsystem = World.GetSubsystem<UDriverlessTrackSubsystem>();
+		// the spline is null when the track was baked
+		TSharedPtr<const FTrackTable> TrackTable = TrackSubsystem ? TrackSubsystem->GetTrackTable(TrackActor, TemplateFollower->GetSplineToFollow()) : nullptr;
+		if (!TrackTable.IsValid() || !TrackTable->IsValid())
+		{
+			Test->AddError(TEXT("Unable to build the track table of the benchmark track."));
+			return false;
+		}
+
+		UClass* PawnClass = TemplatePawn->GetClass();
+		// followers the pawn class brings along (native or Blueprint components) only exist once the pawn is constructed and
+		// begin play right after, the instance settings of the level's pawn (the track) are applied during construction
+		const FComponentInstanceDataCache TemplateInstanceData(TemplatePawn);
+		for (APawn* Pawn : LevelPawns)
+			Pawn->Destroy();
+
+		// evenly spaced along the track, slightly above it so the wheels drop onto the road
+		for (int32 Index = 0; Index < NumFollowers; ++Index)
+		{
+			const float Distance = TrackTable->Length * Index / NumFollowers;
+			const FTransform SpawnTransform(TrackTable->GetDirectionAtDistance(Distance).Rotation(), TrackTable->GetLocationAtDistance(Distance) + FVector(0.0f, 0.0f, 100.0f));
+
+			APawn* Pawn = World.SpawnActorDeferred<APawn>(PawnClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+			if (!Pawn)
+				continue;
+
+			Pawn->FinishSpawning(SpawnTransform, false, &TemplateInstanceData);
+			Pawn->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
+
+			// the level's follower was added to its pawn rather than being part of the class
+			USplineFollowerComponent* Follower = Pawn->FindComponentByClass<USplineFollowerComponent>();
+			if (!Follower)
+			{
+				Follower = Cast<USplineFollowerComponent>(Pawn->AddComponentByClass(USplineFollowerComponent::StaticClass(), false, FTransform::Identity, true));
+				if (Follower)
+				{
+					Follower->TargetTrackActor = TrackActor;
+					Pawn->FinishAddComponent(Follower, false, FTransform::Identity);
+				}
+			}
+			if (!Follower || Follower->TargetTrackActor != TrackActor)
+			{
+				Test->AddError(FString::Printf(TEXT("Follower %d did not start on the benchmark track."), Index));
+				return false;
+			}
+			Follower->TelemetryDisplayIndex = Index;
+
+			if (!Pawn->GetController())
+				Pawn->SpawnDefaultController();
+
+			FTrackedFollower& Tracked = TrackedFollowers.AddDefaulted_GetRef();
+			Tracked.Follower = Follower;
+			Tracked.TrackTable = TrackTable;
+		}
+
+		Results.SpawnMs = (FPlatformTime::Seconds() - SpawnStart) * 1000.0;
+
+		if (TrackedFollowers.Num() != NumFollowers)
+		{
+			Test->AddError(FString::Printf(TEXT("Spawned %d followers out of %d."), TrackedFollowers.Num(), NumFollowers));
+			return false;
+		}
+
+		TickSamples.Reserve(NumFollowers * FMath::CeilToInt(DriverlessPerf::MeasureSeconds / DriverlessPerf::FixedDeltaTime));
+		return true;
+	}
+
+	void ResetProgress()
+	{
+		for (FTrackedFollower& Tracked : TrackedFollowers)
+		{
+			if (USplineFollowerComponent* Follower = Tracked.Follower.Get())
+				Tracked.LastDistance = Tracked.TrackTable->FindDistanceClosestToLocation(Follower->GetOwner()->GetActorLocation());
+			Tracked.TravelledDistance = 0.0;
+		}
+	}
+
+	void Sample()
+	{
+		for (FTrackedFollower& Tracked : TrackedFollowers)
+		{
+			USplineFollowerComponent* Follower = Tracked.Follower.Get();
+			if (!Follower)
+				continue;
+
+			TickSamples.Add(Follower->GetLastTickSeconds());
+
+			const FTrackTable& Table = *Tracked.TrackTable;
+			const float Distance = Table.FindDistanceClosestToLocation(Follower->GetOwner()->GetActorLocation(), Tracked.LastDistance);
+			float Delta = Distance - Tracked.LastDistance;
+			// crossing the start line of a closed track
+			if (Table.bClosedLoop)
+			{
+				if (Delta < -0.5f * Table.Length) Delta += Table.Length;
+				else if (Delta > 0.5f * Table.Length) Delta -= Table.Length;
+			}
+			Tracked.TravelledDistance += Delta;
+			Tracked.LastDistance = Distance;
+		}
+	}
+
+	void Report()
+	{
+		using namespace DriverlessPerf;
+
+		if (TickSamples.Num() == 0)
+		{
+			Test->AddError(TEXT("No follower tick was sampled."));
+			return;
+		}
+
+		TickSamples.Sort();
+		double Sum = 0.0;
+		for (double Sample : TickSamples)
+			Sum += Sample;
+
+		Results.NumSamples = TickSamples.Num();
+		Results.AvgTickUs = Sum / TickSamples.Num() * 1e6;
+		Results.P99TickUs = TickSamples[FMath::Min(TickSamples.Num() - 1, FMath::FloorToInt(TickSamples.Num() * 0.99))] * 1e6;
+
+		double TotalDistance = 0.0;
+		for (const FTrackedFollower& Tracked : TrackedFollowers)
+			TotalDistance += FMath::Max(0.0, Tracked.TravelledDistance) / Tracked.TrackTable->Length;
+		Results.Laps = TotalDistance / TrackedFollowers.Num();
+
+		Test->AddInfo(FString::Printf(TEXT("%d followers: spawn %.2f ms, tick avg %.2f us, p99 %.2f us (%d samples), %.3f laps per vehicle in %.0f s"),
+			NumFollowers, Results.SpawnMs, Results.AvgTickUs, Results.P99TickUs, Results.NumSamples, Results.Laps, MeasureSeconds));
+
+		CompareToBaseline();
+	}
+
+	void CompareToBaseline()
+	{
+		using namespace DriverlessPerf;
+
+		const FString BaselineFile = GetBaselineFile();
+		const FString Section = FString::Printf(TEXT("Followers_%d"), NumFollowers);
+
+		FConfigFile Baseline;
+		Baseline.Read(BaselineFile);
+
+		double BaselineAvg = 0.0, BaselineP99 = 0.0, BaselineSpawn = 0.0, BaselineLaps = 0.0;
+		double Tolerance = DefaultTolerance;
+		Baseline.GetDouble(TEXT("General"), TEXT("Tolerance"), Tolerance);
+
+		const bool bHasBaseline = Baseline.GetDouble(*Section, TEXT("AvgTickUs"), BaselineAvg)
+			&& Baseline.GetDouble(*Section, TEXT("P99TickUs"), BaselineP99)
+			&& Baseline.GetDouble(*Section, TEXT("SpawnMs"), BaselineSpawn)
+			&& Baseline.GetDouble(*Section, TEXT("Laps"), BaselineLaps);
+
+		// the first run on a machine has nothing to compare with, it becomes the reference of the next ones
+		if (!bHasBaseline || FParse::Param(FCommandLine::Get(), TEXT("DriverlessPerfUpdateBaseline")))
+		{
+			Baseline.SetDouble(*Section, TEXT("AvgTickUs"), Results.AvgTickUs);
+			Baseline.SetDouble(*Section, TEXT("P99TickUs"), Results.P99TickUs);
+			Baseline.SetDouble(*Section, TEXT("SpawnMs"), Results.SpawnMs);
+			Baseline.SetDouble(*Section, TEXT("Laps"), Results.Laps);
+			if (!Baseline.Contains(TEXT("General")))
+				Baseline.SetDouble(TEXT("General"), TEXT("Tolerance"), Tolerance);
+			Baseline.Dirty = true;
+			Baseline.Write(BaselineFile);
+			Test->AddWarning(FString::Printf(TEXT("%s baseline for %d followers in %s, nothing compared."),
+				bHasBaseline ? TEXT("Recorded a new") : TEXT("No baseline yet, recorded a"), NumFollowers, *BaselineFile));
+			return;
+		}
+
+		auto CheckNotAbove = [this, Tolerance](const TCHAR* Name, double Value, double Reference)
+		{
+			if (Reference > 0.0 && Value > Reference * (1.0 + Tolerance))
+				Test->AddError(FString::Printf(TEXT("%s regressed: %.2f vs baseline %.2f (tolerance %.0f%%)."), Name, Value, Reference, Tolerance * 100.0));
+		};
+
+		CheckNotAbove(TEXT("Average follower tick (us)"), Results.AvgTickUs, BaselineAvg);
+		CheckNotAbove(TEXT("p99 follower tick (us)"), Results.P99TickUs, BaselineP99);
+		CheckNotAbove(TEXT("Spawn time (ms)"), Results.SpawnMs, BaselineSpawn);
+
+		// the vehicles must still get around the track, otherwise a cheaper tick is meaningless
+		if (Results.Laps < BaselineLaps * (1.0 - Tolerance))
+		{
+			Test->AddError(FString::Printf(TEXT("Lap completion regressed: %.3f laps vs baseline %.3f (tolerance %.0f%%)."), Results.Laps, BaselineLaps, Tolerance * 100.0));
+		}
+	}
+
+	void RestoreSettings()
+	{
+		if (!bSettingsChanged)
+			return;
+
+		FApp::SetUseFixedTimeStep(bPrevFixedTimeStep);
+		FApp::SetFixedDeltaTime(PrevFixedDeltaTime);
+		if (IConsoleVariable* LODDistance = IConsoleManager::Get().FindConsoleVariable(TEXT("Driverless.PhysicsLODDistance")))
+			LODDistance->Set(PrevLODDistance, ECVF_SetByCode);
+		bSettingsChanged = false;
+	}
+
+	FAutomationTestBase* Test;
+	int32 NumFollowers;
+
+	EPhase Phase = EPhase::Setup;
+	double PhaseStartTime = 0.0;
+
+	TArray<FTrackedFollower> TrackedFollowers;
+	TArray<double> TickSamples;
+	DriverlessPerf::FResults Results;
+
+	bool bSettingsChanged = false;
+	bool bPrevFixedTimeStep = false;
+	double PrevFixedDeltaTime = 0.0;
+	float PrevLODDistance = 0.0f;
+};
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FDriverlessFollowerPerfTest, "Driverless.Perf.Followers",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FDriverlessFollowerPerfTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const int32 NumFollowers : { 1, 10, 100 })
+	{
+		OutBeautifiedNames.Add(FString::Printf(TEXT("%d"), NumFollowers));
+		OutTestCommands.Add(FString::FromInt(NumFollowers));
+	}
+}
+
+bool FDriverlessFollowerPerfTest::RunTest(const FString& Parameters)
+{
+	const int32 NumFollowers = FCString::Atoi(*Parameters);
+	if (NumFollowers <= 0)
+	{
+		AddError(FString::Printf(TEXT("Invalid follower count '%s'."), *Parameters));
+		return false;
+	}
+
+	AutomationOpenMap(DriverlessPerf::MapName);
+	ADD_LATENT_AUTOMATION_COMMAND(FDriverlessPerfRunCommand(this, NumFollowers));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrackDataAsset.h"
+#include "GameFramework/Actor.h"
+#include "TrackTable.h"
+
+void UTrackDataAsset::SetFromTable(const FString& InTrackName, uint32 InSourceHash, const FTrackTable& Table)
+{
+	Version = LatestVersion;
+	TrackName = InTrackName;
+	SourceHash = InSourceHash;
+
+	SampleSpacing = Table.SampleSpacing;
+	BoundaryRange = Table.BoundaryRange;
+	Length = Table.Length;
+	bClosedLoop = Table.bClosedLoop;
+
+	Locations = Table.Locations;
+	Directions = Table.Directions;
+	Tangents = Table.Tangents;
+	Curvature = Table.Curvature;
+	SpeedProfile = Table.SpeedProfile;
+	LeftBoundary = Table.LeftBoundary;
+	RightBoundary = Table.RightBoundary;
+
+	IndexOrigin = Table.IndexOrigin;
+	IndexCellSize = Table.IndexCellSize;
+	IndexSizeX = Table.IndexSizeX;
+	IndexSizeY = Table.IndexSizeY;
+	IndexCellStarts = Table.IndexCellStarts;
+	IndexSegments = Table.IndexSegments;
+}
+
+TSharedRef<FTrackTable> UTrackDataAsset::BuildTable() const
+{
+	TSharedRef<FTrackTable> Table = MakeShared<FTrackTable>();
+	Table->SampleSpacing = SampleSpacing;
+	Table->Length = Length;
+	Table->bClosedLoop = bClosedLoop;
+
+	Table->Locations = Locations;
+	Table->Directions = Directions;
+	Table->Tangents = Tangents;
+	Table->Curvature = Curvature;
+	Table->SpeedProfile = SpeedProfile;
+	Table->LeftBoundary = LeftBoundary;
+	Table->RightBoundary = RightBoundary;
+	Table->BoundaryRange = BoundaryRange;
+
+	Table->IndexOrigin = IndexOrigin;
+	Table->IndexCellSize = IndexCellSize;
+	Table->IndexSizeX = IndexSizeX;
+	Table->IndexSizeY = IndexSizeY;
+	Table->IndexCellStarts = IndexCellStarts;
+	Table->IndexSegments = IndexSegments;
+
+	return Table;
+}
+
+FString UTrackDataAsset::GetStaleReason(const AActor* TrackActor, uint32 CurrentSourceHash, float CurrentSampleSpacing, float CurrentBoundaryRange) const
+{
+	if (Version != LatestVersion)
+		return FString::Printf(TEXT("baked with version %d, the table is now at version %d"), Version, LatestVersion);
+
+	if (!TrackActor || TrackActor->GetName() != TrackName)
+		return FString::Printf(TEXT("baked for '%s'"), *TrackName);
+
+	if (SourceHash != CurrentSourceHash)
+		return TEXT("the spline was edited since");
+
+	if (!FMath::IsNearlyEqual(SampleSpacing, CurrentSampleSpacing, 1.0f) || !FMath::IsNearlyEqual(BoundaryRange, CurrentBoundaryRange, 1.0f))
+		return FString::Printf(TEXT("baked every %.0f cm within %.0f cm, the settings are now %.0f cm and %.0f cm"),
+			SampleSpacing, BoundaryRange, CurrentSampleSpacing, CurrentBoundaryRange);
+
+	const int32 NumSamples = Locations.Num();
+	const bool bComplete = NumSamples >= 2 && Directions.Num() == NumSamples && Tangents.Num() == NumSamples && Curvature.Num() == NumSamples
+		&& SpeedProfile.Num() == NumSamples && LeftBoundary.Num() == NumSamples && RightBoundary.Num() == NumSamples;
+	if (!bComplete)
+		return TEXT("its samples are incomplete");
+
+	return FString();
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "TrackDataAsset.generated.h"
+
+struct FTrackTable;
+
+/**
+ * Track table of a track actor, baked offline by the DriverlessTrackData commandlet: samples, curvature, speed profile,
+ * boundaries and spatial index exactly as the table holds them, so loading it is a copy instead of converting and
+ * resampling the spline and tracing the walls.
+ */
+UCLASS(BlueprintType)
+class DRIVERLESSTASK_API UTrackDataAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// bumped whenever the table or the way it's built changes, older assets are ignored
+	static constexpr int32 LatestVersion = 1;
+
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	int32 Version = 0;
+
+	// name of the track actor the table was baked from, and the hash of its spline then (see HashTrackSource)
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	FString TrackName;
+
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	uint32 SourceHash = 0;
+
+	// settings the table was built with
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	float SampleSpacing = 100.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	float BoundaryRange = 0.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	float Length = 0.0f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Track Data")
+	bool bClosedLoop = false;
+
+	// one entry per sample, as in the track table
+	UPROPERTY()
+	TArray<FVector> Locations;
+
+	UPROPERTY()
+	TArray<FVector> Directions;
+
+	UPROPERTY()
+	TArray<FVector> Tangents;
+
+	UPROPERTY()
+	TArray<float> Curvature;
+
+	UPROPERTY()
+	TArray<float> SpeedProfile;
+
+	UPROPERTY()
+	TArray<float> LeftBoundary;
+
+	UPROPERTY()
+	TArray<float> RightBoundary;
+
+	// spatial index of the table
+	UPROPERTY()
+	FVector2D IndexOrigin = FVector2D::ZeroVector;
+
+	UPROPERTY()
+	float IndexCellSize = 0.0f;
+
+	UPROPERTY()
+	int32 IndexSizeX = 0;
+
+	UPROPERTY()
+	int32 IndexSizeY = 0;
+
+	UPROPERTY()
+	TArray<int32> IndexCellStarts;
+
+	UPROPERTY()
+	TArray<int32> IndexSegments;
+
+	void SetFromTable(const FString& InTrackName, uint32 InSourceHash, const FTrackTable& Table);
+
+	// the baked table as is, nothing is recomputed
+	TSharedRef<FTrackTable> BuildTable() const;
+
+	// why the asset can't stand in for the table of TrackActor as it is now (another actor, an edited spline, other settings),
+	// empty when it can
+	FString GetStaleReason(const AActor* TrackActor, uint32 CurrentSourceHash, float CurrentSampleSpacing, float CurrentBoundaryRange) const;
+};